@@ -18,6 +18,403 @@ const char* Buffer::__CNAME = "Buffer";
  */
 static const char __digits[17] = "0123456789ABCDEF";
 
+/**
+ * `__digits2` contains pair of decimal digits from "00" until "99", used to
+ * convert integer to string two digits at a time.
+ */
+static const char __digits2[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/**
+ * Function U64_DEC_LEN(v) will return number of decimal digits in `v`.
+ */
+static size_t U64_DEC_LEN(uint64_t v)
+{
+	size_t n = 1;
+
+	for (;;) {
+		if (v < 10) {
+			return n;
+		}
+		if (v < 100) {
+			return n + 1;
+		}
+		if (v < 1000) {
+			return n + 2;
+		}
+		if (v < 10000) {
+			return n + 3;
+		}
+		v /= 10000;
+		n += 4;
+	}
+}
+
+/**
+ * Function U64_TO_DEC(end,v) will write decimal representation of `v`
+ * backward, with the last digit at `end - 1`.
+ */
+static void U64_TO_DEC(char* end, uint64_t v)
+{
+	while (v >= 100) {
+		size_t r = size_t(v % 100) * 2;
+		v /= 100;
+		*--end = __digits2[r + 1];
+		*--end = __digits2[r];
+	}
+	if (v >= 10) {
+		size_t r = size_t(v) * 2;
+		*--end = __digits2[r + 1];
+		*--end = __digits2[r];
+	} else {
+		*--end = char('0' + v);
+	}
+}
+
+//
+// Shortest representation of double, using Grisu2 algorithm by Florian
+// Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with
+// Integers".
+//
+// The result is always can be read back to the same double, and in most
+// case its the shortest.
+//
+
+struct diy_fp {
+	uint64_t f;
+	int e;
+};
+
+static const uint64_t DP_SIGNIFICAND_MASK = 0x000FFFFFFFFFFFFFULL;
+static const uint64_t DP_EXPONENT_MASK = 0x7FF0000000000000ULL;
+static const uint64_t DP_HIDDEN_BIT = 0x0010000000000000ULL;
+static const int DP_SIGNIFICAND_SIZE = 52;
+static const int DP_EXPONENT_BIAS = 0x3FF + DP_SIGNIFICAND_SIZE;
+
+/**
+ * `__pow10_f` and `__pow10_e` contains normalized cached power of ten,
+ * 10^-348, 10^-340, ..., 10^340, as `f * 2^e`.
+ */
+static const uint64_t __pow10_f[] = {
+	0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+	0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+	0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+	0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+	0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+	0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+	0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+	0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+	0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+	0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+	0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+	0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+	0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+	0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+	0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+	0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+	0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+	0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+	0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+	0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+	0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+	0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+	0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+	0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+	0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+	0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+	0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+	0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+	0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const int16_t __pow10_e[] = {
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+	-954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+	-688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+	-422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+	-157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+	109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+	375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+	641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+	907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static const uint32_t __pow10_u32[] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+	1000000000
+};
+
+static diy_fp DIYFP_MUL(const diy_fp& x, const diy_fp& y)
+{
+	const uint64_t M32 = 0xFFFFFFFFULL;
+	uint64_t a = x.f >> 32;
+	uint64_t b = x.f & M32;
+	uint64_t c = y.f >> 32;
+	uint64_t d = y.f & M32;
+	uint64_t ac = a * c;
+	uint64_t bc = b * c;
+	uint64_t ad = a * d;
+	uint64_t bd = b * d;
+	uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+	diy_fp r;
+
+	// Round.
+	tmp += 1ULL << 31;
+
+	r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+	r.e = x.e + y.e + 64;
+
+	return r;
+}
+
+static diy_fp DIYFP_NORMALIZE(diy_fp x)
+{
+	while (!(x.f & (1ULL << 63))) {
+		x.f <<= 1;
+		x.e--;
+	}
+	return x;
+}
+
+/**
+ * Function DIYFP_BOUNDARIES(d,m,p) will convert `d` into diy_fp and compute
+ * their normalized lower boundary `m` and upper boundary `p`.
+ */
+static diy_fp DIYFP_BOUNDARIES(double d, diy_fp* m, diy_fp* p)
+{
+	uint64_t u;
+	diy_fp v;
+
+	memcpy(&u, &d, sizeof(u));
+
+	int be = int((u & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE);
+	uint64_t sig = u & DP_SIGNIFICAND_MASK;
+
+	if (be) {
+		v.f = sig + DP_HIDDEN_BIT;
+		v.e = be - DP_EXPONENT_BIAS;
+	} else {
+		v.f = sig;
+		v.e = 1 - DP_EXPONENT_BIAS;
+	}
+
+	p->f = (v.f << 1) + 1;
+	p->e = v.e - 1;
+	while (!(p->f & (DP_HIDDEN_BIT << 1))) {
+		p->f <<= 1;
+		p->e--;
+	}
+	p->f <<= 64 - DP_SIGNIFICAND_SIZE - 2;
+	p->e -= 64 - DP_SIGNIFICAND_SIZE - 2;
+
+	if (v.f == DP_HIDDEN_BIT) {
+		m->f = (v.f << 2) - 1;
+		m->e = v.e - 2;
+	} else {
+		m->f = (v.f << 1) - 1;
+		m->e = v.e - 1;
+	}
+	m->f <<= m->e - p->e;
+	m->e = p->e;
+
+	return v;
+}
+
+/**
+ * Function DIYFP_CACHED_POW10(e,k) will return cached power of ten `10^-k`
+ * such that their product with number with binary exponent `e` has exponent
+ * in range [-60, -32].
+ */
+static diy_fp DIYFP_CACHED_POW10(int e, int* k)
+{
+	double dk = (-61 - e) * 0.30102999566398114 + 347;
+	int ik = int(dk);
+
+	if (dk - ik > 0.0) {
+		ik++;
+	}
+
+	size_t idx = size_t((ik >> 3) + 1);
+	diy_fp c;
+
+	*k = -(-348 + int(idx) * 8);
+	c.f = __pow10_f[idx];
+	c.e = __pow10_e[idx];
+
+	return c;
+}
+
+static void GRISU_ROUND(char* bfr, int len, uint64_t delta, uint64_t rest
+	, uint64_t ten_kappa, uint64_t wp_w)
+{
+	while (rest < wp_w && delta - rest >= ten_kappa
+	&& (rest + ten_kappa < wp_w
+		|| wp_w - rest > rest + ten_kappa - wp_w)) {
+		bfr[len - 1]--;
+		rest += ten_kappa;
+	}
+}
+
+static int GRISU_DIGIT_GEN(const diy_fp& w, const diy_fp& mp
+	, uint64_t delta, char* bfr, int* k)
+{
+	int one_e = -mp.e;
+	uint64_t one_f = 1ULL << one_e;
+	uint64_t wp_w = mp.f - w.f;
+	uint32_t p1 = uint32_t(mp.f >> one_e);
+	uint64_t p2 = mp.f & (one_f - 1);
+	int kappa = int(U64_DEC_LEN(p1));
+	int len = 0;
+
+	while (kappa > 0) {
+		uint32_t pow = __pow10_u32[kappa - 1];
+		uint32_t d = p1 / pow;
+
+		p1 %= pow;
+
+		if (d || len) {
+			bfr[len++] = char('0' + d);
+		}
+		kappa--;
+
+		uint64_t tmp = (uint64_t(p1) << one_e) + p2;
+		if (tmp <= delta) {
+			*k += kappa;
+			GRISU_ROUND(bfr, len, delta, tmp
+				, uint64_t(__pow10_u32[kappa]) << one_e, wp_w);
+			return len;
+		}
+	}
+
+	for (;;) {
+		p2 *= 10;
+		delta *= 10;
+
+		char d = char(p2 >> one_e);
+		if (d || len) {
+			bfr[len++] = char('0' + d);
+		}
+		p2 &= one_f - 1;
+		kappa--;
+
+		if (p2 < delta) {
+			*k += kappa;
+			int idx = -kappa;
+			GRISU_ROUND(bfr, len, delta, p2, one_f
+				, wp_w * (idx < 10 ? __pow10_u32[idx] : 0));
+			return len;
+		}
+	}
+}
+
+/**
+ * Function GRISU2(d,bfr,k) will generate the shortest digits of positive
+ * double `d` into `bfr`, where `d = bfr * 10^k`.
+ *
+ * It will return number of digits.
+ */
+static int GRISU2(double d, char* bfr, int* k)
+{
+	diy_fp m;
+	diy_fp p;
+	diy_fp v = DIYFP_BOUNDARIES(d, &m, &p);
+	diy_fp c = DIYFP_CACHED_POW10(p.e, k);
+	diy_fp w = DIYFP_MUL(DIYFP_NORMALIZE(v), c);
+	diy_fp wp = DIYFP_MUL(p, c);
+	diy_fp wm = DIYFP_MUL(m, c);
+
+	wm.f++;
+	wp.f--;
+
+	return GRISU_DIGIT_GEN(w, wp, wp.f - wm.f, bfr, k);
+}
+
+/**
+ * Function DTOA_SHORTEST(d,out) will write the shortest representation of
+ * finite and positive double `d` that round-trip into `out`.
+ *
+ * Number with decimal exponent in range [-6, 21] is written in decimal
+ * notation with at least one fractional digit (e.g. "1.0", "0.001"),
+ * otherwise it will be written in scientific notation (e.g. "1.5e+300").
+ *
+ * It will return length of `out`, which is never greater than 26.
+ */
+static size_t DTOA_SHORTEST(double d, char* out)
+{
+	char digits[24];
+	int k = 0;
+	int len;
+
+	if (d == 0) {
+		memcpy(out, "0.0", 3);
+		return 3;
+	}
+
+	len = GRISU2(d, digits, &k);
+
+	int kk = len + k;
+	size_t n = 0;
+
+	if (k >= 0 && kk <= 21) {
+		// dddd000.0
+		memcpy(out, digits, size_t(len));
+		n = size_t(len);
+		for (int x = 0; x < k; x++) {
+			out[n++] = '0';
+		}
+		out[n++] = '.';
+		out[n++] = '0';
+	} else if (kk > 0 && kk <= 21) {
+		// dd.dd
+		memcpy(out, digits, size_t(kk));
+		n = size_t(kk);
+		out[n++] = '.';
+		memcpy(&out[n], &digits[kk], size_t(len - kk));
+		n += size_t(len - kk);
+	} else if (kk > -6 && kk <= 0) {
+		// 0.000dddd
+		out[n++] = '0';
+		out[n++] = '.';
+		for (int x = kk; x < 0; x++) {
+			out[n++] = '0';
+		}
+		memcpy(&out[n], digits, size_t(len));
+		n += size_t(len);
+	} else {
+		// d.ddde+xxx
+		out[n++] = digits[0];
+		if (len > 1) {
+			out[n++] = '.';
+			memcpy(&out[n], &digits[1], size_t(len - 1));
+			n += size_t(len - 1);
+		}
+		out[n++] = 'e';
+
+		int exp = kk - 1;
+		if (exp < 0) {
+			out[n++] = '-';
+			exp = -exp;
+		} else {
+			out[n++] = '+';
+		}
+
+		size_t elen = U64_DEC_LEN(uint64_t(exp));
+		U64_TO_DEC(&out[n + elen], uint64_t(exp));
+		n += elen;
+	}
+
+	return n;
+}
+
 enum __print_flag {
 	FL_LEFT_ADJUST	= (1 << 0)
 ,	FL_SIGN		= (1 << 1)
@@ -33,6 +430,149 @@ enum __print_flag {
 ,	FL_LONG_DBL	= (1 << 11)
 };
 
+//
+// Parsing decimal number using SWAR (SIMD within a register), converting
+// eight digits at a time.
+//
+
+/**
+ * `__pow10_u64` contains power of ten from 10^0 until 10^19.
+ */
+static const uint64_t __pow10_u64[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL
+,	10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL
+,	100000000000ULL, 1000000000000ULL, 10000000000000ULL
+,	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL
+,	100000000000000000ULL, 1000000000000000000ULL
+,	10000000000000000000ULL
+};
+
+/**
+ * `PARSE_DOUBLE_MAX` define the maximum length of number that can be parsed
+ * by PARSE_DOUBLE(), including the NUL terminator.
+ */
+static const size_t PARSE_DOUBLE_MAX = 512;
+
+/**
+ * `__pow10_dbl` contains power of ten that can be represented exactly as
+ * double, from 10^0 until 10^22.
+ */
+static const double __pow10_dbl[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11
+,	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * Function LOAD_8CHARS(p) will load eight characters from `p` into 64 bit
+ * integer, with the first character in the lowest byte.
+ */
+static uint64_t LOAD_8CHARS(const char* p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+/**
+ * Function IS_8DIGITS(v) will return non-zero if all eight characters in `v`
+ * are decimal digits.
+ */
+static int IS_8DIGITS(uint64_t v)
+{
+	return (((v & 0xF0F0F0F0F0F0F0F0ULL)
+		| (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4))
+		== 0x3333333333333333ULL);
+}
+
+/**
+ * Function CONVERT_8DIGITS(v) will convert eight decimal digits in `v` into
+ * their integer value.
+ */
+static uint32_t CONVERT_8DIGITS(uint64_t v)
+{
+	const uint64_t mask = 0x000000FF000000FFULL;
+	const uint64_t mul1 = 0x000F424000000064ULL; // 100 + (1000000 << 32)
+	const uint64_t mul2 = 0x0000271000000001ULL; // 1 + (10000 << 32)
+
+	v -= 0x3030303030303030ULL;
+	v = (v * 10) + (v >> 8);
+	v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+
+	return uint32_t(v);
+}
+
+/**
+ * Function PARSE_DIGITS(p,end,v,nsig) will parse decimal digits from `p`
+ * until the first non digit character or `end`.
+ *
+ * The result is saved in `v`, and it may overflow if number of significant
+ * digits, saved in `nsig`, is greater than 19.
+ *
+ * It will return pointer to the first character after the last digit.
+ */
+static const char* PARSE_DIGITS(const char* p, const char* end, uint64_t* v
+	, size_t* nsig)
+{
+	uint64_t r = 0;
+
+	while (p < end && *p == '0') {
+		p++;
+	}
+
+	const char* s = p;
+
+	while (end - p >= 8) {
+		uint64_t chunk = LOAD_8CHARS(p);
+
+		if (!IS_8DIGITS(chunk)) {
+			break;
+		}
+
+		r = r * 100000000ULL + CONVERT_8DIGITS(chunk);
+		p += 8;
+	}
+	while (p < end && uint8_t(*p - '0') < 10) {
+		r = r * 10 + uint64_t(*p - '0');
+		p++;
+	}
+
+	*v = r;
+	*nsig = size_t(p - s);
+
+	return p;
+}
+
+/**
+ * Function PARSE_SIGN(p,end,neg) will skip leading white-spaces and parse
+ * optional sign character.
+ *
+ * It will return pointer to the first character after the sign.
+ */
+static const char* PARSE_SIGN(const char* p, const char* end, int* neg)
+{
+	while (p < end && isspace(*p)) {
+		p++;
+	}
+
+	*neg = 0;
+
+	if (p < end) {
+		if (*p == '-') {
+			*neg = 1;
+			p++;
+		} else if (*p == '+') {
+			p++;
+		}
+	}
+
+	return p;
+}
+
 /**
  * Variable CHAR_SIZE is a constant for size of char, to minimize calling the
  * sizeof.
@@ -85,28 +625,342 @@ int Buffer::CMP(Object* x, Object* y)
  */
 Error Buffer::PARSE_INT(char** pp, int* v)
 {
-	long int lv = 0;
 	char* p = (*pp);
-	char* end = p;
+	size_t n = 0;
+	int32_t i32 = 0;
 
-	errno = 0;
+	Error err = PARSE_I32(p, strlen(p), &i32, &n);
+	if (err != NULL) {
+		return err;
+	}
+
+	(*pp) = p + n;
+	(*v) = i32;
+
+	return 0;
+}
+
+/**
+ * Method PARSE_I32(p,len,v,n) will parse 32 bit signed integer in base 10
+ * from `p` with maximum length `len`. The string `p` does not need to be
+ * terminated by NUL.
+ *
+ * Leading white-spaces and sign character are skipped. Parsing stop at the
+ * first non digit character.
+ *
+ * On success it will return NULL, save the number to `v`, and set `n`, if its
+ * not NULL, to the number of characters that has been parsed. If `p` does not
+ * start with number, `v` and `n` will be set to zero.
+ *
+ * On fail it will return ErrNumRange and value of `v` and `n` will not
+ * changed.
+ */
+Error Buffer::PARSE_I32(const char* p, size_t len, int32_t* v, size_t* n)
+{
+	int64_t i64 = 0;
+	size_t nn = 0;
+
+	Error err = PARSE_I64(p, len, &i64, &nn);
+	if (err != NULL) {
+		return err;
+	}
+	if (i64 > INT32_MAX || i64 < INT32_MIN) {
+		return ErrNumRange;
+	}
+
+	*v = int32_t(i64);
+	if (n) {
+		*n = nn;
+	}
+
+	return 0;
+}
+
+/**
+ * Method PARSE_I64(p,len,v,n) will parse 64 bit signed integer in base 10
+ * from `p` with maximum length `len`.
+ *
+ * See PARSE_I32() for the rules and return value.
+ */
+Error Buffer::PARSE_I64(const char* p, size_t len, int64_t* v, size_t* n)
+{
+	const char* end = p + len;
+	const char* d;
+	const char* e;
+	uint64_t r = 0;
+	size_t nsig = 0;
+	int neg = 0;
+
+	d = PARSE_SIGN(p, end, &neg);
+	e = PARSE_DIGITS(d, end, &r, &nsig);
+
+	if (e == d) {
+		*v = 0;
+		if (n) {
+			*n = 0;
+		}
+		return 0;
+	}
+	if (nsig > 19 || r > uint64_t(INT64_MAX) + uint64_t(neg)) {
+		return ErrNumRange;
+	}
+
+	*v = neg ? int64_t(0ULL - r) : int64_t(r);
+	if (n) {
+		*n = size_t(e - p);
+	}
+
+	return 0;
+}
+
+/**
+ * Method PARSE_U64(p,len,v,n) will parse 64 bit unsigned integer in base 10
+ * from `p` with maximum length `len`. Negative number is not allowed.
+ *
+ * See PARSE_I32() for the rules and return value.
+ */
+Error Buffer::PARSE_U64(const char* p, size_t len, uint64_t* v, size_t* n)
+{
+	const char* end = p + len;
+	const char* d;
+	const char* e;
+	uint64_t r = 0;
+	size_t nsig = 0;
+	int neg = 0;
+
+	d = PARSE_SIGN(p, end, &neg);
+	if (neg) {
+		d = p;
+	}
+
+	e = PARSE_DIGITS(d, end, &r, &nsig);
+
+	if (e == d) {
+		*v = 0;
+		if (n) {
+			*n = 0;
+		}
+		return 0;
+	}
+
+	// Number with 20 digits is only valid if its start with '1' and
+	// does not wrap around.
+	if (nsig > 20 || (nsig == 20 && (e[-20] != '1'
+	|| r < 10000000000000000000ULL))) {
+		return ErrNumRange;
+	}
+
+	*v = r;
+	if (n) {
+		*n = size_t(e - p);
+	}
+
+	return 0;
+}
 
-	lv = strtol(p, &end, 10);
+/**
+ * Method PARSE_LINT(p,len,v,n) will parse long integer from `p` with maximum
+ * length `len`, using the same rules as strtol() with base 0: number that
+ * start with "0x" is parsed as hexadecimal and number that start with "0" is
+ * parsed as octal. Decimal number is parsed using PARSE_I64().
+ *
+ * See PARSE_I32() for the rules and return value.
+ */
+Error Buffer::PARSE_LINT(const char* p, size_t len, long int* v, size_t* n)
+{
+	const char* end = p + len;
+	const char* d;
+	int neg = 0;
+
+	d = PARSE_SIGN(p, end, &neg);
+
+	if (end - d >= 2 && d[0] == '0'
+	&& (d[1] == 'x' || d[1] == 'X' || isdigit(d[1]))) {
+		const char* x = d + 1;
+		unsigned int base = 8;
+		unsigned long r = 0;
+		int over = 0;
+
+		// "0x" without hexadecimal digit is parsed as "0", the same
+		// as strtol().
+		if ((d[1] == 'x' || d[1] == 'X') && end - d >= 3
+		&& isxdigit(d[2])) {
+			base = 16;
+			x = d + 2;
+		}
+
+		for (; x < end; x++) {
+			unsigned int c;
+
+			if (isdigit(*x)) {
+				c = unsigned(*x - '0');
+			} else if (base == 16 && isxdigit(*x)) {
+				c = unsigned(tolower(*x) - 'a' + 10);
+			} else {
+				break;
+			}
+			if (c >= base) {
+				break;
+			}
+			if (r > (ULONG_MAX - c) / base) {
+				over = 1;
+			} else {
+				r = r * base + c;
+			}
+		}
 
-	if (errno) {
-		if (errno == ERANGE) {
+		if (over || r > (unsigned long) LONG_MAX + unsigned(neg)) {
 			return ErrNumRange;
 		}
-		return Error(strerror(errno));
+
+		*v = neg ? long(0UL - r) : long(r);
+		if (n) {
+			*n = size_t(x - p);
+		}
+		return 0;
+	}
+
+	int64_t i64 = 0;
+	size_t nn = 0;
+
+	Error err = PARSE_I64(p, len, &i64, &nn);
+	if (err != NULL) {
+		return err;
+	}
+	if (i64 > LONG_MAX || i64 < LONG_MIN) {
+		return ErrNumRange;
+	}
+
+	*v = long(i64);
+	if (n) {
+		*n = nn;
+	}
+
+	return 0;
+}
+
+/**
+ * Method PARSE_DOUBLE(p,len,v,n) will parse floating point number in decimal
+ * notation, with optional fraction and exponent (e.g. "-12.34e-5"), from `p`
+ * with maximum length `len`.
+ *
+ * Number with no more than 19 significant digits and small exponent is
+ * converted exactly without calling strtod(). Number that is longer than
+ * PARSE_DOUBLE_MAX characters is rejected with ErrNumRange.
+ *
+ * See PARSE_I32() for the rules and return value.
+ */
+Error Buffer::PARSE_DOUBLE(const char* p, size_t len, double* v, size_t* n)
+{
+	const char* end = p + len;
+	const char* num;
+	const char* d;
+	const char* e;
+	uint64_t m = 0;
+	uint64_t frac = 0;
+	size_t nsig = 0;
+	size_t frac_sig = 0;
+	size_t frac_len = 0;
+	int neg = 0;
+	int has_digit = 0;
+	long int exp = 0;
+
+	num = p;
+	while (num < end && isspace(*num)) {
+		num++;
+	}
+
+	d = PARSE_SIGN(num, end, &neg);
+	e = PARSE_DIGITS(d, end, &m, &nsig);
+	has_digit = (e > d);
+
+	if (e < end && *e == '.') {
+		d = e + 1;
+		e = PARSE_DIGITS(d, end, &frac, &frac_sig);
+		frac_len = size_t(e - d);
+		has_digit |= (e > d);
+	}
+
+	if (!has_digit) {
+		*v = 0;
+		if (n) {
+			*n = 0;
+		}
+		return 0;
+	}
+
+	if (e < end && (*e == 'e' || *e == 'E')) {
+		int eneg = 0;
+		const char* x = e + 1;
+
+		if (x < end && (*x == '-' || *x == '+')) {
+			eneg = (*x == '-');
+			x++;
+		}
+		if (x < end && isdigit(*x)) {
+			while (x < end && isdigit(*x)) {
+				if (exp < 100000) {
+					exp = exp * 10 + (*x - '0');
+				}
+				x++;
+			}
+			if (eneg) {
+				exp = -exp;
+			}
+			e = x;
+		}
+	}
+
+	if (n) {
+		*n = size_t(e - p);
+	}
+
+	// Fast path: the mantissa and power of ten are exact in double.
+	if (nsig == 0 && frac_sig == 0) {
+		*v = neg ? -0.0 : 0.0;
+		return 0;
+	}
+	if (nsig + (nsig ? frac_len : frac_sig) <= 19) {
+		if (nsig) {
+			m = m * __pow10_u64[frac_len] + frac;
+		} else {
+			m = frac;
+		}
+
+		long int e10 = exp - long(frac_len);
+
+		if (m <= (1ULL << 53) && e10 >= -22 && e10 <= 22) {
+			double r = double(m);
+
+			if (e10 < 0) {
+				r /= __pow10_dbl[-e10];
+			} else {
+				r *= __pow10_dbl[e10];
+			}
+
+			*v = neg ? -r : r;
+			return 0;
+		}
+	}
+
+	// Slow path, strtod() require NUL terminated string.
+	char tmp[PARSE_DOUBLE_MAX];
+	size_t tmp_len = size_t(e - num);
+
+	if (tmp_len >= sizeof(tmp)) {
+		return ErrNumRange;
 	}
 
-	// value out of integer range.
-	if (lv > INT_MAX || lv < INT_MIN) {
+	memcpy(tmp, num, tmp_len);
+	tmp[tmp_len] = '\0';
+
+	errno = 0;
+	double r = strtod(tmp, NULL);
+	if (errno == ERANGE && (r > 1 || r < -1)) {
 		return ErrNumRange;
 	}
 
-	(*pp) = end;
-	(*v) = (int) lv;
+	*v = r;
 
 	return 0;
 }
@@ -611,102 +1465,149 @@ Error Buffer::appendc(const char c)
  */
 Error Buffer::appendi(long int i, size_t base)
 {
-	int x = -1;
-	long int ibase = int(base);
-	Error err;
-	char angka[23];
+	unsigned long u = (unsigned long) i;
 
 	if (i < 0) {
-		err = appendc('-');
+		Error err = appendc('-');
 		if (err != NULL) {
 			return err;
 		}
-		i = -(i);
-	}
-	while (i >= 0) {
-		++x;
-		angka[x] = __digits[i % ibase];
-		i = i / ibase;
-		if (0 == i) {
-			break;
-		}
+		u = 0UL - u;
 	}
-	while (x >= 0) {
-		err = appendc(angka[x]);
-		if (err != NULL) {
-			return err;
-		}
-		--x;
-	}
-	return 0;
+
+	return appendui(u, base);
 }
 
 /**
  * Method `appendui(i, base)` will append an unsigned long integer `i` as a
  * string to buffer. The value of `i` will be assumed in base 10.
  *
+ * Number in base 10 is converted two digits at a time and written directly
+ * into the end of buffer.
+ *
  * On success it will return NULL, otherwise it will return ErrOutOfMemory.
  */
 Error Buffer::appendui(long unsigned int i, size_t base)
 {
-	int x = 0;
-	char angka[23];
+	Error err;
 
-	angka[0] = '0';
+	if (base != 10) {
+		char angka[sizeof(i) * CHAR_BIT];
+		size_t x = sizeof(angka);
 
-	while (i > 0) {
-		angka[x] = __digits[i % base];
-		i = i / base;
-		if (0 == i) {
-			break;
-		}
-		++x;
+		do {
+			angka[--x] = __digits[i % base];
+			i = i / base;
+		} while (i > 0);
+
+		return append_raw(&angka[x], sizeof(angka) - x);
 	}
 
-	while (x >= 0) {
-		Error err = appendc(angka[x]);
-		if (err != NULL) {
-			return err;
-		}
-		--x;
+	size_t len = U64_DEC_LEN(i);
+
+	err = resize(_i + len);
+	if (err != NULL) {
+		return err;
 	}
+
+	_i += len;
+	U64_TO_DEC(&_v[_i], i);
+	_v[_i] = '\0';
+
 	return 0;
 }
 
 /**
  * Method `appendd(d, prec)` will append a double number as a string to
- * buffer.  Maximum digit in precision is six digits.
+ * buffer, with maximum `prec` digits of fraction. Fraction is truncated, not
+ * rounded, and zero fraction is written as single "0".
  *
  * On success it will return NULL, otherwise it will return ErrOutOfMemory.
  */
 Error Buffer::appendd(double d, size_t prec)
 {
-	long int i = (long int) d;
+	Error err;
+	size_t n = 0;
 
+	// Not a number, infinity, or integer part does not fit in 64 bit,
+	// use shortest representation.
+	if (d != d || d >= 1e19 || d <= -1e19) {
+		return appendd_shortest(d);
+	}
 	if (d < 0) {
+		n = 1;
 		d = -(d);
-		d = d + (double) i;
-	} else {
-		d = d - (double) i;
 	}
 
+	if (prec > 18) {
+		prec = 18;
+	}
+
+	uint64_t ip = uint64_t(d);
+
+	d = d - double(ip);
+
 	for (size_t x = 0; x < prec; x++) {
 		d = d * 10;
 	}
 
-	long int frac = (long int) d;
+	uint64_t frac = uint64_t(d);
+	size_t ip_len = U64_DEC_LEN(ip);
+	size_t frac_len = frac ? prec : 1;
 
-	Error err = appendi(i);
+	err = resize(_i + n + ip_len + 1 + frac_len);
 	if (err != NULL) {
 		return err;
 	}
 
-	err = appendc('.');
-	if (err != NULL) {
-		return err;
+	char* p = &_v[_i];
+
+	if (n) {
+		*p++ = '-';
+	}
+	p += ip_len;
+	U64_TO_DEC(p, ip);
+	*p++ = '.';
+	p += frac_len;
+	U64_TO_DEC(p, frac);
+
+	// Pad fraction with leading zero.
+	for (char* z = p - frac_len; z < p - U64_DEC_LEN(frac); z++) {
+		*z = '0';
+	}
+
+	_i += n + ip_len + 1 + frac_len;
+	_v[_i] = '\0';
+
+	return 0;
+}
+
+/**
+ * Method `appendd_shortest(d)` will append the shortest representation of
+ * double number `d` that can be read back to the same double value.
+ *
+ * On success it will return NULL, otherwise it will return ErrOutOfMemory.
+ */
+Error Buffer::appendd_shortest(double d)
+{
+	char out[32];
+	size_t n = 0;
+
+	if (d != d) {
+		return append_raw("nan", 3);
+	}
+	if (d < 0) {
+		out[n++] = '-';
+		d = -(d);
 	}
+	if (d > 1.7976931348623157e308) {
+		memcpy(&out[n], "inf", 3);
+		return append_raw(out, n + 3);
+	}
+
+	n += DTOA_SHORTEST(d, &out[n]);
 
-	return appendi(frac);
+	return append_raw(out, n);
 }
 
 /**
@@ -809,20 +1710,152 @@ Error Buffer::append_fmt(const char* fmt, ...)
  * Method `vappend_fmt(fmt, args)` will parse formatted string `fmt` and apply
  * any value from `args` and append their result to current buffer.
  *
+ * Literal text and the common conversions, `%s`, `%c`, `%d`, `%i`, and `%u`
+ * with optional `0` flag, field width, and `l` or `z` length modifier, are
+ * written directly into buffer without creating FmtParser. The rest of
+ * format, start from the first conversion that is not in the list above, is
+ * parsed by FmtParser.
+ *
  * On success it will return NULL, otherwise it will return ErrOutOfMemory.
  */
 Error Buffer::vappend_fmt(const char* fmt, va_list args)
 {
+	if (!fmt) {
+		return 0;
+	}
+
+	Error err;
+	const char* p = fmt;
+	const char* spec = NULL;
+
+	while (*p) {
+		spec = strchr(p, '%');
+
+		if (!spec) {
+			return append_raw(p, strlen(p));
+		}
+		if (spec > p) {
+			err = append_raw(p, size_t(spec - p));
+			if (err != NULL) {
+				return err;
+			}
+		}
+
+		p = spec + 1;
+
+		if (*p == '%') {
+			err = appendc('%');
+			if (err != NULL) {
+				return err;
+			}
+			p++;
+			continue;
+		}
+
+		int zero_pad = 0;
+		size_t width = 0;
+		int length = 0;
+
+		if (*p == '0') {
+			zero_pad = 1;
+			p++;
+		}
+		if (isdigit(*p)) {
+			width = size_t(*p - '0');
+			p++;
+			if (isdigit(*p)) {
+				width = width * 10 + size_t(*p - '0');
+				p++;
+			}
+		}
+		if (*p == 'l' || *p == 'z') {
+			length = *p;
+			p++;
+		}
+
+		size_t start = _i;
+
+		switch (*p) {
+		case 's':
+			if (zero_pad || length) {
+				goto complex;
+			}
+			err = append_raw(va_arg(args, const char*));
+			break;
+		case 'c':
+			if (zero_pad || width || length) {
+				goto complex;
+			}
+			{
+				int c = va_arg(args, int);
+				if (c > 0) {
+					err = appendc(char(c));
+				}
+			}
+			break;
+		case 'd':
+		case 'i':
+			if (length == 'l') {
+				err = appendi(va_arg(args, long int));
+			} else if (length == 'z') {
+				err = appendi(va_arg(args, ssize_t));
+			} else {
+				err = appendi(va_arg(args, int));
+			}
+			break;
+		case 'u':
+			if (length == 'l') {
+				err = appendui(va_arg(args, unsigned long));
+			} else if (length == 'z') {
+				err = appendui(va_arg(args, size_t));
+			} else {
+				err = appendui(va_arg(args, unsigned int));
+			}
+			break;
+		default:
+			goto complex;
+		}
+		if (err != NULL) {
+			return err;
+		}
+
+		p++;
+
+		size_t len = _i - start;
+
+		if (width > len) {
+			size_t pad = width - len;
+
+			err = resize(_i + pad);
+			if (err != NULL) {
+				return err;
+			}
+
+			// Zero padding is placed after sign.
+			if (zero_pad && _v[start] == '-') {
+				start++;
+				len--;
+			}
+
+			memmove(&_v[start + pad], &_v[start], len);
+			memset(&_v[start], zero_pad ? '0' : ' ', pad);
+
+			_i += pad;
+			_v[_i] = '\0';
+		}
+	}
+
+	return 0;
+
+complex:
 	FmtParser fmtp;
 
-	Error err = fmtp.parse(fmt, args);
+	err = fmtp.parse(spec, args);
 	if (err != NULL) {
 		return err;
 	}
 
-	append(&fmtp);
-
-	return 0;
+	return append(&fmtp);
 }
 
 /**
@@ -1057,19 +2090,23 @@ Error Buffer::to_lint(long int* res)
 		return 0;
 	}
 
-	long int li;
-
-	errno = 0;
-
-	li = strtol(_v, NULL, 0);
+	return PARSE_LINT(_v, _i, res);
+}
 
-	if (errno == ERANGE) {
-		return ErrNumRange;
+/**
+ * Method `to_double(v)` will convert content of buffer into double and save
+ * their value to `res`.
+ *
+ * On success, it will return NULL.
+ * On fail, the value of `res` will not changed and it will return ErrNumRange.
+ */
+Error Buffer::to_double(double* res)
+{
+	if (!_v) {
+		return 0;
 	}
 
-	*res = li;
-
-	return 0;
+	return PARSE_DOUBLE(_v, _i, res);
 }
 
 const char* Buffer::chars()
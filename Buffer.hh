@@ -29,6 +29,16 @@ public:
 
 	static int CMP(Object* x, Object* y);
 	static Error PARSE_INT(char** pp, int* v);
+	static Error PARSE_I32(const char* p, size_t len, int32_t* v
+		, size_t* n = NULL);
+	static Error PARSE_I64(const char* p, size_t len, int64_t* v
+		, size_t* n = NULL);
+	static Error PARSE_U64(const char* p, size_t len, uint64_t* v
+		, size_t* n = NULL);
+	static Error PARSE_LINT(const char* p, size_t len, long int* v
+		, size_t* n = NULL);
+	static Error PARSE_DOUBLE(const char* p, size_t len, double* v
+		, size_t* n = NULL);
 	static size_t TRIM(char* bfr, size_t len);
 
 	explicit Buffer(const size_t size = DFLT_SIZE);
@@ -69,6 +79,7 @@ public:
 	Error appendi(long int i, size_t base = 10);
 	Error appendui(long unsigned int i, size_t base = 10);
 	Error appendd(double d, size_t prec = 6);
+	Error appendd_shortest(double d);
 	Error append(const Buffer* bfr);
 	Error append_raw(const char* bfr, size_t len = 0);
 	Error append_bin(const void* bin, size_t len);
@@ -87,6 +98,7 @@ public:
 	int like_raw(const char* bfr, size_t len = 0);
 
 	Error to_lint(long int* res);
+	Error to_double(double* res);
 
 	const char* chars();
 	const char* dump();
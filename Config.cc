@@ -193,6 +193,8 @@ const char* Config::get(const char* head, const char* key, const char* dflt)
 /**
  * Method get_number(head,key,dflt) will return a number representation of
  * config value in with 'head' and 'key'.
+ *
+ * If value is not found or out of range, it will return `dflt`.
  */
 long int Config::get_number(const char* head, const char* key, const int dflt)
 {
@@ -202,7 +204,14 @@ long int Config::get_number(const char* head, const char* key, const int dflt)
 		return dflt;
 	}
 
-	return strtol(v, 0, 0);
+	long int n = 0;
+
+	Error err = Buffer::PARSE_LINT(v, strlen(v), &n);
+	if (err != NULL) {
+		return dflt;
+	}
+
+	return n;
 }
 
 /**
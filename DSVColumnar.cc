@@ -0,0 +1,1151 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "DSVColumnar.hh"
+
+namespace vos {
+
+Error ErrDSVColumnarFormat("DSVColumnar: invalid file format");
+Error ErrDSVColumnarColumn("DSVColumnar: invalid column");
+Error ErrDSVColumnarType("DSVColumnar: column is not stored as string");
+
+const char* DSVColumnar::__cname = "DSVColumnar";
+
+//
+// Variable MAGIC contain 8 bytes at the beginning and at the end of columnar
+// file.
+//
+const char* DSVColumnar::MAGIC = "VOSCOL01";
+
+//
+// Variable BLOCK_ROWS contain maximum number of rows in one block, used by
+// CONVERT().
+//
+size_t DSVColumnar::BLOCK_ROWS = 65536;
+
+//
+// Variable IO_SIZE contain size of buffer for reading and writing file in
+// CONVERT().
+//
+size_t DSVColumnar::IO_SIZE = 1024 * 1024;
+
+#define HDR_SIZE	16
+#define TRAILER_SIZE	16
+#define CHUNK_SIZE	34
+
+//
+// Maximum integer that can be stored in double without losing precision.
+//
+#define MAX_EXACT_INT	9007199254740992.0
+
+//
+// dsv_col_conv contain the state of converter.
+//
+// Field `data` contain the values of each column in current block.
+// Field `off` contain the offset of each values in `data`, for each column.
+// Field `vals` and `dvals` contain numbers parsed from a column.
+// Field `codes` contain index of each values in dictionary.
+// Field `dict` contain the row of the first occurrence of each distinct
+// values.
+// Field `slots` contain hash table of dictionary, with zero as empty slot.
+//
+struct dsv_col_conv {
+	int		n_cols;
+	size_t		block_rows;
+	size_t		n;
+	Buffer*		data;
+	size_t*		off;
+	uint64_t*	vals;
+	double*		dvals;
+	uint32_t*	codes;
+	uint32_t*	dict;
+	uint32_t*	slots;
+	size_t		n_slots;
+
+	dsv_col_conv()
+	:	n_cols(0)
+	,	block_rows(0)
+	,	n(0)
+	,	data(NULL)
+	,	off(NULL)
+	,	vals(NULL)
+	,	dvals(NULL)
+	,	codes(NULL)
+	,	dict(NULL)
+	,	slots(NULL)
+	,	n_slots(0)
+	{}
+
+	~dsv_col_conv()
+	{
+		if (data) {
+			delete[] data;
+		}
+		free(off);
+		free(vals);
+		free(dvals);
+		free(codes);
+		free(dict);
+		free(slots);
+	}
+private:
+	dsv_col_conv(const dsv_col_conv&);
+	void operator=(const dsv_col_conv&);
+};
+
+//
+// dsv_col_view contain pointers to the parts of one chunk.
+//
+struct dsv_col_view {
+	size_t		n;
+	int		enc;
+	const char*	offs;
+	const char*	data;
+	size_t		data_len;
+	uint32_t	n_dict;
+	int		width;
+	const char*	words;
+	int64_t		base;
+};
+
+//
+// PUT will append `len` bytes from `p` into buffer `b`.
+//
+static Error PUT(Buffer* b, const void* p, size_t len)
+{
+	if (len == 0) {
+		return NULL;
+	}
+	return b->append_raw((const char*) p, len);
+}
+
+static uint32_t GET_U32(const char* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static uint64_t GET_U64(const char* p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+//
+// BITS will return number of bits needed to store `v`.
+//
+static int BITS(uint64_t v)
+{
+	int n = 0;
+
+	while (v) {
+		++n;
+		v >>= 1;
+	}
+	return n;
+}
+
+//
+// PACKED_SIZE will return size of `n` values packed in `width` bits, in
+// bytes, rounded to 64 bits word.
+//
+static size_t PACKED_SIZE(size_t n, int width)
+{
+	return (n * size_t(width) + 63) / 64 * 8;
+}
+
+//
+// PACK will append `n` values in `vals` into `out`, each of them packed in
+// `width` bits.
+//
+static Error PACK(Buffer* out, const uint64_t* vals, size_t n, int width)
+{
+	size_t size = PACKED_SIZE(n, width);
+	size_t bit = 0;
+	size_t w = 0;
+	size_t shift = 0;
+	uint64_t* words = NULL;
+	Error err;
+
+	if (size == 0) {
+		return NULL;
+	}
+
+	words = (uint64_t*) calloc(size / 8, sizeof(*words));
+	if (! words) {
+		return ErrOutOfMemory;
+	}
+
+	for (size_t x = 0; x < n; x++, bit += size_t(width)) {
+		w = bit / 64;
+		shift = bit % 64;
+
+		words[w] |= vals[x] << shift;
+		if (shift + size_t(width) > 64) {
+			words[w + 1] |= vals[x] >> (64 - shift);
+		}
+	}
+
+	err = PUT(out, words, size);
+
+	free(words);
+
+	return err;
+}
+
+//
+// UNPACK will return value at index `i` in `words`, that is packed in `width`
+// bits.
+//
+static uint64_t UNPACK(const char* words, size_t i, int width)
+{
+	size_t bit = i * size_t(width);
+	size_t w = bit / 64;
+	size_t shift = bit % 64;
+	uint64_t v = 0;
+
+	if (width == 0) {
+		return 0;
+	}
+
+	v = GET_U64(&words[w * 8]) >> shift;
+	if (shift + size_t(width) > 64) {
+		v |= GET_U64(&words[(w + 1) * 8]) << (64 - shift);
+	}
+	if (width < 64) {
+		v &= (uint64_t(1) << width) - 1;
+	}
+
+	return v;
+}
+
+//
+// CONV_INIT will allocate the state of converter for `n_cols` columns and
+// `block_rows` rows.
+//
+static Error CONV_INIT(struct dsv_col_conv* c, int n_cols, size_t block_rows)
+{
+	c->n_cols = n_cols;
+	c->block_rows = block_rows;
+
+	c->n_slots = 16;
+	while (c->n_slots < block_rows * 2) {
+		c->n_slots <<= 1;
+	}
+
+	c->data = new Buffer[n_cols];
+	c->off = (size_t*) calloc(size_t(n_cols) * (block_rows + 1)
+		, sizeof(*c->off));
+	c->vals = (uint64_t*) calloc(block_rows, sizeof(*c->vals));
+	c->dvals = (double*) calloc(block_rows, sizeof(*c->dvals));
+	c->codes = (uint32_t*) calloc(block_rows, sizeof(*c->codes));
+	c->dict = (uint32_t*) calloc(block_rows, sizeof(*c->dict));
+	c->slots = (uint32_t*) calloc(c->n_slots, sizeof(*c->slots));
+
+	if (! c->data || ! c->off || ! c->vals || ! c->dvals || ! c->codes
+	||  ! c->dict || ! c->slots) {
+		return ErrOutOfMemory;
+	}
+
+	return NULL;
+}
+
+//
+// ENCODE_PLAIN will append values of column `col` into `out`, as list of
+// offsets followed by the values.
+//
+static Error ENCODE_PLAIN(struct dsv_col_conv* c, int col, Buffer* out)
+{
+	uint32_t o = 0;
+	size_t* off = &c->off[size_t(col) * (c->block_rows + 1)];
+	Error err;
+
+	if (off[c->n] > UINT32_MAX) {
+		return ErrDSVColumnarFormat;
+	}
+
+	for (size_t x = 0; x <= c->n; x++) {
+		o = uint32_t(off[x]);
+		err = PUT(out, &o, sizeof(o));
+		if (err != NULL) {
+			return err;
+		}
+	}
+
+	return PUT(out, c->data[col].v(), off[c->n]);
+}
+
+//
+// ENCODE_DICT will append values of column `col` into `out` using
+// dictionary. It will return 1 if number of distinct values is more than
+// half of rows, and nothing is appended.
+//
+static int ENCODE_DICT(struct dsv_col_conv* c, int col, Buffer* out
+	, Error* err)
+{
+	uint32_t n_dict = 0;
+	uint32_t o = 0;
+	uint32_t d = 0;
+	uint8_t width = 0;
+	size_t mask = c->n_slots - 1;
+	size_t slot = 0;
+	size_t len = 0;
+	size_t* off = &c->off[size_t(col) * (c->block_rows + 1)];
+	const char* data = c->data[col].v();
+	const char* v = NULL;
+
+	memset(c->slots, 0, c->n_slots * sizeof(*c->slots));
+
+	for (size_t x = 0; x < c->n; x++) {
+		v = &data[off[x]];
+		len = off[x + 1] - off[x];
+		slot = FNV1A_32(v, len) & mask;
+
+		for (;;) {
+			if (c->slots[slot] == 0) {
+				c->dict[n_dict] = uint32_t(x);
+				c->slots[slot] = ++n_dict;
+				c->codes[x] = n_dict - 1;
+				break;
+			}
+
+			d = c->dict[c->slots[slot] - 1];
+			if (off[d + 1] - off[d] == len
+			&& memcmp(&data[off[d]], v, len) == 0) {
+				c->codes[x] = c->slots[slot] - 1;
+				break;
+			}
+			slot = (slot + 1) & mask;
+		}
+
+		if (n_dict > c->n / 2) {
+			return 1;
+		}
+	}
+
+	*err = PUT(out, &n_dict, sizeof(n_dict));
+
+	for (d = 0; d < n_dict && *err == NULL; d++) {
+		*err = PUT(out, &o, sizeof(o));
+		o += uint32_t(off[c->dict[d] + 1] - off[c->dict[d]]);
+	}
+	if (*err == NULL) {
+		*err = PUT(out, &o, sizeof(o));
+	}
+	for (d = 0; d < n_dict && *err == NULL; d++) {
+		*err = PUT(out, &data[off[c->dict[d]]]
+			, off[c->dict[d] + 1] - off[c->dict[d]]);
+	}
+
+	if (*err == NULL) {
+		width = uint8_t(BITS(n_dict - 1));
+		*err = PUT(out, &width, sizeof(width));
+	}
+	if (*err == NULL) {
+		for (size_t x = 0; x < c->n; x++) {
+			c->vals[x] = c->codes[x];
+		}
+		*err = PACK(out, c->vals, c->n, width);
+	}
+
+	return 0;
+}
+
+//
+// ENCODE_NUMBER will append values of column `col` into `out` as integer or
+// double, and set the statistic in `chunk`. It will return 1 if one of the
+// values is not a number, and nothing is appended.
+//
+static int ENCODE_NUMBER(struct dsv_col_conv* c, int col, Buffer* out
+	, struct dsv_col_chunk* chunk, Error* err)
+{
+	int is_int = 1;
+	uint8_t width = 0;
+	int64_t base = 0;
+	size_t n = 0;
+	size_t len = 0;
+	size_t* off = &c->off[size_t(col) * (c->block_rows + 1)];
+	const char* data = c->data[col].v();
+	double d = 0;
+
+	for (size_t x = 0; x < c->n; x++) {
+		len = off[x + 1] - off[x];
+		if (len == 0) {
+			return 1;
+		}
+		if (Buffer::PARSE_DOUBLE(&data[off[x]], len, &d, &n) != NULL
+		|| n != len || isnan(d) || isinf(d)) {
+			return 1;
+		}
+
+		c->dvals[x] = d;
+
+		if (x == 0 || d < chunk->min) {
+			chunk->min = d;
+		}
+		if (x == 0 || d > chunk->max) {
+			chunk->max = d;
+		}
+		if (is_int && (d > MAX_EXACT_INT || d < -MAX_EXACT_INT
+		|| d != double(int64_t(d)))) {
+			is_int = 0;
+		}
+	}
+
+	chunk->has_stat = 1;
+
+	if (! is_int) {
+		chunk->enc = DSV_COL_DOUBLE;
+		*err = PUT(out, c->dvals, c->n * sizeof(*c->dvals));
+		return 0;
+	}
+
+	chunk->enc = DSV_COL_INT;
+	base = int64_t(chunk->min);
+
+	for (size_t x = 0; x < c->n; x++) {
+		c->vals[x] = uint64_t(int64_t(c->dvals[x]) - base);
+	}
+	width = uint8_t(BITS(uint64_t(int64_t(chunk->max) - base)));
+
+	*err = PUT(out, &base, sizeof(base));
+	if (*err == NULL) {
+		*err = PUT(out, &width, sizeof(width));
+	}
+	if (*err == NULL) {
+		*err = PACK(out, c->vals, c->n, width);
+	}
+
+	return 0;
+}
+
+//
+// WRITE_BLOCK will encode all columns in current block, write them into `w`,
+// and append their location to `idx`.
+//
+static Error WRITE_BLOCK(struct dsv_col_conv* c, const int* types, File* w
+	, uint64_t* pos, Buffer* idx)
+{
+	uint32_t n = uint32_t(c->n);
+	uint8_t u8 = 0;
+	struct dsv_col_chunk chunk;
+	Buffer out;
+	Error err;
+
+	err = PUT(idx, &n, sizeof(n));
+	if (err != NULL) {
+		return err;
+	}
+
+	for (int x = 0; x < c->n_cols; x++) {
+		memset(&chunk, 0, sizeof(chunk));
+		out.truncate(0);
+
+		if (types[x] != RMD_T_NUMBER
+		||  ENCODE_NUMBER(c, x, &out, &chunk, &err) != 0) {
+			chunk.has_stat = 0;
+			chunk.enc = DSV_COL_DICT;
+			if (ENCODE_DICT(c, x, &out, &err) != 0) {
+				chunk.enc = DSV_COL_PLAIN;
+				out.truncate(0);
+				err = ENCODE_PLAIN(c, x, &out);
+			}
+		}
+		if (err == NULL && out.len() > 0) {
+			err = w->write_raw(out.v(), out.len());
+		}
+		if (err != NULL) {
+			return err;
+		}
+
+		chunk.off = *pos;
+		chunk.size = out.len();
+		*pos += chunk.size;
+
+		PUT(idx, &chunk.off, sizeof(chunk.off));
+		PUT(idx, &chunk.size, sizeof(chunk.size));
+		u8 = uint8_t(chunk.enc);
+		PUT(idx, &u8, sizeof(u8));
+		u8 = uint8_t(chunk.has_stat);
+		PUT(idx, &u8, sizeof(u8));
+		PUT(idx, &chunk.min, sizeof(chunk.min));
+		err = PUT(idx, &chunk.max, sizeof(chunk.max));
+		if (err != NULL) {
+			return err;
+		}
+
+		c->data[x].truncate(0);
+	}
+
+	c->n = 0;
+
+	return NULL;
+}
+
+/**
+ * Method CONVERT(fin,list_md,fout) will read all rows in DSV file `fin` using
+ * `list_md` as meta-data, and write them into columnar file `fout`.
+ *
+ * Rows rejected by filter in `list_md` are not converted. All fields are
+ * converted, projection in `list_md` is ignored while reading and restored
+ * before returning.
+ *
+ * On success it will return NULL, otherwise it will return error.
+ */
+Error DSVColumnar::CONVERT(const char* fin, List* list_md, const char* fout)
+{
+	int s = 0;
+	int x = 0;
+	int n_cols = list_md->size();
+	uint16_t u16 = 0;
+	uint32_t u32 = 0;
+	uint64_t pos = HDR_SIZE;
+	uint64_t n_rows = 0;
+	uint64_t n_blocks = 0;
+	size_t block_rows = BLOCK_ROWS > 0 ? BLOCK_ROWS : 1;
+	size_t* off = NULL;
+	int* types = NULL;
+	int* skip = NULL;
+	BNode* node = NULL;
+	DSVRecordMD* rmd = NULL;
+	DSVRecord* row = NULL;
+	DSVRecord* col = NULL;
+	DSVReader reader;
+	File w;
+	Buffer idx;
+	Buffer footer;
+	struct dsv_col_conv c;
+	Error err;
+
+	if (n_cols <= 0 || block_rows > UINT32_MAX) {
+		return ErrDSVColumnarColumn;
+	}
+
+	err = CONV_INIT(&c, n_cols, block_rows);
+	if (err != NULL) {
+		return err;
+	}
+
+	types = (int*) calloc(size_t(n_cols), sizeof(*types));
+	skip = (int*) calloc(size_t(n_cols), sizeof(*skip));
+	if (! types || ! skip) {
+		free(types);
+		free(skip);
+		return ErrOutOfMemory;
+	}
+
+	node = list_md->head();
+	for (x = 0; x < n_cols; x++, node = node->get_right()) {
+		rmd = (DSVRecordMD*) node->get_content();
+		types[x] = rmd->_type;
+		skip[x] = rmd->_flag & RMD_FL_SKIP;
+
+		u16 = uint16_t(rmd->_name.len());
+		footer.appendc(char(rmd->_type));
+		PUT(&footer, &u16, sizeof(u16));
+		PUT(&footer, rmd->_name.v(), u16);
+	}
+
+	err = reader.open_ro(fin);
+	if (err != NULL) {
+		goto out;
+	}
+	reader.resize(IO_SIZE);
+
+	err = w.open_wt(fout);
+	if (err != NULL) {
+		goto out;
+	}
+	w.resize(IO_SIZE);
+
+	PUT(&idx, MAGIC, 8);
+	u32 = uint32_t(block_rows);
+	PUT(&idx, &u32, sizeof(u32));
+	u32 = uint32_t(n_cols);
+	PUT(&idx, &u32, sizeof(u32));
+
+	err = w.write_raw(idx.v(), idx.len());
+	if (err != NULL) {
+		goto out;
+	}
+	idx.truncate(0);
+
+	DSVRecordMD::PROJECT_IDX(list_md, NULL, 0);
+	DSVRecord::INIT_ROW(&row, n_cols);
+
+	do {
+		row->columns_reset();
+		s = reader.read(row, list_md);
+		if (s <= 0) {
+			continue;
+		}
+
+		for (x = 0, col = row; x < n_cols; x++, col = col->_next_col) {
+			off = &c.off[size_t(x) * (block_rows + 1)];
+			off[c.n] = c.data[x].len();
+			if (col->len() > 0) {
+				err = c.data[x].append_raw(col->v(), col->len());
+				if (err != NULL) {
+					goto out;
+				}
+			}
+			off[c.n + 1] = c.data[x].len();
+		}
+		++n_rows;
+
+		if (++c.n == block_rows) {
+			err = WRITE_BLOCK(&c, types, &w, &pos, &idx);
+			if (err != NULL) {
+				goto out;
+			}
+			++n_blocks;
+		}
+	} while (s != 0);
+
+	if (c.n > 0) {
+		err = WRITE_BLOCK(&c, types, &w, &pos, &idx);
+		if (err != NULL) {
+			goto out;
+		}
+		++n_blocks;
+	}
+
+	PUT(&footer, &n_rows, sizeof(n_rows));
+	PUT(&footer, &n_blocks, sizeof(n_blocks));
+	err = PUT(&footer, idx.v(), idx.len());
+	if (err == NULL) {
+		PUT(&footer, &pos, sizeof(pos));
+		err = PUT(&footer, MAGIC, 8);
+	}
+	if (err == NULL) {
+		err = w.write_raw(footer.v(), footer.len());
+	}
+	if (err == NULL) {
+		err = w.flush();
+	}
+out:
+	// Restore projection from caller.
+	node = list_md->head();
+	for (x = 0; x < n_cols; x++, node = node->get_right()) {
+		rmd = (DSVRecordMD*) node->get_content();
+		rmd->_flag |= skip[x];
+	}
+
+	if (row) {
+		delete row;
+	}
+	free(skip);
+	free(types);
+	w.close();
+
+	return err;
+}
+
+DSVColumnar::DSVColumnar()
+:	_n_cols(0)
+,	_n_rows(0)
+,	_n_blocks(0)
+,	_block_rows(0)
+,	_blk(0)
+,	_blk_rows(0)
+,	_n_skipped(0)
+,	_map(NULL)
+,	_map_size(0)
+,	_next_blk(0)
+,	_types(NULL)
+,	_names(NULL)
+,	_rows(NULL)
+,	_chunks(NULL)
+,	_checked(NULL)
+{}
+
+DSVColumnar::~DSVColumnar()
+{
+	close();
+}
+
+/**
+ * Method open(path) will map columnar file `path` into memory and load its
+ * footer.
+ *
+ * On success it will return NULL, otherwise it will return error.
+ */
+Error DSVColumnar::open(const char* path)
+{
+	int fd = 0;
+	int x = 0;
+	uint16_t len = 0;
+	uint64_t footer_off = 0;
+	uint64_t n_blocks = 0;
+	size_t b = 0;
+	struct stat st;
+	struct dsv_col_chunk* c = NULL;
+	const char* p = NULL;
+	const char* end = NULL;
+
+	close();
+
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		return Error::SYS();
+	}
+	if (fstat(fd, &st) < 0) {
+		::close(fd);
+		return Error::SYS();
+	}
+	if (size_t(st.st_size) < HDR_SIZE + TRAILER_SIZE + 16) {
+		::close(fd);
+		return ErrDSVColumnarFormat;
+	}
+
+	_map_size = size_t(st.st_size);
+	_map = (char*) mmap(NULL, _map_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+
+	if (_map == MAP_FAILED) {
+		_map = NULL;
+		return Error::SYS();
+	}
+
+	end = &_map[_map_size - TRAILER_SIZE];
+
+	if (memcmp(_map, MAGIC, 8) != 0 || memcmp(end + 8, MAGIC, 8) != 0) {
+		goto fail;
+	}
+
+	_block_rows = GET_U32(&_map[8]);
+	_n_cols = int(GET_U32(&_map[12]));
+	footer_off = GET_U64(end);
+
+	if (_n_cols <= 0 || _block_rows == 0 || footer_off < HDR_SIZE
+	||  footer_off > uint64_t(end - _map)) {
+		goto fail;
+	}
+
+	_types = (int*) calloc(size_t(_n_cols), sizeof(*_types));
+	_names = new Buffer[_n_cols];
+	if (! _types || ! _names) {
+		goto fail;
+	}
+
+	p = &_map[footer_off];
+	for (x = 0; x < _n_cols; x++) {
+		if (end - p < 3) {
+			goto fail;
+		}
+		_types[x] = (uint8_t) p[0];
+		memcpy(&len, &p[1], sizeof(len));
+		p += 3;
+
+		if (end - p < len) {
+			goto fail;
+		}
+		if (len > 0) {
+			_names[x].copy_raw(p, len);
+		}
+		p += len;
+	}
+
+	if (end - p < 16) {
+		goto fail;
+	}
+	_n_rows = GET_U64(p);
+	n_blocks = GET_U64(p + 8);
+	p += 16;
+
+	if (n_blocks > size_t(end - p) / (4 + size_t(_n_cols) * CHUNK_SIZE)) {
+		goto fail;
+	}
+	_n_blocks = size_t(n_blocks);
+
+	_rows = (uint32_t*) calloc(_n_blocks + 1, sizeof(*_rows));
+	_chunks = (struct dsv_col_chunk*) calloc(
+		(_n_blocks + 1) * size_t(_n_cols), sizeof(*_chunks));
+	_checked = (char*) calloc(size_t(_n_cols), sizeof(*_checked));
+	if (! _rows || ! _chunks || ! _checked) {
+		goto fail;
+	}
+
+	for (b = 0; b < _n_blocks; b++) {
+		_rows[b] = GET_U32(p);
+		p += 4;
+		if (_rows[b] > _block_rows) {
+			goto fail;
+		}
+
+		for (x = 0; x < _n_cols; x++, p += CHUNK_SIZE) {
+			c = &_chunks[b * size_t(_n_cols) + size_t(x)];
+			c->off = GET_U64(p);
+			c->size = GET_U64(p + 8);
+			c->enc = (uint8_t) p[16];
+			c->has_stat = (uint8_t) p[17];
+			memcpy(&c->min, p + 18, sizeof(c->min));
+			memcpy(&c->max, p + 26, sizeof(c->max));
+
+			if (c->off < HDR_SIZE || c->off > footer_off
+			||  c->size > footer_off - c->off
+			||  c->enc > DSV_COL_DOUBLE) {
+				goto fail;
+			}
+		}
+	}
+
+	rewind();
+
+	return NULL;
+fail:
+	close();
+	return ErrDSVColumnarFormat;
+}
+
+/**
+ * Method close will unmap the file and release the footer.
+ */
+void DSVColumnar::close()
+{
+	if (_map) {
+		munmap(_map, _map_size);
+		_map = NULL;
+	}
+	if (_names) {
+		delete[] _names;
+		_names = NULL;
+	}
+	free(_types);
+	free(_rows);
+	free(_chunks);
+	free(_checked);
+
+	_types = NULL;
+	_rows = NULL;
+	_chunks = NULL;
+	_checked = NULL;
+	_map_size = 0;
+	_n_cols = 0;
+	_n_rows = 0;
+	_n_blocks = 0;
+	_block_rows = 0;
+	_blk_rows = 0;
+}
+
+/**
+ * Method column(name) will return index of column `name`, or -1 if no column
+ * with that name.
+ */
+int DSVColumnar::column(const char* name)
+{
+	for (int x = 0; x < _n_cols; x++) {
+		if (_names[x].like_raw(name) == 0) {
+			return x;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Method column_type(col) will return type of column `col` in meta-data
+ * that is used when file is converted, one of RMD_T_*, or -1 if `col` is
+ * invalid.
+ */
+int DSVColumnar::column_type(int col)
+{
+	if (col < 0 || col >= _n_cols) {
+		return -1;
+	}
+	return _types[col];
+}
+
+/**
+ * Method chunk(blk,col) will return location and statistic of column `col`
+ * in block `blk`, or NULL if one of them is invalid.
+ */
+const struct dsv_col_chunk* DSVColumnar::chunk(size_t blk, int col)
+{
+	if (blk >= _n_blocks || col < 0 || col >= _n_cols) {
+		return NULL;
+	}
+	return &_chunks[blk * size_t(_n_cols) + size_t(col)];
+}
+
+/**
+ * Method rewind will make the next call to next_block() start from the first
+ * block.
+ */
+void DSVColumnar::rewind()
+{
+	_next_blk = 0;
+	_blk = 0;
+	_blk_rows = 0;
+	_n_skipped = 0;
+}
+
+/**
+ * Method next_block(col,min,max) will move to the next block and return its
+ * number of rows, or zero if no block left.
+ *
+ * If `col` is not negative, block that has statistic of column `col` that
+ * does not overlap with range `min` and `max` is skipped without reading its
+ * data.
+ */
+size_t DSVColumnar::next_block(int col, double min, double max)
+{
+	const struct dsv_col_chunk* c = NULL;
+
+	if (col >= _n_cols) {
+		col = -1;
+	}
+
+	while (_next_blk < _n_blocks) {
+		_blk = _next_blk++;
+
+		if (col >= 0) {
+			c = &_chunks[_blk * size_t(_n_cols) + size_t(col)];
+			if (c->has_stat && (c->max < min || c->min > max)) {
+				++_n_skipped;
+				continue;
+			}
+		}
+
+		_blk_rows = _rows[_blk];
+		memset(_checked, 0, size_t(_n_cols));
+		return _blk_rows;
+	}
+
+	_blk_rows = 0;
+
+	return 0;
+}
+
+//
+// OFFS_CHECK will return -1 if one of `n` + 1 string offsets in `offs` is
+// less than its previous offset, or the last one is larger than `data_len`.
+//
+static int OFFS_CHECK(const char* offs, size_t n, size_t data_len)
+{
+	uint32_t prev = 0;
+	uint32_t b = 0;
+
+	for (size_t x = 0; x <= n; x++) {
+		b = GET_U32(&offs[x * 4]);
+		if (b < prev) {
+			return -1;
+		}
+		prev = b;
+	}
+	if (b > data_len) {
+		return -1;
+	}
+	return 0;
+}
+
+//
+// VIEW will set `v` to the parts of chunk `c` with `n` rows in `map`. It will
+// return -1 if the chunk is too small for its content. If `check` is not
+// zero, all string offsets in chunk are also checked.
+//
+static int VIEW(const char* map, const struct dsv_col_chunk* c, size_t n
+	, struct dsv_col_view* v, int check)
+{
+	const char* p = &map[c->off];
+	size_t size = size_t(c->size);
+	size_t need = 0;
+
+	memset(v, 0, sizeof(*v));
+	v->n = n;
+	v->enc = c->enc;
+
+	switch (c->enc) {
+	case DSV_COL_PLAIN:
+		need = (n + 1) * 4;
+		if (size < need) {
+			return -1;
+		}
+		v->offs = p;
+		v->data = p + need;
+		v->data_len = GET_U32(&p[n * 4]);
+		if (v->data_len > size - need) {
+			return -1;
+		}
+		if (check && OFFS_CHECK(v->offs, n, v->data_len) < 0) {
+			return -1;
+		}
+		break;
+
+	case DSV_COL_DICT:
+		if (size < 4) {
+			return -1;
+		}
+		v->n_dict = GET_U32(p);
+		if (v->n_dict == 0 || v->n_dict > n
+		||  size - 4 < (size_t(v->n_dict) + 1) * 4 + 1) {
+			return -1;
+		}
+		v->offs = p + 4;
+		v->data = v->offs + (v->n_dict + 1) * 4;
+		v->data_len = GET_U32(&v->offs[v->n_dict * 4]);
+		need = size_t(v->data - p) + v->data_len;
+		if (size < need + 1) {
+			return -1;
+		}
+		if (check && OFFS_CHECK(v->offs, v->n_dict, v->data_len) < 0) {
+			return -1;
+		}
+		v->width = (uint8_t) p[need];
+		v->words = &p[need + 1];
+		if (v->width > 32
+		||  size - need - 1 < PACKED_SIZE(n, v->width)) {
+			return -1;
+		}
+		break;
+
+	case DSV_COL_INT:
+		if (size < 9) {
+			return -1;
+		}
+		memcpy(&v->base, p, sizeof(v->base));
+		v->width = (uint8_t) p[8];
+		v->words = p + 9;
+		if (v->width > 64 || size - 9 < PACKED_SIZE(n, v->width)) {
+			return -1;
+		}
+		break;
+
+	case DSV_COL_DOUBLE:
+		if (size < n * sizeof(double)) {
+			return -1;
+		}
+		v->data = p;
+		break;
+	}
+
+	return 0;
+}
+
+//
+// VIEW_STRING will set `s` and `len` to value at `row` in string view `v`. It
+// will return -1 if offsets of value is not ordered or outside of data.
+//
+static int VIEW_STRING(const struct dsv_col_view* v, size_t row
+	, const char** s, size_t* len)
+{
+	uint32_t a = 0;
+	uint32_t b = 0;
+
+	if (v->enc == DSV_COL_DICT) {
+		row = size_t(UNPACK(v->words, row, v->width));
+		if (row >= v->n_dict) {
+			return -1;
+		}
+	}
+
+	a = GET_U32(&v->offs[row * 4]);
+	b = GET_U32(&v->offs[(row + 1) * 4]);
+	if (a > b || b > v->data_len) {
+		return -1;
+	}
+
+	*s = &v->data[a];
+	*len = b - a;
+
+	return 0;
+}
+
+/**
+ * Method get_number(col,vals) will decode all values of column `col` in
+ * current block into `vals`, which must be able to hold `_blk_rows` values.
+ *
+ * Values in block that is stored as string are parsed, and invalid number
+ * is set to NaN.
+ *
+ * On success it will return NULL, otherwise it will return error.
+ */
+Error DSVColumnar::get_number(int col, double* vals)
+{
+	size_t len = 0;
+	size_t n = 0;
+	const char* s = NULL;
+	struct dsv_col_view v;
+
+	if (col < 0 || col >= _n_cols || _blk_rows == 0) {
+		return ErrDSVColumnarColumn;
+	}
+
+	if (VIEW(_map, &_chunks[_blk * size_t(_n_cols) + size_t(col)]
+	, _blk_rows, &v, ! _checked[col]) < 0) {
+		return ErrDSVColumnarFormat;
+	}
+	_checked[col] = 1;
+
+	switch (v.enc) {
+	case DSV_COL_INT:
+		for (size_t x = 0; x < _blk_rows; x++) {
+			vals[x] = double(v.base
+				+ int64_t(UNPACK(v.words, x, v.width)));
+		}
+		break;
+
+	case DSV_COL_DOUBLE:
+		memcpy(vals, v.data, _blk_rows * sizeof(*vals));
+		break;
+
+	default:
+		for (size_t x = 0; x < _blk_rows; x++) {
+			if (VIEW_STRING(&v, x, &s, &len) < 0) {
+				return ErrDSVColumnarFormat;
+			}
+			if (len == 0
+			|| Buffer::PARSE_DOUBLE(s, len, &vals[x], &n) != NULL
+			|| n != len) {
+				vals[x] = NAN;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Method get_string(col,row,v,len) will set `v` and `len` to value of column
+ * `col` at `row` in current block. The value point to the mapped file, is
+ * not terminated by NUL, and only valid until file is closed.
+ *
+ * It will return ErrDSVColumnarType if column in current block is stored as
+ * number.
+ */
+Error DSVColumnar::get_string(int col, size_t row, const char** v
+	, size_t* len)
+{
+	struct dsv_col_view view;
+
+	if (col < 0 || col >= _n_cols || row >= _blk_rows) {
+		return ErrDSVColumnarColumn;
+	}
+
+	if (VIEW(_map, &_chunks[_blk * size_t(_n_cols) + size_t(col)]
+	, _blk_rows, &view, ! _checked[col]) < 0) {
+		return ErrDSVColumnarFormat;
+	}
+	_checked[col] = 1;
+
+	if (view.enc != DSV_COL_PLAIN && view.enc != DSV_COL_DICT) {
+		return ErrDSVColumnarType;
+	}
+
+	if (VIEW_STRING(&view, row, v, len) < 0) {
+		return ErrDSVColumnarFormat;
+	}
+
+	return NULL;
+}
+
+} // namespace::vos
+// vi: ts=8 sw=8 tw=80:
@@ -0,0 +1,117 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#ifndef _LIBVOS_DSVCOLUMNAR_HH
+#define _LIBVOS_DSVCOLUMNAR_HH 1
+
+#include "DSVReader.hh"
+
+namespace vos {
+
+extern Error ErrDSVColumnarFormat;
+extern Error ErrDSVColumnarColumn;
+extern Error ErrDSVColumnarType;
+
+//
+// Encoding of column data in one block.
+//
+// - DSV_COL_PLAIN: offsets of each values followed by their content.
+// - DSV_COL_DICT: list of distinct values followed by bit-packed index of
+//   each values in the list.
+// - DSV_COL_INT: base value followed by bit-packed difference of each values
+//   with the base.
+// - DSV_COL_DOUBLE: array of double.
+//
+enum _dsv_col_enc {
+	DSV_COL_PLAIN = 0
+,	DSV_COL_DICT
+,	DSV_COL_INT
+,	DSV_COL_DOUBLE
+};
+
+//
+// dsv_col_chunk contain the location and statistic of one column in one
+// block.
+//
+struct dsv_col_chunk {
+	uint64_t	off;
+	uint64_t	size;
+	int		enc;
+	int		has_stat;
+	double		min;
+	double		max;
+};
+
+//
+// Class DSVColumnar will convert DSV file into columnar binary file, and read
+// the columnar file back using memory map.
+//
+// Rows in columnar file are divided into blocks of at most `BLOCK_ROWS` rows,
+// and each block contain one chunk of data for each column. Column with
+// NUMBER type is stored as integer or double, with minimum and maximum value
+// of each block, if all of its values in block are valid number; otherwise
+// it is stored as string. The location of each chunks are stored in footer
+// at the end of file.
+//
+// Field `_n_cols` contain number of columns.
+// Field `_n_rows` contain number of rows.
+// Field `_n_blocks` contain number of blocks.
+// Field `_block_rows` contain maximum number of rows in one block.
+// Field `_blk` contain index of current block, set by next_block().
+// Field `_blk_rows` contain number of rows in current block.
+// Field `_n_skipped` contain number of blocks skipped by next_block() since
+// the last rewind().
+//
+class DSVColumnar {
+public:
+	static const char* __cname;
+	static const char* MAGIC;
+	static size_t BLOCK_ROWS;
+	static size_t IO_SIZE;
+
+	static Error CONVERT(const char* fin, List* list_md, const char* fout);
+
+	int		_n_cols;
+	size_t		_n_rows;
+	size_t		_n_blocks;
+	size_t		_block_rows;
+	size_t		_blk;
+	size_t		_blk_rows;
+	size_t		_n_skipped;
+
+	DSVColumnar();
+	~DSVColumnar();
+
+	Error open(const char* path);
+	void close();
+
+	int column(const char* name);
+	int column_type(int col);
+	const struct dsv_col_chunk* chunk(size_t blk, int col);
+
+	void rewind();
+	size_t next_block(int col = -1, double min = 0, double max = 0);
+
+	Error get_number(int col, double* vals);
+	Error get_string(int col, size_t row, const char** v, size_t* len);
+
+private:
+	char*			_map;
+	size_t			_map_size;
+	size_t			_next_blk;
+	int*			_types;
+	Buffer*			_names;
+	uint32_t*		_rows;
+	struct dsv_col_chunk*	_chunks;
+	char*			_checked;
+
+	DSVColumnar(const DSVColumnar&);
+	void operator=(const DSVColumnar&);
+};
+
+} // namespace::vos
+#endif
+// vi: ts=8 sw=8 tw=80:
@@ -0,0 +1,883 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include <float.h>
+
+#include "DSVGroup.hh"
+
+namespace vos {
+
+Error ErrDSVGroupKey("DSVGroup: invalid or unknown key");
+Error ErrDSVGroupAgg("DSVGroup: invalid aggregate");
+
+const char* DSVGroup::__cname = "DSVGroup";
+
+const char* DSVGroup::FN_NAMES[N_DSV_GROUP_FN] = {
+	"count"
+,	"sum"
+,	"min"
+,	"max"
+,	"avg"
+};
+
+//
+// Variable N_THREAD contain default number of aggregating threads.
+//
+int DSVGroup::N_THREAD = 2;
+
+//
+// Variable BATCH_ROWS contain number of rows passed to aggregating thread at
+// once.
+//
+size_t DSVGroup::BATCH_ROWS = 8192;
+
+//
+// Variable IO_SIZE contain size of buffer for input file.
+//
+size_t DSVGroup::IO_SIZE = 1024 * 1024;
+
+static const size_t GROUP_BUCKET_MIN = 1024;
+
+//
+// dsv_group_acc contain accumulator of one aggregate in one group.
+// Field `n` contain number of rows for count, or number of numeric values
+// for the other functions.
+//
+struct dsv_group_acc {
+	double	sum;
+	double	min;
+	double	max;
+	size_t	n;
+};
+
+//
+// dsv_group_entry contain one group in table. Field `next` contain index plus
+// one of the next group in the same bucket, or zero if none. Field `key`
+// contain offset of key in table keys.
+//
+struct dsv_group_entry {
+	uint64_t	hash;
+	size_t		next;
+	size_t		key;
+	size_t		key_len;
+};
+
+//
+// dsv_group_table is a chained hash table of groups. Accumulators of group
+// `x` is in `acc[x * n_aggs]`.
+//
+struct dsv_group_table {
+	size_t*			buckets;
+	size_t			n_bucket;
+	struct dsv_group_entry*	e;
+	struct dsv_group_acc*	acc;
+	size_t			n;
+	size_t			cap;
+	Buffer			keys;
+
+	dsv_group_table()
+	:	buckets(NULL)
+	,	n_bucket(0)
+	,	e(NULL)
+	,	acc(NULL)
+	,	n(0)
+	,	cap(0)
+	,	keys()
+	{}
+
+	~dsv_group_table()
+	{
+		free(buckets);
+		free(e);
+		free(acc);
+	}
+private:
+	dsv_group_table(const dsv_group_table&);
+	void operator=(const dsv_group_table&);
+};
+
+//
+// dsv_group_batch contain rows that will be aggregated by one thread.
+// Key of row `x` is in `keys` at `key_off[x]`, and its value for aggregate
+// `a` is in `vals[x * n_aggs + a]`, which is valid only if `valid` at the same
+// index is 1.
+//
+struct dsv_group_batch {
+	Buffer		keys;
+	size_t*		key_off;
+	size_t*		key_len;
+	uint64_t*	hash;
+	double*		vals;
+	char*		valid;
+	size_t		n;
+
+	dsv_group_batch()
+	:	keys()
+	,	key_off(NULL)
+	,	key_len(NULL)
+	,	hash(NULL)
+	,	vals(NULL)
+	,	valid(NULL)
+	,	n(0)
+	{}
+
+	~dsv_group_batch()
+	{
+		free(key_off);
+		free(key_len);
+		free(hash);
+		free(vals);
+		free(valid);
+	}
+private:
+	dsv_group_batch(const dsv_group_batch&);
+	void operator=(const dsv_group_batch&);
+};
+
+//
+// dsv_group_part contain partial aggregate of one thread.
+//
+struct dsv_group_part {
+	DSVGroup*		g;
+	struct dsv_group_table	t;
+	struct dsv_group_batch	b;
+	Error			err;
+
+	dsv_group_part()
+	:	g(NULL)
+	,	t()
+	,	b()
+	,	err()
+	{}
+private:
+	dsv_group_part(const dsv_group_part&);
+	void operator=(const dsv_group_part&);
+};
+
+//
+// COLUMN will return the column of field `idx` in row that contain only the
+// fields in `sel`, which is the number of distinct fields in `sel` that is
+// less than `idx`.
+//
+static int COLUMN(const int* sel, int n, int idx)
+{
+	int col = 0;
+	int y = 0;
+
+	for (int x = 0; x < n; x++) {
+		if (sel[x] < 0 || sel[x] >= idx) {
+			continue;
+		}
+		for (y = 0; y < x; y++) {
+			if (sel[y] == sel[x]) {
+				break;
+			}
+		}
+		if (y == x) {
+			++col;
+		}
+	}
+
+	return col;
+}
+
+//
+// FIELD will return index of field with name `name` of length `len` in
+// `list_md`, or -1 if not found.
+//
+static int FIELD(List* list_md, const char* name, size_t len)
+{
+	BNode* node = list_md->head();
+	DSVRecordMD* md = NULL;
+
+	for (int x = 0; x < list_md->size(); x++, node = node->get_right()) {
+		md = (DSVRecordMD*) node->get_content();
+		if (md->_name.len() == len
+		&&  memcmp(md->_name.v(), name, len) == 0) {
+			return x;
+		}
+	}
+
+	return -1;
+}
+
+//
+// TABLE_GROW will double the number of buckets in `t` and rehash its groups.
+//
+static Error TABLE_GROW(struct dsv_group_table* t)
+{
+	size_t n = t->n_bucket ? t->n_bucket * 2 : GROUP_BUCKET_MIN;
+	size_t* b = (size_t*) calloc(n, sizeof(*b));
+	size_t slot = 0;
+
+	if (! b) {
+		return ErrOutOfMemory;
+	}
+
+	for (size_t x = 0; x < t->n; x++) {
+		slot = t->e[x].hash & (n - 1);
+		t->e[x].next = b[slot];
+		b[slot] = x + 1;
+	}
+
+	free(t->buckets);
+	t->buckets = b;
+	t->n_bucket = n;
+
+	return NULL;
+}
+
+//
+// TABLE_GET will return accumulators of group with key `key` in `acc`. If
+// group is not exist, it will be created.
+//
+static Error TABLE_GET(struct dsv_group_table* t, int n_aggs, uint64_t hash
+	, const char* key, size_t len, struct dsv_group_acc** acc)
+{
+	size_t x = 0;
+	size_t cap = 0;
+	size_t na = size_t(n_aggs);
+	struct dsv_group_entry* e = NULL;
+	void* p = NULL;
+	Error err;
+
+	if (t->n_bucket) {
+		x = t->buckets[hash & (t->n_bucket - 1)];
+		for (; x; x = e->next) {
+			e = &t->e[x - 1];
+			if (e->hash == hash && e->key_len == len
+			&&  memcmp(t->keys.v(e->key), key, len) == 0) {
+				*acc = &t->acc[(x - 1) * na];
+				return NULL;
+			}
+		}
+	}
+
+	if (t->n == t->cap) {
+		cap = t->cap ? t->cap * 2 : GROUP_BUCKET_MIN;
+
+		p = realloc(t->e, cap * sizeof(*t->e));
+		if (! p) {
+			return ErrOutOfMemory;
+		}
+		t->e = (struct dsv_group_entry*) p;
+
+		p = realloc(t->acc, cap * na * sizeof(*t->acc) + 1);
+		if (! p) {
+			return ErrOutOfMemory;
+		}
+		t->acc = (struct dsv_group_acc*) p;
+
+		t->cap = cap;
+	}
+	if (t->n >= t->n_bucket / 4 * 3) {
+		err = TABLE_GROW(t);
+		if (err != NULL) {
+			return err;
+		}
+	}
+
+	cap = t->keys.size();
+	if (t->keys.len() + len >= cap) {
+		err = t->keys.resize(cap * 2 > len ? cap * 2 : cap + len);
+		if (err != NULL) {
+			return err;
+		}
+	}
+
+	e = &t->e[t->n];
+	e->hash = hash;
+	e->key = t->keys.len();
+	e->key_len = len;
+
+	if (len > 0) {
+		t->keys.append_raw(key, len);
+	}
+
+	*acc = &t->acc[t->n * na];
+	for (x = 0; x < na; x++) {
+		(*acc)[x].sum = 0;
+		(*acc)[x].min = DBL_MAX;
+		(*acc)[x].max = -DBL_MAX;
+		(*acc)[x].n = 0;
+	}
+
+	x = hash & (t->n_bucket - 1);
+	e->next = t->buckets[x];
+	t->buckets[x] = ++t->n;
+
+	return NULL;
+}
+
+//
+// AGG_BATCH will aggregate all rows in batch of partial `arg` into its table,
+// and empty the batch.
+//
+static void* AGG_BATCH(void* arg)
+{
+	struct dsv_group_part* part = (struct dsv_group_part*) arg;
+	struct dsv_group_batch* b = &part->b;
+	struct dsv_group_acc* acc = NULL;
+	int n_aggs = part->g->_n_aggs;
+	int* fn = part->g->_agg_fn;
+	size_t na = size_t(n_aggs);
+	size_t y = 0;
+	double v = 0;
+
+	for (size_t x = 0; x < b->n; x++) {
+		part->err = TABLE_GET(&part->t, n_aggs, b->hash[x]
+			, b->keys.v(b->key_off[x]), b->key_len[x], &acc);
+		if (part->err != NULL) {
+			break;
+		}
+
+		for (int a = 0; a < n_aggs; a++) {
+			if (fn[a] == DSV_GROUP_COUNT) {
+				++acc[a].n;
+				continue;
+			}
+
+			y = x * na + size_t(a);
+			if (! b->valid[y]) {
+				continue;
+			}
+
+			v = b->vals[y];
+
+			++acc[a].n;
+			acc[a].sum += v;
+			if (v < acc[a].min) {
+				acc[a].min = v;
+			}
+			if (v > acc[a].max) {
+				acc[a].max = v;
+			}
+		}
+	}
+
+	b->n = 0;
+	b->keys.truncate(0);
+
+	return NULL;
+}
+
+//
+// BATCH_INIT will allocate space for `rows` rows with `n_aggs` aggregates in
+// batch `b`.
+//
+static Error BATCH_INIT(struct dsv_group_batch* b, size_t rows, int n_aggs)
+{
+	size_t nv = rows * size_t(n_aggs) + 1;
+
+	b->key_off = (size_t*) calloc(rows, sizeof(*b->key_off));
+	b->key_len = (size_t*) calloc(rows, sizeof(*b->key_len));
+	b->hash = (uint64_t*) calloc(rows, sizeof(*b->hash));
+	b->vals = (double*) calloc(nv, sizeof(*b->vals));
+	b->valid = (char*) calloc(nv, sizeof(*b->valid));
+
+	if (! b->key_off || ! b->key_len || ! b->hash || ! b->vals
+	||  ! b->valid) {
+		return ErrOutOfMemory;
+	}
+
+	return NULL;
+}
+
+DSVGroup::DSVGroup()
+:	_n_thread(N_THREAD)
+,	_sep(',')
+,	_n_keys(0)
+,	_key_idx(NULL)
+,	_key_col(NULL)
+,	_n_aggs(0)
+,	_agg_fn(NULL)
+,	_agg_idx(NULL)
+,	_agg_col(NULL)
+,	_n_rows(0)
+,	_n_groups(0)
+,	_elapsed(0)
+{}
+
+DSVGroup::~DSVGroup()
+{
+	free(_key_idx);
+	free(_key_col);
+	free(_agg_fn);
+	free(_agg_idx);
+	free(_agg_col);
+}
+
+/**
+ * Method set_keys will set the group keys using field names in `keys`,
+ * separated by comma, e.g. "date,name". If `keys` is NULL or empty, all rows
+ * is aggregated into one group.
+ *
+ * On success it will return NULL. If one of the key is not found in
+ * `list_md` it will return ErrDSVGroupKey.
+ */
+Error DSVGroup::set_keys(List* list_md, const char* keys)
+{
+	size_t len = 0;
+	size_t cap = 0;
+	const char* p = keys ? keys : "";
+
+	free(_key_idx);
+	free(_key_col);
+	_n_keys = 0;
+
+	cap = strlen(p) / 2 + 1;
+
+	_key_idx = (int*) calloc(cap, sizeof(int));
+	_key_col = (int*) calloc(cap, sizeof(int));
+	if (! _key_idx || ! _key_col) {
+		return ErrOutOfMemory;
+	}
+
+	while (*p) {
+		while (*p == ',' || isspace(*p)) {
+			++p;
+		}
+		len = 0;
+		while (p[len] && p[len] != ',' && !isspace(p[len])) {
+			++len;
+		}
+		if (len == 0) {
+			break;
+		}
+
+		_key_idx[_n_keys] = FIELD(list_md, p, len);
+		if (_key_idx[_n_keys] < 0) {
+			_n_keys = 0;
+			return ErrDSVGroupKey;
+		}
+		++_n_keys;
+
+		p += len;
+	}
+
+	return NULL;
+}
+
+/**
+ * Method set_aggs will set the aggregates using list of function in `aggs`,
+ * separated by comma, e.g. "count,sum(n),avg(n)". Known functions are count,
+ * sum, min, max, and avg. Except count, function must have one field with
+ * type NUMBER as parameter. Count always count all rows in group, with or
+ * without field.
+ *
+ * Field value that is not a number is not aggregated by sum, min, max, and
+ * avg.
+ *
+ * On success it will return NULL, otherwise it will return ErrDSVGroupAgg.
+ */
+Error DSVGroup::set_aggs(List* list_md, const char* aggs)
+{
+	int fn = 0;
+	size_t len = 0;
+	size_t cap = strlen(aggs) / 2 + 1;
+	const char* p = aggs;
+	DSVRecordMD* md = NULL;
+
+	free(_agg_fn);
+	free(_agg_idx);
+	free(_agg_col);
+	_n_aggs = 0;
+
+	_agg_fn = (int*) calloc(cap, sizeof(int));
+	_agg_idx = (int*) calloc(cap, sizeof(int));
+	_agg_col = (int*) calloc(cap, sizeof(int));
+	if (! _agg_fn || ! _agg_idx || ! _agg_col) {
+		return ErrOutOfMemory;
+	}
+
+	while (*p) {
+		while (*p == ',' || isspace(*p)) {
+			++p;
+		}
+		len = 0;
+		while (isalpha(p[len])) {
+			++len;
+		}
+		if (len == 0) {
+			if (*p) {
+				goto err;
+			}
+			break;
+		}
+
+		for (fn = 0; fn < N_DSV_GROUP_FN; fn++) {
+			if (strlen(FN_NAMES[fn]) == len
+			&&  strncmp(FN_NAMES[fn], p, len) == 0) {
+				break;
+			}
+		}
+		if (fn == N_DSV_GROUP_FN) {
+			goto err;
+		}
+		p += len;
+
+		_agg_fn[_n_aggs] = fn;
+		_agg_idx[_n_aggs] = -1;
+
+		if (*p != '(') {
+			if (fn != DSV_GROUP_COUNT) {
+				goto err;
+			}
+			++_n_aggs;
+			continue;
+		}
+
+		++p;
+		len = 0;
+		while (p[len] && p[len] != ')') {
+			++len;
+		}
+		if (p[len] != ')') {
+			goto err;
+		}
+
+		_agg_idx[_n_aggs] = FIELD(list_md, p, len);
+		if (_agg_idx[_n_aggs] < 0) {
+			goto err;
+		}
+
+		md = (DSVRecordMD*) list_md->at(_agg_idx[_n_aggs]);
+		if (fn != DSV_GROUP_COUNT && md->_type != RMD_T_NUMBER) {
+			goto err;
+		}
+
+		++_n_aggs;
+		p += len + 1;
+	}
+
+	if (_n_aggs > 0) {
+		return NULL;
+	}
+err:
+	_n_aggs = 0;
+	return ErrDSVGroupAgg;
+}
+
+/**
+ * Method group will aggregate rows in file `fin` by keys that has been set
+ * by set_keys() and write each group into `fout`, one row per group. Each
+ * output row contain the value of keys, followed by the value of aggregates
+ * that has been set by set_aggs(), separated by `_sep`.
+ *
+ * Groups are written in the order they are first found by each thread; they
+ * are not sorted. Min, max, and avg of group without any numeric value is
+ * written as empty column.
+ *
+ * Only key and aggregate fields are read from input. Projection in
+ * `list_md` is reset to all fields when it is finished.
+ *
+ * On success it will return NULL, otherwise it will return error.
+ */
+Error DSVGroup::group(const char* fin, List* list_md, const char* fout)
+{
+	int s = 0;
+	int b = 0;
+	int x = 0;
+	int n_thread = _n_thread > 0 ? _n_thread : 1;
+	int n_col = 0;
+	size_t na = size_t(_n_aggs);
+	size_t n = 0;
+	size_t len = 0;
+	size_t y = 0;
+	double start = NOW();
+	DSVReader reader;
+	DSVRecord* row = NULL;
+	DSVRecord* col = NULL;
+	struct dsv_group_part* parts = NULL;
+	struct dsv_group_part* part = NULL;
+	struct dsv_group_batch* batch = NULL;
+	struct dsv_group_table* t = NULL;
+	struct dsv_group_acc* acc = NULL;
+	struct dsv_group_acc* from = NULL;
+	Thread** threads = NULL;
+	int* busy = NULL;
+	const char* key = NULL;
+	Buffer line;
+	File w;
+	Error err;
+
+	_n_rows = 0;
+	_n_groups = 0;
+
+	if (_n_aggs == 0) {
+		return ErrDSVGroupAgg;
+	}
+
+	n_col = project(list_md);
+
+	err = reader.open_ro(fin);
+	if (err != NULL) {
+		goto out;
+	}
+	reader.resize(IO_SIZE);
+
+	parts = new struct dsv_group_part[n_thread];
+	threads = (Thread**) calloc(size_t(n_thread), sizeof(*threads));
+	busy = (int*) calloc(size_t(n_thread), sizeof(*busy));
+	if (! parts || ! threads || ! busy) {
+		err = ErrOutOfMemory;
+		goto out;
+	}
+
+	for (x = 0; x < n_thread; x++) {
+		parts[x].g = this;
+		threads[x] = new Thread(&AGG_BATCH);
+		if (! threads[x]) {
+			err = ErrOutOfMemory;
+			goto out;
+		}
+
+		err = BATCH_INIT(&parts[x].b, BATCH_ROWS, _n_aggs);
+		if (err != NULL) {
+			goto out;
+		}
+	}
+
+	batch = &parts[0].b;
+
+	DSVRecord::INIT_ROW(&row, n_col);
+
+	do {
+		row->columns_reset();
+		s = reader.read(row, list_md);
+		if (s <= 0) {
+			continue;
+		}
+		++_n_rows;
+
+		n = batch->n;
+
+		batch->key_off[n] = batch->keys.len();
+		for (x = 0; x < _n_keys; x++) {
+			col = row->get_column(_key_col[x]);
+			len = col->len();
+			batch->keys.append_raw((const char*) &len, sizeof(len));
+			if (len > 0) {
+				batch->keys.append_raw(col->v(), len);
+			}
+		}
+		batch->key_len[n] = batch->keys.len() - batch->key_off[n];
+		batch->hash[n] = FNV1A_64(batch->keys.v(batch->key_off[n])
+			, batch->key_len[n]);
+
+		for (x = 0; x < _n_aggs; x++) {
+			y = n * na + size_t(x);
+			if (_agg_fn[x] == DSV_GROUP_COUNT) {
+				continue;
+			}
+
+			col = row->get_column(_agg_col[x]);
+			len = 0;
+			batch->valid[y] = Buffer::PARSE_DOUBLE(col->v()
+				, col->len(), &batch->vals[y], &len) == NULL
+				&& len > 0;
+		}
+
+		if (++batch->n < BATCH_ROWS) {
+			continue;
+		}
+
+		// Aggregate the batch in this thread if new thread can not be
+		// started.
+		if (threads[b]->start(&parts[b]) == 0) {
+			busy[b] = 1;
+		} else {
+			AGG_BATCH(&parts[b]);
+			if (parts[b].err != NULL) {
+				err = parts[b].err;
+				goto out;
+			}
+		}
+
+		b = (b + 1) % n_thread;
+		batch = &parts[b].b;
+
+		if (busy[b]) {
+			threads[b]->join();
+			busy[b] = 0;
+			if (parts[b].err != NULL) {
+				err = parts[b].err;
+				goto out;
+			}
+		}
+	} while (s != 0);
+
+	if (batch->n > 0) {
+		AGG_BATCH(&parts[b]);
+	}
+
+	for (x = 0; x < n_thread; x++) {
+		if (busy[x]) {
+			threads[x]->join();
+			busy[x] = 0;
+		}
+		if (parts[x].err != NULL) {
+			err = parts[x].err;
+			goto out;
+		}
+	}
+
+	// Combine the partial tables into the first one.
+	t = &parts[0].t;
+	for (x = 1; x < n_thread; x++) {
+		part = &parts[x];
+
+		for (n = 0; n < part->t.n; n++) {
+			err = TABLE_GET(t, _n_aggs, part->t.e[n].hash
+				, part->t.keys.v(part->t.e[n].key)
+				, part->t.e[n].key_len, &acc);
+			if (err != NULL) {
+				goto out;
+			}
+
+			from = &part->t.acc[n * na];
+			for (y = 0; y < na; y++) {
+				acc[y].n += from[y].n;
+				acc[y].sum += from[y].sum;
+				if (from[y].min < acc[y].min) {
+					acc[y].min = from[y].min;
+				}
+				if (from[y].max > acc[y].max) {
+					acc[y].max = from[y].max;
+				}
+			}
+		}
+	}
+
+	err = w.open_wt(fout);
+	if (err != NULL) {
+		goto out;
+	}
+	w.resize(IO_SIZE);
+
+	for (n = 0; n < t->n; n++) {
+		line.truncate(0);
+
+		key = t->keys.v(t->e[n].key);
+		for (x = 0; x < _n_keys; x++) {
+			memcpy(&len, key, sizeof(len));
+			key += sizeof(len);
+
+			if (x > 0) {
+				line.appendc(_sep);
+			}
+			if (len > 0) {
+				line.append_raw(key, len);
+			}
+			key += len;
+		}
+
+		acc = &t->acc[n * na];
+		for (x = 0; x < _n_aggs; x++) {
+			if (_n_keys > 0 || x > 0) {
+				line.appendc(_sep);
+			}
+			if (_agg_fn[x] == DSV_GROUP_COUNT) {
+				line.appendui(acc[x].n);
+				continue;
+			}
+			if (_agg_fn[x] == DSV_GROUP_SUM) {
+				line.appendd_shortest(acc[x].sum);
+				continue;
+			}
+			if (acc[x].n == 0) {
+				continue;
+			}
+			switch (_agg_fn[x]) {
+			case DSV_GROUP_MIN:
+				line.appendd_shortest(acc[x].min);
+				break;
+			case DSV_GROUP_MAX:
+				line.appendd_shortest(acc[x].max);
+				break;
+			case DSV_GROUP_AVG:
+				line.appendd_shortest(acc[x].sum / double(acc[x].n));
+				break;
+			}
+		}
+		line.appendc('\n');
+
+		err = w.write(&line);
+		if (err != NULL) {
+			goto out;
+		}
+	}
+
+	_n_groups = t->n;
+
+	err = w.flush();
+out:
+	w.close();
+
+	if (row) {
+		delete row;
+	}
+	for (x = 0; threads && x < n_thread; x++) {
+		if (busy && busy[x]) {
+			threads[x]->join();
+		}
+		delete threads[x];
+	}
+	delete[] parts;
+	free(threads);
+	free(busy);
+
+	reader.close();
+
+	DSVRecordMD::PROJECT_IDX(list_md, NULL, 0);
+
+	_elapsed = NOW() - start;
+
+	return err;
+}
+
+//
+// `project(list_md)` will select only key and aggregate fields in `list_md`
+// and set the column of each keys and aggregates in projected row. It will
+// return number of selected fields.
+//
+int DSVGroup::project(List* list_md)
+{
+	int n = _n_keys + _n_aggs;
+	int* sel = (int*) calloc(size_t(n) + 1, sizeof(int));
+	int x = 0;
+	int y = 0;
+
+	for (x = 0; x < _n_keys; x++) {
+		sel[y++] = _key_idx[x];
+	}
+	for (x = 0; x < _n_aggs; x++) {
+		if (_agg_idx[x] >= 0) {
+			sel[y++] = _agg_idx[x];
+		}
+	}
+
+	for (x = 0; x < _n_keys; x++) {
+		_key_col[x] = COLUMN(sel, y, _key_idx[x]);
+	}
+	for (x = 0; x < _n_aggs; x++) {
+		_agg_col[x] = COLUMN(sel, y, _agg_idx[x]);
+	}
+
+	if (y == 0) {
+		// Only count without keys; read the first field.
+		sel[y++] = 0;
+	}
+
+	n = DSVRecordMD::PROJECT_IDX(list_md, sel, y);
+
+	free(sel);
+
+	return n;
+}
+
+} // namespace::vos
+// vi: ts=8 sw=8 tw=80:
@@ -0,0 +1,85 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#ifndef _LIBVOS_DSVGROUP_HH
+#define _LIBVOS_DSVGROUP_HH 1
+
+#include "Thread.hh"
+#include "DSVReader.hh"
+
+namespace vos {
+
+extern Error ErrDSVGroupKey;
+extern Error ErrDSVGroupAgg;
+
+enum _dsv_group_fn {
+	DSV_GROUP_COUNT = 0
+,	DSV_GROUP_SUM
+,	DSV_GROUP_MIN
+,	DSV_GROUP_MAX
+,	DSV_GROUP_AVG
+,	N_DSV_GROUP_FN
+};
+
+//
+// Class DSVGroup will aggregate rows in DSV file by one or more key fields,
+// in one pass, using hash table of accumulators.
+//
+// Rows are read by one thread into batches, and each batch is aggregated by
+// one of `_n_thread` threads into its own partial table. All partial tables
+// are combined when the input has been read.
+//
+// Field `_n_thread` contain number of aggregating threads.
+// Field `_sep` contain character that separate columns in output.
+// Field `_n_keys` contain number of key fields.
+// Field `_key_idx` contain field index of each keys in meta-data.
+// Field `_key_col` contain column index of each keys in the projected row.
+// Field `_n_aggs` contain number of aggregates.
+// Field `_agg_fn` contain function of each aggregates, one of DSV_GROUP_*.
+// Field `_agg_idx` contain field index of each aggregates, -1 for count.
+// Field `_agg_col` contain column index of each aggregates in projected row.
+// Field `_n_rows` contain number of rows read by the last group().
+// Field `_n_groups` contain number of groups written by the last group().
+// Field `_elapsed` contain the time used by the last group(), in seconds.
+//
+class DSVGroup {
+public:
+	static const char* __cname;
+	static const char* FN_NAMES[N_DSV_GROUP_FN];
+	static int N_THREAD;
+	static size_t BATCH_ROWS;
+	static size_t IO_SIZE;
+
+	int	_n_thread;
+	char	_sep;
+	int	_n_keys;
+	int*	_key_idx;
+	int*	_key_col;
+	int	_n_aggs;
+	int*	_agg_fn;
+	int*	_agg_idx;
+	int*	_agg_col;
+	size_t	_n_rows;
+	size_t	_n_groups;
+	double	_elapsed;
+
+	DSVGroup();
+	~DSVGroup();
+
+	Error set_keys(List* list_md, const char* keys);
+	Error set_aggs(List* list_md, const char* aggs);
+	Error group(const char* fin, List* list_md, const char* fout);
+
+private:
+	int project(List* list_md);
+
+	DSVGroup(const DSVGroup&);
+	void operator=(const DSVGroup&);
+};
+
+} // namespace::vos
+#endif
+// vi: ts=8 sw=8 tw=80:
@@ -0,0 +1,991 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include "DSVJoin.hh"
+
+namespace vos {
+
+Error ErrDSVJoinKey("DSVJoin: invalid or unknown key");
+
+const char* DSVJoin::__cname = "DSVJoin";
+
+//
+// Variable MEM_LIMIT contain default memory limit for hash table.
+//
+size_t DSVJoin::MEM_LIMIT = 64 * 1024 * 1024;
+
+//
+// Variable IO_SIZE contain size of buffer for input and output file.
+//
+size_t DSVJoin::IO_SIZE = 1024 * 1024;
+
+//
+// Variable N_PART_MAX contain maximum number of partitions when input does
+// not fit in memory.
+//
+int DSVJoin::N_PART_MAX = 64;
+
+static const size_t PART_IO_SIZE = 64 * 1024;
+static const size_t HASH_BUCKET_MIN = 1024;
+
+//
+// dsv_hash_entry contain one row in hash table. Field `next`, `dup`, and
+// `last` contain index plus one of another entry, or zero if none.
+//
+// Field `next` point to the next entry with different key in the same bucket.
+// Field `dup` point to the next entry with the same key, in the order they
+// are added.
+// Field `last` point to the last entry with the same key, set only on the
+// first one.
+// Field `key` and `raw` contain offset of key and raw row in hash data.
+//
+struct dsv_hash_entry {
+	uint64_t	hash;
+	size_t		next;
+	size_t		dup;
+	size_t		last;
+	size_t		key;
+	size_t		key_len;
+	size_t		raw;
+	size_t		raw_len;
+};
+
+//
+// dsv_hash is a chained hash table of rows, with keys and raw rows stored in
+// `data`.
+//
+struct dsv_hash {
+	size_t*			buckets;
+	size_t			n_bucket;
+	struct dsv_hash_entry*	e;
+	size_t			n;
+	size_t			cap;
+	Buffer			data;
+
+	dsv_hash()
+	:	buckets(NULL)
+	,	n_bucket(0)
+	,	e(NULL)
+	,	n(0)
+	,	cap(0)
+	,	data()
+	{}
+
+	~dsv_hash()
+	{
+		free(buckets);
+		free(e);
+	}
+private:
+	dsv_hash(const dsv_hash&);
+	void operator=(const dsv_hash&);
+};
+
+//
+// dsv_join_key contain the key of rows read with projected meta-data.
+//
+// Field `n_col` contain number of columns in projected row.
+// Field `col` contain column index in projected row of each `n` keys, in the
+// order of key names.
+//
+struct dsv_join_key {
+	int	n_col;
+	int	n;
+	int*	col;
+
+	dsv_join_key()
+	:	n_col(0)
+	,	n(0)
+	,	col(NULL)
+	{}
+
+	~dsv_join_key()
+	{
+		free(col);
+	}
+private:
+	dsv_join_key(const dsv_join_key&);
+	void operator=(const dsv_join_key&);
+};
+
+//
+// KEY_INIT will project `list_md` to fields in `names`, separated by comma,
+// and set the column of each name in `k`. If `names` is NULL all fields are
+// used.
+//
+// On success it will return NULL. If one of the name is not found, it will
+// return ErrDSVJoinKey.
+//
+static Error KEY_INIT(struct dsv_join_key* k, List* list_md
+	, const char* names)
+{
+	int x = 0;
+	int y = 0;
+	int size = list_md->size();
+	size_t len = 0;
+	size_t cap = names ? strlen(names) / 2 + 1 : size_t(size);
+	const char* p = names;
+	DSVRecordMD* md = NULL;
+	int* idx = (int*) calloc(cap, sizeof(*idx));
+
+	free(k->col);
+	k->n_col = 0;
+	k->n = 0;
+	k->col = (int*) calloc(cap, sizeof(*k->col));
+
+	if (! idx || ! k->col) {
+		free(idx);
+		return ErrOutOfMemory;
+	}
+
+	if (! names) {
+		for (; k->n < size; k->n++) {
+			idx[k->n] = k->n;
+		}
+	}
+
+	while (p && *p) {
+		while (*p == ',' || isspace(*p)) {
+			++p;
+		}
+		len = 0;
+		while (p[len] && p[len] != ',' && !isspace(p[len])) {
+			++len;
+		}
+		if (len == 0) {
+			break;
+		}
+
+		for (x = 0; x < size; x++) {
+			md = (DSVRecordMD*) list_md->at(x);
+			if (md->_name.len() == len
+			&&  memcmp(md->_name.v(), p, len) == 0) {
+				break;
+			}
+		}
+		if (x >= size) {
+			k->n = 0;
+			break;
+		}
+
+		idx[k->n++] = x;
+		p += len;
+	}
+
+	if (k->n > 0) {
+		k->n_col = DSVRecordMD::PROJECT_IDX(list_md, idx, k->n);
+	}
+
+	// Selected fields are read into row in the order of meta-data, so the
+	// column of each key is the number of selected fields before it.
+	for (x = 0; x < k->n; x++) {
+		for (y = 0; y < idx[x]; y++) {
+			md = (DSVRecordMD*) list_md->at(y);
+			if (! (md->_flag & RMD_FL_SKIP)) {
+				++k->col[x];
+			}
+		}
+	}
+
+	free(idx);
+
+	if (k->n_col <= 0) {
+		return ErrDSVJoinKey;
+	}
+
+	return NULL;
+}
+
+//
+// SKIP_SAVE will return the projection in `list_md`, as RMD_FL_SKIP flag of
+// each field, or NULL if out of memory.
+//
+static int* SKIP_SAVE(List* list_md)
+{
+	int* skip = (int*) calloc(size_t(list_md->size()) + 1, sizeof(*skip));
+
+	for (int x = 0; skip && x < list_md->size(); x++) {
+		skip[x] = ((DSVRecordMD*) list_md->at(x))->_flag & RMD_FL_SKIP;
+	}
+
+	return skip;
+}
+
+//
+// SKIP_RESTORE will set the projection in `list_md` back to `skip` that has
+// been returned by SKIP_SAVE, and free it.
+//
+static void SKIP_RESTORE(List* list_md, int* skip)
+{
+	DSVRecordMD* md = NULL;
+
+	for (int x = 0; skip && x < list_md->size(); x++) {
+		md = (DSVRecordMD*) list_md->at(x);
+		md->_flag = (md->_flag & ~RMD_FL_SKIP) | skip[x];
+	}
+
+	free(skip);
+}
+
+//
+// KEY will set `key` to the value of each key columns `k` in `row`, each
+// prefixed with its length.
+//
+static void KEY(DSVRecord* row, const struct dsv_join_key* k, Buffer* key)
+{
+	size_t len = 0;
+	DSVRecord* col = NULL;
+
+	key->truncate(0);
+
+	for (int x = 0; x < k->n; x++) {
+		col = row->get_column(k->col[x]);
+		if (! col) {
+			break;
+		}
+		len = col->len();
+		key->append_raw((const char*) &len, sizeof(len));
+		key->append_raw(col->v(), len);
+	}
+}
+
+//
+// HASH_MEM will return the size of memory used by hash table `h`.
+//
+static size_t HASH_MEM(struct dsv_hash* h)
+{
+	return h->data.size() + h->cap * sizeof(*h->e)
+		+ h->n_bucket * sizeof(*h->buckets);
+}
+
+//
+// HASH_RESET will remove all entries and release memory in hash table `h`.
+//
+static void HASH_RESET(struct dsv_hash* h)
+{
+	free(h->buckets);
+	free(h->e);
+	h->buckets = NULL;
+	h->n_bucket = 0;
+	h->e = NULL;
+	h->n = 0;
+	h->cap = 0;
+	h->data.release();
+}
+
+//
+// HASH_FIND will return index plus one of the first entry with key `key`, or
+// zero if not found.
+//
+static size_t HASH_FIND(struct dsv_hash* h, uint64_t hash, const char* key
+	, size_t len)
+{
+	size_t x = 0;
+	struct dsv_hash_entry* e = NULL;
+
+	if (h->n_bucket == 0) {
+		return 0;
+	}
+
+	for (x = h->buckets[hash & (h->n_bucket - 1)]; x; x = e->next) {
+		e = &h->e[x - 1];
+		if (e->hash == hash && e->key_len == len
+		&&  memcmp(h->data.v(e->key), key, len) == 0) {
+			return x;
+		}
+	}
+
+	return 0;
+}
+
+//
+// HASH_GROW will double the number of buckets in `h` and rehash its entries.
+//
+static Error HASH_GROW(struct dsv_hash* h)
+{
+	size_t n = h->n_bucket ? h->n_bucket * 2 : HASH_BUCKET_MIN;
+	size_t* b = (size_t*) calloc(n, sizeof(*b));
+	size_t slot = 0;
+
+	if (! b) {
+		return ErrOutOfMemory;
+	}
+
+	for (size_t x = 0; x < h->n; x++) {
+		if (h->e[x].last == 0) {
+			continue;
+		}
+		slot = h->e[x].hash & (n - 1);
+		h->e[x].next = b[slot];
+		b[slot] = x + 1;
+	}
+
+	free(h->buckets);
+	h->buckets = b;
+	h->n_bucket = n;
+
+	return NULL;
+}
+
+//
+// HASH_APPEND will append `len` bytes of `v` to data in `h` and return its
+// offset in `off`. If `eol` is not NULL and `v` does not end with it, it will
+// be appended.
+//
+static Error HASH_APPEND(struct dsv_hash* h, const char* v, size_t len
+	, const char* eol, size_t* off)
+{
+	size_t need = h->data.len() + len + 1;
+	size_t size = h->data.size();
+	Error err;
+
+	if (need > size) {
+		err = h->data.resize(need > size * 2 ? need : size * 2);
+		if (err != NULL) {
+			return err;
+		}
+	}
+
+	*off = h->data.len();
+	h->data.append_raw(v, len);
+
+	if (eol && (len == 0 || v[len - 1] != eol[0])) {
+		h->data.appendc(eol[0]);
+	}
+
+	return NULL;
+}
+
+//
+// HASH_ADD will add row with key `key` and raw row `raw` to `h`. If `raw` is
+// NULL only the key is stored. The raw row is stored with end of line `eol`.
+//
+static Error HASH_ADD(struct dsv_hash* h, uint64_t hash, const char* key
+	, size_t key_len, const char* raw, size_t raw_len, const char* eol)
+{
+	size_t first = HASH_FIND(h, hash, key, key_len);
+	size_t slot = 0;
+	struct dsv_hash_entry* e = NULL;
+	void* p = NULL;
+	Error err;
+
+	if (h->n == h->cap) {
+		h->cap = h->cap ? h->cap * 2 : HASH_BUCKET_MIN;
+		p = realloc(h->e, h->cap * sizeof(*h->e));
+		if (! p) {
+			return ErrOutOfMemory;
+		}
+		h->e = (struct dsv_hash_entry*) p;
+	}
+	if (h->n >= h->n_bucket / 4 * 3) {
+		err = HASH_GROW(h);
+		if (err != NULL) {
+			return err;
+		}
+	}
+
+	e = &h->e[h->n];
+	memset(e, 0, sizeof(*e));
+	e->hash = hash;
+
+	if (first) {
+		e->key = h->e[first - 1].key;
+		e->key_len = key_len;
+	} else {
+		e->key_len = key_len;
+		err = HASH_APPEND(h, key, key_len, NULL, &e->key);
+		if (err != NULL) {
+			return err;
+		}
+	}
+
+	if (raw) {
+		err = HASH_APPEND(h, raw, raw_len, eol, &e->raw);
+		if (err != NULL) {
+			return err;
+		}
+		e->raw_len = h->data.len() - e->raw;
+	}
+
+	++h->n;
+
+	if (first) {
+		h->e[h->e[first - 1].last - 1].dup = h->n;
+		h->e[first - 1].last = h->n;
+	} else {
+		e->last = h->n;
+		slot = hash & (h->n_bucket - 1);
+		e->next = h->buckets[slot];
+		h->buckets[slot] = h->n;
+	}
+
+	return NULL;
+}
+
+//
+// PART_COUNT will return number of partitions for `size` bytes of input that
+// will be processed with memory limit `limit`.
+//
+static int PART_COUNT(off_t size, size_t limit)
+{
+	size_t n = size_t(size) / (limit / 2 + 1) + 1;
+
+	if (n < 2) {
+		n = 2;
+	}
+	if (n > size_t(DSVJoin::N_PART_MAX)) {
+		n = size_t(DSVJoin::N_PART_MAX);
+	}
+
+	return int(n);
+}
+
+DSVJoin::DSVJoin()
+:	_mem_limit(MEM_LIMIT)
+,	_sep(',')
+,	_n_left(0)
+,	_n_right(0)
+,	_n_out(0)
+,	_n_parts(0)
+,	_elapsed(0)
+{}
+
+DSVJoin::~DSVJoin()
+{}
+
+/**
+ * Method join will write each row in file `fleft` that has the same key with
+ * rows in file `fright` into `fout`. Each output row is the left row, followed
+ * by `_sep`, followed by the right row, both as it is in their input file.
+ * If a left row match more than one right rows, they are written in the
+ * order of right rows.
+ *
+ * `key_left` and `key_right` contain field names, separated by comma, in
+ * `md_left` and `md_right`. Both must have the same number of fields, which
+ * are matched by their position in the keys, e.g. the first field in
+ * `key_left` with the first field in `key_right`. Values are compared byte by
+ * byte.
+ *
+ * The right file is loaded into hash table and the left file is streamed.
+ * When the right file does not fit in `_mem_limit`, both files are
+ * partitioned into temporary files "fout.part.rN" and "fout.part.lN" and each
+ * pair of partitions is joined on its own; in this case the output is not in
+ * the order of left rows.
+ *
+ * Projection in `md_left` and `md_right` is ignored while reading and
+ * restored before returning.
+ *
+ * On success it will return NULL, otherwise it will return error.
+ */
+Error DSVJoin::join(const char* fleft, List* md_left, const char* key_left
+	, const char* fright, List* md_right, const char* key_right
+	, const char* fout)
+{
+	int full = 0;
+	int n_part = 0;
+	double start = NOW();
+	off_t size = 0;
+	Buffer prefix;
+	Buffer name_l;
+	Buffer name_r;
+	DSVReader reader;
+	struct dsv_join_key kl;
+	struct dsv_join_key kr;
+	struct dsv_hash h;
+	int* skip_l = SKIP_SAVE(md_left);
+	int* skip_r = SKIP_SAVE(md_right);
+	File w;
+	Error err;
+
+	_n_left = 0;
+	_n_right = 0;
+	_n_out = 0;
+	_n_parts = 0;
+
+	if (! skip_l || ! skip_r) {
+		err = ErrOutOfMemory;
+		goto out;
+	}
+
+	err = KEY_INIT(&kl, md_left, key_left);
+	if (err == NULL) {
+		err = KEY_INIT(&kr, md_right, key_right);
+	}
+	if (err == NULL && kl.n != kr.n) {
+		err = ErrDSVJoinKey;
+	}
+	if (err != NULL) {
+		goto out;
+	}
+
+	err = w.open_wt(fout);
+	if (err != NULL) {
+		goto out;
+	}
+	w.resize(IO_SIZE);
+
+	err = build(&h, fright, md_right, &kr, _mem_limit, &full);
+	if (err != NULL) {
+		goto out;
+	}
+
+	if (! full) {
+		err = probe(&h, fleft, md_left, &kl, &w);
+		if (err == NULL) {
+			err = w.flush();
+		}
+		goto out;
+	}
+
+	HASH_RESET(&h);
+	_n_right = 0;
+
+	err = File::GET_SIZE(fright, &size);
+	if (err != NULL) {
+		goto out;
+	}
+
+	n_part = PART_COUNT(size, _mem_limit);
+	prefix.append_fmt("%s.part.r", fout);
+
+	err = reader.open_ro(fright);
+	if (err == NULL) {
+		reader.resize(IO_SIZE);
+		err = partition(&reader, md_right, &kr, prefix.chars(), n_part
+			, NULL, NULL);
+		reader.close();
+	}
+	if (err != NULL) {
+		goto clean;
+	}
+
+	prefix.truncate(prefix.len() - 1);
+	prefix.appendc('l');
+
+	err = reader.open_ro(fleft);
+	if (err == NULL) {
+		reader.resize(IO_SIZE);
+		err = partition(&reader, md_left, &kl, prefix.chars(), n_part
+			, NULL, NULL);
+		reader.close();
+	}
+	if (err != NULL) {
+		goto clean;
+	}
+
+	for (int p = 0; err == NULL && p < n_part; p++) {
+		name_r.reset();
+		name_r.append_fmt("%s.part.r%d", fout, p);
+		name_l.reset();
+		name_l.append_fmt("%s.part.l%d", fout, p);
+
+		err = build(&h, name_r.chars(), md_right, &kr, 0, &full);
+		if (err == NULL) {
+			err = probe(&h, name_l.chars(), md_left, &kl, &w);
+		}
+
+		HASH_RESET(&h);
+	}
+	if (err == NULL) {
+		err = w.flush();
+	}
+
+	_n_parts = size_t(n_part);
+clean:
+	for (int p = 0; p < n_part; p++) {
+		name_r.reset();
+		name_r.append_fmt("%s.part.r%d", fout, p);
+		unlink(name_r.chars());
+		name_l.reset();
+		name_l.append_fmt("%s.part.l%d", fout, p);
+		unlink(name_l.chars());
+	}
+out:
+	w.close();
+
+	SKIP_RESTORE(md_left, skip_l);
+	SKIP_RESTORE(md_right, skip_r);
+
+	_elapsed = NOW() - start;
+
+	return err;
+}
+
+/**
+ * Method distinct will write rows in file `fin` into `fout`, except rows that
+ * has the same key with previous row. `keys` contain field names, separated
+ * by comma, in `list_md`; if it is NULL all fields are used as key.
+ *
+ * Rows are written in the order of their first occurrence as long as the
+ * keys fit in `_mem_limit`. After that, the rest of input whose key has not
+ * been seen is partitioned into temporary files "fout.part.N" and each
+ * partition is written after distinct on its own.
+ *
+ * Projection in `list_md` is ignored while reading and restored before
+ * returning.
+ *
+ * On success it will return NULL, otherwise it will return error.
+ */
+Error DSVJoin::distinct(const char* fin, List* list_md, const char* keys
+	, const char* fout)
+{
+	int n_part = 0;
+	double start = NOW();
+	Buffer prefix;
+	Buffer name;
+	struct dsv_join_key k;
+	struct dsv_hash h;
+	int* skip = SKIP_SAVE(list_md);
+	File w;
+	Error err;
+
+	_n_left = 0;
+	_n_right = 0;
+	_n_out = 0;
+	_n_parts = 0;
+
+	if (! skip) {
+		err = ErrOutOfMemory;
+		goto out;
+	}
+
+	err = KEY_INIT(&k, list_md, keys);
+	if (err != NULL) {
+		goto out;
+	}
+
+	err = w.open_wt(fout);
+	if (err != NULL) {
+		goto out;
+	}
+	w.resize(IO_SIZE);
+
+	prefix.append_fmt("%s.part.", fout);
+
+	err = dedup(&h, fin, list_md, &k, _mem_limit, &w, prefix.chars()
+		, &n_part);
+
+	HASH_RESET(&h);
+
+	for (int p = 0; err == NULL && p < n_part; p++) {
+		name.reset();
+		name.append_fmt("%s%d", prefix.chars(), p);
+
+		err = dedup(&h, name.chars(), list_md, &k, 0, &w, NULL
+			, NULL);
+
+		HASH_RESET(&h);
+	}
+	if (err == NULL) {
+		err = w.flush();
+	}
+
+	for (int p = 0; p < n_part; p++) {
+		name.reset();
+		name.append_fmt("%s%d", prefix.chars(), p);
+		unlink(name.chars());
+	}
+
+	_n_parts = size_t(n_part);
+out:
+	w.close();
+
+	SKIP_RESTORE(list_md, skip);
+
+	_elapsed = NOW() - start;
+
+	return err;
+}
+
+/**
+ * Method rows_per_sec will return number of input rows processed per second
+ * by the last operation.
+ */
+double DSVJoin::rows_per_sec()
+{
+	if (_elapsed <= 0) {
+		return 0;
+	}
+	return double(_n_left + _n_right) / _elapsed;
+}
+
+//
+// `build(h, fin, list_md, k, limit, full)` will add all rows in `fin` to
+// hash table `h`, keyed by their key columns `k`. If `limit` is not
+// zero and memory used by `h` reach it, it will stop and set `full` to 1.
+//
+Error DSVJoin::build(struct dsv_hash* h, const char* fin, List* list_md
+	, const struct dsv_join_key* k, size_t limit, int* full)
+{
+	int s = 0;
+	size_t len = 0;
+	const char* raw = NULL;
+	DSVReader reader;
+	DSVRecord* row = NULL;
+	Buffer key;
+	Error err;
+
+	*full = 0;
+
+	err = reader.open_ro(fin);
+	if (err != NULL) {
+		return err;
+	}
+	reader.resize(IO_SIZE);
+
+	DSVRecord::INIT_ROW(&row, k->n_col);
+
+	do {
+		row->columns_reset();
+		s = reader.read(row, list_md);
+		if (s <= 0) {
+			continue;
+		}
+
+		KEY(row, k, &key);
+		raw = reader.raw(&len);
+
+		err = HASH_ADD(h, FNV1A_64(key.v(), key.len()), key.v()
+			, key.len(), raw, len, reader.eol());
+		if (err != NULL) {
+			break;
+		}
+		++_n_right;
+
+		if (limit && HASH_MEM(h) >= limit) {
+			*full = 1;
+			break;
+		}
+	} while (s != 0);
+
+	delete row;
+
+	return err;
+}
+
+//
+// `probe(h, fin, list_md, k, out)` will write each row in `fin` joined
+// with rows in hash table `h` that has the same key into `out`.
+//
+Error DSVJoin::probe(struct dsv_hash* h, const char* fin, List* list_md
+	, const struct dsv_join_key* k, File* out)
+{
+	int s = 0;
+	size_t x = 0;
+	size_t len = 0;
+	const char* raw = NULL;
+	const char* eol = NULL;
+	struct dsv_hash_entry* e = NULL;
+	DSVReader reader;
+	DSVRecord* row = NULL;
+	Buffer key;
+	Error err;
+
+	err = reader.open_ro(fin);
+	if (err != NULL) {
+		return err;
+	}
+	reader.resize(IO_SIZE);
+	eol = reader.eol();
+
+	DSVRecord::INIT_ROW(&row, k->n_col);
+
+	do {
+		row->columns_reset();
+		s = reader.read(row, list_md);
+		if (s <= 0) {
+			continue;
+		}
+		++_n_left;
+
+		KEY(row, k, &key);
+
+		x = HASH_FIND(h, FNV1A_64(key.v(), key.len()), key.v()
+			, key.len());
+		if (! x) {
+			continue;
+		}
+
+		raw = reader.raw(&len);
+		if (len > 0 && raw[len - 1] == eol[0]) {
+			--len;
+		}
+
+		for (; x && err == NULL; x = e->dup) {
+			e = &h->e[x - 1];
+
+			err = out->write_raw(raw, len);
+			if (err == NULL) {
+				err = out->write_raw(&_sep, 1);
+			}
+			if (err == NULL) {
+				err = out->write_raw(h->data.v(e->raw)
+					, e->raw_len);
+			}
+			++_n_out;
+		}
+	} while (s != 0 && err == NULL);
+
+	delete row;
+
+	return err;
+}
+
+//
+// `partition(reader, list_md, k, prefix, n_part, skip, n_skip)` will write
+// the rest of rows in `reader` into `n_part` files, "prefixN", by the hash of
+// their key. Rows whose key is in hash table `skip`, if not NULL, are not
+// written and their count is added to `n_skip`.
+//
+Error DSVJoin::partition(DSVReader* reader, List* list_md
+	, const struct dsv_join_key* k, const char* prefix, int n_part
+	, struct dsv_hash* skip, size_t* n_skip)
+{
+	int s = 0;
+	int p = 0;
+	uint64_t hash = 0;
+	size_t len = 0;
+	const char* raw = NULL;
+	const char* eol = reader->eol();
+	File* parts = new File[n_part];
+	DSVRecord* row = NULL;
+	Buffer name;
+	Buffer key;
+	Error err;
+
+	for (p = 0; p < n_part; p++) {
+		name.reset();
+		name.append_fmt("%s%d", prefix, p);
+
+		err = parts[p].open_wt(name.chars());
+		if (err != NULL) {
+			goto out;
+		}
+		parts[p].resize(PART_IO_SIZE);
+	}
+
+	DSVRecord::INIT_ROW(&row, k->n_col);
+
+	do {
+		row->columns_reset();
+		s = reader->read(row, list_md);
+		if (s <= 0) {
+			continue;
+		}
+
+		KEY(row, k, &key);
+		hash = FNV1A_64(key.v(), key.len());
+
+		if (skip && HASH_FIND(skip, hash, key.v(), key.len())) {
+			++*n_skip;
+			continue;
+		}
+
+		raw = reader->raw(&len);
+		p = int((hash >> 32) % uint64_t(n_part));
+
+		err = parts[p].write_raw(raw, len);
+		if (err == NULL && (len == 0 || raw[len - 1] != eol[0])) {
+			err = parts[p].write_raw(eol, 1);
+		}
+	} while (s != 0 && err == NULL);
+
+	for (p = 0; p < n_part && err == NULL; p++) {
+		err = parts[p].flush();
+	}
+out:
+	if (row) {
+		delete row;
+	}
+	delete[] parts;
+
+	return err;
+}
+
+//
+// `dedup(h, fin, list_md, k, limit, out, prefix, n_part)` will write rows
+// in `fin` whose key is not in hash table `h` into `out`, adding their key to
+// `h`.
+//
+// If `limit` is not zero and memory used by `h` reach it, the rest of rows
+// whose key is not in `h` are partitioned into files with `prefix` and their
+// number is returned in `n_part`.
+//
+Error DSVJoin::dedup(struct dsv_hash* h, const char* fin, List* list_md
+	, const struct dsv_join_key* k, size_t limit, File* out
+	, const char* prefix, int* n_part)
+{
+	int s = 0;
+	uint64_t hash = 0;
+	size_t len = 0;
+	off_t size = 0;
+	const char* raw = NULL;
+	const char* eol = NULL;
+	DSVReader reader;
+	DSVRecord* row = NULL;
+	Buffer key;
+	Error err;
+
+	err = reader.open_ro(fin);
+	if (err != NULL) {
+		return err;
+	}
+	reader.resize(IO_SIZE);
+	eol = reader.eol();
+
+	DSVRecord::INIT_ROW(&row, k->n_col);
+
+	do {
+		row->columns_reset();
+		s = reader.read(row, list_md);
+		if (s <= 0) {
+			continue;
+		}
+		++_n_left;
+
+		KEY(row, k, &key);
+		hash = FNV1A_64(key.v(), key.len());
+
+		if (HASH_FIND(h, hash, key.v(), key.len())) {
+			continue;
+		}
+
+		err = HASH_ADD(h, hash, key.v(), key.len(), NULL, 0, NULL);
+		if (err != NULL) {
+			break;
+		}
+
+		raw = reader.raw(&len);
+		err = out->write_raw(raw, len);
+		if (err == NULL && (len == 0 || raw[len - 1] != eol[0])) {
+			err = out->write_raw(eol, 1);
+		}
+		++_n_out;
+
+		if (limit && HASH_MEM(h) >= limit) {
+			break;
+		}
+	} while (s != 0 && err == NULL);
+
+	delete row;
+
+	if (err != NULL || s == 0) {
+		return err;
+	}
+
+	err = File::GET_SIZE(fin, &size);
+	if (err != NULL) {
+		return err;
+	}
+
+	*n_part = PART_COUNT(size - reader.offset(), limit);
+
+	return partition(&reader, list_md, k, prefix, *n_part, h
+		, &_n_left);
+}
+
+} // namespace::vos
+// vi: ts=8 sw=8 tw=80:
@@ -0,0 +1,81 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#ifndef _LIBVOS_DSVJOIN_HH
+#define _LIBVOS_DSVJOIN_HH 1
+
+#include "DSVReader.hh"
+
+namespace vos {
+
+extern Error ErrDSVJoinKey;
+
+struct dsv_hash;
+struct dsv_join_key;
+
+//
+// Class DSVJoin implement hash join and distinct over rows in DSV files.
+//
+// Rows are written to output as it is in their input file. Rows that are
+// rejected by reader, e.g. by filter in meta-data, are not read.
+//
+// Field `_mem_limit` contain maximum size of memory used by hash table. When
+// the build side does not fit in it, both inputs is partitioned by the hash of
+// their key into temporary files and each partition is processed on its own.
+// Field `_sep` contain character that separate left and right row in the
+// output of join.
+// Field `_n_left` contain number of rows read from left, or input, file.
+// Field `_n_right` contain number of rows read from right file.
+// Field `_n_out` contain number of rows written to output.
+// Field `_n_parts` contain number of partitions used, zero if the input fit in
+// memory.
+// Field `_elapsed` contain the time used by the last operation, in seconds.
+//
+class DSVJoin {
+public:
+	static const char* __cname;
+	static size_t MEM_LIMIT;
+	static size_t IO_SIZE;
+	static int N_PART_MAX;
+
+	size_t	_mem_limit;
+	char	_sep;
+	size_t	_n_left;
+	size_t	_n_right;
+	size_t	_n_out;
+	size_t	_n_parts;
+	double	_elapsed;
+
+	DSVJoin();
+	~DSVJoin();
+
+	Error join(const char* fleft, List* md_left, const char* key_left
+		, const char* fright, List* md_right, const char* key_right
+		, const char* fout);
+	Error distinct(const char* fin, List* list_md, const char* keys
+		, const char* fout);
+
+	double rows_per_sec();
+
+private:
+	Error build(struct dsv_hash* h, const char* fin, List* list_md
+		, const struct dsv_join_key* k, size_t limit, int* full);
+	Error probe(struct dsv_hash* h, const char* fin, List* list_md
+		, const struct dsv_join_key* k, File* out);
+	Error partition(DSVReader* reader, List* list_md
+		, const struct dsv_join_key* k, const char* prefix
+		, int n_part, struct dsv_hash* skip, size_t* n_skip);
+	Error dedup(struct dsv_hash* h, const char* fin, List* list_md
+		, const struct dsv_join_key* k, size_t limit, File* out
+		, const char* prefix, int* n_part);
+
+	DSVJoin(const DSVJoin&);
+	void operator=(const DSVJoin&);
+};
+
+} // namespace::vos
+#endif
+// vi: ts=8 sw=8 tw=80:
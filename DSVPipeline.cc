@@ -0,0 +1,534 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include "DSVPipeline.hh"
+
+namespace vos {
+
+Error ErrDSVPipelineTransform("DSVPipeline: transform failed");
+Error ErrDSVPipelineWrite("DSVPipeline: failed to write row");
+Error ErrDSVPipelineThread("DSVPipeline: failed to start thread");
+
+const char* DSVPipeline::__cname = "DSVPipeline";
+
+//
+// Variable N_THREAD contain default number of transforming threads.
+//
+int DSVPipeline::N_THREAD = 2;
+
+//
+// Variable N_BATCH contain default number of batches in the pipeline.
+//
+int DSVPipeline::N_BATCH = 8;
+
+//
+// Variable BATCH_ROWS contain default number of rows in one batch.
+//
+size_t DSVPipeline::BATCH_ROWS = 4096;
+
+//
+// Variable IO_SIZE contain size of buffer for reading and writing file.
+//
+size_t DSVPipeline::IO_SIZE = 1024 * 1024;
+
+//
+// dsv_pipe_batch contain rows that is moved between stages.
+//
+// Field `seq` contain the order of batch in input.
+// Field `n` contain number of rows read into batch.
+// Field `rows` contain the rows, allocated once and reused.
+// Field `keep` contain the result of transform of each rows.
+// Field `next` link the batch in queue.
+//
+struct dsv_pipe_batch {
+	size_t			seq;
+	size_t			n;
+	DSVRecord**		rows;
+	int*			keep;
+	struct dsv_pipe_batch*	next;
+
+	dsv_pipe_batch()
+	:	seq(0)
+	,	n(0)
+	,	rows(NULL)
+	,	keep(NULL)
+	,	next(NULL)
+	{}
+
+	~dsv_pipe_batch()
+	{
+		if (rows) {
+			for (size_t x = 0; rows[x]; x++) {
+				delete rows[x];
+			}
+		}
+		free(rows);
+		free(keep);
+	}
+private:
+	dsv_pipe_batch(const dsv_pipe_batch&);
+	void operator=(const dsv_pipe_batch&);
+};
+
+//
+// dsv_pipe_queue is a FIFO of batches.
+//
+struct dsv_pipe_queue {
+	struct dsv_pipe_batch* head;
+	struct dsv_pipe_batch* tail;
+};
+
+//
+// dsv_pipe contain the state shared by all stages. All fields, except the
+// one that is set before threads is started, are protected by its lock.
+//
+// Field `free` contain batches that can be filled by reader.
+// Field `work` contain batches that wait to be transformed.
+// Field `done` contain transformed batches, indexed by their sequence
+// modulo number of batches.
+// Field `n_seq` contain number of batches produced by reader.
+// Field `next_seq` contain sequence of the next batch to be written.
+// Field `eof` is set to 1 when reader has finished.
+// Field `stop` is set to 1 when one of the stage has failed.
+//
+class dsv_pipe : public Locker {
+public:
+	pthread_cond_t		cond;
+	struct dsv_pipe_queue	free;
+	struct dsv_pipe_queue	work;
+	struct dsv_pipe_batch**	done;
+	int			n_batch;
+	size_t			n_seq;
+	size_t			next_seq;
+	int			eof;
+	int			stop;
+	Error			err;
+	dsv_pipeline_fn		fn;
+	void*			arg;
+	DSVWriter*		writer;
+	List*			md_out;
+	size_t			n_out;
+
+	dsv_pipe()
+	:	Locker()
+	,	cond()
+	,	free()
+	,	work()
+	,	done(NULL)
+	,	n_batch(0)
+	,	n_seq(0)
+	,	next_seq(0)
+	,	eof(0)
+	,	stop(0)
+	,	err(NULL)
+	,	fn(NULL)
+	,	arg(NULL)
+	,	writer(NULL)
+	,	md_out(NULL)
+	,	n_out(0)
+	{
+		pthread_cond_init(&cond, NULL);
+	}
+
+	~dsv_pipe()
+	{
+		pthread_cond_destroy(&cond);
+		::free(done);
+	}
+
+	// wait will release the lock until other stage change the state.
+	void wait()
+	{
+		pthread_cond_wait(&cond, &_lock);
+	}
+
+	// notify will wake up all stages that wait for change of state.
+	void notify()
+	{
+		pthread_cond_broadcast(&cond);
+	}
+
+	// fail will stop all stages with error `e`. Caller must hold the
+	// lock.
+	void fail(Error e)
+	{
+		if (err == NULL) {
+			err = e;
+		}
+		stop = 1;
+		notify();
+	}
+private:
+	dsv_pipe(const dsv_pipe&);
+	void operator=(const dsv_pipe&);
+};
+
+//
+// PUSH will append batch `b` to the end of queue `q`.
+//
+static void PUSH(struct dsv_pipe_queue* q, struct dsv_pipe_batch* b)
+{
+	b->next = NULL;
+	if (q->tail) {
+		q->tail->next = b;
+	} else {
+		q->head = b;
+	}
+	q->tail = b;
+}
+
+//
+// POP will remove and return the first batch in queue `q`, or NULL if queue
+// is empty.
+//
+static struct dsv_pipe_batch* POP(struct dsv_pipe_queue* q)
+{
+	struct dsv_pipe_batch* b = q->head;
+
+	if (b) {
+		q->head = b->next;
+		if (! q->head) {
+			q->tail = NULL;
+		}
+		b->next = NULL;
+	}
+	return b;
+}
+
+//
+// BATCH_INIT will allocate `n_rows` rows with `n_col` columns in batch `b`.
+//
+static Error BATCH_INIT(struct dsv_pipe_batch* b, size_t n_rows, int n_col)
+{
+	b->rows = (DSVRecord**) calloc(n_rows + 1, sizeof(*b->rows));
+	b->keep = (int*) calloc(n_rows, sizeof(*b->keep));
+	if (! b->rows || ! b->keep) {
+		return ErrOutOfMemory;
+	}
+
+	for (size_t x = 0; x < n_rows; x++) {
+		DSVRecord::INIT_ROW(&b->rows[x], n_col);
+		if (! b->rows[x]) {
+			return ErrOutOfMemory;
+		}
+	}
+
+	return NULL;
+}
+
+//
+// TRANSFORM_STAGE will take batch from work queue, transform each of its rows,
+// and put it into done slot, until reader has finished and work queue is
+// empty.
+//
+static void* TRANSFORM_STAGE(void* arg)
+{
+	int s = 0;
+	size_t x = 0;
+	dsv_pipe* p = (dsv_pipe*) arg;
+	struct dsv_pipe_batch* b = NULL;
+
+	for (;;) {
+		p->lock();
+		while (! p->stop && ! p->work.head && ! p->eof) {
+			p->wait();
+		}
+		b = p->stop ? NULL : POP(&p->work);
+		p->unlock();
+
+		if (! b) {
+			break;
+		}
+
+		for (x = 0; x < b->n; x++) {
+			if (! p->fn) {
+				b->keep[x] = 1;
+				continue;
+			}
+
+			s = p->fn(b->rows[x], p->arg);
+			if (s < 0) {
+				p->lock();
+				p->fail(ErrDSVPipelineTransform);
+				p->unlock();
+				return NULL;
+			}
+			b->keep[x] = s;
+		}
+
+		p->lock();
+		p->done[b->seq % size_t(p->n_batch)] = b;
+		p->notify();
+		p->unlock();
+	}
+
+	return NULL;
+}
+
+//
+// WRITE_STAGE will write transformed batches in the order they are read, and
+// return them to the free queue.
+//
+static void* WRITE_STAGE(void* arg)
+{
+	int s = 0;
+	size_t x = 0;
+	size_t slot = 0;
+	dsv_pipe* p = (dsv_pipe*) arg;
+	struct dsv_pipe_batch* b = NULL;
+
+	for (;;) {
+		p->lock();
+		slot = p->next_seq % size_t(p->n_batch);
+		while (! p->stop && ! p->done[slot]
+		&& ! (p->eof && p->next_seq == p->n_seq)) {
+			p->wait();
+		}
+		b = p->stop ? NULL : p->done[slot];
+		p->done[slot] = NULL;
+		p->unlock();
+
+		if (! b) {
+			break;
+		}
+
+		for (x = 0; x < b->n; x++) {
+			if (! b->keep[x]) {
+				continue;
+			}
+			s = p->writer->write(b->rows[x], p->md_out);
+			if (s < 0) {
+				p->lock();
+				p->fail(ErrDSVPipelineWrite);
+				p->unlock();
+				return NULL;
+			}
+			++p->n_out;
+		}
+
+		p->lock();
+		PUSH(&p->free, b);
+		++p->next_seq;
+		p->notify();
+		p->unlock();
+	}
+
+	return NULL;
+}
+
+DSVPipeline::DSVPipeline()
+:	_n_thread(N_THREAD)
+,	_n_batch(N_BATCH)
+,	_batch_rows(BATCH_ROWS)
+,	_n_rows(0)
+,	_n_out(0)
+,	_elapsed(0)
+{}
+
+DSVPipeline::~DSVPipeline()
+{}
+
+/**
+ * Method run(fin,md_in,fn,arg,fout,md_out) will read each rows in `fin` using
+ * `md_in` as meta-data, pass it to `fn` with `arg`, and write the rows that
+ * is accepted by `fn` to `fout` using `md_out` as meta-data. If `md_out` is
+ * NULL, `md_in` will be used. If `fn` is NULL, all rows will be written.
+ *
+ * Rows are read in the calling thread, transformed by `_n_thread` threads,
+ * and written by another thread, so `fn` must be safe to be called from
+ * several threads at the same time. Output rows keep the order of input.
+ *
+ * Each row passed to `fn` has as many columns as the longest of `md_in` and
+ * `md_out`; columns are written by their position, not by their name.
+ *
+ * On success it will return NULL, otherwise it will return error, e.g.
+ * ErrDSVPipelineThread if one of the thread can not be started.
+ */
+Error DSVPipeline::run(const char* fin, List* md_in, dsv_pipeline_fn fn
+	, void* arg, const char* fout, List* md_out)
+{
+	int s = 0;
+	int x = 0;
+	int n_thread = _n_thread > 0 ? _n_thread : 1;
+	int n_batch = _n_batch > 0 ? _n_batch : 1;
+	int n_col = 0;
+	int n_started = 0;
+	int w_started = 0;
+	size_t batch_rows = _batch_rows > 0 ? _batch_rows : 1;
+	double start = NOW();
+	DSVReader reader;
+	DSVWriter writer;
+	dsv_pipe p;
+	struct dsv_pipe_batch* batches = NULL;
+	struct dsv_pipe_batch* b = NULL;
+	Thread** threads = NULL;
+	Thread* wthread = NULL;
+	Error err;
+
+	_n_rows = 0;
+	_n_out = 0;
+
+	if (! md_out) {
+		md_out = md_in;
+	}
+	n_col = md_in->size();
+	if (md_out->size() > n_col) {
+		n_col = md_out->size();
+	}
+
+	err = reader.open_ro(fin);
+	if (err != NULL) {
+		return err;
+	}
+	reader.resize(IO_SIZE);
+
+	err = writer.open_wt(fout);
+	if (err != NULL) {
+		return err;
+	}
+	writer.resize(IO_SIZE);
+
+	batches = new struct dsv_pipe_batch[n_batch];
+	threads = (Thread**) calloc(size_t(n_thread), sizeof(*threads));
+	p.done = (struct dsv_pipe_batch**) calloc(size_t(n_batch)
+		, sizeof(*p.done));
+	if (! batches || ! threads || ! p.done) {
+		err = ErrOutOfMemory;
+		goto out;
+	}
+
+	for (x = 0; x < n_batch; x++) {
+		err = BATCH_INIT(&batches[x], batch_rows, n_col);
+		if (err != NULL) {
+			goto out;
+		}
+		PUSH(&p.free, &batches[x]);
+	}
+
+	p.n_batch	= n_batch;
+	p.fn		= fn;
+	p.arg		= arg;
+	p.writer	= &writer;
+	p.md_out	= md_out;
+
+	for (; n_started < n_thread; n_started++) {
+		threads[n_started] = new Thread(&TRANSFORM_STAGE);
+		if (! threads[n_started]
+		||  threads[n_started]->start(&p) != 0) {
+			break;
+		}
+	}
+	if (n_started == n_thread) {
+		wthread = new Thread(&WRITE_STAGE);
+		if (wthread && wthread->start(&p) == 0) {
+			w_started = 1;
+		}
+	}
+
+	// Stop the stages that has been started, so none of them wait for
+	// batch that will never come.
+	if (! w_started) {
+		p.lock();
+		p.fail(ErrDSVPipelineThread);
+		p.unlock();
+
+		for (x = 0; x < n_started; x++) {
+			threads[x]->join();
+		}
+		err = ErrDSVPipelineThread;
+		goto out;
+	}
+
+	// Read stage.
+	do {
+		p.lock();
+		while (! p.stop && ! p.free.head) {
+			p.wait();
+		}
+		b = p.stop ? NULL : POP(&p.free);
+		p.unlock();
+
+		if (! b) {
+			break;
+		}
+
+		b->n = 0;
+		do {
+			b->rows[b->n]->columns_reset();
+			s = reader.read(b->rows[b->n], md_in);
+			if (s > 0) {
+				++b->n;
+			}
+		} while (s != 0 && b->n < batch_rows);
+
+		_n_rows += b->n;
+
+		p.lock();
+		if (b->n > 0) {
+			b->seq = p.n_seq++;
+			PUSH(&p.work, b);
+		} else {
+			PUSH(&p.free, b);
+		}
+		if (s == 0) {
+			p.eof = 1;
+		}
+		p.notify();
+		p.unlock();
+	} while (s != 0);
+
+	p.lock();
+	p.eof = 1;
+	p.notify();
+	p.unlock();
+
+	for (x = 0; x < n_thread; x++) {
+		threads[x]->join();
+	}
+	wthread->join();
+
+	err = p.err;
+	if (err == NULL) {
+		err = writer.flush();
+	}
+
+	_n_out = p.n_out;
+out:
+	if (threads) {
+		for (x = 0; x < n_thread; x++) {
+			delete threads[x];
+		}
+		free(threads);
+	}
+	if (wthread) {
+		delete wthread;
+	}
+	if (batches) {
+		delete[] batches;
+	}
+
+	writer.close();
+	reader.close();
+
+	_elapsed = NOW() - start;
+
+	return err;
+}
+
+/**
+ * Method rows_per_sec will return number of input rows processed per second
+ * by the last run().
+ */
+double DSVPipeline::rows_per_sec()
+{
+	if (_elapsed <= 0) {
+		return 0;
+	}
+	return double(_n_rows) / _elapsed;
+}
+
+} // namespace::vos
+// vi: ts=8 sw=8 tw=80:
@@ -0,0 +1,74 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#ifndef _LIBVOS_DSVPIPELINE_HH
+#define _LIBVOS_DSVPIPELINE_HH 1
+
+#include "Thread.hh"
+#include "DSVReader.hh"
+#include "DSVWriter.hh"
+
+namespace vos {
+
+extern Error ErrDSVPipelineTransform;
+extern Error ErrDSVPipelineWrite;
+extern Error ErrDSVPipelineThread;
+
+//
+// dsv_pipeline_fn is a function that transform one row in place.
+// It should return 1 if row should be written, 0 if row should be dropped,
+// or -1 to stop the pipeline.
+//
+typedef int (*dsv_pipeline_fn)(DSVRecord* row, void* arg);
+
+//
+// Class DSVPipeline will read rows from DSV file, transform each of them, and
+// write the result to another DSV file, with each stage running on its own
+// thread.
+//
+// Rows are moved between stages in batches. There are `_n_batch` batches
+// in the pipeline, and their rows are reused after they has been written,
+// so reader will wait when the slower stages can not keep up.
+// Batches are written in the same order as they are read.
+//
+// Field `_n_thread` contain number of transforming threads.
+// Field `_n_batch` contain number of batches in the pipeline.
+// Field `_batch_rows` contain maximum number of rows in one batch.
+// Field `_n_rows` contain number of rows read by the last run().
+// Field `_n_out` contain number of rows written by the last run().
+// Field `_elapsed` contain the time used by the last run(), in seconds.
+//
+class DSVPipeline {
+public:
+	static const char* __cname;
+	static int N_THREAD;
+	static int N_BATCH;
+	static size_t BATCH_ROWS;
+	static size_t IO_SIZE;
+
+	int	_n_thread;
+	int	_n_batch;
+	size_t	_batch_rows;
+	size_t	_n_rows;
+	size_t	_n_out;
+	double	_elapsed;
+
+	DSVPipeline();
+	~DSVPipeline();
+
+	Error run(const char* fin, List* md_in, dsv_pipeline_fn fn, void* arg
+		, const char* fout, List* md_out = NULL);
+
+	double rows_per_sec();
+
+private:
+	DSVPipeline(const DSVPipeline&);
+	void operator=(const DSVPipeline&);
+};
+
+} // namespace::vos
+#endif
+// vi: ts=8 sw=8 tw=80:
@@ -4,17 +4,51 @@
 // found in the LICENSE file.
 //
 
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
 #include "DSVReader.hh"
 
 namespace vos {
 
+Error ErrDSVIndexInvalid("DSVReader: invalid or outdated index");
+
+//
+// dsv_index_hdr define the header of index file. The header is followed by
+// list of 64 bit byte offset of row 0, 'every', 2 * 'every', and so on.
+// 'data_size' and 'data_mtime' are size and modification time of data file
+// when the index was created.
+//
+struct dsv_index_hdr {
+	char		magic[8];
+	uint64_t	every;
+	uint64_t	rows;
+	uint64_t	data_size;
+	int64_t		data_mtime;
+};
+
+static const char __idx_magic[8] = { 'D', 'S', 'V', 'I', 'D', 'X', '0', '1' };
+
 const char* DSVReader::__cname = "DSVReader";
+const char* DSVReader::INDEX_EXT = ".idx";
+size_t DSVReader::INDEX_EVERY = 4096;
 
 /**
  * @method	: DSVReader::DSVReader
  * @desc	: DSVReader object constructor.
  */
-DSVReader::DSVReader()
+DSVReader::DSVReader() : File()
+,	_idx_every(0)
+,	_idx_rows(0)
+,	_idx_n(0)
+,	_idx_off(NULL)
+,	_rp(0)
+,	_ifd(-1)
+,	_iwd(-1)
+,	_dwd(-1)
+,	_date_cache(NULL)
+,	_n_date_cache(0)
 {}
 
 /**
@@ -22,7 +56,15 @@ DSVReader::DSVReader()
  * @desc	: DSVReader object desctructor.
  */
 DSVReader::~DSVReader()
-{}
+{
+	if (_idx_off) {
+		free(_idx_off);
+	}
+	free(_date_cache);
+	if (_ifd >= 0) {
+		::close(_ifd);
+	}
+}
 
 /**
  * @method		: DSVReader::refill_buffer
@@ -43,7 +85,7 @@ ssize_t DSVReader::refill_buffer(const size_t read_min)
 	ssize_t s = 0;
 
 	move_len = _i - _p;
-	if (move_len > 0 && _p > ((_i / 2) + 1)) {
+	if (move_len > 0 && _p > 0) {
 		if (LIBVOS_DEBUG) {
 			printf("[%s] refill_buffer: memmove from %zu of %zu\n"
 				, __cname, _p, _i);
@@ -86,9 +128,42 @@ ssize_t DSVReader::refill_buffer(const size_t read_min)
 	_p	= 0;
 	_v[_i]	= '\0';
 
+	if (s == 0) {
+		return 0;
+	}
+
 	return ssize_t(_i);
 }
 
+/**
+ * @method	: DSVReader::date_cache
+ * @param	:
+ *	> n	: number of fields in meta data.
+ * @return	: cache of date day part for each `n` fields, or NULL if no
+ *		  memory left.
+ * @desc	:
+ *	The cache is kept in reader, not in meta data, so the same meta data
+ *	can be used by many readers in different threads.
+ */
+struct rmd_date_cache* DSVReader::date_cache(int n)
+{
+	if (n <= _n_date_cache) {
+		return _date_cache;
+	}
+
+	void* p = realloc(_date_cache, size_t(n) * sizeof(*_date_cache));
+	if (! p) {
+		return NULL;
+	}
+
+	_date_cache = (struct rmd_date_cache*) p;
+	memset(&_date_cache[_n_date_cache], 0
+		, size_t(n - _n_date_cache) * sizeof(*_date_cache));
+	_n_date_cache = n;
+
+	return _date_cache;
+}
+
 /**
  * @method	: DSVReader::read
  * @param	:
@@ -101,6 +176,14 @@ ssize_t DSVReader::refill_buffer(const size_t read_min)
  * @desc	:
  *	read one row from file, using 'r' as record buffer, and 'md' as record
  *	meta data.
+ *
+ *	Filter in meta data is applied as soon as its field is parsed, before
+ *	the field is copied to record buffer; when the filter reject the row,
+ *	the rest of the row is skipped without being extracted.
+ *
+ *	Field that is not selected by DSVRecordMD::PROJECT() is only scanned
+ *	for its delimiter, and is not copied into 'r'; 'r' only need to have
+ *	as many columns as the selected fields.
  */
 int DSVReader::read(DSVRecord* r, List* list_md)
 {
@@ -111,7 +194,10 @@ int DSVReader::read(DSVRecord* r, List* list_md)
 	size_t chop_bgn = 0;
 	size_t blob_size = 0;
 	ssize_t s = 0;
+	int skip = 0;
+	BNode* node = list_md->head();
 	DSVRecordMD* rmd = NULL;
+	struct rmd_date_cache* dc = date_cache(list_md->size());
 	Error err;
 
 	if (_i == 0) {
@@ -133,8 +219,9 @@ int DSVReader::read(DSVRecord* r, List* list_md)
 		}
 	}
 
-	for (; x < list_md->size(); x++) {
-		rmd = (DSVRecordMD*) list_md->at(x);
+	for (; x < list_md->size(); x++, node = node->get_right()) {
+		rmd	= (DSVRecordMD*) node->get_content();
+		skip	= rmd->_flag & RMD_FL_SKIP;
 
 		if (rmd->_start_p) {
 			len = _p + rmd->_start_p;
@@ -173,31 +260,31 @@ int DSVReader::read(DSVRecord* r, List* list_md)
 			/* get record blob size */
 			memcpy(&blob_size, &_v[startp], DSVRecordMD::BLOB_SIZE);
 
-			r->set_len(blob_size);
-
 			startp += DSVRecordMD::BLOB_SIZE;
 
-			if (r->len() > _l) {
+			if (blob_size > _l) {
 				startp	= startp - _p;
-				s	= refill_buffer(r->len());
+				s	= refill_buffer(blob_size);
 				if (s <= 0) {
 					goto reject;
 				}
 			}
 
-			len = startp + r->len();
+			len = startp + blob_size;
 			if (len >= _i) {
 				startp	= startp - _p;
-				s	= refill_buffer(r->len());
+				s	= refill_buffer(blob_size);
 				if (s <= 0) {
 					goto reject;
 				}
 			}
 
 			/* copy blob from file buffer to record buffer */
-			r->copy_raw(&_v[startp], r->len());
+			if (! skip) {
+				r->copy_raw(&_v[startp], blob_size);
+			}
 
-			startp += r->len();
+			startp += blob_size;
 			if (startp >= _i) {
 				startp = startp - _p;
 				s = refill_buffer(0);
@@ -245,7 +332,7 @@ int DSVReader::read(DSVRecord* r, List* list_md)
 			if (rmd->_end_p) {
 				len = (startp - _p) + size_t(rmd->_end_p);
 
-				if (len > r->size()) {
+				if (! skip && len > r->size()) {
 					r->resize(len);
 				}
 
@@ -259,7 +346,15 @@ int DSVReader::read(DSVRecord* r, List* list_md)
 					}
 				}
 
-				r->copy_raw(&_v[startp], len);
+				if (rmd->_fop
+				&&  ! rmd->filter(&_v[startp], len
+					, dc ? &dc[x] : NULL)) {
+					goto reject;
+				}
+
+				if (! skip) {
+					r->copy_raw(&_v[startp], len);
+				}
 				startp += len;
 
 			} else if (rmd->_right_q) {
@@ -279,7 +374,12 @@ int DSVReader::read(DSVRecord* r, List* list_md)
 				}
 
 				len = startp - chop_bgn;
-				if (len > 0) {
+				if (rmd->_fop
+				&&  ! rmd->filter(&_v[chop_bgn], len
+					, dc ? &dc[x] : NULL)) {
+					goto reject;
+				}
+				if (! skip && len > 0) {
 					s		= _v[startp];
 					_v[startp]	= '\0';
 					r->append_raw(&_v[chop_bgn], len);
@@ -334,7 +434,12 @@ int DSVReader::read(DSVRecord* r, List* list_md)
 					}
 				}
 				len = startp - chop_bgn;
-				if (len > 0) {
+				if (rmd->_fop
+				&&  ! rmd->filter(&_v[chop_bgn], len
+					, dc ? &dc[x] : NULL)) {
+					goto reject;
+				}
+				if (! skip && len > 0) {
 					s		= _v[startp];
 					_v[startp]	= '\0';
 					r->append_raw(&_v[chop_bgn], len);
@@ -369,7 +474,12 @@ int DSVReader::read(DSVRecord* r, List* list_md)
 				}
 
 				len = startp - chop_bgn;
-				if (len > 0) {
+				if (rmd->_fop
+				&&  ! rmd->filter(&_v[chop_bgn], len
+					, dc ? &dc[x] : NULL)) {
+					goto reject;
+				}
+				if (! skip && len > 0) {
 					s		= _v[startp];
 					_v[startp]	= '\0';
 					r->append_raw(&_v[chop_bgn], len);
@@ -377,7 +487,9 @@ int DSVReader::read(DSVRecord* r, List* list_md)
 				}
 			}
 		}
-		r	= r->_next_col;
+		if (! skip) {
+			r = r->_next_col;
+		}
 		++n;
 	}
 	if (n == 0) {
@@ -394,13 +506,15 @@ int DSVReader::read(DSVRecord* r, List* list_md)
 			s	= refill_buffer(0);
 			if (s <= 0) {
 				if (0 == s) {
-					_p = startp;
+					_rp = _p;
+					_p = _i;
 					return 1;
 				}
 				goto reject;
 			}
 		}
 	}
+	_rp = _p;
 	_p = startp + 1;
 
 	return 1;
@@ -413,7 +527,7 @@ reject:
 			s	= refill_buffer(0);
 			if (s <= 0) {
 				if (0 == s) {
-					_p = startp;
+					_p = _i;
 					return -1;
 				}
 				break;
@@ -425,5 +539,561 @@ reject:
 	return -1;
 }
 
+/**
+ * Method read_row(pool,list_md) will read the next accepted row from file into
+ * a row that is taken from `pool`, skipping rejected rows. Rejected rows reuse
+ * the same row, so reading does not allocate once the pool has enough rows.
+ *
+ * It will return the row, which should be released back to `pool` when it is
+ * not used anymore, or NULL on end of file or if no memory left.
+ */
+DSVRecord* DSVReader::read_row(DSVRecordPool* pool, List* list_md)
+{
+	int s = 0;
+	DSVRecord* row = pool->get();
+
+	if (! row) {
+		return NULL;
+	}
+
+	do {
+		s = read(row, list_md);
+		if (s > 0) {
+			return row;
+		}
+		row->columns_reset();
+	} while (s != 0);
+
+	pool->put(row);
+
+	return NULL;
+}
+
+/**
+ * Method follow(r,list_md,timeout) will read the next row from file that is
+ * still being appended by other process, into `r`, using `list_md` as
+ * meta-data.
+ *
+ * Only complete row, which is terminated by end of line, is read; the partial
+ * row at the end of file is kept in buffer until the rest of it is written.
+ * When there is no complete row, it will wait for the file to be modified
+ * using inotify, up to `timeout` milliseconds, or forever if `timeout` is
+ * negative.
+ *
+ * If the file is truncated, it will continue reading from the beginning. If
+ * the file is renamed or deleted and a new file is created with the same
+ * name, it will continue reading from the new file; the partial row in old
+ * file is discarded.
+ *
+ * Rows rejected by filter are skipped.
+ *
+ * It will return 1 if one row has been read, 0 if there is no new row after
+ * `timeout`, or -1 on error.
+ */
+int DSVReader::follow(DSVRecord* r, List* list_md, int timeout)
+{
+	int s = 0;
+	ssize_t n = 0;
+	long int wait = timeout;
+	long int end = 0;
+	char eol = '\n';
+	struct timespec ts;
+
+	if (_ifd < 0 && follow_init() != NULL) {
+		return -1;
+	}
+	if (_eol && _eol[0]) {
+		eol = _eol[strlen(_eol) - 1];
+	}
+	if (timeout >= 0) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		end = ts.tv_sec * 1000 + ts.tv_nsec / 1000000 + timeout;
+	}
+
+	for (;;) {
+		if (_p < _i && memchr(&_v[_p], eol, _i - _p)) {
+			r->columns_reset();
+			s = read(r, list_md);
+			if (s > 0) {
+				return 1;
+			}
+			if (s < 0) {
+				continue;
+			}
+		}
+
+		n = refill_buffer(0);
+		if (n < 0) {
+			return -1;
+		}
+		if (n > 0) {
+			continue;
+		}
+
+		s = follow_reopen();
+		if (s < 0) {
+			return -1;
+		}
+		if (s > 0) {
+			continue;
+		}
+
+		if (timeout >= 0) {
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			wait = end - (ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+			if (wait < 0) {
+				wait = 0;
+			}
+		}
+
+		s = follow_wait(int(wait));
+		if (s <= 0) {
+			return s;
+		}
+	}
+}
+
+/**
+ * Method raw will return pointer to the content of the last row that has been
+ * read successfully by read(), as it is in the file, including the end of
+ * line if exist. The length of row will be set in `len`.
+ *
+ * The returned pointer is only valid until the next call to read().
+ */
+const char* DSVReader::raw(size_t* len)
+{
+	*len = _p - _rp;
+
+	return &_v[_rp];
+}
+
+/**
+ * Method offset will return byte offset in file of the next row that will be
+ * returned by read(), or -1 if the offset can not be retrieved.
+ */
+off_t DSVReader::offset()
+{
+	off_t cur = lseek(_d, 0, SEEK_CUR);
+
+	if (cur < 0) {
+		return -1;
+	}
+
+	return cur - off_t(_i - _p);
+}
+
+/**
+ * Method index_create will read all rows in file using `list_md` and save the
+ * byte offset of every `every` rows, and number of rows, into index file.
+ * The index file is saved in the same directory as data file, with ".idx"
+ * appended to its name. If `every` is zero, INDEX_EVERY will be used.
+ *
+ * Rejected rows, either by filter or by invalid format, are counted as rows.
+ *
+ * After index is created, the index is loaded and reader is moved back to the
+ * beginning of file.
+ *
+ * On success it will return NULL, otherwise it will return error.
+ */
+Error DSVReader::index_create(List* list_md, size_t every)
+{
+	int s = 0;
+	off_t off = 0;
+	size_t rows = 0;
+	uint64_t off64 = 0;
+	struct stat st;
+	struct dsv_index_hdr hdr;
+	DSVRecord* row = NULL;
+	Buffer offs;
+	Buffer fidx;
+	File f;
+
+	if (every == 0) {
+		every = INDEX_EVERY;
+	}
+
+	Error err = index_file_name(&fidx);
+	if (err != NULL) {
+		return err;
+	}
+
+	err = rewind(0);
+	if (err != NULL) {
+		return err;
+	}
+
+	DSVRecord::INIT_ROW(&row, list_md->size());
+
+	do {
+		off = offset();
+		if (off < 0) {
+			delete row;
+			return Error::SYS();
+		}
+
+		row->columns_reset();
+		s = read(row, list_md);
+		if (s == 0) {
+			break;
+		}
+
+		if (rows % every == 0) {
+			off64 = uint64_t(off);
+			offs.append_raw((const char*) &off64, sizeof(off64));
+		}
+		++rows;
+	} while (1);
+
+	delete row;
+
+	if (fstat(_d, &st) < 0) {
+		return Error::SYS();
+	}
+
+	memcpy(hdr.magic, __idx_magic, sizeof(hdr.magic));
+	hdr.every	= every;
+	hdr.rows	= rows;
+	hdr.data_size	= uint64_t(st.st_size);
+	hdr.data_mtime	= int64_t(st.st_mtime);
+
+	err = f.open_wt(fidx.chars());
+	if (err != NULL) {
+		return err;
+	}
+
+	err = f.write_raw((const char*) &hdr, sizeof(hdr));
+	if (err == NULL && offs.len() > 0) {
+		err = f.write_raw(offs.v(), offs.len());
+	}
+	if (err == NULL) {
+		err = f.flush();
+	}
+	f.close();
+
+	if (err != NULL) {
+		return err;
+	}
+
+	err = index_load();
+	if (err != NULL) {
+		return err;
+	}
+
+	return rewind(0);
+}
+
+/**
+ * Method index_load will load the index file of current data file, created
+ * by index_create().
+ *
+ * On success it will return NULL. If index file is not valid, or data file
+ * has been modified after index was created, it will return
+ * ErrDSVIndexInvalid.
+ */
+Error DSVReader::index_load()
+{
+	size_t n = 0;
+	struct stat st;
+	struct dsv_index_hdr hdr;
+	Buffer fidx;
+	File f;
+
+	Error err = index_file_name(&fidx);
+	if (err != NULL) {
+		return err;
+	}
+
+	err = f.open_ro(fidx.chars());
+	if (err != NULL) {
+		return err;
+	}
+
+	if (size_t(f.size()) < sizeof(hdr)) {
+		return ErrDSVIndexInvalid;
+	}
+
+	err = f.resize(size_t(f.size()));
+	if (err != NULL) {
+		return err;
+	}
+
+	err = f.read();
+	if (err != NULL) {
+		return err;
+	}
+
+	memcpy(&hdr, f.v(), sizeof(hdr));
+
+	if (memcmp(hdr.magic, __idx_magic, sizeof(hdr.magic)) != 0
+	||  hdr.every == 0) {
+		return ErrDSVIndexInvalid;
+	}
+
+	n = size_t((hdr.rows + hdr.every - 1) / hdr.every);
+
+	if (f.len() != sizeof(hdr) + n * sizeof(uint64_t)) {
+		return ErrDSVIndexInvalid;
+	}
+
+	if (fstat(_d, &st) < 0) {
+		return Error::SYS();
+	}
+	if (hdr.data_size != uint64_t(st.st_size)
+	||  hdr.data_mtime != int64_t(st.st_mtime)) {
+		return ErrDSVIndexInvalid;
+	}
+
+	if (_idx_off) {
+		free(_idx_off);
+	}
+
+	_idx_off = (uint64_t*) calloc(n + 1, sizeof(uint64_t));
+	if (! _idx_off) {
+		_idx_n = 0;
+		return ErrOutOfMemory;
+	}
+
+	memcpy(_idx_off, f.v(sizeof(hdr)), n * sizeof(uint64_t));
+
+	_idx_every	= size_t(hdr.every);
+	_idx_rows	= size_t(hdr.rows);
+	_idx_n		= n;
+
+	return NULL;
+}
+
+/**
+ * Method seek_row will move the reader to the beginning of row number `row`,
+ * started from zero, so the next read() will return that row.
+ *
+ * The reader jump to the nearest indexed offset before the row and skip the
+ * remaining rows using `list_md`. If index has not been loaded, it will be
+ * loaded first.
+ *
+ * On success it will return NULL. If `row` is beyond the last row, it will
+ * return ErrFileEnd.
+ */
+Error DSVReader::seek_row(size_t row, List* list_md)
+{
+	size_t x = 0;
+	size_t skip = 0;
+	DSVRecord* r = NULL;
+	Error err;
+
+	if (! _idx_off) {
+		err = index_load();
+		if (err != NULL) {
+			return err;
+		}
+	}
+
+	if (row >= _idx_rows) {
+		return ErrFileEnd;
+	}
+
+	x = row / _idx_every;
+
+	err = rewind(off_t(_idx_off[x]));
+	if (err != NULL) {
+		return err;
+	}
+
+	skip = row - (x * _idx_every);
+	if (skip == 0) {
+		return NULL;
+	}
+
+	DSVRecord::INIT_ROW(&r, list_md->size());
+
+	for (; skip > 0; skip--) {
+		r->columns_reset();
+		if (read(r, list_md) == 0) {
+			err = ErrFileEnd;
+			break;
+		}
+	}
+
+	delete r;
+
+	return err;
+}
+
+/**
+ * Method rows will return number of rows in data file, according to loaded
+ * index, or zero if index has not been loaded.
+ */
+size_t DSVReader::rows()
+{
+	return _idx_rows;
+}
+
+//
+// `rewind(off)` will move file descriptor to offset `off` and discard the
+// content of reader buffer.
+//
+Error DSVReader::rewind(off_t off)
+{
+	if (lseek(_d, off, SEEK_SET) < 0) {
+		return Error::SYS();
+	}
+
+	_i = 0;
+	_p = 0;
+	_rp = 0;
+	if (_v) {
+		_v[0] = '\0';
+	}
+
+	return NULL;
+}
+
+//
+// `index_file_name(fidx)` will set `fidx` to the name of index file, which is
+// the name of data file appended with INDEX_EXT.
+//
+Error DSVReader::index_file_name(Buffer* fidx)
+{
+	if (_name.is_empty()) {
+		return ErrFileNameEmpty;
+	}
+
+	Error err = fidx->copy(&_name);
+	if (err != NULL) {
+		return err;
+	}
+
+	return fidx->append_raw(INDEX_EXT);
+}
+
+#define FOLLOW_FILE_EVENTS	(IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF \
+				| IN_DELETE_SELF)
+
+//
+// `follow_init()` will create inotify descriptor, and watch the data file and
+// its directory, where the new file will be created when data file is
+// rotated.
+//
+Error DSVReader::follow_init()
+{
+	const char* name = _name.chars();
+	const char* slash = NULL;
+	Buffer dir;
+	Error err;
+
+	if (_name.is_empty()) {
+		return ErrFileNameEmpty;
+	}
+
+	slash = strrchr(name, '/');
+	if (slash) {
+		dir.copy_raw(name, size_t(slash - name) + 1);
+	} else {
+		dir.copy_raw(".");
+	}
+
+	_ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_ifd < 0) {
+		return Error::SYS();
+	}
+
+	_iwd = inotify_add_watch(_ifd, name, FOLLOW_FILE_EVENTS);
+	if (_iwd >= 0) {
+		_dwd = inotify_add_watch(_ifd, dir.chars()
+			, IN_CREATE | IN_MOVED_TO);
+	}
+	if (_iwd < 0 || _dwd < 0) {
+		err = Error::SYS();
+		::close(_ifd);
+		_ifd = -1;
+		_iwd = -1;
+		_dwd = -1;
+		return err;
+	}
+
+	return NULL;
+}
+
+//
+// `follow_wait(timeout)` will wait until one of the watched files is changed
+// or `timeout` milliseconds has passed, and discard the events; the state of
+// file is checked again by caller.
+//
+// It will return 1 if there is an event, 0 on timeout, or -1 on error.
+//
+int DSVReader::follow_wait(int timeout)
+{
+	int s = 0;
+	char events[4096]
+		__attribute__ ((aligned(__alignof__(struct inotify_event))));
+	struct pollfd pfd;
+
+	pfd.fd = _ifd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	s = poll(&pfd, 1, timeout);
+	if (s < 0) {
+		return errno == EINTR ? 0 : -1;
+	}
+	if (s == 0) {
+		return 0;
+	}
+
+	while (::read(_ifd, events, sizeof(events)) > 0) {
+	}
+
+	return 1;
+}
+
+//
+// `follow_reopen()` will open the data file again if it has been replaced by
+// a new file with the same name, or read it from the beginning if it has been
+// truncated.
+//
+// It will return 1 if file has been reopened or rewound, 0 if file does not
+// change, or -1 on error.
+//
+int DSVReader::follow_reopen()
+{
+	int fd = 0;
+	off_t pos = 0;
+	struct stat cur;
+	struct stat st;
+
+	if (fstat(_d, &cur) < 0) {
+		return -1;
+	}
+
+	if (stat(_name.chars(), &st) == 0
+	&& (st.st_ino != cur.st_ino || st.st_dev != cur.st_dev)) {
+		fd = ::open(_name.chars(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			return errno == ENOENT ? 0 : -1;
+		}
+
+		::close(_d);
+		_d = fd;
+
+		inotify_rm_watch(_ifd, _iwd);
+		_iwd = inotify_add_watch(_ifd, _name.chars()
+			, FOLLOW_FILE_EVENTS);
+		if (_iwd < 0) {
+			return -1;
+		}
+
+		return rewind(0) == NULL ? 1 : -1;
+	}
+
+	pos = lseek(_d, 0, SEEK_CUR);
+	if (pos < 0) {
+		return -1;
+	}
+	if (cur.st_size < pos) {
+		return rewind(0) == NULL ? 1 : -1;
+	}
+
+	return 0;
+}
+
 } /* namespace::vos */
 // vi: ts=8 sw=8 tw=78:
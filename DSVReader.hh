@@ -7,25 +7,74 @@
 #ifndef _LIBVOS_READER_HH
 #define _LIBVOS_READER_HH 1
 
-#include "DSVRecord.hh"
+#include "DSVRecordPool.hh"
 #include "DSVRecordMD.hh"
 
 namespace vos {
 
+extern Error ErrDSVIndexInvalid;
+
 /**
- * @class	: DSVReader
- * @desc	: a module for reading DSV file.
+ * @class		: DSVReader
+ * @attr		:
+ *	- INDEX_EXT	: static, extension of index file, appended to the
+ *			  name of data file.
+ *	- INDEX_EVERY	: static, default number of rows between two offsets
+ *			  in index.
+ *	- _idx_every	: number of rows between two offsets in index.
+ *	- _idx_rows	: number of rows in data file, according to index.
+ *	- _idx_n	: number of offsets in index.
+ *	- _idx_off	: list of byte offsets of every '_idx_every' rows.
+ *	- _rp		: position of the last row in buffer.
+ *	- _ifd		: inotify descriptor used by follow(), or -1.
+ *	- _iwd		: inotify watch of data file.
+ *	- _dwd		: inotify watch of directory of data file.
+ *	- _date_cache	: day part of the last date parsed by filter of each
+ *			  field.
+ *	- _n_date_cache	: number of fields in '_date_cache'.
+ * @desc		: a module for reading DSV file.
  */
 class DSVReader : public File {
 public:
+	static const char* __cname;
+	static const char* INDEX_EXT;
+	static size_t INDEX_EVERY;
+
 	DSVReader();
 	~DSVReader();
 
 	ssize_t refill_buffer(const size_t read_min);
 	int read(DSVRecord* r, List* list_md);
+	DSVRecord* read_row(DSVRecordPool* pool, List* list_md);
+	int follow(DSVRecord* r, List* list_md, int timeout = -1);
+	const char* raw(size_t* len);
+
+	off_t offset();
+	Error index_create(List* list_md, size_t every = 0);
+	Error index_load();
+	Error seek_row(size_t row, List* list_md);
+	size_t rows();
+
+protected:
+	size_t		_idx_every;
+	size_t		_idx_rows;
+	size_t		_idx_n;
+	uint64_t*	_idx_off;
+	size_t		_rp;
+	int		_ifd;
+	int		_iwd;
+	int		_dwd;
+	struct rmd_date_cache*	_date_cache;
+	int		_n_date_cache;
 
-	static const char* __cname;
 private:
+	struct rmd_date_cache* date_cache(int n);
+	Error rewind(off_t off);
+	Error follow_init();
+	int follow_wait(int timeout);
+	int follow_reopen();
+	Error index_file_name(Buffer* fidx);
+
 	DSVReader(const DSVReader&);
 	void operator=(const DSVReader&);
 };
@@ -171,14 +171,17 @@ int DSVRecord::set_column_ulong(int n, const unsigned long number)
 
 /**
  * @method	: DSVRecord::columns_reset
- * @desc	: empties all columns.
+ * @desc	:
+ *	empties all columns. Memory of each column is kept and only the first
+ *	byte is cleared, so resetting a row cost the same regardless of the size
+ *	of its largest value.
  */
 void DSVRecord::columns_reset()
 {
 	DSVRecord* p = this;
 
 	while (p) {
-		p->reset();
+		p->truncate(0);
 		p = p->_next_col;
 	}
 }
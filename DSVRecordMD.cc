@@ -17,13 +17,168 @@ enum _rmd_parser {
 	MD_RIGHT_Q,
 	MD_START_P,
 	MD_END_P,
-	MD_TYPE
+	MD_TYPE,
+	MD_FILTER
 };
 
 const char* DSVRecordMD::__CNAME	= "DSVRecordMD";
 uint8_t DSVRecordMD::BLOB_SIZE		= sizeof(int);
 int DSVRecordMD::DEF_SEP		= ',';
 
+//
+// DEF_DATE_FORMAT contain format of DATE field that does not define its
+// format.
+//
+const char* DSVRecordMD::DEF_DATE_FORMAT	= "%Y-%m-%d";
+
+static const char* MONTHS = "janfebmaraprmayjunjulaugsepoctnovdec";
+
+//
+// DATE_DAYS will return number of days since 1970-01-01 of date `y`-`m`-`d`
+// in proleptic Gregorian calendar.
+//
+static int64_t DATE_DAYS(int64_t y, int64_t m, int64_t d)
+{
+	int64_t era = 0;
+	int64_t yoe = 0;
+	int64_t doy = 0;
+	int64_t doe = 0;
+
+	y -= m <= 2;
+	era = (y >= 0 ? y : y - 399) / 400;
+	yoe = y - era * 400;
+	doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
+
+//
+// DATE_VALID will return 1 if `d` is a valid day in month `m` of year `y`,
+// otherwise it will return 0.
+//
+static int DATE_VALID(int64_t y, int64_t m, int64_t d)
+{
+	static const int mdays[] = {
+		31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+	};
+
+	if (m < 1 || m > 12 || d < 1 || d > mdays[m - 1]) {
+		return 0;
+	}
+	if (m == 2 && d == 29) {
+		return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+	}
+	return 1;
+}
+
+//
+// FILTER_CMP will convert result of comparison `s` into filter match, based
+// on filter operator `op`.
+//
+static int FILTER_CMP(const int op, const int s)
+{
+	switch (op) {
+	case RMD_FLTR_EQ:
+		return s == 0;
+	case RMD_FLTR_LT:
+		return s < 0;
+	case RMD_FLTR_LE:
+		return s <= 0;
+	case RMD_FLTR_GT:
+		return s > 0;
+	case RMD_FLTR_GE:
+		return s >= 0;
+	}
+	return 0;
+}
+
+//
+// FILTER_STRING will compare field value `v` with length `len` against filter
+// value in `md`, byte by byte.
+//
+// It will return 1 if field value match the filter, or 0 otherwise.
+//
+static int FILTER_STRING(const DSVRecordMD* md, const char* v, size_t len
+	, struct rmd_date_cache*)
+{
+	const Buffer* f = md->_fltr_v;
+	size_t flen = f->len();
+	int s = 0;
+
+	if (md->_fltr_idx == RMD_FLTR_LIKE) {
+		const char* p = v;
+		const char* end = v + len;
+
+		if (flen == 0) {
+			return 1;
+		}
+		while (size_t(end - p) >= flen) {
+			p = (const char*) memchr(p, f->v()[0]
+				, size_t(end - p) - flen + 1);
+			if (! p) {
+				return 0;
+			}
+			if (memcmp(p, f->v(), flen) == 0) {
+				return 1;
+			}
+			++p;
+		}
+		return 0;
+	}
+
+	s = memcmp(v, f->v(), len < flen ? len : flen);
+	if (s == 0) {
+		s = (len > flen) - (len < flen);
+	}
+
+	return FILTER_CMP(md->_fltr_idx, s);
+}
+
+//
+// FILTER_NUMBER will parse field value `v` with length `len` as number and
+// compare it with numeric value of filter in `md`.
+//
+// It will return 1 if field value match the filter, or 0 if field value is
+// not a number or does not match the filter.
+//
+static int FILTER_NUMBER(const DSVRecordMD* md, const char* v, size_t len
+	, struct rmd_date_cache*)
+{
+	double d = 0;
+	size_t n = 0;
+
+	Error err = Buffer::PARSE_DOUBLE(v, len, &d, &n);
+	if (err != NULL || n == 0) {
+		return 0;
+	}
+
+	return FILTER_CMP(md->_fltr_idx, (d > md->_fltr_n) - (d < md->_fltr_n));
+}
+
+//
+// FILTER_DATE will parse field value `v` with length `len` as date, using
+// day part in `cache` if its match, and compare it with date value of filter
+// in `md`.
+//
+// It will return 1 if field value match the filter, or 0 if field value is
+// not a valid date or does not match the filter.
+//
+static int FILTER_DATE(const DSVRecordMD* md, const char* v, size_t len
+	, struct rmd_date_cache* cache)
+{
+	int64_t t = 0;
+	double d = 0;
+
+	if (md->date_parse(v, len, &t, cache) < 0) {
+		return 0;
+	}
+
+	d = double(t);
+
+	return FILTER_CMP(md->_fltr_idx, (d > md->_fltr_n) - (d < md->_fltr_n));
+}
+
 /**
  * Method INIT will create and initialize meta data using field declaration in
  * 'meta'.
@@ -31,12 +186,23 @@ int DSVRecordMD::DEF_SEP		= ',';
  * Field format:
  *
  * ```
- * ['<char>']:name[:['<char>']:[start-pos]:[end-pos | '<char>']:[type]]
+ * ['<char>']:name[:['<char>']:[start-pos]:[end-pos | '<char>']:[type]
+ *	[:filter]]
  * ```
  *
  * - name  : name only allow characters: a-z,A-Z,0-9.
  * - []	   : optional field.
  *- <char> : any single character, except characters: a-z,A-Z,0-9.
+ * - filter: ['!']<op><value>, where op is one of "=", "<", "<=", ">", ">=",
+ *   or "~" (field contains value). Value is a single word or any characters
+ *   inside single quotes. Row where the field match the filter will be
+ *   accepted, or rejected if filter is prefixed with '!'. Filter on NUMBER
+ *   field compare the value numerically, other types compare it byte by
+ *   byte. BLOB field can not have a filter.
+ * - type  : one of STRING, NUMBER, DATE, or BLOB. DATE can be followed by
+ *   its format inside single quotes, e.g. DATE'%d/%b/%Y:%H:%M:%S'; see
+ *   date_compile() for known conversions. Filter on DATE field with format
+ *   compare the value as date.
  */
 List* DSVRecordMD::INIT(const char* meta)
 {
@@ -48,7 +214,10 @@ List* DSVRecordMD::INIT(const char* meta)
 	int		todo		= MD_START;
 	int		todo_next	= 0;
 	int		len		= (int) strlen(meta);
+	size_t		n		= 0;
+	int64_t		t		= 0;
 	Buffer		v;
+	Error		e;
 	DSVRecordMD*	md		= NULL;
 	List*		o		= new List();
 
@@ -58,7 +227,7 @@ List* DSVRecordMD::INIT(const char* meta)
 		}
 		if (i >= len) {
 			if (todo_next == MD_START || todo_next == MD_END_P
-			||  todo_next == MD_TYPE) {
+			||  todo_next == MD_TYPE || todo_next == MD_FILTER) {
 				break;
 			} else {
 				goto err;
@@ -68,6 +237,7 @@ List* DSVRecordMD::INIT(const char* meta)
 		switch (todo) {
 		case MD_START:
 			md	= new DSVRecordMD();
+			md->_idx = o->size();
 			todo	= MD_LEFT_Q;
 			o->push_tail(md);
 			break;
@@ -83,13 +253,11 @@ List* DSVRecordMD::INIT(const char* meta)
 				todo = todo_next;
 				break;
 			case ',':
-				if (todo_next > MD_NAME) {
+				if (todo_next > MD_NAME || todo_next == MD_START) {
 					if (0 == md->_sep) {
 						md->_sep = DEF_SEP;
 					}
 					todo		= MD_START;
-				} else if (todo_next == MD_START) {
-					todo = todo_next;
 				} else {
 					goto err;
 				}
@@ -323,7 +491,7 @@ List* DSVRecordMD::INIT(const char* meta)
 					goto err;
 				}
 				++i;
-			} else {
+			} else if (meta[i] != ':') {
 				md->_sep = DEF_SEP;
 			}
 			todo		= MD_META_SEP;
@@ -331,7 +499,8 @@ List* DSVRecordMD::INIT(const char* meta)
 			break;
 
 		case MD_TYPE:
-			while (i < len && meta[i] != ',' && !isspace(meta[i])) {
+			while (i < len && meta[i] != ',' && meta[i] != ':'
+			&& meta[i] != '\'' && !isspace(meta[i])) {
 				v.appendc(meta[i]);
 				++i;
 			}
@@ -351,6 +520,113 @@ List* DSVRecordMD::INIT(const char* meta)
 				md->_type = RMD_T_STRING;
 			}
 
+			if (md->_type == RMD_T_DATE && i < len
+			&&  meta[i] == '\'') {
+				md->_date_format = new Buffer();
+
+				++i;
+				while (i < len && meta[i] != '\'') {
+					if (meta[i] == '\\' && i + 1 < len) {
+						++i;
+					}
+					md->_date_format->appendc(meta[i]);
+					++i;
+				}
+				if (i >= len) {
+					goto err;
+				}
+				++i;
+			}
+			if (md->_type == RMD_T_DATE
+			&&  md->date_compile(md->_date_format
+				? md->_date_format->chars() : DEF_DATE_FORMAT)
+				< 0) {
+				goto err;
+			}
+
+			todo		= MD_META_SEP;
+			todo_next	= MD_FILTER;
+			break;
+
+		case MD_FILTER:
+			if (md->_type == RMD_T_BLOB) {
+				goto err;
+			}
+			if (meta[i] == '!') {
+				md->_fltr_rule = RMD_FLTR_REJECT;
+				++i;
+			}
+			if (i >= len) {
+				goto err;
+			}
+			switch (meta[i]) {
+			case '=':
+				md->_fltr_idx = RMD_FLTR_EQ;
+				break;
+			case '<':
+				md->_fltr_idx = RMD_FLTR_LT;
+				break;
+			case '>':
+				md->_fltr_idx = RMD_FLTR_GT;
+				break;
+			case '~':
+				md->_fltr_idx = RMD_FLTR_LIKE;
+				break;
+			default:
+				goto err;
+			}
+			++i;
+			if (i < len && meta[i] == '='
+			&& (md->_fltr_idx == RMD_FLTR_LT
+			||  md->_fltr_idx == RMD_FLTR_GT)) {
+				++md->_fltr_idx;
+				++i;
+			}
+
+			md->_fltr_v = new Buffer();
+
+			if (i < len && meta[i] == '\'') {
+				++i;
+				while (i < len && meta[i] != '\'') {
+					if (meta[i] == '\\' && i + 1 < len) {
+						++i;
+					}
+					md->_fltr_v->appendc(meta[i]);
+					++i;
+				}
+				if (i >= len) {
+					goto err;
+				}
+				++i;
+			} else {
+				while (i < len && meta[i] != ','
+				&& !isspace(meta[i])) {
+					md->_fltr_v->appendc(meta[i]);
+					++i;
+				}
+			}
+
+			if (md->_type == RMD_T_NUMBER
+			&&  md->_fltr_idx != RMD_FLTR_LIKE) {
+				e = Buffer::PARSE_DOUBLE(md->_fltr_v->v()
+					, md->_fltr_v->len(), &md->_fltr_n, &n);
+				if (e != NULL || n == 0) {
+					goto err;
+				}
+				md->_fop = FILTER_NUMBER;
+			} else if (md->_type == RMD_T_DATE
+			&& md->_date_format
+			&& md->_fltr_idx != RMD_FLTR_LIKE) {
+				if (md->date_parse(md->_fltr_v->v()
+					, md->_fltr_v->len(), &t) < 0) {
+					goto err;
+				}
+				md->_fltr_n = double(t);
+				md->_fop = FILTER_DATE;
+			} else {
+				md->_fop = FILTER_STRING;
+			}
+
 			todo		= MD_META_SEP;
 			todo_next	= MD_START;
 			break;
@@ -405,6 +681,112 @@ List* DSVRecordMD::INIT_FROM_FILE(const char* fmeta)
 
 
 
+/**
+ * Method PROJECT will select fields in `list_md` that will be copied into
+ * record by DSVReader, using their name. `names` is list of field name
+ * separated by comma, e.g. "name,stat". Field that is not selected will be
+ * skipped by reader, although its filter, if any, is still applied.
+ *
+ * Selected fields are copied into record columns in the same order as in
+ * `list_md`, not in the order of `names`.
+ *
+ * On success it will return number of selected fields, otherwise when one of
+ * the names is not found it will return -1 and all fields will be selected.
+ */
+int DSVRecordMD::PROJECT(List* list_md, const char* names)
+{
+	int x = 0;
+	int n = 0;
+	int found = 0;
+	size_t len = 0;
+	const char* p = names;
+	DSVRecordMD* md = NULL;
+
+	for (x = 0; x < list_md->size(); x++) {
+		md = (DSVRecordMD*) list_md->at(x);
+		md->_flag |= RMD_FL_SKIP;
+	}
+
+	while (*p) {
+		while (*p == ',' || isspace(*p)) {
+			++p;
+		}
+		len = 0;
+		while (p[len] && p[len] != ',' && !isspace(p[len])) {
+			++len;
+		}
+		if (len == 0) {
+			break;
+		}
+
+		found = 0;
+		for (x = 0; x < list_md->size(); x++) {
+			md = (DSVRecordMD*) list_md->at(x);
+			if (md->_name.len() == len
+			&&  memcmp(md->_name.v(), p, len) == 0) {
+				if (md->_flag & RMD_FL_SKIP) {
+					md->_flag &= ~RMD_FL_SKIP;
+					++n;
+				}
+				found = 1;
+				break;
+			}
+		}
+		if (! found) {
+			PROJECT_IDX(list_md, NULL, 0);
+			return -1;
+		}
+
+		p += len;
+	}
+
+	return n;
+}
+
+/**
+ * Method PROJECT_IDX will select fields in `list_md` that will be copied into
+ * record by DSVReader, using `n` field index in `idx`. If `idx` is NULL, all
+ * fields will be selected.
+ *
+ * See PROJECT() for more information.
+ *
+ * On success it will return number of selected fields, otherwise when one of
+ * index is out of range it will return -1 and all fields will be selected.
+ */
+int DSVRecordMD::PROJECT_IDX(List* list_md, const int* idx, int n)
+{
+	int x = 0;
+	int size = list_md->size();
+	int sel = 0;
+	DSVRecordMD* md = NULL;
+
+	for (x = 0; x < size; x++) {
+		md = (DSVRecordMD*) list_md->at(x);
+		if (idx) {
+			md->_flag |= RMD_FL_SKIP;
+		} else {
+			md->_flag &= ~RMD_FL_SKIP;
+		}
+	}
+	if (! idx) {
+		return size;
+	}
+
+	for (x = 0; x < n; x++) {
+		if (idx[x] < 0 || idx[x] >= size) {
+			PROJECT_IDX(list_md, NULL, 0);
+			return -1;
+		}
+		md = (DSVRecordMD*) list_md->at(idx[x]);
+		if (md->_flag & RMD_FL_SKIP) {
+			md->_flag &= ~RMD_FL_SKIP;
+			++sel;
+		}
+	}
+
+	return sel;
+}
+
 /**
  * @method	: DSVRecordMD::DSVRecordMD
  * @desc	: DSVRecordMD object constructor.
@@ -421,9 +803,13 @@ DSVRecordMD::DSVRecordMD() :
 	_fltr_idx(0),
 	_fltr_rule(0),
 	_fop(NULL),
+	_fltr_n(0),
 	_name(),
 	_date_format(NULL),
-	_fltr_v(NULL)
+	_fltr_v(NULL),
+	_date_plan(NULL),
+	_date_n(0),
+	_date_pfx(0)
 {}
 
 /**
@@ -436,6 +822,7 @@ DSVRecordMD::~DSVRecordMD()
 		delete _date_format;
 	if (_fltr_v)
 		delete _fltr_v;
+	free(_date_plan);
 }
 
 //
@@ -479,6 +866,19 @@ const char* DSVRecordMD::chars()
 		o.append_fmt("\"%c\"", _sep);
 	}
 
+	if (_date_format) {
+		o.append_fmt(", \"date_format\": \"%s\""
+			, _date_format->chars());
+	}
+
+	if (_fop) {
+		static const char* ops[] = { "", "=", "<", "<=", ">", ">=", "~" };
+
+		o.append_fmt(", \"filter\": \"%s%s%s\""
+			, _fltr_rule == RMD_FLTR_REJECT ? "!" : ""
+			, ops[_fltr_idx], _fltr_v->chars());
+	}
+
 	o.append_raw(" }");
 
 	if (__str) {
@@ -491,5 +891,264 @@ const char* DSVRecordMD::chars()
 	return __str;
 }
 
+/**
+ * Method filter will check field value `v` with length `len` against filter
+ * defined in this meta-data. If `cache` is not NULL, it is used to cache the
+ * day part of date field, see date_parse().
+ *
+ * It will return 1 if the row that contain the field should be accepted, or 0
+ * if the row should be rejected. Meta-data without filter accept any value.
+ */
+int DSVRecordMD::filter(const char* v, size_t len
+	, struct rmd_date_cache* cache) const
+{
+	if (! _fop) {
+		return 1;
+	}
+
+	int s = _fop(this, v, len, cache);
+
+	if (_fltr_rule == RMD_FLTR_REJECT) {
+		return ! s;
+	}
+	return s;
+}
+
+/**
+ * Method date_compile will compile date format `fmt` into list of parser
+ * steps. Known conversions are,
+ *
+ * - %Y : year, four digits.
+ * - %y : year, two digits; 69-99 is 1969-1999, 00-68 is 2000-2068.
+ * - %m : month, 1 to 12.
+ * - %b : abbreviated English month name, case insensitive.
+ * - %d : day of month.
+ * - %H : hour, 0 to 23.
+ * - %M : minute.
+ * - %S : second.
+ * - %% : literal '%'.
+ *
+ * Any other character must match literally. Numeric conversion read up to
+ * two digits, or four for %Y.
+ *
+ * On success it will return 0, or -1 if format contain unknown conversion.
+ */
+int DSVRecordMD::date_compile(const char* fmt)
+{
+	int n = 0;
+	int last_date = -1;
+	int first_time = -1;
+	size_t len = strlen(fmt);
+	struct rmd_date_step* plan = (struct rmd_date_step*) calloc(len + 1
+		, sizeof(*plan));
+
+	if (! plan) {
+		return -1;
+	}
+
+	for (size_t x = 0; x < len; x++, n++) {
+		if (fmt[x] != '%') {
+			plan[n].lit = fmt[x];
+			plan[n].width = 1;
+			continue;
+		}
+		if (++x >= len) {
+			free(plan);
+			return -1;
+		}
+
+		switch (fmt[x]) {
+		case '%':
+			plan[n].lit = '%';
+			plan[n].width = 1;
+			continue;
+		case 'Y':
+			plan[n].width = 4;
+			last_date = n;
+			break;
+		case 'y':
+		case 'm':
+		case 'd':
+			plan[n].width = 2;
+			last_date = n;
+			break;
+		case 'b':
+			plan[n].width = 3;
+			last_date = n;
+			break;
+		case 'H':
+		case 'M':
+		case 'S':
+			plan[n].width = 2;
+			if (first_time < 0) {
+				first_time = n;
+			}
+			break;
+		default:
+			free(plan);
+			return -1;
+		}
+		plan[n].conv = fmt[x];
+	}
+
+	free(_date_plan);
+	_date_plan = plan;
+	_date_n = n;
+	_date_pfx = 0;
+
+	// The day part can be cached only if it is followed by literal, so a
+	// value with the same prefix always has the same day.
+	if (last_date >= 0 && (first_time < 0 || first_time > last_date)
+	&&  last_date + 1 < n && plan[last_date + 1].conv == 0) {
+		_date_pfx = last_date + 2;
+	}
+
+	return 0;
+}
+
+/**
+ * Method date_parse will parse field value `v` with length `len` as date,
+ * using format that has been compiled by date_compile(), and return the
+ * number of seconds since 1970-01-01 00:00:00 UTC in `t`. Date is assumed in
+ * UTC, no time zone conversion is applied.
+ *
+ * If `cache` is not NULL, the day part of the parsed value is saved in
+ * `cache`, so consecutive values in the same day only parse their time part.
+ * The cache is owned by caller, e.g. one per reader, so this method does not
+ * modify the meta-data.
+ *
+ * It will return 0 on success, or -1 if `v` does not match the format or is
+ * not a valid date.
+ */
+int DSVRecordMD::date_parse(const char* v, size_t len, int64_t* t
+	, struct rmd_date_cache* cache) const
+{
+	int step = 0;
+	int cached = 0;
+	int c = 0;
+	int64_t num = 0;
+	int64_t year = 1970;
+	int64_t mon = 1;
+	int64_t day = 1;
+	int64_t hour = 0;
+	int64_t min = 0;
+	int64_t sec = 0;
+	size_t p = 0;
+	size_t w = 0;
+	int64_t days = 0;
+	struct rmd_date_step* st = NULL;
+
+	if (! _date_plan) {
+		return -1;
+	}
+
+	if (cache && cache->md == this && _date_pfx && cache->len
+	&&  len > cache->len && memcmp(v, cache->v, cache->len) == 0) {
+		p = cache->len;
+		step = _date_pfx;
+		days = cache->days;
+		cached = 1;
+	}
+
+	for (; step < _date_n; step++) {
+		st = &_date_plan[step];
+
+		if (p >= len) {
+			return -1;
+		}
+
+		if (st->conv == 0) {
+			if (v[p] != st->lit) {
+				return -1;
+			}
+			++p;
+		} else if (st->conv == 'b') {
+			if (p + 3 > len) {
+				return -1;
+			}
+			for (c = 0; c < 12; c++) {
+				if (tolower(v[p]) == MONTHS[c * 3]
+				&&  tolower(v[p + 1]) == MONTHS[c * 3 + 1]
+				&&  tolower(v[p + 2]) == MONTHS[c * 3 + 2]) {
+					break;
+				}
+			}
+			if (c == 12) {
+				return -1;
+			}
+			mon = c + 1;
+			p += 3;
+		} else {
+			num = 0;
+			for (w = 0; w < st->width && p < len; w++, p++) {
+				if (v[p] < '0' || v[p] > '9') {
+					break;
+				}
+				num = num * 10 + (v[p] - '0');
+			}
+			if (w == 0) {
+				return -1;
+			}
+			switch (st->conv) {
+			case 'Y':
+				year = num;
+				break;
+			case 'y':
+				year = num < 69 ? 2000 + num : 1900 + num;
+				break;
+			case 'm':
+				mon = num;
+				break;
+			case 'd':
+				day = num;
+				break;
+			case 'H':
+				hour = num;
+				break;
+			case 'M':
+				min = num;
+				break;
+			case 'S':
+				sec = num;
+				break;
+			}
+		}
+
+		if (step + 1 == _date_pfx) {
+			if (! DATE_VALID(year, mon, day)) {
+				return -1;
+			}
+			days = DATE_DAYS(year, mon, day);
+			cached = 1;
+
+			if (cache && p < sizeof(cache->v)) {
+				cache->md = this;
+				memcpy(cache->v, v, p);
+				cache->len = p;
+				cache->days = days;
+			}
+		}
+	}
+
+	if (p != len) {
+		return -1;
+	}
+	if (! cached) {
+		if (! DATE_VALID(year, mon, day)) {
+			return -1;
+		}
+		num = DATE_DAYS(year, mon, day);
+	} else {
+		num = days;
+	}
+	if (hour > 23 || min > 59 || sec > 60) {
+		return -1;
+	}
+
+	*t = num * 86400 + hour * 3600 + min * 60 + sec;
+
+	return 0;
+}
+
 } // namespace::vos
 // vi: ts=8 sw=8 tw=80:
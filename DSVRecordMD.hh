@@ -19,22 +19,87 @@ enum _rmd_type {
 	RMD_T_BLOB
 };
 
+enum _rmd_flag {
+	RMD_FL_SKIP	= 1
+};
+
+enum _rmd_filter_op {
+	RMD_FLTR_NONE	= 0,
+	RMD_FLTR_EQ,
+	RMD_FLTR_LT,
+	RMD_FLTR_LE,
+	RMD_FLTR_GT,
+	RMD_FLTR_GE,
+	RMD_FLTR_LIKE
+};
+
+enum _rmd_filter_rule {
+	RMD_FLTR_ACCEPT	= 0,
+	RMD_FLTR_REJECT
+};
+
+/**
+ * @struct	: rmd_date_step
+ * @attr	:
+ *	- conv	: conversion character of step, e.g. 'Y' for "%Y", or zero
+ *		  if step is a literal character.
+ *	- lit	: literal character, if conv is zero.
+ *	- width	: maximum number of characters consumed by step.
+ * @desc	: one step of date parser compiled from date format.
+ */
+struct rmd_date_step {
+	char	conv;
+	char	lit;
+	uint8_t	width;
+};
+
+class DSVRecordMD;
+
+#define RMD_DATE_CACHE_LEN	32
+
+/**
+ * @struct	: rmd_date_cache
+ * @attr	:
+ *	- md	: meta-data that fill the cache.
+ *	- v	: the last day part that has been parsed.
+ *	- len	: length of `v`, or zero if cache is empty.
+ *	- days	: number of days since epoch of `v`.
+ * @desc	: the day part of the last date parsed by
+ *		  DSVRecordMD::date_parse(), owned by the caller, so the same
+ *		  meta-data can be used by many readers at the same time.
+ */
+struct rmd_date_cache {
+	const DSVRecordMD*	md;
+	char			v[RMD_DATE_CACHE_LEN];
+	size_t			len;
+	int64_t			days;
+};
+
 /**
  * @class		: DSVRecordMD
  * @attr		:
  *	- _idx		: index of current meta-data record.
- *	- _flag		: flag of current meta-data record.
+ *	- _flag		: flag of current meta-data record, combination of
+ *			  RMD_FL_*.
  *	- _type		: type of record that this meta-data hold.
  *	- _left_q	: left character used in record data.
  *	- _right_q	: right character used in record data.
  *	- _start_p	: start position of record data.
  *	- _end_p	: end position of record data.
  *	- _sep		: character used as separator between record data.
- *	- _fltr_idx	: index of filter used in record.
- *	- _fltr_rule	: rule of filter that will be used in record.
- *	- _fop		: pointer to filter function.
+ *	- _fltr_idx	: index of filter operator used in record, one of
+ *			  RMD_FLTR_*.
+ *	- _fltr_rule	: rule of filter that will be used in record, accept or
+ *			  reject the row when the filter match.
+ *	- _fop		: pointer to filter function, compiled by INIT based on
+ *			  record type.
+ *	- _fltr_n	: numeric value of filter, if record type is NUMBER.
  *	- _name		: name of record.
  *	- _date_format	: format of date used in data.
+ *	- _date_plan	: list of steps compiled from _date_format.
+ *	- _date_n	: number of steps in _date_plan.
+ *	- _date_pfx	: number of steps that parse the day part of date, or
+ *			  zero if the day part can not be cached.
  *	- _fltr_v	: value of filter, if filter is in comparable mode.
  *	- BLOB_SIZE	: static, size of blob header.
  * @desc		:
@@ -52,13 +117,21 @@ public:
 	static const char* __CNAME;
 	static uint8_t BLOB_SIZE;
 	static int DEF_SEP;
+	static const char* DEF_DATE_FORMAT;
 
 	static List* INIT(const char* meta);
 	static List* INIT_FROM_FILE(const char* fmeta);
+	static int PROJECT(List* list_md, const char* names);
+	static int PROJECT_IDX(List* list_md, const int* idx, int n);
 
 	DSVRecordMD();
 	~DSVRecordMD();
 	const char* chars();
+	int filter(const char* v, size_t len
+		, struct rmd_date_cache* cache = NULL) const;
+	int date_compile(const char* fmt);
+	int date_parse(const char* v, size_t len, int64_t* t
+		, struct rmd_date_cache* cache = NULL) const;
 
 	int		_idx;
 	int		_flag;
@@ -70,10 +143,15 @@ public:
 	int		_sep;
 	int		_fltr_idx;
 	int		_fltr_rule;
-	int		(*_fop)(const int, const void*, const void*);
+	int		(*_fop)(const DSVRecordMD*, const char*, size_t
+				, struct rmd_date_cache*);
+	double		_fltr_n;
 	Buffer		_name;
 	Buffer*		_date_format;
 	Buffer*		_fltr_v;
+	struct rmd_date_step*	_date_plan;
+	int		_date_n;
+	int		_date_pfx;
 
 private:
 	DSVRecordMD(const DSVRecordMD&);
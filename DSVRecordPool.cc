@@ -0,0 +1,103 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include "DSVRecordPool.hh"
+
+namespace vos {
+
+const char* DSVRecordPool::__cname = "DSVRecordPool";
+
+DSVRecordPool::DSVRecordPool(int n_col)
+:	_n_col(n_col)
+,	_n_alloc(0)
+,	_free(NULL)
+{}
+
+//
+// The rows is deleted one by one, because deleting the head of row list will
+// delete the rest of list recursively.
+//
+DSVRecordPool::~DSVRecordPool()
+{
+	DSVRecord* row = NULL;
+
+	while (_free) {
+		row = _free;
+		_free = row->_next_row;
+
+		row->_next_row = NULL;
+		delete row;
+	}
+}
+
+/**
+ * Method reserve(n) will allocate `n` new rows into pool.
+ *
+ * On success it will return NULL, otherwise it will return error.
+ */
+Error DSVRecordPool::reserve(size_t n)
+{
+	DSVRecord* row = NULL;
+
+	for (; n > 0; n--) {
+		row = NULL;
+		if (DSVRecord::INIT_ROW(&row, _n_col) < 0 || ! row) {
+			return ErrOutOfMemory;
+		}
+		++_n_alloc;
+
+		row->_next_row = _free;
+		_free = row;
+	}
+
+	return NULL;
+}
+
+/**
+ * Method get will return an empty row with `_n_col` columns. The row is taken
+ * from released rows if there is one, otherwise a new row is allocated.
+ *
+ * It will return NULL if no memory left.
+ */
+DSVRecord* DSVRecordPool::get()
+{
+	DSVRecord* row = _free;
+
+	if (! row) {
+		if (reserve(1) != NULL) {
+			return NULL;
+		}
+		row = _free;
+	}
+
+	_free = row->_next_row;
+
+	row->_next_row = NULL;
+	row->_last_row = row;
+	row->columns_reset();
+
+	return row;
+}
+
+/**
+ * Method put(rows) will release `rows` back to pool. The `rows` can be a
+ * single row or a list of rows that is created by DSVRecord::ADD_ROW, which
+ * will be released at once.
+ *
+ * The columns of released rows are emptied when they are returned by get().
+ */
+void DSVRecordPool::put(DSVRecord* rows)
+{
+	if (! rows) {
+		return;
+	}
+
+	rows->_last_row->_next_row = _free;
+	_free = rows;
+}
+
+} // namespace::vos
+// vi: ts=8 sw=8 tw=80:
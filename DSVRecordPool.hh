@@ -0,0 +1,49 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#ifndef _LIBVOS_DSVRECORDPOOL_HH
+#define _LIBVOS_DSVRECORDPOOL_HH 1
+
+#include "DSVRecord.hh"
+
+namespace vos {
+
+//
+// Class DSVRecordPool will keep rows that has been released, so they can be
+// reused by the next get() without allocating new columns and without
+// releasing the memory of their column buffers.
+//
+// Released rows are linked by their `_next_row`, the same way as list of
+// rows created by DSVRecord::ADD_ROW, so the whole list can be returned to
+// pool at once.
+//
+// Field `_n_col` contain number of columns in each rows.
+// Field `_n_alloc` contain number of rows that has been allocated by pool.
+// Field `_free` contain the list of released rows.
+//
+class DSVRecordPool {
+public:
+	static const char* __cname;
+
+	int		_n_col;
+	size_t		_n_alloc;
+	DSVRecord*	_free;
+
+	explicit DSVRecordPool(int n_col);
+	~DSVRecordPool();
+
+	Error reserve(size_t n);
+	DSVRecord* get();
+	void put(DSVRecord* rows);
+
+private:
+	DSVRecordPool(const DSVRecordPool&);
+	void operator=(const DSVRecordPool&);
+};
+
+} // namespace::vos
+#endif
+// vi: ts=8 sw=8 tw=80:
@@ -0,0 +1,871 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include <float.h>
+
+#include "DSVSort.hh"
+
+namespace vos {
+
+Error ErrDSVSortKey("DSVSort: invalid or unknown key");
+
+const char* DSVSort::__cname = "DSVSort";
+
+//
+// Variable MEM_LIMIT contain default memory limit for sorting rows in memory.
+//
+size_t DSVSort::MEM_LIMIT = 64 * 1024 * 1024;
+
+//
+// Variable IO_SIZE contain maximum size of buffer for each file that is read
+// or written.
+//
+size_t DSVSort::IO_SIZE = 1024 * 1024;
+
+//
+// Variable N_THREAD contain default number of threads used to sort the runs.
+//
+int DSVSort::N_THREAD = 2;
+
+//
+// Variable MERGE_WAY contain maximum number of runs that is merged at once.
+// If number of runs is greater than this, runs will be merged in several
+// passes.
+//
+int DSVSort::MERGE_WAY = 64;
+
+static const size_t MIN_IO_SIZE = 64 * 1024;
+static const size_t INSERTION_SIZE = 16;
+
+//
+// dsv_sort_batch contain rows that will be sorted in memory and written into
+// a single run file `fout` by one thread.
+//
+// Field `data` contain the raw rows and the value of their keys. Its size is
+// allocated once, so pointer to rows and keys inside it does not change while
+// rows are added.
+//
+struct dsv_sort_batch {
+	DSVSort*		sort;
+	struct dsv_sort_row*	rows;
+	struct dsv_sort_key*	keys;
+	size_t			n;
+	size_t			cap;
+	Buffer			data;
+	Buffer*			fout;
+	const char*		eol;
+	Error			err;
+
+	dsv_sort_batch()
+	:	sort(NULL)
+	,	rows(NULL)
+	,	keys(NULL)
+	,	n(0)
+	,	cap(0)
+	,	data()
+	,	fout(NULL)
+	,	eol(NULL)
+	,	err()
+	{}
+private:
+	dsv_sort_batch(const dsv_sort_batch&);
+	void operator=(const dsv_sort_batch&);
+};
+
+//
+// MSORT will sort `n` rows in `a` using bottom-up merge sort, with `tmp` as
+// temporary space. The sort is stable.
+//
+static void MSORT(DSVSort* s, struct dsv_sort_row* a
+	, struct dsv_sort_row* tmp, size_t n)
+{
+	size_t x, y, o, lo, mid, hi, w;
+	struct dsv_sort_row* src = a;
+	struct dsv_sort_row* dst = tmp;
+	struct dsv_sort_row* swp = NULL;
+	struct dsv_sort_row r;
+
+	for (lo = 0; lo < n; lo += INSERTION_SIZE) {
+		hi = lo + INSERTION_SIZE < n ? lo + INSERTION_SIZE : n;
+		for (x = lo + 1; x < hi; x++) {
+			r = a[x];
+			for (y = x; y > lo; y--) {
+				if (s->compare(&a[y - 1], &r) <= 0) {
+					break;
+				}
+				a[y] = a[y - 1];
+			}
+			a[y] = r;
+		}
+	}
+
+	for (w = INSERTION_SIZE; w < n; w *= 2) {
+		for (lo = 0; lo < n; lo += 2 * w) {
+			mid	= lo + w < n ? lo + w : n;
+			hi	= lo + 2 * w < n ? lo + 2 * w : n;
+			x	= lo;
+			y	= mid;
+			o	= lo;
+
+			while (x < mid && y < hi) {
+				if (s->compare(&src[y], &src[x]) < 0) {
+					dst[o++] = src[y++];
+				} else {
+					dst[o++] = src[x++];
+				}
+			}
+			while (x < mid) {
+				dst[o++] = src[x++];
+			}
+			while (y < hi) {
+				dst[o++] = src[y++];
+			}
+		}
+		swp = src;
+		src = dst;
+		dst = swp;
+	}
+
+	if (src != a) {
+		memcpy(a, src, n * sizeof(*a));
+	}
+}
+
+//
+// SORT_BATCH will sort rows in batch `arg` and write them into run file.
+// The batch will be emptied after the rows is written.
+//
+static void* SORT_BATCH(void* arg)
+{
+	struct dsv_sort_batch* b = (struct dsv_sort_batch*) arg;
+	struct dsv_sort_row* tmp = NULL;
+	struct dsv_sort_key* keys = NULL;
+	const int* type = b->sort->_key_type;
+	size_t nk = size_t(b->sort->_n_keys);
+	size_t off = 0;
+	size_t x = 0;
+	size_t k = 0;
+	File w;
+
+	for (x = 0; x < b->n; x++) {
+		keys = &b->keys[x * nk];
+
+		b->rows[x].raw = b->data.v(off);
+		b->rows[x].keys = keys;
+		off += b->rows[x].len;
+
+		for (k = 0; k < nk; k++) {
+			if (type[k] == RMD_T_STRING) {
+				keys[k].v = b->data.v(off);
+				off += keys[k].len;
+			}
+		}
+	}
+
+	tmp = (struct dsv_sort_row*) calloc(b->n, sizeof(*tmp));
+	if (! tmp) {
+		b->err = ErrOutOfMemory;
+		goto out;
+	}
+
+	MSORT(b->sort, b->rows, tmp, b->n);
+
+	free(tmp);
+
+	b->err = w.open_wt(b->fout->chars());
+	if (b->err != NULL) {
+		goto out;
+	}
+
+	w.resize(DSVSort::IO_SIZE);
+
+	for (x = 0; x < b->n; x++) {
+		b->err = w.write_raw(b->rows[x].raw, b->rows[x].len);
+		if (b->err != NULL) {
+			goto out;
+		}
+	}
+
+	b->err = w.flush();
+out:
+	b->n = 0;
+	b->data.reset();
+
+	return NULL;
+}
+
+//
+// BATCH_ADD will add the last row read by `reader`, with its key columns in
+// `row`, to batch `b`, if there is space for it.
+//
+// The space used by batch is the size of its data buffer, its rows and keys
+// array, and the temporary rows allocated by SORT_BATCH, which must not
+// exceed `limit`, except for the first row in batch.
+//
+// Each row is appended to data buffer followed by its STRING keys, which
+// may be moved when data buffer grow, so their pointers is set later by
+// SORT_BATCH.
+//
+// It will return 1 if row has been added, or 0 if batch is full.
+//
+static int BATCH_ADD(struct dsv_sort_batch* b, DSVReader* reader
+	, DSVRecord* row, size_t limit)
+{
+	DSVSort* s = b->sort;
+	size_t nk = size_t(s->_n_keys);
+	size_t len = 0;
+	size_t need = 0;
+	size_t cap = b->cap;
+	size_t meta = 0;
+	size_t size = 0;
+	size_t k = 0;
+	const char* raw = reader->raw(&len);
+	DSVRecord* col = NULL;
+	void* p = NULL;
+
+	need = b->data.len() + len + 1;
+	for (k = 0; k < nk; k++) {
+		if (s->_key_type[k] == RMD_T_STRING) {
+			need += row->get_column(s->_key_col[k])->len();
+		}
+	}
+
+	if (b->n == cap) {
+		cap = cap ? cap * 2 : 1024;
+	}
+	meta = cap * (sizeof(*b->rows) + nk * sizeof(*b->keys))
+		+ (b->n + 1) * sizeof(*b->rows);
+
+	size = b->data.size();
+	if (need > size) {
+		size = size * 2 > need ? size * 2 : need;
+		if (b->n > 0 && size + meta > limit) {
+			size = need;
+		}
+	}
+	if (b->n > 0 && size + meta > limit) {
+		return 0;
+	}
+
+	if (size > b->data.size() && b->data.resize(size) != NULL) {
+		return 0;
+	}
+
+	if (cap > b->cap) {
+		p = realloc(b->rows, cap * sizeof(*b->rows));
+		if (! p) {
+			return 0;
+		}
+		b->rows = (struct dsv_sort_row*) p;
+
+		p = realloc(b->keys, cap * nk * sizeof(*b->keys));
+		if (! p) {
+			return 0;
+		}
+		b->keys = (struct dsv_sort_key*) p;
+
+		b->cap = cap;
+	}
+
+	b->rows[b->n].len = len;
+	b->data.append_raw(raw, len);
+
+	if (len == 0 || raw[len - 1] != b->eol[0]) {
+		b->data.appendc(b->eol[0]);
+		b->rows[b->n].len++;
+	}
+
+	s->fill_keys(row, &b->keys[b->n * nk]);
+
+	for (k = 0; k < nk; k++) {
+		if (s->_key_type[k] == RMD_T_STRING) {
+			col = row->get_column(s->_key_col[k]);
+			b->data.append_raw(col->v(), col->len());
+		}
+	}
+
+	++b->n;
+
+	return 1;
+}
+
+DSVSort::DSVSort()
+:	_mem_limit(MEM_LIMIT)
+,	_n_thread(N_THREAD)
+,	_n_keys(0)
+,	_key_idx(NULL)
+,	_key_col(NULL)
+,	_key_type(NULL)
+,	_key_md(NULL)
+,	_key_desc(NULL)
+,	_n_rows(0)
+,	_n_runs(0)
+{}
+
+DSVSort::~DSVSort()
+{
+	free(_key_idx);
+	free(_key_col);
+	free(_key_type);
+	free(_key_md);
+	free(_key_desc);
+}
+
+/**
+ * Method set_keys will set the sort keys using field names in `keys`,
+ * separated by comma, e.g. "name,-date". Key with '-' prefix will be sorted
+ * in descending order. Each key is compared based on their type in
+ * `list_md`: NUMBER is compared numerically, DATE is parsed using its date
+ * format and compared by time, and STRING is compared byte by byte.
+ * `list_md` must be kept until sorting is done.
+ *
+ * On success it will return NULL. If one of the key is not found in
+ * `list_md` or has type BLOB, it will return ErrDSVSortKey.
+ */
+Error DSVSort::set_keys(List* list_md, const char* keys)
+{
+	int x = 0;
+	int desc = 0;
+	size_t len = 0;
+	size_t cap = strlen(keys) / 2 + 1;
+	const char* p = keys;
+	DSVRecordMD* md = NULL;
+
+	free(_key_idx);
+	free(_key_col);
+	free(_key_type);
+	free(_key_md);
+	free(_key_desc);
+	_n_keys = 0;
+
+	_key_idx = (int*) calloc(cap, sizeof(int));
+	_key_col = (int*) calloc(cap, sizeof(int));
+	_key_type = (int*) calloc(cap, sizeof(int));
+	_key_md = (const DSVRecordMD**) calloc(cap, sizeof(*_key_md));
+	_key_desc = (int*) calloc(cap, sizeof(int));
+	if (! _key_idx || ! _key_col || ! _key_type || ! _key_md
+	||  ! _key_desc) {
+		return ErrOutOfMemory;
+	}
+
+	while (*p) {
+		while (*p == ',' || isspace(*p)) {
+			++p;
+		}
+		desc = 0;
+		if (*p == '-') {
+			desc = 1;
+			++p;
+		}
+		len = 0;
+		while (p[len] && p[len] != ',' && !isspace(p[len])) {
+			++len;
+		}
+		if (len == 0) {
+			if (desc) {
+				_n_keys = 0;
+				return ErrDSVSortKey;
+			}
+			break;
+		}
+
+		for (x = 0; x < list_md->size(); x++) {
+			md = (DSVRecordMD*) list_md->at(x);
+			if (md->_name.len() == len
+			&&  memcmp(md->_name.v(), p, len) == 0) {
+				break;
+			}
+		}
+		if (x >= list_md->size() || md->_type == RMD_T_BLOB) {
+			_n_keys = 0;
+			return ErrDSVSortKey;
+		}
+
+		_key_idx[_n_keys]	= x;
+		_key_type[_n_keys]	= md->_type;
+		_key_md[_n_keys]	= md;
+		_key_desc[_n_keys]	= desc;
+		++_n_keys;
+
+		p += len;
+	}
+
+	if (_n_keys == 0) {
+		return ErrDSVSortKey;
+	}
+
+	// Only key fields is read into row, so the column of each key is the
+	// number of distinct key fields before it.
+	for (int k = 0; k < _n_keys; k++) {
+		for (x = 0; x < _n_keys; x++) {
+			if (_key_idx[x] >= _key_idx[k]) {
+				continue;
+			}
+			for (desc = 0; desc < x; desc++) {
+				if (_key_idx[desc] == _key_idx[x]) {
+					break;
+				}
+			}
+			if (desc == x) {
+				++_key_col[k];
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Method fill_keys will set the value of each keys in `keys` using the key
+ * columns in `row`. `keys` must have space for all keys.
+ *
+ * Key with type NUMBER that is not a number, or key with type DATE that does
+ * not match its format, is sorted before any valid value.
+ */
+void DSVSort::fill_keys(DSVRecord* row, struct dsv_sort_key* keys)
+{
+	size_t n = 0;
+	int64_t t = 0;
+	DSVRecord* col = NULL;
+	Error err;
+
+	for (int k = 0; k < _n_keys; k++) {
+		col = row->get_column(_key_col[k]);
+
+		keys[k].v	= col->v();
+		keys[k].len	= col->len();
+		keys[k].num	= 0;
+
+		if (_key_type[k] == RMD_T_DATE) {
+			if (_key_md[k]->date_parse(col->v(), col->len(), &t)
+				== 0) {
+				keys[k].num = double(t);
+			} else {
+				keys[k].num = -DBL_MAX;
+			}
+			continue;
+		}
+		if (_key_type[k] != RMD_T_NUMBER) {
+			continue;
+		}
+
+		err = Buffer::PARSE_DOUBLE(col->v(), col->len(), &keys[k].num
+			, &n);
+		if (err != NULL || n == 0) {
+			keys[k].num = -DBL_MAX;
+		}
+	}
+}
+
+/**
+ * Method compare will compare the keys of row `a` with row `b`.
+ *
+ * It will return negative value if `a` should be sorted before `b`, positive
+ * value if `a` should be sorted after `b`, or zero if both keys are equal.
+ */
+int DSVSort::compare(const struct dsv_sort_row* a
+	, const struct dsv_sort_row* b)
+{
+	int s = 0;
+	const struct dsv_sort_key* ka = a->keys;
+	const struct dsv_sort_key* kb = b->keys;
+
+	for (int k = 0; k < _n_keys; k++) {
+		if (_key_type[k] != RMD_T_STRING) {
+			s = (ka[k].num > kb[k].num) - (ka[k].num < kb[k].num);
+		} else {
+			s = memcmp(ka[k].v, kb[k].v
+				, ka[k].len < kb[k].len ? ka[k].len : kb[k].len);
+			if (s == 0) {
+				s = (ka[k].len > kb[k].len) - (ka[k].len < kb[k].len);
+			}
+		}
+		if (s) {
+			return _key_desc[k] ? -s : s;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Method sort will sort rows in file `fin` using keys that has been set by
+ * set_keys(), and write the sorted rows into `fout`. Both files use
+ * `list_md` as meta-data. Rows are written as it is in `fin`; rows that are
+ * rejected by reader are not written.
+ *
+ * Only the key fields are extracted by reader. Rows are collected into
+ * batches, one for each thread. Each batch of rows is sorted and written
+ * into a run file, "fout.run.N", by its own thread while the next batch is
+ * read. Since all batches may be in memory at the same time, each batch,
+ * including its keys and the temporary space for sorting, is limited to the
+ * memory limit divided by number of threads. All runs
+ * then merged into `fout`, `MERGE_WAY` runs at a time, and removed.
+ *
+ * Projection in `list_md` is reset to all fields when sort is finished.
+ *
+ * On success it will return NULL, otherwise it will return error.
+ */
+Error DSVSort::sort(const char* fin, const char* fout, List* list_md)
+{
+	int s = 0;
+	int b = 0;
+	int x = 0;
+	int n_thread = _n_thread > 0 ? _n_thread : 1;
+	int way = MERGE_WAY > 1 ? MERGE_WAY : 2;
+	int n_col = 0;
+	size_t batch_limit = 0;
+	DSVRecord* row = NULL;
+	DSVReader reader;
+	Buffer* run = NULL;
+	File f;
+	List runs;
+	List next;
+	struct dsv_sort_batch* batch = NULL;
+	struct dsv_sort_batch* batches = NULL;
+	Thread** threads = NULL;
+	int* busy = NULL;
+	Error err;
+
+	if (_n_keys == 0) {
+		return ErrDSVSortKey;
+	}
+
+	_n_rows = 0;
+	_n_runs = 0;
+
+	n_col = DSVRecordMD::PROJECT_IDX(list_md, _key_idx, _n_keys);
+
+	batch_limit = _mem_limit / size_t(n_thread);
+
+	err = reader.open_ro(fin);
+	if (err != NULL) {
+		goto out;
+	}
+
+	reader.resize(IO_SIZE);
+
+	batches = new struct dsv_sort_batch[n_thread];
+	threads = (Thread**) calloc(size_t(n_thread), sizeof(*threads));
+	busy = (int*) calloc(size_t(n_thread), sizeof(*busy));
+	if (! batches || ! threads || ! busy) {
+		err = ErrOutOfMemory;
+		goto out;
+	}
+
+	for (x = 0; x < n_thread; x++) {
+		batches[x].sort	= this;
+		batches[x].eol	= reader.eol();
+		threads[x]	= new Thread(&SORT_BATCH);
+		if (! threads[x]) {
+			err = ErrOutOfMemory;
+			goto out;
+		}
+	}
+
+	batch = &batches[0];
+
+	DSVRecord::INIT_ROW(&row, n_col);
+
+	do {
+		row->columns_reset();
+
+		s = reader.read(row, list_md);
+		if (s == 0) {
+			break;
+		}
+		if (s < 0) {
+			continue;
+		}
+
+		if (BATCH_ADD(batch, &reader, row, batch_limit)) {
+			++_n_rows;
+			continue;
+		}
+
+		run = new Buffer();
+		run->append_fmt("%s.run.%zu", fout, _n_runs++);
+		runs.push_tail(run);
+
+		batch->fout = run;
+
+		// Sort the batch in this thread if new thread can not be
+		// started.
+		if (threads[b]->start(batch) == 0) {
+			busy[b] = 1;
+		} else {
+			SORT_BATCH(batch);
+			if (batch->err != NULL) {
+				err = batch->err;
+				goto out;
+			}
+		}
+
+		b = (b + 1) % n_thread;
+		batch = &batches[b];
+
+		if (busy[b]) {
+			threads[b]->join();
+			busy[b] = 0;
+			if (batch->err != NULL) {
+				err = batch->err;
+				goto out;
+			}
+		}
+
+		if (! BATCH_ADD(batch, &reader, row, batch_limit)) {
+			err = ErrOutOfMemory;
+			goto out;
+		}
+		++_n_rows;
+	} while (1);
+
+	if (batch->n > 0) {
+		run = new Buffer();
+		run->append_fmt("%s.run.%zu", fout, _n_runs++);
+		runs.push_tail(run);
+
+		batch->fout = run;
+		SORT_BATCH(batch);
+		if (batch->err != NULL) {
+			err = batch->err;
+		}
+	}
+
+out:
+	if (row) {
+		delete row;
+	}
+
+	for (x = 0; threads && x < n_thread; x++) {
+		if (busy && busy[x]) {
+			threads[x]->join();
+			if (err == NULL && batches[x].err != NULL) {
+				err = batches[x].err;
+			}
+		}
+		delete threads[x];
+	}
+	for (x = 0; batches && x < n_thread; x++) {
+		free(batches[x].rows);
+		free(batches[x].keys);
+	}
+	delete[] batches;
+	free(threads);
+	free(busy);
+
+	reader.close();
+
+	if (err == NULL && runs.size() <= 1) {
+		if (runs.size() == 1) {
+			run = (Buffer*) runs.at(0);
+			if (rename(run->chars(), fout) < 0) {
+				err = Error::SYS();
+			}
+		} else {
+			err = f.open_wt(fout);
+			f.close();
+		}
+		runs.reset();
+		DSVRecordMD::PROJECT_IDX(list_md, NULL, 0);
+		return err;
+	}
+
+	while (err == NULL && runs.size() > way) {
+		for (x = 0; err == NULL && x < runs.size(); x += way) {
+			run = new Buffer();
+			run->append_fmt("%s.run.%zu", fout, _n_runs++);
+			next.push_tail(run);
+
+			err = merge(&runs, x, x + way < runs.size()
+				? x + way : runs.size(), run->chars(), list_md);
+		}
+
+		runs.reset();
+		while (next.size() > 0) {
+			runs.push_tail(next.pop_head());
+		}
+	}
+
+	if (err == NULL) {
+		err = merge(&runs, 0, runs.size(), fout, list_md);
+	}
+
+	if (err != NULL) {
+		for (x = 0; x < runs.size(); x++) {
+			unlink(((Buffer*) runs.at(x))->chars());
+		}
+		for (x = 0; x < next.size(); x++) {
+			unlink(((Buffer*) next.at(x))->chars());
+		}
+	}
+
+	DSVRecordMD::PROJECT_IDX(list_md, NULL, 0);
+
+	return err;
+}
+
+//
+// `merge(runs, from, to, fout, list_md)` will merge sorted run files in
+// `runs` from index `from` until `to` into file `fout`, and remove the merged
+// run files.
+//
+Error DSVSort::merge(List* runs, int from, int to, const char* fout
+	, List* list_md)
+{
+	int x = 0;
+	int s = 0;
+	int c = 0;
+	int top = 0;
+	int n_heap = 0;
+	int k = to - from;
+	int n_col = 0;
+	size_t io = _mem_limit / size_t(k + 1);
+	size_t nk = size_t(_n_keys);
+	DSVReader* readers = new DSVReader[k];
+	DSVRecord** rows = NULL;
+	struct dsv_sort_row* cur = NULL;
+	struct dsv_sort_key* keys = NULL;
+	int* heap = NULL;
+	File w;
+	Error err;
+
+	if (io > IO_SIZE) {
+		io = IO_SIZE;
+	}
+	if (io < MIN_IO_SIZE) {
+		io = MIN_IO_SIZE;
+	}
+
+	for (x = 0; x < list_md->size(); x++) {
+		if (! (((DSVRecordMD*) list_md->at(x))->_flag & RMD_FL_SKIP)) {
+			++n_col;
+		}
+	}
+
+	rows = (DSVRecord**) calloc(size_t(k), sizeof(*rows));
+	cur = (struct dsv_sort_row*) calloc(size_t(k), sizeof(*cur));
+	keys = (struct dsv_sort_key*) calloc(size_t(k) * nk, sizeof(*keys));
+	heap = (int*) calloc(size_t(k), sizeof(*heap));
+	if (! rows || ! cur || ! keys || ! heap) {
+		err = ErrOutOfMemory;
+		goto out;
+	}
+
+	err = w.open_wt(fout);
+	if (err != NULL) {
+		goto out;
+	}
+	w.resize(io);
+
+	for (x = 0; x < k; x++) {
+		err = readers[x].open_ro(((Buffer*) runs->at(from + x))->chars());
+		if (err != NULL) {
+			goto out;
+		}
+		readers[x].resize(io);
+
+		DSVRecord::INIT_ROW(&rows[x], n_col);
+		cur[x].keys = &keys[size_t(x) * nk];
+	}
+
+	// Read the first row of each run and push it into heap.
+	for (x = 0; x < k; x++) {
+		do {
+			rows[x]->columns_reset();
+			s = readers[x].read(rows[x], list_md);
+		} while (s < 0);
+		if (s == 0) {
+			continue;
+		}
+
+		cur[x].raw = readers[x].raw(&cur[x].len);
+		fill_keys(rows[x], cur[x].keys);
+
+		// Sift up.
+		c = n_heap++;
+		while (c > 0) {
+			top = (c - 1) / 2;
+			s = compare(&cur[heap[top]], &cur[x]);
+			if (s < 0 || (s == 0 && heap[top] < x)) {
+				break;
+			}
+			heap[c] = heap[top];
+			c = top;
+		}
+		heap[c] = x;
+	}
+
+	while (n_heap > 0) {
+		top = heap[0];
+
+		err = w.write_raw(cur[top].raw, cur[top].len);
+		if (err != NULL) {
+			goto out;
+		}
+
+		do {
+			rows[top]->columns_reset();
+			s = readers[top].read(rows[top], list_md);
+		} while (s < 0);
+
+		if (s == 0) {
+			top = heap[--n_heap];
+		} else {
+			cur[top].raw = readers[top].raw(&cur[top].len);
+			fill_keys(rows[top], cur[top].keys);
+		}
+
+		// Sift down `top` from the root.
+		x = 0;
+		while (1) {
+			c = 2 * x + 1;
+			if (c >= n_heap) {
+				break;
+			}
+			if (c + 1 < n_heap) {
+				s = compare(&cur[heap[c + 1]], &cur[heap[c]]);
+				if (s < 0 || (s == 0 && heap[c + 1] < heap[c])) {
+					++c;
+				}
+			}
+			s = compare(&cur[heap[c]], &cur[top]);
+			if (s > 0 || (s == 0 && heap[c] > top)) {
+				break;
+			}
+			heap[x] = heap[c];
+			x = c;
+		}
+		if (n_heap > 0) {
+			heap[x] = top;
+		}
+	}
+
+	err = w.flush();
+out:
+	w.close();
+
+	for (x = 0; x < k; x++) {
+		readers[x].close();
+		if (rows && rows[x]) {
+			delete rows[x];
+		}
+		if (err == NULL) {
+			unlink(((Buffer*) runs->at(from + x))->chars());
+		}
+	}
+
+	delete[] readers;
+	free(rows);
+	free(cur);
+	free(keys);
+	free(heap);
+
+	return err;
+}
+
+} // namespace::vos
+// vi: ts=8 sw=8 tw=80:
@@ -0,0 +1,94 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#ifndef _LIBVOS_DSVSORT_HH
+#define _LIBVOS_DSVSORT_HH 1
+
+#include "Thread.hh"
+#include "DSVReader.hh"
+#include "DSVWriter.hh"
+
+namespace vos {
+
+extern Error ErrDSVSortKey;
+
+//
+// dsv_sort_key contain value of a sort key in a row.
+// Field `v` and `len` point to the value of key, and `num` contain the numeric
+// value of key, used only if the key type is NUMBER, or the time of key in
+// seconds if the key type is DATE.
+//
+struct dsv_sort_key {
+	const char*	v;
+	size_t		len;
+	double		num;
+};
+
+//
+// dsv_sort_row contain a raw row, as it is in the file, and its sort keys.
+//
+struct dsv_sort_row {
+	const char*		raw;
+	size_t			len;
+	struct dsv_sort_key*	keys;
+};
+
+//
+// Class DSVSort will sort rows in DSV file that may be larger than available
+// memory, using external merge sort.
+//
+// Field `_mem_limit` contain the maximum size of memory used for rows that
+// will be sorted in memory, shared by all threads.
+// Field `_n_thread` contain number of threads that sort and write the runs.
+// Field `_n_keys` contain number of sort keys.
+// Field `_key_idx` contain field index of each keys in meta-data.
+// Field `_key_col` contain column index of each keys in the projected row.
+// Field `_key_type` contain type of each keys, one of RMD_T_*.
+// Field `_key_md` contain meta-data of each keys, used to parse DATE keys.
+// Field `_key_desc` contain 1 if key is sorted in descending order.
+// Field `_n_rows` contain number of rows in the last sorted file.
+// Field `_n_runs` contain number of sorted runs in the last sorted file.
+//
+class DSVSort {
+public:
+	static const char* __cname;
+	static size_t MEM_LIMIT;
+	static size_t IO_SIZE;
+	static int N_THREAD;
+	static int MERGE_WAY;
+
+	size_t		_mem_limit;
+	int		_n_thread;
+	int		_n_keys;
+	int*		_key_idx;
+	int*		_key_col;
+	int*		_key_type;
+	const DSVRecordMD** _key_md;
+	int*		_key_desc;
+	size_t		_n_rows;
+	size_t		_n_runs;
+
+	DSVSort();
+	~DSVSort();
+
+	Error set_keys(List* list_md, const char* keys);
+	Error sort(const char* fin, const char* fout, List* list_md);
+
+	void fill_keys(DSVRecord* row, struct dsv_sort_key* keys);
+	int compare(const struct dsv_sort_row* a
+		, const struct dsv_sort_row* b);
+
+private:
+	Error merge(List* runs, int from, int to, const char* fout
+		, List* list_md);
+
+	DSVSort(const DSVSort&);
+	void operator=(const DSVSort&);
+};
+
+} // namespace::vos
+#endif
+// vi: ts=8 sw=8 tw=80:
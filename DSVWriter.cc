@@ -10,12 +10,26 @@ namespace vos {
 
 const char* DSVWriter::__cname = "DSVWriter";
 
+//
+// Variable WRITES_SIZE contain minimum size of file buffer used by writes().
+//
+size_t DSVWriter::WRITES_SIZE = 1024 * 1024;
+
+//
+// Variable ALIGN_SIZE contain size of block that is written to file when
+// file buffer is full.
+//
+size_t DSVWriter::ALIGN_SIZE = 4096;
+
 /**
  * @method	: DSVWriter::DSVWriter
  * @desc	: DSVWriter object constructor.
  */
 DSVWriter::DSVWriter() :
-	_line()
+	_line(),
+	_cols(NULL),
+	_n_cols(0),
+	_cols_md(NULL)
 {}
 
 /**
@@ -23,7 +37,52 @@ DSVWriter::DSVWriter() :
  * @desc	: DSVWriter object destructor.
  */
 DSVWriter::~DSVWriter()
-{}
+{
+	free(_cols);
+}
+
+/**
+ * @method	: DSVWriter::compile
+ * @param	:
+ *	> list_md: record meta-data.
+ * @return	:
+ *	< 0	: success.
+ *	< -1	: fail.
+ * @desc	:
+ *	compile 'list_md' into plan of columns. The plan is compiled by write()
+ *	when it called with different meta-data; this method must be called
+ *	again if 'list_md' is modified after the plan is compiled.
+ */
+int DSVWriter::compile(List* list_md)
+{
+	int x = 0;
+	int n = list_md->size();
+	BNode* node = list_md->head();
+	DSVRecordMD* rmd = NULL;
+	struct dsv_writer_col* cols = NULL;
+
+	cols = (struct dsv_writer_col*) calloc(size_t(n) + 1, sizeof(*cols));
+	if (! cols) {
+		return -1;
+	}
+
+	for (; x < n; x++, node = node->get_right()) {
+		rmd = (DSVRecordMD*) node->get_content();
+
+		cols[x].type	= rmd->_type;
+		cols[x].left_q	= (char) rmd->_left_q;
+		cols[x].right_q	= (char) rmd->_right_q;
+		cols[x].sep	= (char) rmd->_sep;
+		cols[x].end_p	= rmd->_end_p;
+	}
+
+	free(_cols);
+	_cols		= cols;
+	_n_cols		= n;
+	_cols_md	= list_md;
+
+	return 0;
+}
 
 /**
  * @method	: DSVWriter::write
@@ -33,100 +92,98 @@ DSVWriter::~DSVWriter()
  * @return	:
  *	< 0	: success.
  *	< -1	: fail.
- * @desc	: write one row using 'list_md' as meta-data to file.
+ * @desc	:
+ *	write one row using 'list_md' as meta-data to file. The row is
+ *	formatted directly into file buffer.
  */
 int DSVWriter::write(DSVRecord *row, List *list_md)
 {
-	ssize_t len = 0;
-	size_t blob_size = 0;
 	int x = 0;
-	DSVRecordMD* rmd = NULL;
+	size_t len = 0;
+	size_t need = 0;
+	size_t blob_size = 0;
+	size_t eol_len = strlen(_eol);
+	char* line = NULL;
+	char* p = NULL;
+	DSVRecord* col = row;
+	struct dsv_writer_col* c = NULL;
 	Error err;
 
-	for (; x < list_md->size(); x++) {
-		rmd = (DSVRecordMD*) list_md->at(x);
+	if (list_md != _cols_md || list_md->size() != _n_cols) {
+		if (compile(list_md) < 0) {
+			return -1;
+		}
+	}
 
-		if (rmd->_start_p) {
-			err = _line.resize(rmd->_start_p);
-			if (err != NULL) {
-				return -1;
-			}
+	need = eol_len + 1;
+	for (x = 0; x < _n_cols && col; x++, col = col->_next_col) {
+		need += col->len() + 3 + DSVRecordMD::BLOB_SIZE + _cols[x].end_p;
+	}
+
+	if (_i + need > _l) {
+		err = flush_aligned();
+		if (err != NULL) {
+			return -1;
 		}
-		if (rmd->_left_q) {
-			err = _line.appendc((char) rmd->_left_q);
+		if (_i + need > _l) {
+			err = resize(_i + need);
 			if (err != NULL) {
 				return -1;
 			}
 		}
+	}
 
-		switch (rmd->_type) {
-		case RMD_T_STRING:
-		case RMD_T_NUMBER:
-		case RMD_T_DATE:
-			err = _line.append_raw(row->v(), row->len());
-			if (err != NULL) {
-				return -1;
-			}
-			break;
-		case RMD_T_BLOB:
-			blob_size = row->len();
-			err = _line.append_bin(&blob_size, DSVRecordMD::BLOB_SIZE);
-			if (err != NULL) {
-				return -1;
-			}
+	line = &_v[_i];
+	p = line;
 
-			err = _line.append_raw(row->v(), row->len());
-			if (err != NULL) {
-				return -1;
-			}
-			break;
+	for (x = 0; x < _n_cols; x++, row = row->_next_col) {
+		c = &_cols[x];
+
+		if (c->left_q) {
+			*p++ = c->left_q;
+		}
+
+		len = row->len();
+
+		if (c->type == RMD_T_BLOB) {
+			blob_size = len;
+			memcpy(p, &blob_size, DSVRecordMD::BLOB_SIZE);
+			p += DSVRecordMD::BLOB_SIZE;
+		}
+		if (len > 0) {
+			memcpy(p, row->v(), len);
+			p += len;
 		}
 
-		if (rmd->_end_p) {
-			if (rmd->_end_p < _line.len()) {
-				len = ssize_t(rmd->_end_p);
-				if (rmd->_right_q) {
+		if (c->end_p) {
+			len = size_t(p - line);
+			if (c->end_p < len) {
+				len = c->end_p;
+				if (c->right_q && len > 0) {
 					--len;
 				}
-				if (rmd->_sep) {
+				if (c->sep && len > 0) {
 					--len;
 				}
-
-				_line.truncate(size_t(len));
-			} else {
-				_line.set_len(rmd->_end_p);
-				/* it will resize by itself it the next
-				 * call of append */
+				p = line + len;
+			} else if (c->end_p > len) {
+				memset(p, 0, c->end_p - len);
+				p = line + c->end_p;
 			}
 		}
-		if (rmd->_right_q) {
-			err = _line.appendc((char) rmd->_right_q);
-			if (err != NULL) {
-				return -1;
-			}
+		if (c->right_q) {
+			*p++ = c->right_q;
 		}
-		if (rmd->_sep) {
-			err = _line.appendc((char) rmd->_sep);
-			if (err != NULL) {
-				return -1;
-			}
+		if (c->sep) {
+			*p++ = c->sep;
 		}
-		row = row->_next_col;
 	}
 
-	_line.append_raw(_eol);
+	memcpy(p, _eol, eol_len);
+	p += eol_len;
 
-	len = ssize_t(_i + _line.len());
-	if (size_t(len) > _l) {
-		flush();
-	}
-
-	err = append_raw(_line.v(), _line.len());
-	if (err != NULL) {
-		return -1;
-	}
-
-	_line.reset();
+	_i = size_t(p - _v);
+	_v[_i] = '\0';
 
 	return 0;
 }
@@ -139,10 +196,19 @@ int DSVWriter::write(DSVRecord *row, List *list_md)
  * @return	:
  *	< 0	: success.
  *	< -1	: fail.
- * @desc	: write all 'rows' to file.
+ * @desc	:
+ *	write all 'rows' to file. File buffer is enlarged to at least
+ *	WRITES_SIZE, so rows are written to file in large blocks.
  */
 int DSVWriter::writes(DSVRecord *rows, List *list_md)
 {
+	if (_l < WRITES_SIZE) {
+		Error err = resize(WRITES_SIZE);
+		if (err != NULL) {
+			return -1;
+		}
+	}
+
 	while (rows) {
 		int s = write(rows, list_md);
 		if (s < 0) {
@@ -154,5 +220,38 @@ int DSVWriter::writes(DSVRecord *rows, List *list_md)
 	return 0;
 }
 
+//
+// `flush_aligned()` will write the content of file buffer in multiple of
+// ALIGN_SIZE and move the rest to the beginning of buffer. If buffer is
+// smaller than ALIGN_SIZE, all of its content is written.
+//
+Error DSVWriter::flush_aligned()
+{
+	size_t n = _i - _i % ALIGN_SIZE;
+	size_t x = 0;
+	ssize_t s = 0;
+
+	if (n == 0) {
+		return flush();
+	}
+
+	while (x < n) {
+		s = ::write(_d, &_v[x], n - x);
+		if (s < 0) {
+			return Error::SYS();
+		}
+		x += size_t(s);
+	}
+
+	_size += off_t(n);
+	_i -= n;
+	if (_i > 0) {
+		memmove(_v, &_v[n], _i);
+	}
+	_v[_i] = '\0';
+
+	return NULL;
+}
+
 } /* namespace::vos */
 // vi: ts=8 sw=8 tw=78:
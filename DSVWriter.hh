@@ -13,10 +13,36 @@
 namespace vos {
 
 /**
- * @class	: DSVWriter
+ * @struct	: dsv_writer_col
  * @attr	:
- *	- _line	: temporary buffer for collecting row data in a single line.
- * @desc	:
+ *	- type	: type of column, one of RMD_T_*.
+ *	- left_q	: left quote character, or zero.
+ *	- right_q	: right quote character, or zero.
+ *	- sep	: separator character, or zero.
+ *	- end_p	: end position of column in line, or zero.
+ * @desc	: plan of one column, compiled from record meta-data.
+ */
+struct dsv_writer_col {
+	int	type;
+	char	left_q;
+	char	right_q;
+	char	sep;
+	size_t	end_p;
+};
+
+/**
+ * @class		: DSVWriter
+ * @attr		:
+ *	- WRITES_SIZE	: static, minimum size of file buffer used by writes().
+ *	- ALIGN_SIZE	: static, file buffer is written in multiple of this
+ *			  size when it is full.
+ *	- _cols		: plan of each columns.
+ *	- _n_cols	: number of columns in plan.
+ *	- _cols_md	: meta-data that is used to compile the plan.
+ *	- _line		: deprecated, rows are formatted directly into file
+ *			  buffer. It is no longer used by write() and is kept
+ *			  only for compatibility with existing users.
+ * @desc		:
  *	module for writing DSVRecord object into file using DSVRecord Meta-Data.
  */
 class DSVWriter : public File {
@@ -24,13 +50,22 @@ public:
 	DSVWriter();
 	~DSVWriter();
 
+	int compile(List* list_md);
 	int write(DSVRecord* row, List* rmd);
 	int writes(DSVRecord* rows, List* list_md);
 
 	Buffer _line;
 
 	static const char* __cname;
+	static size_t WRITES_SIZE;
+	static size_t ALIGN_SIZE;
 private:
+	struct dsv_writer_col*	_cols;
+	int			_n_cols;
+	List*			_cols_md;
+
+	Error flush_aligned();
+
 	DSVWriter(const DSVWriter&);
 	void operator=(const DSVWriter&);
 };
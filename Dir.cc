@@ -4,21 +4,802 @@
 // found in the LICENSE file.
 //
 
+#include <fcntl.h>
 #include "Dir.hh"
+#include "Thread.hh"
 
 namespace vos {
 
 const char* Dir::__cname = "Dir";
 
+//
+// Variable N_THREAD contain default number of threads to scan directory.
+//
+int Dir::N_THREAD = 4;
+
+//
+// Variable MAX_FD contain maximum number of opened sub-directories that wait
+// to be scanned by other thread. When the limit is reached, the thread that
+// found the sub-directory will scan it by itself.
+//
+int Dir::MAX_FD = 256;
+
+//
+// dir_scan_job contain a directory that wait to be scanned.
+//
+// Field `node` contain node of directory, where the child will be added.
+// Field `fd` contain file descriptor of opened directory.
+// Field `path` contain path of directory, used to resolve symbolic link.
+// Field `depth` contain maximum depth of directory to scan.
+// Field `next` link the job in queue.
+//
+struct dir_scan_job {
+	DirNode*		node;
+	int			fd;
+	Buffer			path;
+	int			depth;
+	struct dir_scan_job*	next;
+
+	dir_scan_job()
+	:	node(NULL)
+	,	fd(-1)
+	,	path()
+	,	depth(0)
+	,	next(NULL)
+	{}
+
+	~dir_scan_job()
+	{
+		if (fd >= 0) {
+			::close(fd);
+		}
+	}
+private:
+	dir_scan_job(const dir_scan_job&);
+	void operator=(const dir_scan_job&);
+};
+
+//
+// dir_scan contain the state shared by all threads that scan the directory.
+// All fields, except the one that is set before threads is started, are
+// protected by its lock.
+//
+// Field `head` and `tail` contain queue of directories to be scanned.
+// Field `n_fd` contain number of directories in queue.
+// Field `max_fd` contain maximum number of directories in queue.
+// Field `n_busy` contain number of threads that currently scan directory.
+// Field `stop` is set to 1 when one of the thread has failed.
+// Field `root` and `root_len` contain the root path of Dir.
+//
+class dir_scan : public Locker {
+public:
+	pthread_cond_t		cond;
+	struct dir_scan_job*	head;
+	struct dir_scan_job*	tail;
+	int			n_fd;
+	int			max_fd;
+	int			n_busy;
+	int			stop;
+	const char*		root;
+	size_t			root_len;
+
+	dir_scan()
+	:	Locker()
+	,	cond()
+	,	head(NULL)
+	,	tail(NULL)
+	,	n_fd(0)
+	,	max_fd(0)
+	,	n_busy(0)
+	,	stop(0)
+	,	root(NULL)
+	,	root_len(0)
+	{
+		pthread_cond_init(&cond, NULL);
+	}
+
+	~dir_scan()
+	{
+		struct dir_scan_job* job = NULL;
+
+		while (head) {
+			job = head;
+			head = job->next;
+			delete job;
+		}
+		pthread_cond_destroy(&cond);
+	}
+
+	// wait will release the lock until other thread change the state.
+	void wait()
+	{
+		pthread_cond_wait(&cond, &_lock);
+	}
+
+	// notify will wake up all threads that wait for change of state.
+	void notify()
+	{
+		pthread_cond_broadcast(&cond);
+	}
+
+	// fail will stop all threads. Caller must hold the lock.
+	void fail()
+	{
+		stop = 1;
+		notify();
+	}
+private:
+	dir_scan(const dir_scan&);
+	void operator=(const dir_scan&);
+};
+
+//
+// NODE_CMP will compare name of two nodes, ignoring the case. Names that
+// only differ in case are compared by their case, so the order of nodes does
+// not depend on the order they are read.
+//
+static int NODE_CMP(const void* a, const void* b)
+{
+	DirNode* x = *(DirNode* const*) a;
+	DirNode* y = *(DirNode* const*) b;
+
+	int s = x->_name.like(&y->_name);
+	if (s == 0) {
+		s = x->_name.cmp(&y->_name);
+	}
+	return s;
+}
+
+//
+// LINK_CHILD will sort `n` nodes by name and add them as child of `list`.
+//
+static void LINK_CHILD(DirNode* list, DirNode** nodes, size_t n)
+{
+	size_t x;
+
+	if (n == 0) {
+		return;
+	}
+
+	qsort(nodes, n, sizeof(*nodes), NODE_CMP);
+
+	if (list->_child) {
+		for (x = 0; x < n; x++) {
+			DirNode::INSERT(&list->_child, nodes[x]);
+		}
+		return;
+	}
+
+	list->set_child(nodes[0]);
+	for (x = 1; x < n; x++) {
+		nodes[x]->_prev = nodes[x - 1];
+		nodes[x - 1]->_next = nodes[x];
+	}
+}
+
+//
+// SCAN_PUSH will add `job` to the queue of `scan`. It will return 1 if job
+// is queued, or 0 if queue is full.
+//
+static int SCAN_PUSH(dir_scan* scan, struct dir_scan_job* job)
+{
+	int queued = 0;
+
+	scan->lock();
+	if (scan->n_fd < scan->max_fd) {
+		job->next = NULL;
+		if (scan->tail) {
+			scan->tail->next = job;
+		} else {
+			scan->head = job;
+		}
+		scan->tail = job;
+		scan->n_fd++;
+		scan->notify();
+		queued = 1;
+	}
+	scan->unlock();
+
+	return queued;
+}
+
+//
+// SCAN_POP will remove and return the first job in queue. Caller must hold
+// the lock.
+//
+static struct dir_scan_job* SCAN_POP(dir_scan* scan)
+{
+	struct dir_scan_job* job = scan->head;
+
+	scan->head = job->next;
+	if (! scan->head) {
+		scan->tail = NULL;
+	}
+	job->next = NULL;
+	scan->n_fd--;
+
+	return job;
+}
+
+//
+// SCAN_DIR will read all nodes in directory `job`, and add them as child of
+// directory node. Each sub-directory is opened relative to its parent and
+// pushed to the queue, or scanned directly if queue is full.
+//
+// Node that can not be read, because it is removed while scanning or it is
+// a broken symbolic link, is skipped.
+//
+// It will return number of child in directory, or -1 if fail.
+//
+static int SCAN_DIR(dir_scan* scan, struct dir_scan_job* job)
+{
+	int			s	= 0;
+	int			fd	= -1;
+	size_t			n	= 0;
+	size_t			cap	= 0;
+	void*			p	= NULL;
+	DirNode**		nodes	= NULL;
+	DirNode*		node	= NULL;
+	struct dir_scan_job*	sub	= NULL;
+	struct dirent*		dent	= NULL;
+	DIR*			dir	= fdopendir(job->fd);
+
+	if (! dir) {
+		return -1;
+	}
+	job->fd = -1;
+
+	for (dent = readdir(dir); dent; dent = readdir(dir)) {
+		if (strcmp(dent->d_name, ".") == 0
+		||  strcmp(dent->d_name, "..") == 0) {
+			continue;
+		}
+
+		node = new DirNode();
+		if (! node) {
+			s = -1;
+			break;
+		}
+		s = node->get_attr_at(dirfd(dir), job->path.v(), dent->d_name);
+		if (s < 0) {
+			delete node;
+			s = 0;
+			continue;
+		}
+
+		if (n == cap) {
+			cap = cap ? cap * 2 : 64;
+			p = realloc(nodes, cap * sizeof(*nodes));
+			if (! p) {
+				delete node;
+				s = -1;
+				break;
+			}
+			nodes = (DirNode**) p;
+		}
+		node->_parent = job->node;
+		nodes[n++] = node;
+
+		if (! node->is_dir() || job->depth == 1) {
+			continue;
+		}
+
+		if (node->_linkname.is_empty()) {
+			fd = openat(dirfd(dir), dent->d_name
+				, O_RDONLY | O_DIRECTORY | O_NOFOLLOW
+				| O_CLOEXEC);
+		} else if (strncmp(node->_linkname.v(), scan->root
+				, scan->root_len) != 0) {
+			fd = ::open(node->_linkname.v()
+				, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		} else {
+			continue;
+		}
+		if (fd < 0) {
+			if (errno == EACCES) {
+				continue;
+			}
+			s = -1;
+			break;
+		}
+
+		sub = new dir_scan_job();
+		sub->node	= node;
+		sub->fd		= fd;
+		sub->depth	= job->depth - 1;
+
+		if (node->_linkname.is_empty()) {
+			sub->path.copy(&job->path);
+			if (sub->path.char_at(sub->path.len() - 1) != '/') {
+				sub->path.appendc('/');
+			}
+			sub->path.append_raw(dent->d_name);
+		} else {
+			sub->path.copy_raw(node->_linkname.v()
+					, node->_linkname.len());
+		}
+
+		if (SCAN_PUSH(scan, sub)) {
+			continue;
+		}
+
+		s = SCAN_DIR(scan, sub);
+		delete sub;
+		if (s < 0) {
+			break;
+		}
+	}
+
+	// Nodes is linked even if scanning is failed, because some of them
+	// may still be used by sub-directory in queue.
+	LINK_CHILD(job->node, nodes, n);
+
+	closedir(dir);
+	free(nodes);
+
+	if (s < 0) {
+		return -1;
+	}
+	return int(n);
+}
+
+//
+// SCAN_WORKER will scan directory in queue until all directories has been
+// scanned or one of the thread has failed.
+//
+static void* SCAN_WORKER(void* arg)
+{
+	int			s	= 0;
+	dir_scan*		scan	= (dir_scan*) arg;
+	struct dir_scan_job*	job	= NULL;
+
+	scan->lock();
+	for (;;) {
+		while (! scan->stop && ! scan->head && scan->n_busy > 0) {
+			scan->wait();
+		}
+		if (scan->stop || ! scan->head) {
+			break;
+		}
+
+		job = SCAN_POP(scan);
+		scan->n_busy++;
+		scan->unlock();
+
+		s = SCAN_DIR(scan, job);
+		delete job;
+
+		scan->lock();
+		scan->n_busy--;
+		if (s < 0) {
+			scan->fail();
+		} else if (! scan->head && scan->n_busy == 0) {
+			scan->notify();
+		}
+	}
+	scan->unlock();
+
+	return NULL;
+}
+
+//
+// COUNT will return number of nodes in `list`, including all of their
+// child.
+//
+static size_t COUNT(DirNode* list)
+{
+	size_t n = 0;
+
+	for (; list; list = list->_next) {
+		n += 1 + COUNT(list->_child);
+	}
+	return n;
+}
+
+//
+// UNCOUNT will subtract number of nodes in `list` from nodes loaded by
+// `dir`.
+//
+static void UNCOUNT(Dir* dir, DirNode* list)
+{
+	size_t n = COUNT(list);
+
+	if (n > dir->_n_node) {
+		n = dir->_n_node;
+	}
+	dir->_n_node -= n;
+}
+
+//
+// REFRESH_CHILD will update attributes of each child of directory `list`
+// with real path `rpath`, which is restored before returning.
+//
+// It will return number of child that has been changed, or -1 if one of
+// them can not be read, so directory need to be read again.
+//
+static int REFRESH_CHILD(DirNode* list, Buffer* rpath)
+{
+	int		s	= 0;
+	int		n	= 0;
+	size_t		len	= rpath->len();
+	DirNode*	c	= NULL;
+
+	for (c = list->_child; c; c = c->_next) {
+		rpath->truncate(len);
+		if (rpath->char_at(len - 1) != '/') {
+			rpath->appendc('/');
+		}
+		rpath->append_raw(c->_name.v(), c->_name.len());
+
+		s = c->update_attr(c, rpath->v());
+		if (s < 0) {
+			n = -1;
+			break;
+		}
+		if (s > 0) {
+			n++;
+		}
+	}
+	rpath->truncate(len);
+
+	return n;
+}
+
+//
+// FIND_IDLE will search loaded directory in `list` that has the oldest visit
+// time and save it to `idle`.
+//
+static void FIND_IDLE(DirNode* list, DirNode** idle)
+{
+	for (; list; list = list->_next) {
+		if (! list->_visit) {
+			continue;
+		}
+		if (! (*idle) || list->_visit < (*idle)->_visit) {
+			(*idle) = list;
+		}
+		FIND_IDLE(list->_child, idle);
+	}
+}
+
+//
+// APPEND_PATH will append path of `node`, relative to `root`, into `path`.
+//
+static void APPEND_PATH(Buffer* path, DirNode* root, DirNode* node)
+{
+	if (node == root) {
+		return;
+	}
+
+	APPEND_PATH(path, root, node->_parent);
+
+	if (path->is_empty() || path->char_at(path->len() - 1) != '/') {
+		path->appendc('/');
+	}
+	path->append_raw(node->_name.v(), node->_name.len());
+}
+
+//
+// WATCH_EVENTS contain inotify events that change the list of nodes in
+// directory or their attributes.
+//
+#define WATCH_EVENTS	(IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO \
+			| IN_ATTRIB | IN_CLOSE_WRITE | IN_ONLYDIR \
+			| IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+
+//
+// IS_LOADED will return 1 if `node` is directory and its child has been
+// loaded by `dir`.
+//
+static int IS_LOADED(Dir* dir, DirNode* node)
+{
+	if (! node->is_dir() || ! node->_linkname.is_empty()) {
+		return 0;
+	}
+	if (dir->_lazy && ! node->_visit) {
+		return 0;
+	}
+	return 1;
+}
+
+//
+// LOOKUP will return node with path `rel`, relative to `node`, without
+// loading any directory. It will return NULL if node is not found.
+//
+static DirNode* LOOKUP(DirNode* node, const char* rel)
+{
+	size_t		len	= 0;
+	const char*	end	= NULL;
+	DirNode*	c	= NULL;
+
+	while (*rel) {
+		if (*rel == '/') {
+			rel++;
+			continue;
+		}
+
+		end = strchr(rel, '/');
+		len = end ? size_t(end - rel) : strlen(rel);
+
+		c = node->get_child(rel, len);
+		if (! c) {
+			return NULL;
+		}
+
+		node = c;
+		rel += len;
+	}
+
+	return node;
+}
+
+//
+// WATCH_ADD will watch directory `node` and save its path into watch table
+// of `dir`.
+//
+static int WATCH_ADD(Dir* dir, DirNode* node)
+{
+	int	wd;
+	int	n;
+	void*	p;
+	Buffer	rel;
+	Buffer	path;
+
+	APPEND_PATH(&rel, dir->_ls, node);
+
+	path.copy(&dir->_name);
+	path.append(&rel);
+
+	wd = inotify_add_watch(dir->_ifd, path.v(), WATCH_EVENTS);
+	if (wd < 0) {
+		return -1;
+	}
+
+	if (wd >= dir->_n_watch) {
+		n = wd * 2 + 64;
+		p = realloc(dir->_watch, size_t(n) * sizeof(*dir->_watch));
+		if (! p) {
+			return -1;
+		}
+		dir->_watch = (Buffer**) p;
+		memset(&dir->_watch[dir->_n_watch], 0
+			, size_t(n - dir->_n_watch) * sizeof(*dir->_watch));
+		dir->_n_watch = n;
+	}
+	if (! dir->_watch[wd]) {
+		dir->_watch[wd] = new Buffer();
+		if (! dir->_watch[wd]) {
+			return -1;
+		}
+	}
+	dir->_watch[wd]->copy(&rel);
+
+	return 0;
+}
+
+//
+// WATCH_TREE will watch `node` and all of its sub-directories that has been
+// loaded.
+//
+static int WATCH_TREE(Dir* dir, DirNode* node)
+{
+	if (! IS_LOADED(dir, node)) {
+		return 0;
+	}
+	if (WATCH_ADD(dir, node) < 0) {
+		return -1;
+	}
+	for (node = node->_child; node; node = node->_next) {
+		if (WATCH_TREE(dir, node) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+//
+// WATCH_DEL will stop watching directory with path `rel` and all of its
+// sub-directories.
+//
+static void WATCH_DEL(Dir* dir, Buffer* rel)
+{
+	Buffer* p = NULL;
+
+	for (int wd = 0; wd < dir->_n_watch; wd++) {
+		p = dir->_watch[wd];
+		if (! p || p->len() < rel->len()) {
+			continue;
+		}
+		if (strncmp(p->v(), rel->v(), rel->len()) != 0) {
+			continue;
+		}
+		if (p->len() > rel->len() && p->char_at(rel->len()) != '/') {
+			continue;
+		}
+
+		inotify_rm_watch(dir->_ifd, wd);
+		delete p;
+		dir->_watch[wd] = NULL;
+	}
+}
+
+//
+// WATCH_STOP will stop watching all directories. The inotify descriptor is
+// kept open until Dir is closed, so it can still be polled by caller.
+//
+static void WATCH_STOP(Dir* dir)
+{
+	if (! dir->_watch) {
+		return;
+	}
+	for (int wd = 0; wd < dir->_n_watch; wd++) {
+		if (dir->_watch[wd]) {
+			inotify_rm_watch(dir->_ifd, wd);
+			delete dir->_watch[wd];
+		}
+	}
+	free(dir->_watch);
+	dir->_watch = NULL;
+	dir->_n_watch = 0;
+}
+
+//
+// WATCH_RELOAD will load the tree of `dir` again, after some of the events
+// has been lost.
+//
+static int WATCH_RELOAD(Dir* dir)
+{
+	Buffer rel;
+
+	WATCH_DEL(dir, &rel);
+
+	dir->_ls->child_clear();
+	dir->_n_node = 0;
+
+	if (dir->_lazy) {
+		dir->_ls->_visit = 0;
+		return 1;
+	}
+
+	if (dir->get_list(dir->_ls, dir->_name.v(), dir->_depth) < 0
+	||  WATCH_TREE(dir, dir->_ls) < 0) {
+		WATCH_STOP(dir);
+		return -1;
+	}
+
+	return 1;
+}
+
+//
+// WATCH_SYNC will apply inotify event `ev` to the tree of `dir`. It will
+// return 1 if the tree is changed, 0 if not, or -1 if fail.
+//
+static int WATCH_SYNC(Dir* dir, struct inotify_event* ev)
+{
+	int		s;
+	Buffer*		rel	= NULL;
+	DirNode*	node	= NULL;
+	DirNode*	c	= NULL;
+	Buffer		path;
+
+	if (ev->mask & IN_Q_OVERFLOW) {
+		return WATCH_RELOAD(dir);
+	}
+	if (ev->wd < 0 || ev->wd >= dir->_n_watch) {
+		return 0;
+	}
+
+	rel = dir->_watch[ev->wd];
+	if (! rel) {
+		return 0;
+	}
+	if (ev->mask & IN_IGNORED) {
+		delete rel;
+		dir->_watch[ev->wd] = NULL;
+		return 0;
+	}
+	if (ev->len == 0) {
+		return 0;
+	}
+
+	node = LOOKUP(dir->_ls, rel->v());
+	if (! node || ! IS_LOADED(dir, node)) {
+		return 0;
+	}
+
+	path.copy(&dir->_name);
+	path.append(rel);
+	node->update_attr(node, path.v());
+
+	path.appendc('/');
+	path.append_raw(ev->name);
+
+	if ((ev->mask & IN_MOVED_FROM) && (ev->mask & IN_ISDIR)) {
+		Buffer crel;
+
+		crel.copy(rel);
+		crel.appendc('/');
+		crel.append_raw(ev->name);
+
+		WATCH_DEL(dir, &crel);
+	}
+
+	if (ev->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) {
+		c = node->get_child(ev->name);
+		if (c) {
+			if (dir->_lazy) {
+				UNCOUNT(dir, c->_child);
+				if (dir->_n_node) {
+					dir->_n_node--;
+				}
+			}
+			DirNode::UNLINK(&node->_child, c);
+			delete c;
+			c = NULL;
+		}
+		if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+			return 1;
+		}
+	}
+
+	s = node->update_child_attr(&c, path.v(), ev->name);
+	if (s >= 0) {
+		return 1;
+	}
+	if (s == -2) {
+		return 0;
+	}
+
+	s = DirNode::INIT(&c, path.v(), ev->name);
+	if (s < 0) {
+		if (c) {
+			delete c;
+		}
+		return 0;
+	}
+
+	c->_parent = node;
+	DirNode::INSERT(&node->_child, c);
+
+	if (dir->_lazy) {
+		dir->_n_node++;
+		return 1;
+	}
+
+	if (c->is_dir() && c->_linkname.is_empty()) {
+		if (dir->get_list(c, path.v()) < 0
+		||  WATCH_TREE(dir, c) < 0) {
+			WATCH_STOP(dir);
+			return -1;
+		}
+	}
+
+	return 1;
+}
+
 Dir::Dir()
 :	Object()
 ,	_depth(0)
 ,	_name()
 ,	_ls(NULL)
+,	_n_thread(N_THREAD)
+,	_lazy(0)
+,	_stat_child(0)
+,	_max_node(0)
+,	_n_node(0)
+,	_n_visit(0)
+,	_ifd(-1)
+,	_n_watch(0)
+,	_watch(NULL)
 {}
 
 Dir::~Dir()
 {
+	WATCH_STOP(this);
+	if (_ifd >= 0) {
+		::close(_ifd);
+		_ifd = -1;
+	}
 	if (_ls) {
 		delete _ls;
 		_ls = NULL;
@@ -60,6 +841,13 @@ int Dir::open(const char *path, int depth)
 		return -1;
 	}
 
+	_n_node		= 0;
+	_n_visit	= 0;
+
+	if (_lazy) {
+		return 0;
+	}
+
 	/* 1st pass: scan normal directory or any symlink of directory that
 	 * does not have the same root path */
 	s = get_list(_ls, rpath, depth);
@@ -86,7 +874,15 @@ int Dir::open(const char *path, int depth)
  */
 void Dir::close()
 {
-	_depth = 0;
+	WATCH_STOP(this);
+	if (_ifd >= 0) {
+		::close(_ifd);
+		_ifd = -1;
+	}
+
+	_depth		= 0;
+	_n_node		= 0;
+	_n_visit	= 0;
 	_name.reset();
 	if (_ls) {
 		delete _ls;
@@ -113,6 +909,9 @@ DirNode* Dir::find(DirNode* dir, const char* name, int depth)
 	if (depth == 0) {
 		return NULL;
 	}
+	if (depth == 1) {
+		return dir->get_child(name);
+	}
 
 	if (LIBVOS_DEBUG) {
 		printf("[%s] find: scanning directory '%s'\n", __cname
@@ -170,7 +969,7 @@ int Dir::get_parent_path(Buffer *path, DirNode *ls, int depth)
 	}
 
 	if (ls && ls->_name.cmp_raw("/") != 0) {
-		path->append(&ls->_name);
+		path->append_raw(ls->_name.v(), ls->_name.len());
 
 		if (ls->is_dir() && path->char_at(path->len() - 1) != '/') {
 			path->appendc('/');
@@ -189,14 +988,20 @@ int Dir::get_parent_path(Buffer *path, DirNode *ls, int depth)
  *	< >=0	: success, number of child in this node.
  *	< -1	: fail.
  * @desc	: get list of all files in directory.
+ *
+ *	Directory 'path' is read by the caller, while its sub-directories are
+ *	read by '_n_thread' threads, relative to the file descriptor of their
+ *	parent directory.
  */
 int Dir::get_list(DirNode* list, const char* path, int depth)
 {
-	int		n	= 0;
-	Buffer		rpath;
-	DIR*		dir	= NULL;
-	struct dirent*	dent	= NULL;
-	DirNode*	node	= NULL;
+	int			s;
+	int			x;
+	int			n_thread	= _n_thread;
+	int			n_started	= 0;
+	dir_scan		scan;
+	struct dir_scan_job	job;
+	Thread**		threads		= NULL;
 
 	if (depth == 0) {
 		return 0;
@@ -206,75 +1011,71 @@ int Dir::get_list(DirNode* list, const char* path, int depth)
 		printf("[%s] get_list: scanning '%s' ...\n", __cname, path);
 	}
 
-	dir = opendir(path);
-	if (!dir) {
+	job.fd = ::open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (job.fd < 0) {
 		if (errno == EACCES) {
 			return 0;
 		}
 		return -1;
 	}
+	job.node	= list;
+	job.depth	= depth;
+	job.path.copy_raw(path);
 
-	do {
-		dent = readdir(dir);
-		if (!dent) {
-			break;
-		}
+	scan.root	= _name.v();
+	scan.root_len	= _name.len();
+	scan.n_busy	= 1;
 
-		int s = strcmp(dent->d_name, ".");
-		if (s == 0) {
-			continue;
-		}
-		s = strcmp(dent->d_name, "..");
-		if (s == 0) {
-			continue;
+	if (n_thread > 1 && depth != 1) {
+		threads = (Thread**) calloc(size_t(n_thread), sizeof(*threads));
+	}
+	if (threads) {
+		for (; n_started < n_thread; n_started++) {
+			threads[n_started] = new Thread(&SCAN_WORKER);
+			if (! threads[n_started]) {
+				break;
+			}
+			if (threads[n_started]->start(&scan) != 0) {
+				delete threads[n_started];
+				threads[n_started] = NULL;
+				break;
+			}
 		}
-		if (LIBVOS_DEBUG) {
-			printf("[%s] get_list: checking '%s'\n", __cname
-				, dent->d_name);
+		if (n_started > 0) {
+			scan.max_fd = MAX_FD;
 		}
+	}
 
-		rpath.reset();
-		rpath.append_raw(path);
-
-		if (rpath.char_at(rpath.len() - 1) != '/') {
-			rpath.appendc('/');
-		}
+	s = SCAN_DIR(&scan, &job);
 
-		rpath.append_raw(dent->d_name);
+	scan.lock();
+	scan.n_busy--;
+	if (s < 0) {
+		scan.fail();
+	} else if (! scan.head && scan.n_busy == 0) {
+		scan.notify();
+	}
+	scan.unlock();
 
-		s = DirNode::INIT(&node, rpath.v(), dent->d_name);
-		if (s < 0) {
-			break;
-		}
+	// Directories in queue that should be scanned by threads that can
+	// not be started are scanned by the caller.
+	if (n_started > 0 && n_started < n_thread) {
+		SCAN_WORKER(&scan);
+	}
 
-		if (node->is_dir()) {
-			if (node->_linkname.is_empty()) {
-				s = get_list(node, rpath.v(), depth - 1);
-				if (s < 0) {
-					return s;
-				}
-			} else {
-				s = strncmp(node->_linkname.v(), _name.v()
-						, _name.len());
-				if (s != 0) {
-					s = get_list(node, node->_linkname.v()
-						, depth - 1);
-					if (s < 0) {
-						return s;
-					}
-				}
-			}
+	if (threads) {
+		for (x = 0; x < n_started; x++) {
+			threads[x]->join();
+			delete threads[x];
 		}
+		free(threads);
+	}
 
-		node->_parent = list;
-		DirNode::INSERT(&list->_child, node);
-		node = NULL;
-		n++;
-	} while (dent);
-
-	closedir(dir);
+	if (scan.stop) {
+		return -1;
+	}
 
-	return n;
+	return s;
 }
 
 /**
@@ -303,7 +1104,12 @@ int Dir::get_symlink(DirNode *list)
 		} else if (list->_linkname.is_empty()) {
 			continue;
 		} else {
-			list->_link = get_node(&list->_linkname, _name.v()
+			Buffer linkname;
+
+			linkname.copy_raw(list->_linkname.v()
+					, list->_linkname.len());
+
+			list->_link = get_node(&linkname, _name.v()
 						, _name.len());
 			if (!list->_link) {
 				fprintf(stderr
@@ -384,14 +1190,13 @@ DirNode* Dir::get_node(Buffer* path, const char* root, size_t root_len)
 			p = p->_parent;
 			continue;
 		}
-		for (c = p->_child; c; c = c->_next) {
-			if (node.cmp(&c->_name) == 0) {
-				node.reset();
-				p = c;
-				break;
-			}
+		if (_lazy && load(p) < 0) {
+			return NULL;
 		}
-		if (node.is_empty()) {
+		c = p->get_child(node.v(), node.len());
+		if (c) {
+			node.reset();
+			p = c;
 			continue;
 		}
 
@@ -404,6 +1209,10 @@ DirNode* Dir::get_node(Buffer* path, const char* root, size_t root_len)
 		return NULL;
 	}
 
+	if (_lazy && load(p) < 0) {
+		return NULL;
+	}
+
 	return p;
 }
 
@@ -412,17 +1221,24 @@ DirNode* Dir::get_node(Buffer* path, const char* root, size_t root_len)
  * @param	:
  *	> path	: path to be refreshed, path must in the same root.
  * @return	:
- *	< >0	: number of change (new node, mod node) in the path.
+ *	< >0	: number of change (new, modified, or deleted node) in the
+ *		  path.
  *	< -1	: fail, path is not in the same root.
  *	< -2	: fail, system error.
  * @desc	:
  *	check for a new, deleted or modified node in the 'path'.
  *	Use '_name' path if 'path' value is NULL.
+ *
+ *	If directory itself is not modified, its child is not read again.
+ *	Modifying a file does not change its directory, so if '_stat_child'
+ *	is set only the attributes of its child is updated, with one stat for
+ *	each child.
  */
 int Dir::refresh_by_path(Buffer* path)
 {
 	int		n = 0;
 	int		s;
+	size_t		n_new	= 0;
 	Buffer		rpath;
 	DIR*		dir	= NULL;
 	struct dirent*	dent	= NULL;
@@ -461,9 +1277,19 @@ int Dir::refresh_by_path(Buffer* path)
 	}
 
 	s = list->update_attr(list, rpath.v());
-	if (s <= 0 || !list->is_dir()) {
+	if (s < 0 || !list->is_dir()) {
 		return s;
 	}
+	if (s == 0) {
+		if (! _stat_child) {
+			return 0;
+		}
+		n = REFRESH_CHILD(list, &rpath);
+		if (n >= 0) {
+			return n;
+		}
+		n = 0;
+	}
 
 	dir = opendir(rpath.v());
 	if (!dir) {
@@ -519,7 +1345,7 @@ int Dir::refresh_by_path(Buffer* path)
 				break;
 			}
 
-			if (cnode->is_dir()) {
+			if (cnode->is_dir() && ! _lazy) {
 				if (cnode->_linkname.is_empty()) {
 					s = get_list(cnode, rpath.v());
 					if (s < 0) {
@@ -541,7 +1367,11 @@ int Dir::refresh_by_path(Buffer* path)
 
 			cnode->_parent = list;
 			DirNode::INSERT(&childs, cnode);
+			if (is_watching() && WATCH_TREE(this, cnode) < 0) {
+				WATCH_STOP(this);
+			}
 			cnode = NULL;
+			n_new++;
 			n++;
 		} else if (s == -2) {
 			return s;
@@ -553,9 +1383,30 @@ int Dir::refresh_by_path(Buffer* path)
 		if (LIBVOS_DEBUG) {
 			list->_child->dump();
 		}
-		delete list->_child;
+		for (cnode = list->_child; cnode; cnode = cnode->_next) {
+			n++;
+		}
+		if (_lazy) {
+			UNCOUNT(this, list->_child);
+		}
+		if (is_watching()) {
+			for (cnode = list->_child; cnode; cnode = cnode->_next) {
+				if (! cnode->is_dir()) {
+					continue;
+				}
+				rpath.reset();
+				APPEND_PATH(&rpath, _ls, cnode);
+				WATCH_DEL(this, &rpath);
+			}
+		}
+		list->child_clear();
+	}
+	// The index is emptied when child is moved to `childs`.
+	list->set_child(childs);
+
+	if (_lazy) {
+		_n_node += n_new;
 	}
-	list->_child = childs;
 
 	closedir(dir);
 
@@ -567,6 +1418,189 @@ int Dir::refresh_by_path(Buffer* path)
 	return n;
 }
 
+/**
+ * Method load(node) will scan the child of directory `node`, if it has not
+ * been loaded, and set the visit time of `node`. It should be used only in
+ * lazy mode.
+ *
+ * It will return 0 on success, or -1 if directory can not be read.
+ */
+int Dir::load(DirNode* node)
+{
+	int	s;
+	Buffer	path;
+
+	if (! node->is_dir()) {
+		return 0;
+	}
+	if (node->_visit) {
+		node->_visit = ++_n_visit;
+		return 0;
+	}
+
+	if (node->_linkname.is_empty()) {
+		path.copy(&_name);
+		APPEND_PATH(&path, _ls, node);
+	} else {
+		path.copy_raw(node->_linkname.v(), node->_linkname.len());
+	}
+
+	if (LIBVOS_DEBUG) {
+		printf("[%s] load: '%s'\n", __cname, path.chars());
+	}
+
+	if (node->_child) {
+		UNCOUNT(this, node->_child);
+		node->child_clear();
+	}
+
+	s = get_list(node, path.v(), 1);
+	if (s < 0) {
+		return -1;
+	}
+
+	node->_visit	= ++_n_visit;
+	_n_node		+= size_t(s);
+
+	if (is_watching() && WATCH_ADD(this, node) < 0) {
+		WATCH_STOP(this);
+	}
+
+	return 0;
+}
+
+/**
+ * Method evict will remove the child of directory that has not been visited
+ * for the longest time, until the number of loaded nodes is not greater than
+ * `_max_node`. The root directory is never evicted.
+ *
+ * Any pointer to evicted node became invalid, so caller should not keep
+ * pointer to node after calling this method.
+ */
+void Dir::evict()
+{
+	DirNode* idle = NULL;
+
+	if (! _lazy || ! _ls || _max_node == 0) {
+		return;
+	}
+
+	while (_n_node > _max_node) {
+		idle = NULL;
+		FIND_IDLE(_ls->_child, &idle);
+		if (! idle) {
+			break;
+		}
+
+		if (LIBVOS_DEBUG) {
+			printf("[%s] evict: '%s'\n", __cname
+				, idle->_name.chars());
+		}
+
+		if (is_watching()) {
+			Buffer rel;
+
+			APPEND_PATH(&rel, _ls, idle);
+			WATCH_DEL(this, &rel);
+		}
+		if (idle->_child) {
+			UNCOUNT(this, idle->_child);
+			idle->child_clear();
+		}
+		idle->_visit = 0;
+	}
+}
+
+/**
+ * Method watch will start watching all loaded directories for changes. The
+ * change is applied to the tree when sync() is called, which should be
+ * called when `_ifd` is readable.
+ *
+ * It will return 0 on success, or -1 if directory can not be watched.
+ */
+int Dir::watch()
+{
+	if (! _ls) {
+		return -1;
+	}
+	if (is_watching()) {
+		return 0;
+	}
+	if (_ifd < 0) {
+		_ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (_ifd < 0) {
+			return -1;
+		}
+	}
+
+	_watch = (Buffer**) calloc(64, sizeof(*_watch));
+	if (! _watch) {
+		return -1;
+	}
+	_n_watch = 64;
+
+	if (WATCH_TREE(this, _ls) < 0) {
+		WATCH_STOP(this);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Method sync will read all pending events from `_ifd` and apply them to
+ * the tree. If directory can not be watched anymore, watching is stopped
+ * and caller should use refresh_by_path() to get the changes.
+ *
+ * It will return number of changes applied to the tree, or -1 if fail.
+ */
+int Dir::sync()
+{
+	int			n	= 0;
+	int			s;
+	ssize_t			len;
+	char*			p	= NULL;
+	struct inotify_event*	ev	= NULL;
+	char			buf[4096]
+		__attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	if (_ifd < 0) {
+		return 0;
+	}
+
+	for (;;) {
+		len = read(_ifd, buf, sizeof(buf));
+		if (len <= 0) {
+			if (len < 0 && errno != EAGAIN && errno != EINTR) {
+				return -1;
+			}
+			break;
+		}
+
+		for (p = buf; p < buf + len
+		; p += sizeof(struct inotify_event) + ev->len) {
+			ev = (struct inotify_event*) p;
+
+			if (! is_watching()) {
+				continue;
+			}
+
+			s = WATCH_SYNC(this, ev);
+			if (s < 0) {
+				return -1;
+			}
+			n += s;
+		}
+	}
+
+	if (LIBVOS_DEBUG) {
+		printf("[%s] sync: numbers of node changed '%d'\n", __cname
+			, n);
+	}
+
+	return n;
+}
+
 /**
  * @method	: Dir::dump
  * @desc	: dump content of Dir object.
@@ -8,6 +8,7 @@
 #define _LIBVOS_DIR_HH 1
 
 #include <dirent.h>
+#include <sys/inotify.h>
 #include "DirNode.hh"
 
 namespace vos {
@@ -20,9 +21,40 @@ namespace vos {
  *	- _depth	: maximum depth of child directory to scan.
  *	- _name		: the first name of directory to scan.
  *	- _ls		: linked list of DirNode objects.
+ *	- _n_thread	: number of threads used to scan directory, default to
+ *			  N_THREAD.
+ *	- _lazy		: if set to 1 before open(), the child of directory is
+ *			  loaded only when directory is visited by get_node().
+ *	- _stat_child	: if set to 1, refresh_by_path() also update the
+ *			  attributes of each child when directory itself is
+ *			  not modified, so change on file content is seen.
+ *			  Default to 0, which only check the directory.
+ *	- _max_node	: maximum number of nodes loaded in lazy mode, before
+ *			  the idle directory is evicted by evict(). Zero
+ *			  means no limit.
+ *	- _n_node	: number of nodes loaded in lazy mode.
+ *	- _n_visit	: counter for visit time of directory in lazy mode.
+ *	- _ifd		: inotify file descriptor, set by watch().
+ *	- _n_watch	: size of '_watch'.
+ *	- _watch	: path of watched directory, relative to '_name' and
+ *			  indexed by their watch descriptor. It is NULL if
+ *			  directory is not watched.
  * @desc		:
  * a module for handling task involving directory (listing,
  * creating, and removing directory).
+ *
+ * Directory tree is scanned by '_n_thread' threads in parallel, where each
+ * sub-directory is read and its nodes is allocated by one thread only, and
+ * the child nodes are sorted by name, so the result is always the same no
+ * matter which thread read them.
+ *
+ * In lazy mode, open() only read the root directory, and the memory used by
+ * nodes follow the directories that is visited. Evicted directory is loaded
+ * again when it is visited.
+ *
+ * After watch(), each loaded directory is watched with inotify, and the
+ * change in directory is applied to the tree by sync(), so the tree does
+ * not need to be refreshed by reading the directory again.
  */
 class Dir : public Object {
 public:
@@ -40,14 +72,36 @@ public:
 	DirNode* get_node(Buffer* path, const char* root, size_t root_len);
 
 	int refresh_by_path(Buffer* path);
+	int load(DirNode* node);
+	void evict();
+
+	int watch();
+	int sync();
+
+	inline int is_watching()
+	{
+		return _watch != NULL;
+	}
 	void dump();
 
+	static int N_THREAD;
+	static int MAX_FD;
+
 	static int CREATE(const char *path, mode_t perm = DEF_DIR_PERM);
 	static int CREATES(const char* path, mode_t perm = DEF_DIR_PERM);
 
 	int		_depth;
 	Buffer		_name;
 	DirNode*	_ls;
+	int		_n_thread;
+	int		_lazy;
+	int		_stat_child;
+	size_t		_max_node;
+	size_t		_n_node;
+	uint64_t	_n_visit;
+	int		_ifd;
+	int		_n_watch;
+	Buffer**	_watch;
 
 	static const char* __cname;
 private:
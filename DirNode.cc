@@ -4,17 +4,591 @@
 // found in the LICENSE file.
 //
 
+#include <fcntl.h>
+#include <strings.h>
 #include "DirNode.hh"
 
 namespace vos {
 
 const char* DirNode::__cname = "DirNode";
 
+//
+// Variable IDX_MIN contain minimum number of child nodes in directory before
+// they are indexed.
+//
+size_t DirNode::IDX_MIN = 32;
+
+#define MEM_ALIGN		8
+#define MEM_N_CLASS		32
+#define MEM_BLOCK		(256 * 1024)
+#define MEM_N_SHARD		8
+#define NAMES_SHARD_BITS	3
+#define NAMES_N_SHARD		(1 << NAMES_SHARD_BITS)
+
+//
+// dir_mem_free link the released memory in the same size class.
+//
+struct dir_mem_free {
+	struct dir_mem_free* next;
+};
+
+//
+// dir_mem contain the memory for nodes and names. Memory is taken from
+// blocks of MEM_BLOCK bytes, in size class of MEM_ALIGN bytes, and the
+// released memory is kept in the free list of its class to be reused. Memory
+// larger than the biggest class is allocated by malloc.
+//
+// There are MEM_N_SHARD of them, each with its own lock, and thread use the
+// one selected by its id, so threads that scan directory do not wait for
+// each other. Blocks are never released, so memory can be released into
+// any of them.
+//
+// Field `cur` contain the unused memory in current block.
+// Field `left` contain the size of `cur`.
+// Field `free` contain the free list of each size class.
+//
+struct dir_mem {
+	pthread_mutex_t		lock;
+	char*			cur;
+	size_t			left;
+	struct dir_mem_free*	free[MEM_N_CLASS];
+};
+
+//
+// dir_name contain the interned name, shared by all DirName with the same
+// value.
+//
+// Field `ref` contain number of DirName that use this name.
+// Field `len` contain length of name, without the terminating NUL.
+// Field `v` contain the name.
+//
+struct dir_name {
+	uint32_t	ref;
+	uint32_t	len;
+	char		v[1];
+};
+
+//
+// dir_names contain hash table of interned names, using linear probing.
+// Names are divided into NAMES_N_SHARD tables, each with its own lock, by
+// the highest bits of their hash.
+//
+// Field `size` contain number of slots, always power of two.
+// Field `n` contain number of names in table.
+//
+struct dir_names {
+	pthread_mutex_t		lock;
+	size_t			size;
+	size_t			n;
+	struct dir_name**	slot;
+};
+
+//
+// dir_node_idx contain hash table of child nodes, using linear probing.
+//
+// Field `size` contain number of slots, always power of two.
+// Field `n` contain number of nodes in table.
+//
+struct dir_node_idx {
+	size_t		size;
+	size_t		n;
+	DirNode**	slot;
+};
+
+#define MEM_INIT	{ PTHREAD_MUTEX_INITIALIZER, NULL, 0, {} }
+#define NAMES_INIT	{ PTHREAD_MUTEX_INITIALIZER, 0, 0, NULL }
+
+static struct dir_mem	_mem_[MEM_N_SHARD]	= {
+	MEM_INIT, MEM_INIT, MEM_INIT, MEM_INIT
+,	MEM_INIT, MEM_INIT, MEM_INIT, MEM_INIT
+};
+static struct dir_names	_names_[NAMES_N_SHARD]	= {
+	NAMES_INIT, NAMES_INIT, NAMES_INIT, NAMES_INIT
+,	NAMES_INIT, NAMES_INIT, NAMES_INIT, NAMES_INIT
+};
+
+//
+// MEM_SHARD will return memory shard of the calling thread.
+//
+static struct dir_mem* MEM_SHARD()
+{
+	pthread_t t = pthread_self();
+
+	return &_mem_[FNV1A_32((const char*) &t, sizeof(t)) & (MEM_N_SHARD - 1)];
+}
+
+//
+// MEM_ALLOC will return memory with at least `size` bytes, or NULL if no
+// memory left.
+//
+static void* MEM_ALLOC(size_t size)
+{
+	size_t		c;
+	void*		p	= NULL;
+	struct dir_mem*	mem	= NULL;
+
+	size = (size + MEM_ALIGN - 1) & ~size_t(MEM_ALIGN - 1);
+	c = size / MEM_ALIGN - 1;
+
+	if (c >= MEM_N_CLASS) {
+		return malloc(size);
+	}
+
+	mem = MEM_SHARD();
+	pthread_mutex_lock(&mem->lock);
+
+	if (mem->free[c]) {
+		p = mem->free[c];
+		mem->free[c] = mem->free[c]->next;
+	} else {
+		if (mem->left < size) {
+			mem->cur = (char*) malloc(MEM_BLOCK);
+			mem->left = mem->cur ? MEM_BLOCK : 0;
+		}
+		if (mem->cur) {
+			p = mem->cur;
+			mem->cur += size;
+			mem->left -= size;
+		}
+	}
+
+	pthread_mutex_unlock(&mem->lock);
+
+	return p;
+}
+
+//
+// MEM_FREE will release memory `p` with `size` bytes, that is allocated by
+// MEM_ALLOC.
+//
+static void MEM_FREE(void* p, size_t size)
+{
+	size_t c;
+	struct dir_mem_free* f = (struct dir_mem_free*) p;
+	struct dir_mem* mem = NULL;
+
+	if (! p) {
+		return;
+	}
+
+	size = (size + MEM_ALIGN - 1) & ~size_t(MEM_ALIGN - 1);
+	c = size / MEM_ALIGN - 1;
+
+	if (c >= MEM_N_CLASS) {
+		free(p);
+		return;
+	}
+
+	mem = MEM_SHARD();
+	pthread_mutex_lock(&mem->lock);
+	f->next = mem->free[c];
+	mem->free[c] = f;
+	pthread_mutex_unlock(&mem->lock);
+}
+
+//
+// NAME_SIZE will return size of memory for name with length `len`.
+//
+static size_t NAME_SIZE(size_t len)
+{
+	return offsetof(struct dir_name, v) + len + 1;
+}
+
+//
+// NAMES_SHARD will return table of interned names for hash `h`.
+//
+static struct dir_names* NAMES_SHARD(uint32_t h)
+{
+	return &_names_[h >> (32 - NAMES_SHARD_BITS)];
+}
+
+//
+// NAMES_GROW will double the slots of interned names in table `t`. Caller
+// must hold the lock of `t`.
+//
+static int NAMES_GROW(struct dir_names* t)
+{
+	size_t			size	= t->size ? t->size * 2 : 1024;
+	size_t			h	= 0;
+	struct dir_name**	slot	= NULL;
+
+	slot = (struct dir_name**) calloc(size, sizeof(*slot));
+	if (! slot) {
+		return -1;
+	}
+
+	for (size_t x = 0; x < t->size; x++) {
+		struct dir_name* name = t->slot[x];
+
+		if (! name) {
+			continue;
+		}
+		h = FNV1A_32(name->v, name->len) & (size - 1);
+		while (slot[h]) {
+			h = (h + 1) & (size - 1);
+		}
+		slot[h] = name;
+	}
+
+	free(t->slot);
+	t->slot = slot;
+	t->size = size;
+
+	return 0;
+}
+
+//
+// NAME_GET will return interned name with value `v`, with its reference
+// increased by one, or NULL if no memory left.
+//
+static struct dir_name* NAME_GET(const char* v, size_t len)
+{
+	uint32_t		hash	= FNV1A_32(v, len);
+	size_t			h	= 0;
+	struct dir_name*	name	= NULL;
+	struct dir_names*	t	= NAMES_SHARD(hash);
+
+	pthread_mutex_lock(&t->lock);
+
+	if ((t->n + 1) * 2 > t->size && NAMES_GROW(t) < 0) {
+		goto out;
+	}
+
+	h = hash & (t->size - 1);
+
+	for (; t->slot[h]; h = (h + 1) & (t->size - 1)) {
+		name = t->slot[h];
+		if (name->len == len && memcmp(name->v, v, len) == 0) {
+			name->ref++;
+			goto out;
+		}
+	}
+
+	name = (struct dir_name*) MEM_ALLOC(NAME_SIZE(len));
+	if (name) {
+		name->ref = 1;
+		name->len = uint32_t(len);
+		memcpy(name->v, v, len);
+		name->v[len] = '\0';
+
+		t->slot[h] = name;
+		t->n++;
+	}
+out:
+	pthread_mutex_unlock(&t->lock);
+
+	return name;
+}
+
+//
+// NAME_PUT will decrease the reference of interned `name`, and release it
+// when no one use it.
+//
+static void NAME_PUT(struct dir_name* name)
+{
+	size_t i;
+	size_t j;
+	size_t k;
+	size_t mask;
+	uint32_t hash = FNV1A_32(name->v, name->len);
+	struct dir_names* t = NAMES_SHARD(hash);
+
+	pthread_mutex_lock(&t->lock);
+
+	if (--name->ref > 0) {
+		pthread_mutex_unlock(&t->lock);
+		return;
+	}
+
+	mask = t->size - 1;
+	i = hash & mask;
+	while (t->slot[i] != name) {
+		i = (i + 1) & mask;
+	}
+
+	// Move the next names in the same probe sequence back, so there is
+	// no hole between their hash slot and their current slot.
+	for (j = (i + 1) & mask; t->slot[j]; j = (j + 1) & mask) {
+		k = FNV1A_32(t->slot[j]->v, t->slot[j]->len) & mask;
+		if (((j - k) & mask) >= ((j - i) & mask)) {
+			t->slot[i] = t->slot[j];
+			i = j;
+		}
+	}
+	t->slot[i] = NULL;
+	t->n--;
+
+	pthread_mutex_unlock(&t->lock);
+
+	MEM_FREE(name, NAME_SIZE(name->len));
+}
+
+DirName::DirName()
+:	_p(NULL)
+{}
+
+DirName::~DirName()
+{
+	reset();
+}
+
+/**
+ * Method v will return the name, or empty string if name is empty.
+ */
+const char* DirName::v() const
+{
+	return _p ? _p->v : "";
+}
+
+/**
+ * Method chars will return the name, or empty string if name is empty.
+ */
+const char* DirName::chars() const
+{
+	return v();
+}
+
+/**
+ * Method len will return length of name.
+ */
+size_t DirName::len() const
+{
+	return _p ? _p->len : 0;
+}
+
+/**
+ * Method is_empty will return 1 if name is empty, or 0 otherwise.
+ */
+int DirName::is_empty() const
+{
+	return _p == NULL;
+}
+
+/**
+ * Method copy(bfr) will set the name to content of `bfr`.
+ *
+ * On success it will return NULL, otherwise it will return error.
+ */
+Error DirName::copy(const Buffer* bfr)
+{
+	return copy_raw(bfr->v(), bfr->len());
+}
+
+/**
+ * Method copy_raw(v,len) will set the name to `v` with length `len`. If
+ * `len` is zero, the length of `v` is computed with strlen.
+ *
+ * On success it will return NULL, otherwise it will return error and the
+ * name is not changed.
+ */
+Error DirName::copy_raw(const char* v, size_t len)
+{
+	struct dir_name* p = NULL;
+
+	if (len == 0 && v) {
+		len = strlen(v);
+	}
+	if (len > 0) {
+		p = NAME_GET(v, len);
+		if (! p) {
+			return ErrOutOfMemory;
+		}
+	}
+	reset();
+	_p = p;
+
+	return NULL;
+}
+
+/**
+ * Method reset will set the name to empty.
+ */
+void DirName::reset()
+{
+	if (_p) {
+		NAME_PUT(_p);
+		_p = NULL;
+	}
+}
+
+/**
+ * Method cmp(name) will compare the name with another `name`, and return
+ * -1, 0, or 1, if the name is less, equal, or greater than `name`.
+ */
+int DirName::cmp(const DirName* name) const
+{
+	if (_p == name->_p) {
+		return 0;
+	}
+	return cmp_raw(name->v(), name->len());
+}
+
+/**
+ * Method cmp_raw(v,len) will compare the name with `v` and return -1, 0, or
+ * 1, if the name is less, equal, or greater than `v`.
+ */
+int DirName::cmp_raw(const char* v, size_t len) const
+{
+	if (len == 0) {
+		len = strlen(v);
+	}
+
+	int s = strncmp(this->v(), v, len);
+	if (s < 0) {
+		return -1;
+	}
+	if (s > 0) {
+		return 1;
+	}
+	if (this->len() > len) {
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Method like(name) will compare the name with another `name`, ignoring
+ * the case, and return -1, 0, or 1, if the name is less, equal, or greater
+ * than `name`.
+ */
+int DirName::like(const DirName* name) const
+{
+	if (_p == name->_p) {
+		return 0;
+	}
+
+	int s = strncasecmp(v(), name->v(), name->len());
+	if (s < 0) {
+		return -1;
+	}
+	if (s > 0) {
+		return 1;
+	}
+	if (len() > name->len()) {
+		return 1;
+	}
+	return 0;
+}
+
+//
+// IDX_FREE will remove the index of child nodes in `dir`.
+//
+static void IDX_FREE(DirNode* dir)
+{
+	if (! dir->_idx) {
+		return;
+	}
+	free(dir->_idx->slot);
+	free(dir->_idx);
+	dir->_idx = NULL;
+}
+
+//
+// IDX_PUT will add `node` into index of `dir`, without resizing the index.
+//
+static void IDX_PUT(DirNode* dir, DirNode* node)
+{
+	struct dir_node_idx* idx = dir->_idx;
+	size_t mask = idx->size - 1;
+	size_t h = FNV1A_32(node->_name.v(), node->_name.len()) & mask;
+
+	while (idx->slot[h]) {
+		h = (h + 1) & mask;
+	}
+	idx->slot[h] = node;
+	idx->n++;
+}
+
+//
+// IDX_BUILD will create index for all child nodes of `dir`, with number of
+// slots at least twice of `n` or twice of the number of child nodes.
+//
+static int IDX_BUILD(DirNode* dir, size_t n)
+{
+	size_t		size	= 64;
+	size_t		n_child	= 0;
+	DirNode*	c	= NULL;
+
+	IDX_FREE(dir);
+
+	for (c = dir->_child; c; c = c->_next) {
+		n_child++;
+	}
+	if (n < n_child) {
+		n = n_child;
+	}
+	while (size < n * 2) {
+		size <<= 1;
+	}
+
+	dir->_idx = (struct dir_node_idx*) calloc(1, sizeof(*dir->_idx));
+	if (! dir->_idx) {
+		return -1;
+	}
+	dir->_idx->slot = (DirNode**) calloc(size, sizeof(DirNode*));
+	if (! dir->_idx->slot) {
+		IDX_FREE(dir);
+		return -1;
+	}
+	dir->_idx->size = size;
+
+	for (c = dir->_child; c; c = c->_next) {
+		IDX_PUT(dir, c);
+	}
+
+	return 0;
+}
+
+//
+// IDX_ADD will add `node`, that is not yet linked as child of `dir`, into
+// index of `dir`, and double the number of slots if the index is half full.
+//
+static void IDX_ADD(DirNode* dir, DirNode* node)
+{
+	if ((dir->_idx->n + 1) * 2 > dir->_idx->size) {
+		if (IDX_BUILD(dir, dir->_idx->size) < 0) {
+			return;
+		}
+	}
+	IDX_PUT(dir, node);
+}
+
+//
+// IDX_DEL will remove `node` from index of `dir`.
+//
+static void IDX_DEL(DirNode* dir, DirNode* node)
+{
+	struct dir_node_idx*	idx	= dir->_idx;
+	size_t			mask	= idx->size - 1;
+	size_t			i;
+	size_t			j;
+	size_t			k;
+
+	i = FNV1A_32(node->_name.v(), node->_name.len()) & mask;
+	for (; idx->slot[i] != node; i = (i + 1) & mask) {
+		if (! idx->slot[i]) {
+			return;
+		}
+	}
+
+	for (j = (i + 1) & mask; idx->slot[j]; j = (j + 1) & mask) {
+		k = FNV1A_32(idx->slot[j]->_name.v(), idx->slot[j]->_name.len())
+			& mask;
+		if (((j - k) & mask) >= ((j - i) & mask)) {
+			idx->slot[i] = idx->slot[j];
+			i = j;
+		}
+	}
+	idx->slot[i] = NULL;
+	idx->n--;
+}
+
 DirNode::DirNode()
 :	Object()
 ,	_mode(0)
 ,	_uid(0)
 ,	_gid(0)
+,	_visit(0)
 ,	_size(0)
 ,	_mtime(0)
 ,	_ctime(0)
@@ -25,10 +599,12 @@ DirNode::DirNode()
 ,	_child(NULL)
 ,	_link(NULL)
 ,	_parent(this)
+,	_idx(NULL)
 {}
 
 DirNode::~DirNode()
 {
+	IDX_FREE(this);
 	if (_next) {
 		delete _next;
 		_next = NULL;
@@ -42,6 +618,24 @@ DirNode::~DirNode()
 	_parent	= NULL;
 }
 
+/**
+ * Method operator new will allocate memory for node from blocks of memory
+ * shared by all nodes. It will return NULL if no memory left.
+ */
+void* DirNode::operator new(size_t size) throw()
+{
+	return MEM_ALLOC(size);
+}
+
+/**
+ * Method operator delete will release memory of node, to be reused by the
+ * next new node.
+ */
+void DirNode::operator delete(void* p, size_t size)
+{
+	MEM_FREE(p, size);
+}
+
 /**
  * @method		: DirNode::get_attr
  * @param		:
@@ -74,10 +668,13 @@ int DirNode::get_attr(const char* rpath, const char* name)
 	_mode = st.st_mode;
 
 	if (S_ISLNK(st.st_mode)) {
-		s = GET_LINK_NAME(&_linkname, rpath);
+		Buffer linkname;
+
+		s = GET_LINK_NAME(&linkname, rpath);
 		if (s < 0) {
 			return -1;
 		}
+		_linkname.copy(&linkname);
 
 		memset(&st, 0, sizeof(struct stat));
 
@@ -96,6 +693,132 @@ int DirNode::get_attr(const char* rpath, const char* name)
 	return 0;
 }
 
+/**
+ * @method		: DirNode::get_attr_at
+ * @param		:
+ *	> dir_fd	: file descriptor of opened directory.
+ *	> dir_path	: path of directory 'dir_fd'.
+ *	> name		: the name of node inside directory 'dir_fd'.
+ * @return		:
+ *	< 0		: success.
+ *	< -1		: fail.
+ * @desc		:
+ *	get attribute of 'name' relative to directory 'dir_fd', without
+ *	building the full path of node. The full path is only created when
+ *	node is a symbolic link, to get the real path of link.
+ */
+int DirNode::get_attr_at(int dir_fd, const char* dir_path, const char* name)
+{
+	struct stat st;
+
+	_name.copy_raw(name);
+
+	int s = fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW);
+	if (s < 0) {
+		return -1;
+	}
+
+	_mode = st.st_mode;
+
+	if (S_ISLNK(st.st_mode)) {
+		Buffer rpath;
+		Buffer linkname;
+
+		rpath.append_raw(dir_path);
+		if (rpath.is_empty() || rpath.char_at(rpath.len() - 1) != '/') {
+			rpath.appendc('/');
+		}
+		rpath.append_raw(name);
+
+		s = GET_LINK_NAME(&linkname, rpath.v());
+		if (s < 0) {
+			return -1;
+		}
+		_linkname.copy(&linkname);
+
+		memset(&st, 0, sizeof(struct stat));
+
+		s = lstat(_linkname.v(), &st);
+		if (s < 0) {
+			return -1;
+		}
+	}
+
+	_uid	= st.st_uid;
+	_gid	= st.st_gid;
+	_size	= st.st_size;
+	_mtime	= st.st_mtime;
+	_ctime	= st.st_ctime;
+
+	return 0;
+}
+
+/**
+ * Method get_child(name,len) will return child node with `name`, or NULL if
+ * not found. If `len` is zero, the length of `name` is computed with strlen.
+ *
+ * If directory has more than IDX_MIN child nodes, the child is searched
+ * using hash index, which is created on the first search.
+ */
+DirNode* DirNode::get_child(const char* name, size_t len)
+{
+	size_t		n = 0;
+	DirNode*	c = NULL;
+
+	if (len == 0) {
+		len = strlen(name);
+	}
+
+	if (_idx) {
+		size_t mask = _idx->size - 1;
+		size_t h = FNV1A_32(name, len) & mask;
+
+		for (; _idx->slot[h]; h = (h + 1) & mask) {
+			c = _idx->slot[h];
+			if (c->_name.len() == len
+			&&  c->_name.cmp_raw(name, len) == 0) {
+				return c;
+			}
+		}
+		return NULL;
+	}
+
+	for (c = _child; c; c = c->_next, n++) {
+		if (c->_name.len() == len && c->_name.cmp_raw(name, len) == 0) {
+			break;
+		}
+	}
+
+	if (n > IDX_MIN) {
+		IDX_BUILD(this, n);
+	}
+
+	return c;
+}
+
+/**
+ * Method set_child(child) will replace the list of child nodes with `child`,
+ * which is sorted by name, and remove the index of the previous list. The
+ * previous child nodes is not deleted.
+ */
+void DirNode::set_child(DirNode* child)
+{
+	IDX_FREE(this);
+	_child = child;
+}
+
+/**
+ * Method child_clear will delete all child nodes and their index.
+ */
+void DirNode::child_clear()
+{
+	IDX_FREE(this);
+	if (_child) {
+		delete _child;
+		_child = NULL;
+	}
+}
+
 /**
  * @method	: DirNode::update_attr
  * @param	:
@@ -104,7 +827,7 @@ int DirNode::get_attr(const char* rpath, const char* name)
  * @return	:
  *	< 3	: success, _mtime and _ctime changed.
  *	< 2	: success, _ctime changed
- *	< 1	: success, _mtime changed.
+ *	< 1	: success, _mtime or _size changed.
  *	< 0	: success, stat does not change.
  *	< -1	: fail.
  * @desc	: update node attributes.
@@ -122,7 +845,7 @@ int DirNode::update_attr(DirNode* node, const char* rpath)
 	if (s < 0) {
 		return -1;
 	}
-	if (st.st_mtime != node->_mtime) {
+	if (st.st_mtime != node->_mtime || st.st_size != node->_size) {
 		s		|= _MTIME_CHANGED;
 		node->_size	= st.st_size;
 		node->_mtime	= st.st_mtime;
@@ -153,21 +876,19 @@ int DirNode::update_attr(DirNode* node, const char* rpath)
 int DirNode::update_child_attr(DirNode** node, const char* rpath
 				, const char* name)
 {
-	DirNode*	p = _child;
+	int		s;
+	DirNode*	p = get_child(name);
 
-	while (p) {
-		int s = p->_name.cmp_raw(name);
-		if (s == 0) {
-			(*node)	= p;
-			s	= update_attr(p, rpath);
-			if (s < 0) {
-				return -2;
-			}
-			return 0;
-		}
-		p = p->_next;
+	if (! p) {
+		return -1;
+	}
+
+	(*node)	= p;
+	s = update_attr(p, rpath);
+	if (s < 0) {
+		return -2;
 	}
-	return -1;
+	return s > 0;
 }
 
 /**
@@ -275,6 +996,10 @@ void DirNode::INSERT(DirNode** list, DirNode* node)
 	if (!node) {
 		return;
 	}
+	if (node->_parent && list == &node->_parent->_child
+	&&  node->_parent->_idx) {
+		IDX_ADD(node->_parent, node);
+	}
 	if (!(*list)) {
 		(*list) = node;
 		return;
@@ -347,6 +1072,11 @@ void DirNode::UNLINK(DirNode** list, DirNode* node)
 	DirNode* next = node->_next;
 	DirNode* prev = node->_prev;
 
+	if (node->_parent && list == &node->_parent->_child
+	&&  node->_parent->_idx) {
+		IDX_DEL(node->_parent, node);
+	}
+
 	if ((*list) == node) {
 		(*list) = next;
 	} else if (prev) {
@@ -373,17 +1103,16 @@ void DirNode::UNLINK(DirNode** list, DirNode* node)
  */
 int DirNode::REMOVE_CHILD_BY_NAME(DirNode* list, const char* name)
 {
-	DirNode* p = list->_child;
+	DirNode* p = list->get_child(name);
 
-	while (p) {
-		if (p->_name.cmp_raw(name) == 0) {
-			UNLINK(&list->_child, p);
-			delete p;
-			return 0;
-		}
-		p = p->_next;
+	if (! p) {
+		return -1;
 	}
-	return -1;
+
+	UNLINK(&list->_child, p);
+	delete p;
+
+	return 0;
 }
 
 } /* namespace::vos */
@@ -9,10 +9,49 @@
 
 #include <sys/stat.h>
 #include <time.h>
+#include <stddef.h>
+#include <pthread.h>
 #include "Buffer.hh"
 
 namespace vos {
 
+struct dir_name;
+struct dir_node_idx;
+
+//
+// Class DirName contain name of node in directory.
+//
+// The name is interned: all DirName with the same value share one copy of
+// name, which is released when the last DirName that use it is reset or
+// destroyed. Empty name does not use any memory.
+//
+// Field `_p` contain pointer to interned name, or NULL if name is empty.
+//
+class DirName {
+public:
+	DirName();
+	~DirName();
+
+	const char* v() const;
+	const char* chars() const;
+	size_t len() const;
+	int is_empty() const;
+
+	Error copy(const Buffer* bfr);
+	Error copy_raw(const char* v, size_t len = 0);
+	void reset();
+
+	int cmp(const DirName* name) const;
+	int cmp_raw(const char* v, size_t len = 0) const;
+	int like(const DirName* name) const;
+
+private:
+	struct dir_name* _p;
+
+	DirName(const DirName&);
+	void operator=(const DirName&);
+};
+
 enum _DirNode_upstat {
 	_MTIME_CHANGED	= 1
 ,	_CTIME_CHANGED	= 2
@@ -25,6 +64,8 @@ enum _DirNode_upstat {
  *	- _mode		: attributes (type and permission) of node.
  *	- _uid		: user id of node in file system.
  *	- _gid		: groud id of node in file system.
+ *	- _visit	: the last time directory is visited, set by Dir in lazy
+ *			  mode. Zero if its child has not been loaded.
  *	- _size		: size of node.
  *	- _mtime	: last modification to the contents of the file.
  *	- _ctime	: last modification to the attributes of the file.
@@ -36,22 +77,40 @@ enum _DirNode_upstat {
  *	- _link		: pointer to the real node object if this node is
  *			  symbolic link to directory.
  *	- _parent	: pointer to parent directory.
+ *	- _idx		: hash index of child nodes, by their name.
  * @desc		:
  *
  * This class handling attributes and link of each node (regular file
  * or directory) in directory.
+ *
+ * Directory with more than IDX_MIN child nodes is indexed by hash of their
+ * name, when its child is searched by get_child(). The index is updated by
+ * INSERT() and UNLINK(), so the child nodes should be added and removed only
+ * by those methods, or by child_clear().
+ *
+ * Node is allocated from blocks of memory shared by all nodes, and the
+ * memory of deleted node is reused by the next new node, so a large tree
+ * does not pay the overhead of allocating each node and name by malloc.
  */
 class DirNode : public Object {
 public:
 	DirNode();
 	virtual ~DirNode();
 
+	static void* operator new(size_t size) throw();
+	static void operator delete(void* p, size_t size);
+
 	int get_attr(const char* rpath, const char* name = NULL);
+	int get_attr_at(int dir_fd, const char* dir_path, const char* name);
 	int update_attr(DirNode* node, const char* rpath);
 	int update_child_attr(DirNode** node, const char* rpath
 				, const char* name);
 	void dump(int space = 0);
 
+	DirNode* get_child(const char* name, size_t len = 0);
+	void set_child(DirNode* child);
+	void child_clear();
+
 	inline int is_dir()
 	{
 		return S_ISDIR(_mode);
@@ -65,6 +124,8 @@ public:
 		return S_ISREG(_mode);
 	}
 
+	static size_t IDX_MIN;
+
 	static int INIT(DirNode** node, const char* rpath, const char* path);
 	static int GET_LINK_NAME(Buffer* linkname, const char* path);
 
@@ -77,16 +138,18 @@ public:
 	mode_t _mode;
 	uid_t		_uid;
 	gid_t		_gid;
+	uint64_t	_visit;
 	off_t		_size;
 	long		_mtime;
 	long		_ctime;
-	Buffer		_name;
-	Buffer		_linkname;
+	DirName		_name;
+	DirName		_linkname;
 	DirNode*	_next;
 	DirNode*	_prev;
 	DirNode*	_child;
 	DirNode*	_link;
 	DirNode*	_parent;
+	struct dir_node_idx*	_idx;
 
 	static const char* __cname;
 private:
@@ -24,6 +24,8 @@ Dlogger::Dlogger () : File()
 ,	_time_show(0)
 ,	_args()
 ,	_max_size (0)
+,	_max_files(0)
+,	_rotating(0)
 {
 	_d	= STDERR_FILENO;
 	_status	= FILE_OPEN_WO;
@@ -43,12 +45,15 @@ Dlogger::~Dlogger()
  * @param prefix	: string to be inserted at the beginning of each
  * line, after timestamp and before actual log output.
  * @param show_timestamp: `0` to disable timestamp on log output.
+ * @param max_files	: number of rotated log files to keep, as
+ * 'logfile.1' until 'logfile.max_files'. If its zero, the log file will be
+ * truncated when its size reach 'max_size'.
  * @return < 0		: success.
  * @return < -1		: fail.
  * @desc		: start the log daemon on the file 'logfile'.
  */
 Error Dlogger::open (const char* logfile, size_t max_size, const char* prefix
-	, int show_timestamp)
+	, int show_timestamp, size_t max_files)
 {
 	_prefix.copy_raw(prefix);
 	_time_show = show_timestamp;
@@ -63,6 +68,7 @@ Error Dlogger::open (const char* logfile, size_t max_size, const char* prefix
 		}
 
 		_max_size = max_size;
+		_max_files = max_files;
 	}
 	return NULL;
 }
@@ -82,6 +88,121 @@ void Dlogger::close()
 	}
 }
 
+/**
+ * @method	: Dlogger::rotate
+ * @return < NULL	: success.
+ * @return < Error	: fail.
+ * @desc	:
+ *	flush the log buffer, rename the current log file to 'logfile.1',
+ *	shifting the older one up to 'logfile.max_files', and continue writing
+ *	to a new empty log file.
+ *
+ *	The files are renamed and the new log file is opened without holding
+ *	the lock, so writers only wait for the swap of file descriptor. Log
+ *	written while rotating, including the one that start the rotation, is
+ *	kept in the log buffer and written to the new file after the swap,
+ *	unless the buffer is full before that, which is then written to the
+ *	renamed file. If the new file can not be opened, log will keep written
+ *	to the renamed file.
+ *
+ *	If '_max_files' is zero, the log file will be truncated instead.
+ */
+Error Dlogger::rotate()
+{
+	Error err;
+
+	_locker.lock();
+
+	if (_d == STDERR_FILENO || _name.is_empty() || _rotating) {
+		_locker.unlock();
+		return NULL;
+	}
+
+	if (_max_files == 0) {
+		err = truncate(FLUSH_NO);
+		_locker.unlock();
+		return err;
+	}
+
+	err = flush();
+	if (err == NULL) {
+		_rotating = 1;
+	}
+
+	_locker.unlock();
+
+	if (err != NULL) {
+		return err;
+	}
+
+	return rotate_files();
+}
+
+/**
+ * @method	: Dlogger::rotate_files
+ * @return < NULL	: success.
+ * @return < Error	: fail.
+ * @desc	:
+ *	rename the log files and swap the file descriptor to the new log
+ *	file. It must be called without holding the lock, after '_rotating'
+ *	is set.
+ */
+Error Dlogger::rotate_files()
+{
+	Error err;
+	Buffer from;
+	Buffer to;
+	int s;
+	int fd = -1;
+
+	for (size_t x = _max_files - 1; x > 0; x--) {
+		from.reset();
+		to.reset();
+
+		from.append_fmt("%s.%lu", _name.v(), x);
+		to.append_fmt("%s.%lu", _name.v(), x + 1);
+
+		s = ::rename(from.v(), to.v());
+		if (s < 0 && errno != ENOENT) {
+			err = Error::SYS();
+			goto out;
+		}
+	}
+
+	to.reset();
+	to.append_fmt("%s.1", _name.v());
+
+	s = ::rename(_name.v(), to.v());
+	if (s < 0) {
+		err = Error::SYS();
+		goto out;
+	}
+
+	fd = ::open(_name.v(), FILE_OPEN_WOCA, _perm);
+	if (fd < 0) {
+		err = Error::SYS();
+	}
+out:
+	_locker.lock();
+
+	if (fd >= 0) {
+		int old = _d;
+
+		_d = fd;
+		_size = 0;
+		fd = old;
+	}
+	_rotating = 0;
+
+	_locker.unlock();
+
+	if (fd >= 0) {
+		::close(fd);
+	}
+
+	return err;
+}
+
 /**
  * @method	: Dlogger::add_timestamp
  * @desc	:
@@ -112,10 +233,14 @@ void Dlogger::add_prefix()
  * @param		:
  *	> stream	: File stream.
  *	> fmt		: format of messages.
+ *	> rotating	: set to 1 if log files need to be rotated by calling
+ *	rotate_files() after the lock is released.
  * @desc		: The generic method of writing a log messages.
  */
-Error Dlogger::_w(int fd, const char* fmt)
+Error Dlogger::_w(int fd, const char* fmt, int* rotating)
 {
+	Error err_rotate;
+
 	add_timestamp();
 	add_prefix();
 
@@ -127,9 +252,19 @@ Error Dlogger::_w(int fd, const char* fmt)
 
 	if (_d != STDERR_FILENO || !fd) {
 		// Check size of file
-		if (_max_size > 0
-		&& ((size_t(_size) + _i) > _max_size)) {
-			truncate(FLUSH_NO);
+		if (_max_size > 0 && !_rotating && !_name.is_empty()
+		&& (size_t(_size) + _i) > 0
+		&& ((size_t(_size) + _i + _tmp.len()) > _max_size)) {
+			// Keep writing to the current file if rotation fail.
+			if (_max_files == 0) {
+				err_rotate = truncate(FLUSH_NO);
+			} else {
+				err_rotate = flush();
+				if (err_rotate == NULL) {
+					_rotating = 1;
+					*rotating = 1;
+				}
+			}
 		}
 
 		err = write_raw(_tmp.v(), _tmp.len());
@@ -149,7 +284,7 @@ Error Dlogger::_w(int fd, const char* fmt)
 	}
 	_tmp.reset();
 
-	return NULL;
+	return err_rotate;
 }
 
 /**
@@ -170,13 +305,21 @@ Error Dlogger::er(const char* fmt, ...)
 	va_start(args, fmt);
 	va_copy(_args, args);
 
-	Error err = _w(STDERR_FILENO, fmt);
+	int rotating = 0;
+	Error err = _w(STDERR_FILENO, fmt, &rotating);
 
 	va_end(_args);
 	va_end(args);
 
 	_locker.unlock();
 
+	if (rotating) {
+		Error err_rotate = rotate_files();
+		if (err == NULL) {
+			err = err_rotate;
+		}
+	}
+
 	return err;
 }
 
@@ -198,13 +341,21 @@ Error Dlogger::out(const char* fmt, ...)
 	va_start(args, fmt);
 	va_copy(_args, args);
 
-	Error err = _w(STDOUT_FILENO, fmt);
+	int rotating = 0;
+	Error err = _w(STDOUT_FILENO, fmt, &rotating);
 
 	va_end(_args);
 	va_end(args);
 
 	_locker.unlock();
 
+	if (rotating) {
+		Error err_rotate = rotate_files();
+		if (err == NULL) {
+			err = err_rotate;
+		}
+	}
+
 	return err;
 }
 
@@ -226,13 +377,21 @@ Error Dlogger::it(const char* fmt, ...)
 	va_start(args, fmt);
 	va_copy(_args, args);
 
-	Error err = _w(0, fmt);
+	int rotating = 0;
+	Error err = _w(0, fmt, &rotating);
 
 	va_end(_args);
 	va_end(args);
 
 	_locker.unlock();
 
+	if (rotating) {
+		Error err_rotate = rotate_files();
+		if (err == NULL) {
+			err = err_rotate;
+		}
+	}
+
 	return err;
 }
 
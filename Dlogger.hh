@@ -19,6 +19,8 @@ namespace vos {
  * error.
  *
  * Field _max_size define maximum log file size.
+ * Field _max_files define number of rotated log files to keep.
+ * Field _rotating is set while log files is being rotated.
  */
 class Dlogger : public File {
 public:
@@ -29,8 +31,10 @@ public:
 
 	Error open(const char* logfile, size_t max_size = 0
 		, const char* prefix = 0
-		, int show_timestamp = 1);
+		, int show_timestamp = 1
+		, size_t max_files = 0);
 	void close();
+	Error rotate();
 
 	Error er(const char* fmt, ...);
 	Error out(const char* fmt, ...);
@@ -41,7 +45,8 @@ private:
 
 	void add_timestamp();
 	void add_prefix();
-	Error _w(int fd, const char* fmt);
+	Error _w(int fd, const char* fmt, int* rotating);
+	Error rotate_files();
 
 	Locker		_locker;
 	Buffer		_tmp;
@@ -51,6 +56,8 @@ private:
 	int		_time_show;
 	va_list		_args;
 	size_t		_max_size;
+	size_t		_max_files;
+	int		_rotating;
 };
 
 } // namespace::vos
@@ -4,6 +4,8 @@
 // found in the LICENSE file.
 //
 
+#include <sched.h>
+
 #include "Error.hh"
 
 namespace vos {
@@ -14,30 +16,107 @@ Error ErrUnknown("libvos: unknown error");
 
 const char* Error::__CNAME = "Error";
 
-Error Error::SYS()
+/**
+ * Variable ERRNO_MAX define the maximum system error number that will be
+ * cached by STRERROR().
+ * Variable ERRNO_MSG_LEN define the maximum length of cached error message.
+ */
+static const int ERRNO_MAX = 256;
+static const size_t ERRNO_MSG_LEN = 128;
+
+enum __errno_state {
+	ERRNO_EMPTY	= 0
+,	ERRNO_FILLING	= 1
+,	ERRNO_READY	= 2
+,	ERRNO_INVALID	= 3
+};
+
+static char __errno_msg[ERRNO_MAX][ERRNO_MSG_LEN];
+static int __errno_state[ERRNO_MAX];
+
+/**
+ * Method STRERROR(errnum) will return static message for system error number
+ * `errnum`.
+ *
+ * The message is rendered only once, at the first time the error number is
+ * requested, and then reused by all subsequent calls without any allocation.
+ *
+ * It will return NULL if `errnum` is unknown or out of cache range.
+ */
+const char* Error::STRERROR(int errnum)
 {
-	int errnum = errno;
-	size_t len = 512;
-	char* msg = (char*) calloc(len, 1);
-	char* remsg = NULL;
-
-	do {
-		int s = strerror_r(errnum, msg, len);
-		if (s && errno == ERANGE) {
-			len = len * 2;
-			remsg = (char*) realloc(msg, len);
-			if (remsg != NULL) {
-				free(msg);
-				msg = remsg;
+	if (errnum <= 0 || errnum >= ERRNO_MAX) {
+		return NULL;
+	}
+
+	int* state = &__errno_state[errnum];
+	int st = __atomic_load_n(state, __ATOMIC_ACQUIRE);
+
+	if (st == ERRNO_EMPTY) {
+		int expect = ERRNO_EMPTY;
+
+		if (__atomic_compare_exchange_n(state, &expect, ERRNO_FILLING
+			, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			int s = strerror_r(errnum, __errno_msg[errnum]
+				, ERRNO_MSG_LEN);
+
+			// XSI strerror_r may return -1 and set errno, or return
+			// the error number directly.
+			if (s < 0) {
+				s = errno;
+			}
+			if (s == 0 || s == ERANGE) {
+				__errno_msg[errnum][ERRNO_MSG_LEN - 1] = '\0';
+				st = ERRNO_READY;
+			} else {
+				st = ERRNO_INVALID;
 			}
+
+			__atomic_store_n(state, st, __ATOMIC_RELEASE);
+		} else {
+			st = expect;
 		}
-	} while (errno == ERANGE);
+	}
+
+	// Other thread is rendering the same message.
+	while (st == ERRNO_FILLING) {
+		sched_yield();
+		st = __atomic_load_n(state, __ATOMIC_ACQUIRE);
+	}
 
-	if (errno == EINVAL) {
-		return ErrUnknown.with(&errnum, sizeof(int));
+	if (st != ERRNO_READY) {
+		return NULL;
 	}
 
-	return Error(msg);
+	return __errno_msg[errnum];
+}
+
+/**
+ * Method SYS() will create new error from current system error number,
+ * `errno`.
+ *
+ * The error only contains the error number and reference to static message
+ * from STRERROR(), so two system errors with the same error number will be
+ * equal.
+ *
+ * If error number is unknown, it will return ErrUnknown with error number as
+ * data.
+ */
+Error Error::SYS()
+{
+	int errnum = errno;
+	const char* msg = STRERROR(errnum);
+
+	if (!msg) {
+		Error err = ErrUnknown.with(&errnum, sizeof(int));
+		err._errnum = errnum;
+		return err;
+	}
+
+	Error err(msg);
+	err._errnum = errnum;
+
+	return err;
 }
 
 Error::Error()
@@ -45,6 +124,8 @@ Error::Error()
 , _data(NULL)
 , _p_data(NULL)
 , _len(0)
+, _errnum(0)
+, _inline()
 {
 	__str = NULL;
 }
@@ -54,6 +135,8 @@ Error::Error(const char* msg)
 , _data(NULL)
 , _p_data(NULL)
 , _len(0)
+, _errnum(0)
+, _inline()
 {
 	__str = (char*) msg;
 }
@@ -67,15 +150,11 @@ Error::Error(const Error& err)
 , _data(NULL)
 , _p_data(NULL)
 , _len(0)
+, _errnum(err._errnum)
+, _inline()
 {
 	__str = err.__str;
-	if (err._data) {
-		_p_data = err._data;
-	}
-	if (err._p_data) {
-		_p_data = err._p_data;
-	}
-	_len = err._len;
+	copy_data(err);
 }
 
 /**
@@ -94,12 +173,23 @@ Error::~Error()
 
 Error& Error::operator=(const Error& err)
 {
+	if (this == &err) {
+		return *this;
+	}
+
 	__str = err.__str;
-	if (err._data) {
+	_errnum = err._errnum;
+
+	// Release our own data before replacing it with data from `err`.
+	if (_data != NULL) {
+		free(_data);
 		_data = NULL;
-		_p_data = err._data;
 	}
-	_len = err._len;
+	_p_data = NULL;
+	_len = 0;
+
+	copy_data(err);
+
 	return *this;
 }
 
@@ -113,19 +203,42 @@ int Error::operator!=(const Error& err) const
 	return (__str != err.__str);
 }
 
+/**
+ * Method with(data,len) will create new error with the same message and
+ * additional `data` with length `len`.
+ *
+ * Data that is shorter than INLINE_SIZE is copied into the error object
+ * itself, without allocation.
+ */
 Error Error::with(const void* data, size_t len)
 {
 	Error err(__str);
 
+	err._errnum = _errnum;
+
 	if (data && len) {
-		err._data = calloc(len, 1);
-		memcpy(err._data, data, len);
+		if (len < INLINE_SIZE) {
+			memcpy(err._inline, data, len);
+			err._p_data = err._inline;
+		} else {
+			err._data = calloc(len + 1, 1);
+			memcpy(err._data, data, len);
+		}
 		err._len = len;
 	}
 
 	return err;
 }
 
+/**
+ * Method errnum() will return the system error number if error is created
+ * by SYS(), otherwise it will return 0.
+ */
+int Error::errnum() const
+{
+	return _errnum;
+}
+
 void* Error::data() const
 {
 	if (_p_data) {
@@ -230,5 +343,34 @@ double Error::data_as_double() const
 	return *(double*) _data;
 }
 
+/**
+ * Method copy_data(err) will copy inline data from `err` or referencing their
+ * allocated data.
+ */
+void Error::copy_data(const Error& err)
+{
+	if (err._p_data == err._inline) {
+		memcpy(_inline, err._inline, INLINE_SIZE);
+		_p_data = _inline;
+		_len = err._len;
+		return;
+	}
+	if (err._data) {
+		// Keep our own copy, so data is still valid after `err` is
+		// released.
+		_data = calloc(err._len + 1, 1);
+		if (!_data) {
+			return;
+		}
+		memcpy(_data, err._data, err._len);
+		_len = err._len;
+		return;
+	}
+	if (err._p_data) {
+		_p_data = err._p_data;
+		_len = err._len;
+	}
+}
+
 } // namespace vos
 // vi: ts=8 sw=8 tw=80:
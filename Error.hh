@@ -15,12 +15,18 @@ namespace vos {
  * Class Error represent error type as object with string and data.
  *
  * Field _data contains any value that cause the error.
+ * Field _p_data contains pointer to data that is not owned by this error.
+ * Field _len contains length of data.
+ * Field _errnum contains system error number, if error is created by SYS().
+ * Field _inline contains small data, to minimize allocation on with().
  */
 class Error : public Object {
 public:
 	static const char* __CNAME;
+	static const size_t INLINE_SIZE = 16;
 
 	static Error SYS();
+	static const char* STRERROR(int errnum);
 
 	Error();
 	Error(const char* msg);
@@ -34,6 +40,8 @@ public:
 
 	Error with(const void* data, size_t len);
 
+	int errnum() const;
+
 	void* data() const;
 	char data_as_char() const;
 	const char* data_as_string() const;
@@ -45,6 +53,10 @@ protected:
 	void* _data;
 	void* _p_data;
 	size_t _len;
+	int _errnum;
+	char _inline[INLINE_SIZE];
+
+	void copy_data(const Error& err);
 };
 
 extern const Error ErrNumRange;
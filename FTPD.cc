@@ -64,6 +64,17 @@ const char* _FTP_month[12] =
 ,	"Dec"
 };
 
+//
+// Variable LIST_CACHE_SIZE contain default number of directories that their
+// LIST and NLST output are cached.
+//
+int FTPD::LIST_CACHE_SIZE = 32;
+
+//
+// Variable LIST_CACHE_MAX contain maximum size of output that will be cached.
+//
+size_t FTPD::LIST_CACHE_MAX = 1024 * 1024;
+
 static FTPD* _ftpd_ = NULL;
 
 FTPD::FTPD() : SockServer()
@@ -72,6 +83,9 @@ FTPD::FTPD() : SockServer()
 ,	_maxfd(0)
 ,	_path()
 ,	_dir()
+,	_list_cache_size(LIST_CACHE_SIZE)
+,	_list_cache(NULL)
+,	_n_list(0)
 ,	_fd_all()
 ,	_fd_read()
 ,	_clients()
@@ -80,7 +94,12 @@ FTPD::FTPD() : SockServer()
 {}
 
 FTPD::~FTPD()
-{}
+{
+	if (_list_cache) {
+		delete[] _list_cache;
+		_list_cache = NULL;
+	}
+}
 
 /**
  * @method		: FTPD::init
@@ -129,6 +148,10 @@ int FTPD::init(const char* address, const uint16_t port, const char* path
 	FD_ZERO(&_fd_read);
 	set_add(&_fd_all, &_maxfd);
 
+	if (_dir._ifd >= 0) {
+		FD_SET(_dir._ifd, &_fd_all);
+	}
+
 	return 0;
 }
 
@@ -279,11 +302,17 @@ int FTPD::set_path(const char* path)
 		_dir.close();
 	}
 
+	list_cache_clear();
+
 	s = _dir.open(path, -1);
 	if (s < 0) {
 		return -1;
 	}
 
+	// If directory can not be watched, the tree is refreshed on LIST and
+	// NLST.
+	_dir.watch();
+
 	Error err = _path.copy(&_dir._name);
 	if (err != NULL) {
 		return -1;
@@ -390,6 +419,10 @@ int FTPD::run()
 	_maxfd		= _d + 1;
 	_running	= 1;
 
+	if (_dir._ifd >= _maxfd) {
+		_maxfd = _dir._ifd + 1;
+	}
+
 	signal(SIGINT, &EXIT);
 	signal(SIGQUIT, &EXIT);
 
@@ -409,6 +442,14 @@ int FTPD::run()
 		if (!_running) {
 			break;
 		}
+		if (_dir._ifd >= 0 && FD_ISSET(_dir._ifd, &_fd_read)) {
+			if (_dir.sync() != 0) {
+				list_cache_clear();
+			}
+			if (--s == 0) {
+				continue;
+			}
+		}
 		if (FD_ISSET(_d, &_fd_read)) {
 			Error err = accept_conn(&sock);
 			if (sock) {
@@ -496,6 +537,7 @@ void FTPD::client_process()
 				c->reply_raw(CODE_530
 					, _FTP_reply_msg[CODE_530], NULL);
 			} else if (c->_cmd._callback != NULL) {
+				_dir.evict();
 				c->_cmd._callback(this, c);
 			} else {
 				on_cmd_unknown(c);
@@ -747,6 +789,133 @@ out:
 	return c->_s;
 }
 
+/**
+ * Method list_cache_get(path,dir,nlst,month) will return the cached output
+ * of LIST, or NLST if `nlst` is 1, of directory node `dir` with real path
+ * `path`, that is rendered in `month`.
+ *
+ * It will return NULL if output is not cached, or if directory has been
+ * modified since output is rendered.
+ */
+struct ftpd_list_cache* FTPD::list_cache_get(Buffer* path, DirNode* dir
+						, int nlst, int month)
+{
+	struct ftpd_list_cache* lc = NULL;
+
+	if (! _list_cache) {
+		return NULL;
+	}
+
+	for (int x = 0; x < _list_cache_size; x++) {
+		lc = &_list_cache[x];
+
+		if (lc->nlst != nlst || lc->path.cmp(path) != 0) {
+			continue;
+		}
+		if (lc->month != month || lc->mtime != dir->_mtime
+		||  lc->ctime != dir->_ctime) {
+			lc->path.reset();
+			lc->out.reset();
+			return NULL;
+		}
+
+		lc->used = ++_n_list;
+
+		return lc;
+	}
+
+	return NULL;
+}
+
+/**
+ * Method list_cache_put(path,dir,nlst,month,out) will save the output `out`
+ * of LIST, or NLST if `nlst` is 1, of directory node `dir` with real path
+ * `path`. If cache is full, the least recently used output is replaced.
+ *
+ * Output larger than LIST_CACHE_MAX is not cached.
+ */
+void FTPD::list_cache_put(Buffer* path, DirNode* dir, int nlst, int month
+				, const Buffer* out)
+{
+	struct ftpd_list_cache* lc = NULL;
+	struct ftpd_list_cache* p = NULL;
+
+	if (_list_cache_size <= 0 || out->len() > LIST_CACHE_MAX) {
+		return;
+	}
+	if (! _list_cache) {
+		_list_cache = new ftpd_list_cache[_list_cache_size];
+		if (! _list_cache) {
+			return;
+		}
+	}
+
+	for (int x = 0; x < _list_cache_size; x++) {
+		p = &_list_cache[x];
+
+		if (p->path.is_empty()
+		|| (p->nlst == nlst && p->path.cmp(path) == 0)) {
+			lc = p;
+			break;
+		}
+		if (! lc || p->used < lc->used) {
+			lc = p;
+		}
+	}
+
+	if (lc->path.copy(path) != NULL || lc->out.copy(out) != NULL) {
+		lc->path.reset();
+		lc->out.reset();
+		return;
+	}
+
+	lc->nlst	= nlst;
+	lc->month	= month;
+	lc->mtime	= dir->_mtime;
+	lc->ctime	= dir->_ctime;
+	lc->used	= ++_n_list;
+}
+
+/**
+ * Method list_refresh(path) will read the directory with real path `path`
+ * again, if the tree is not watched, and remove all cached output of LIST
+ * and NLST if the directory or one of its child has changed.
+ *
+ * It will return 0 on success, or -1 if directory can not be read.
+ */
+int FTPD::list_refresh(Buffer* path)
+{
+	int s;
+
+	if (_dir.is_watching()) {
+		return 0;
+	}
+
+	s = _dir.refresh_by_path(path);
+	if (s < 0) {
+		return -1;
+	}
+	if (s > 0) {
+		list_cache_clear();
+	}
+
+	return 0;
+}
+
+/**
+ * Method list_cache_clear will remove all cached output of LIST and NLST.
+ */
+void FTPD::list_cache_clear()
+{
+	if (! _list_cache) {
+		return;
+	}
+	for (int x = 0; x < _list_cache_size; x++) {
+		_list_cache[x].path.reset();
+		_list_cache[x].out.reset();
+	}
+}
+
 /**
  * @method	: FTPD::on_cmd_USER
  * @param	:
@@ -932,9 +1101,28 @@ void FTPD::on_cmd_CWD(FTPD* s, FTPD_client* c)
 	c->reply();
 }
 
+/**
+ * @method	: FTPD::on_cmd_CDUP
+ * @desc	: change working directory to its parent.
+ *
+ *	The parent is searched by path, because node of working directory may
+ *	have been evicted by Dir in lazy mode.
+ */
 void FTPD::on_cmd_CDUP(FTPD* s, FTPD_client* c)
 {
-	c->_wd_node = c->_wd_node->_parent;
+	Buffer		path;
+	DirNode*	node	= NULL;
+
+	path.concat(s->_path.v(), c->_wd.v(), "/..", 0);
+
+	node = s->_dir.get_node(&path, s->_path.v(), s->_path.len());
+	if (! node) {
+		c->reply_raw(CODE_550, _FTP_reply_msg[CODE_550]
+			, _FTP_add_reply_msg[NODE_NOT_FOUND]);
+		return;
+	}
+
+	c->_wd_node = node;
 	c->_wd.reset();
 	s->_dir.get_parent_path(&c->_wd, c->_wd_node);
 	c->reply_raw(CODE_250, _FTP_reply_msg[CODE_250], NULL);
@@ -1109,19 +1297,61 @@ static int is_old(struct tm* cur_tm, struct tm* node_tm)
 	return 0;
 }
 
+//
+// LIST_NODE will append the LIST output of `node` into `out`, with
+// modification time relative to current time `cur_tm`.
+//
+// It will return 0 on success, or -1 if time of node can not be converted.
+//
+static int LIST_NODE(Buffer* out, DirNode* node, struct tm* cur_tm)
+{
+	struct tm node_tm;
+
+	if (! localtime_r(&node->_mtime, &node_tm)) {
+		return -1;
+	}
+
+	get_node_perm(out, node);
+
+	out->append_fmt(" 1 %d %d %13ld %s %2d ", node->_uid, node->_gid
+			, node->_size, _FTP_month[node_tm.tm_mon]
+			, node_tm.tm_mday);
+
+	if (is_old(cur_tm, &node_tm)) {
+		out->append_fmt("%d ", 1900 + node_tm.tm_year);
+	} else {
+		out->append_fmt("%02d:%02d ", node_tm.tm_hour, node_tm.tm_min);
+	}
+
+	out->append_raw(node->_name.v(), node->_name.len());
+	out->append_raw("\r\n");
+
+	return 0;
+}
+
+/**
+ * Method on_cmd_LIST will send the list of nodes in directory, or the node
+ * itself if it is not directory, to the data connection.
+ *
+ * The output of directory is cached, so the next LIST on the same
+ * directory is sent at once without rendering each node again, until the
+ * directory is changed.
+ */
 void FTPD::on_cmd_LIST(FTPD* s, FTPD_client* c)
 {
 	if (!s || !c) {
 		return;
 	}
 
-	int		x;
+	int		month;
 	time_t		cur_t;
 	struct tm	cur_tm;
-	struct tm	node_tm;
 	DirNode*	node		= NULL;
+	DirNode*	dir		= NULL;
 	Socket*		pasv_c		= NULL;
 	struct tm*	time_p		= NULL;
+	Buffer		out;
+	struct ftpd_list_cache* lc	= NULL;
 
 	if (!c->_psrv || !c->_pclt) {
 		c->_s = CODE_425;
@@ -1133,8 +1363,7 @@ void FTPD::on_cmd_LIST(FTPD* s, FTPD_client* c)
 		goto out;
 	}
 
-	x = s->_dir.refresh_by_path(&c->_path_real);
-	if (x < 0) {
+	if (s->list_refresh(&c->_path_real) < 0) {
 		c->_s		= CODE_450;
 		c->_rmsg_plus	= _FTP_add_reply_msg[NODE_NOT_FOUND];
 		goto out;
@@ -1150,65 +1379,33 @@ void FTPD::on_cmd_LIST(FTPD* s, FTPD_client* c)
 		c->_rmsg_plus	= strerror(errno);
 		goto out;
 	}
+	month = cur_tm.tm_year * 12 + cur_tm.tm_mon;
 
 	c->reply_raw(CODE_150, _FTP_reply_msg[CODE_150], NULL);
 
 	node = c->_path_node;
 	if (!node->is_dir()) {
-		time_p = localtime_r(&node->_mtime, &node_tm);
-		if (!time_p) {
+		if (LIST_NODE(pasv_c, node, &cur_tm) < 0) {
 			c->_s		= CODE_451;
 			c->_rmsg_plus	= strerror(errno);
 			goto out;
 		}
-
-		get_node_perm(pasv_c, node);
-
-		pasv_c->append_fmt(" 1 %d %d %13ld %s %2d "
-				, node->_uid, node->_gid, node->_size
-				, _FTP_month[node_tm.tm_mon], node_tm.tm_mday);
-
-		if (is_old(&cur_tm, &node_tm)) {
-			pasv_c->append_fmt("%d ", 1900 + node_tm.tm_year);
-		} else {
-			pasv_c->append_fmt("%02d:%02d ", node_tm.tm_hour
-					, node_tm.tm_min);
-		}
-
-		pasv_c->append(&node->_name);
-		pasv_c->append_raw("\r\n");
 	} else {
-		if (node->_link) {
-			node = node->_link->_child;
-		} else {
-			node = node->_child;
-		}
-		while (node) {
-			time_p = localtime_r(&node->_mtime, &node_tm);
-			if (!time_p) {
-				c->_s		= CODE_451;
-				c->_rmsg_plus	= strerror(errno);
-				goto out;
-			}
-
-			get_node_perm(pasv_c, node);
+		dir = node->_link ? node->_link : node;
 
-			pasv_c->append_fmt(" 1 %d %d %13ld %s %2d "
-					, node->_uid, node->_gid, node->_size
-					, _FTP_month[node_tm.tm_mon]
-					, node_tm.tm_mday);
-
-			if (is_old(&cur_tm, &node_tm)) {
-				pasv_c->append_fmt("%d ", 1900 + node_tm.tm_year);
-			} else {
-				pasv_c->append_fmt("%02d:%02d ", node_tm.tm_hour
-						, node_tm.tm_min);
+		lc = s->list_cache_get(&c->_path_real, dir, 0, month);
+		if (lc) {
+			pasv_c->write(&lc->out);
+		} else {
+			for (node = dir->_child; node; node = node->_next) {
+				if (LIST_NODE(&out, node, &cur_tm) < 0) {
+					c->_s		= CODE_451;
+					c->_rmsg_plus	= strerror(errno);
+					goto out;
+				}
 			}
-
-			pasv_c->append(&node->_name);
-			pasv_c->append_raw("\r\n");
-
-			node = node->_next;
+			s->list_cache_put(&c->_path_real, dir, 0, month, &out);
+			pasv_c->write(&out);
 		}
 	}
 	pasv_c->flush();
@@ -1225,15 +1422,22 @@ out:
 	c->reply();
 }
 
+/**
+ * Method on_cmd_NLST will send the name of nodes in directory, or the name
+ * of node itself if it is not directory, to the data connection. The
+ * output of directory is cached the same way as LIST.
+ */
 void FTPD::on_cmd_NLST(FTPD* s, FTPD_client* c)
 {
 	if (!s || !c) {
 		return;
 	}
 
-	int		x;
 	DirNode*	node		= NULL;
+	DirNode*	dir		= NULL;
 	Socket*		pasv_c		= NULL;
+	Buffer		out;
+	struct ftpd_list_cache* lc	= NULL;
 
 	if (!c->_psrv || !c->_pclt) {
 		c->_s = CODE_425;
@@ -1245,8 +1449,7 @@ void FTPD::on_cmd_NLST(FTPD* s, FTPD_client* c)
 		goto out;
 	}
 
-	x = s->_dir.refresh_by_path(&c->_path_real);
-	if (x < 0) {
+	if (s->list_refresh(&c->_path_real) < 0) {
 		c->_s		= CODE_450;
 		c->_rmsg_plus	= _FTP_add_reply_msg[NODE_NOT_FOUND];
 		goto out;
@@ -1260,18 +1463,22 @@ void FTPD::on_cmd_NLST(FTPD* s, FTPD_client* c)
 	node = c->_path_node;
 
 	if (!node->is_dir()) {
-		pasv_c->append(&node->_name);
+		pasv_c->append_raw(node->_name.v(), node->_name.len());
 		pasv_c->append_raw("\r\n");
 	} else {
-		if (node->_link) {
-			node = node->_link->_child;
+		dir = node->_link ? node->_link : node;
+
+		lc = s->list_cache_get(&c->_path_real, dir, 1, 0);
+		if (lc) {
+			pasv_c->write(&lc->out);
 		} else {
-			node = node->_child;
-		}
-		while (node) {
-			pasv_c->append(&node->_name);
-			pasv_c->append_raw("\r\n");
-			node = node->_next;
+			for (node = dir->_child; node; node = node->_next) {
+				out.append_raw(node->_name.v()
+						, node->_name.len());
+				out.append_raw("\r\n");
+			}
+			s->list_cache_put(&c->_path_real, dir, 1, 0, &out);
+			pasv_c->write(&out);
 		}
 	}
 	pasv_c->flush();
@@ -1380,6 +1587,8 @@ void FTPD::on_cmd_STOR(FTPD* s, FTPD_client* c)
 		err = pasv_c->read();
 	}
 
+	s->list_cache_clear();
+
 	x = DirNode::INSERT_CHILD(c->_path_node, c->_path_real.v()
 				, c->_path_base.v());
 	if (x < 0) {
@@ -1420,6 +1629,8 @@ void FTPD::on_cmd_DELE(FTPD* s, FTPD_client* c)
 		goto out;
 	}
 
+	s->list_cache_clear();
+
 	x = DirNode::REMOVE_CHILD_BY_NAME(c->_path_node->_parent
 					, c->_path_base.v());
 	if (x < 0) {
@@ -1528,13 +1739,20 @@ void FTPD::on_cmd_RNTO(FTPD* s, FTPD_client* c)
 		c->_rmsg_plus	= strerror(errno);
 	} else {
 		c->_s = CODE_250;
+		s->list_cache_clear();
 		if (c->_path_base.is_empty()) {
 			DirNode::REMOVE_CHILD_BY_NAME(from_node->_parent
 							, from_base.v());
 			DirNode::INSERT_CHILD(c->_path_node, c->_path_real.v()
 						, from_base.v());
 		} else {
+			// Node is re-inserted to update its parent index and
+			// keep the sort order.
+			DirNode::UNLINK(&from_node->_parent->_child
+					, from_node);
 			from_node->_name.copy(&c->_path_base);
+			DirNode::INSERT(&from_node->_parent->_child
+					, from_node);
 		}
 	}
 out:
@@ -1562,6 +1780,8 @@ void FTPD::on_cmd_RMD(FTPD* s, FTPD_client* c)
 		goto out;
 	}
 
+	s->list_cache_clear();
+
 	x = DirNode::REMOVE_CHILD_BY_NAME(c->_path_node->_parent
 					, c->_path_base.v());
 	if (x < 0) {
@@ -1600,6 +1820,8 @@ void FTPD::on_cmd_MKD(FTPD* s, FTPD_client* c)
 		goto out;
 	}
 
+	s->list_cache_clear();
+
 	x = DirNode::INSERT_CHILD(c->_path_node, c->_path_real.v()
 				, c->_path_base.v());
 	if (x < 0) {
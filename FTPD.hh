@@ -67,6 +67,43 @@ enum _FTP_auth_mode {
 
 extern const char* _FTP_month[12];
 
+//
+// ftpd_list_cache contain the rendered output of LIST or NLST of one
+// directory.
+//
+// Field `path` contain real path of directory, or empty if cache is unused.
+// Field `nlst` is 1 if output is rendered by NLST, or 0 by LIST.
+// Field `month` contain number of months since year 1900 when output is
+// rendered, because LIST print year instead of time for node that is older
+// than six months.
+// Field `mtime` and `ctime` contain the modification and change time of
+// directory when output is rendered.
+// Field `used` contain the last time cache is used.
+// Field `out` contain the rendered output.
+//
+struct ftpd_list_cache {
+	Buffer	path;
+	int	nlst;
+	int	month;
+	long	mtime;
+	long	ctime;
+	size_t	used;
+	Buffer	out;
+
+	ftpd_list_cache()
+	:	path()
+	,	nlst(0)
+	,	month(0)
+	,	mtime(0)
+	,	ctime(0)
+	,	used(0)
+	,	out()
+	{}
+private:
+	ftpd_list_cache(const ftpd_list_cache&);
+	void operator=(const ftpd_list_cache&);
+};
+
 /**
  * @class		: FTPD
  * @attr		:
@@ -76,6 +113,19 @@ extern const char* _FTP_month[12];
  *	- _path		: the real path to directory that the server serve to
  *                        the networks.
  *	- _dir		: Dir object, contain cache of all files in 'path'.
+ *			  Set '_dir._lazy' and '_dir._max_node' before
+ *			  set_path() to load directory only when it is
+ *			  visited by client. The loaded directories are
+ *			  watched, and changes are applied to cache when its
+ *			  inotify descriptor is readable.
+ *	- _list_cache_size	: maximum number of directories that
+ *			  their LIST and NLST output are cached. Default to
+ *			  LIST_CACHE_SIZE, zero to disable cache.
+ *	- _list_cache	: the cached output of LIST and NLST. Cache is
+ *			  dropped when directory modification or change time
+ *			  is changed, or when tree is changed by sync or by
+ *			  client command.
+ *	- _n_list	: counter for the last time cache is used.
  *	- _fd_all	: all file descriptor in the server, used by
  *                        'select()'.
  *	- _fd_read	: the change descriptor, file descriptor that has the
@@ -111,11 +161,24 @@ public:
 	int client_get_path(FTPD_client* c, int check_parm = 1);
 	int client_get_parent_path(FTPD_client* c);
 
+	struct ftpd_list_cache* list_cache_get(Buffer* path, DirNode* dir
+						, int nlst, int month);
+	void list_cache_put(Buffer* path, DirNode* dir, int nlst, int month
+				, const Buffer* out);
+	void list_cache_clear();
+	int list_refresh(Buffer* path);
+
+	static int LIST_CACHE_SIZE;
+	static size_t LIST_CACHE_MAX;
+
 	int		_running;
 	int		_auth_mode;
 	int		_maxfd;
 	Buffer		_path;
 	Dir		_dir;
+	int		_list_cache_size;
+	struct ftpd_list_cache*	_list_cache;
+	size_t		_n_list;
 	fd_set		_fd_all;
 	fd_set		_fd_read;
 	List		_clients;
@@ -4,6 +4,11 @@
 // found in the LICENSE file.
 //
 
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
 #include "File.hh"
 
 namespace vos {
@@ -147,10 +152,87 @@ Error File::BASENAME(Buffer* name, const char* path)
 	return NULL;
 }
 
+//
+// COPY_RANGE will copy at most `len` bytes from file descriptor `src` to
+// `dst`, starting at their current offset, inside the kernel using
+// copy_file_range(2).
+//
+// It will return number of bytes copied, which is less than `len` if the
+// system call is not supported for both files or fail; the rest of file can
+// be copied by other method from the current offset.
+//
+static size_t COPY_RANGE(int src, int dst, size_t len)
+{
+	size_t n = 0;
+
+#ifdef SYS_copy_file_range
+	while (n < len) {
+		long s = syscall(SYS_copy_file_range, src, NULL, dst, NULL
+				, len - n, 0);
+		if (s <= 0) {
+			break;
+		}
+		n += size_t(s);
+	}
+#else
+	(void) src;
+	(void) dst;
+	(void) len;
+#endif
+
+	return n;
+}
+
+//
+// COPY_CLONE will make `dst` share the content of `src`, if both files are
+// in the same file system that support reflink.
+//
+// It will return 0 on success, or -1 if file can not be cloned.
+//
+static int COPY_CLONE(int src, int dst)
+{
+#ifdef FICLONE
+	return ioctl(dst, FICLONE, src) == 0 ? 0 : -1;
+#else
+	(void) src;
+	(void) dst;
+
+	return -1;
+#endif
+}
+
+//
+// COPY_SEND will copy at most `len` bytes from file descriptor `src` to
+// `dst`, starting at their current offset, inside the kernel using
+// sendfile(2).
+//
+// It will return number of bytes copied, which is less than `len` if the
+// system call fail.
+//
+static size_t COPY_SEND(int src, int dst, size_t len)
+{
+	size_t n = 0;
+
+	while (n < len) {
+		ssize_t s = sendfile(dst, src, NULL, len - n);
+		if (s <= 0) {
+			break;
+		}
+		n += size_t(s);
+	}
+
+	return n;
+}
+
 /**
  * Method COPY(src,dst) will copy file 'src' to 'dst', create a new file if
  * 'dst' is not exist, or overwrite 'dst' if already exist.
  *
+ * If 'src' is regular file, it is copied inside the kernel using
+ * copy_file_range(2), or cloned if both files is in file system that
+ * support reflink, or copied using sendfile(2). The rest of file that can
+ * not be copied by those methods is copied through the file buffer.
+ *
  * NOTE: use 'rename()' system call for easy and fast move.
  *
  * On success it will return NULL, otherwise it will return error:
@@ -167,6 +249,7 @@ Error File::COPY(const char* src, const char* dst)
 	Error err;
 	File from;
 	File to;
+	struct stat st;
 
 	err = from.open_ro(src);
 	if (err != NULL) {
@@ -178,6 +261,19 @@ Error File::COPY(const char* src, const char* dst)
 		return err;
 	}
 
+	if (fstat(from._d, &st) == 0 && S_ISREG(st.st_mode)
+	&&  st.st_size > 0) {
+		size_t len = size_t(st.st_size);
+		size_t n = COPY_RANGE(from._d, to._d, len);
+
+		if (n == 0 && COPY_CLONE(from._d, to._d) == 0) {
+			return NULL;
+		}
+		if (n < len) {
+			COPY_SEND(from._d, to._d, len - n);
+		}
+	}
+
 	do {
 		err = from.read();
 		if (err != NULL) {
@@ -531,7 +627,7 @@ Error File::read(size_t n)
 	while (n > 0) {
 		ssize_t s = ::read(_d, &_v[_i], n);
 		if (s < 0) {
-			if (s == EAGAIN || s == EWOULDBLOCK) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
 				break;
 			}
 			return Error::SYS();
@@ -906,10 +1002,11 @@ Error File::flush()
 		x	+= size_t(s);
 		_i	-= size_t(s);
 	}
-	_i = x;
-	_size += _i;
-
-	reset();
+	// Buffer content is not cleared, writer always append after _i.
+	if (x) {
+		_size += off_t(x);
+		_v[0] = '\0';
+	}
 
 	return NULL;
 }
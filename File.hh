@@ -140,6 +140,8 @@ protected:
 	Error refill(size_t read_min = 0);
 
 private:
+	friend class IOUring;
+
 	File(const File&);
 	void operator=(const File&);
 
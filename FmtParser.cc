@@ -190,6 +190,7 @@ Error FmtParser::parse_flag_width_prec()
  *
  * '%'-> ...--> ['h'] --> [conversion]
  *           \- ['l'] -/
+ *           \- ['z'] -/
  *           \- ['L'] -/
  *
  * On success it will non-zero flag value and modified the pointer to
@@ -205,6 +206,7 @@ void FmtParser::parse_flag_length_mod()
 		_p++;
 		break;
 	case 'l':
+	case 'z':
 		_flag |= FL_LONG;
 		_flags.appendc(*_p);
 		_p++;
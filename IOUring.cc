@@ -0,0 +1,678 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define LIBVOS_IO_URING 1
+#endif
+
+#include "IOUring.hh"
+
+namespace vos {
+
+Error ErrIOUringFull("IOUring: too many requests in flight");
+Error ErrIOUringNotOpen("IOUring: file is not open");
+
+const char* IOUring::__cname = "IOUring";
+
+unsigned int IOUring::ENTRIES = 64;
+
+//
+// io_uring_req contain one request that is queued or in flight.
+//
+// Field `len` contain number of bytes to be read or written.
+// Field `next` contain the next free request.
+//
+struct io_uring_req {
+	File*			file;
+	void*			data;
+	int			op;
+	size_t			len;
+	struct io_uring_req*	next;
+};
+
+//
+// io_uring_map contain the submission and completion queue of io_uring that
+// is shared with kernel, and the buffers registered to kernel.
+//
+struct io_uring_map {
+	void*			sq;
+	size_t			sq_size;
+	void*			cq;
+	size_t			cq_size;
+	void*			sqes;
+	size_t			sqes_size;
+	unsigned int*		sq_tail;
+	unsigned int		sq_mask;
+	unsigned int*		sq_array;
+	unsigned int*		cq_head;
+	unsigned int*		cq_tail;
+	unsigned int		cq_mask;
+	void*			cqes;
+	struct iovec*		reg;
+	int			n_reg;
+};
+
+#ifdef LIBVOS_IO_URING
+
+//
+// SETUP, ENTER, and REGISTER call the io_uring system calls, which does not
+// have wrapper in C library.
+//
+static int SETUP(unsigned int entries, struct io_uring_params* p)
+{
+	return int(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int ENTER(int fd, unsigned int to_submit, unsigned int min_complete
+		, unsigned int flags)
+{
+	return int(syscall(__NR_io_uring_enter, fd, to_submit, min_complete
+			, flags, NULL, 0));
+}
+
+static int REGISTER(int fd, unsigned int opcode, void* arg
+		, unsigned int nr_args)
+{
+	return int(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+//
+// MAP will map the queues of io_uring `fd` that is created with parameters
+// `p` into `map`.
+//
+// It will return 0 on success, or -1 if fail.
+//
+static int MAP(int fd, struct io_uring_params* p, struct io_uring_map* map)
+{
+	char* sq = NULL;
+	char* cq = NULL;
+
+	map->sq_size = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+	map->cq_size = p->cq_off.cqes
+			+ p->cq_entries * sizeof(struct io_uring_cqe);
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (map->cq_size > map->sq_size) {
+			map->sq_size = map->cq_size;
+		}
+		map->cq_size = 0;
+	}
+
+	map->sq = mmap(NULL, map->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED
+			, fd, IORING_OFF_SQ_RING);
+	if (map->sq == MAP_FAILED) {
+		map->sq = NULL;
+		return -1;
+	}
+
+	if (map->cq_size) {
+		map->cq = mmap(NULL, map->cq_size, PROT_READ | PROT_WRITE
+				, MAP_SHARED, fd, IORING_OFF_CQ_RING);
+		if (map->cq == MAP_FAILED) {
+			map->cq = NULL;
+			return -1;
+		}
+	}
+
+	map->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+	map->sqes = mmap(NULL, map->sqes_size, PROT_READ | PROT_WRITE
+			, MAP_SHARED, fd, IORING_OFF_SQES);
+	if (map->sqes == MAP_FAILED) {
+		map->sqes = NULL;
+		return -1;
+	}
+
+	sq = (char*) map->sq;
+	cq = map->cq ? (char*) map->cq : sq;
+
+	map->sq_tail	= (unsigned int*) (sq + p->sq_off.tail);
+	map->sq_mask	= *(unsigned int*) (sq + p->sq_off.ring_mask);
+	map->sq_array	= (unsigned int*) (sq + p->sq_off.array);
+	map->cq_head	= (unsigned int*) (cq + p->cq_off.head);
+	map->cq_tail	= (unsigned int*) (cq + p->cq_off.tail);
+	map->cq_mask	= *(unsigned int*) (cq + p->cq_off.ring_mask);
+	map->cqes	= cq + p->cq_off.cqes;
+
+	return 0;
+}
+
+#endif
+
+//
+// UNMAP will unmap the queues of io_uring in `map`.
+//
+static void UNMAP(struct io_uring_map* map)
+{
+	if (map->sqes) {
+		munmap(map->sqes, map->sqes_size);
+	}
+	if (map->cq) {
+		munmap(map->cq, map->cq_size);
+	}
+	if (map->sq) {
+		munmap(map->sq, map->sq_size);
+	}
+	free(map->reg);
+	free(map);
+}
+
+IOUring::IOUring()
+:	_fd(-1)
+,	_n_entry(0)
+,	_n_queue(0)
+,	_n_flight(0)
+,	_map(NULL)
+,	_reqs(NULL)
+,	_free(NULL)
+,	_pend(NULL)
+,	_done(NULL)
+,	_n_done(0)
+{}
+
+IOUring::~IOUring()
+{
+	close();
+}
+
+/**
+ * Method open(entries,use_ring) will create io_uring that can hold
+ * `entries` requests in flight, default to ENTRIES. If `use_ring` is 0, or
+ * io_uring is not available in the kernel, requests are executed when
+ * they are submitted.
+ *
+ * On success it will return NULL, otherwise it will return error.
+ */
+Error IOUring::open(unsigned int entries, int use_ring)
+{
+	close();
+
+	if (entries == 0) {
+		entries = ENTRIES;
+	}
+
+#ifdef LIBVOS_IO_URING
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof(p));
+
+	if (use_ring) {
+		_fd = SETUP(entries, &p);
+	}
+	if (_fd >= 0) {
+		_map = (struct io_uring_map*) calloc(1, sizeof(*_map));
+		if (! _map) {
+			close();
+			return ErrOutOfMemory;
+		}
+
+		// Reading from the current file offset require kernel
+		// 5.6, use fallback on older kernel.
+		if (! (p.features & IORING_FEAT_RW_CUR_POS)
+		||  MAP(_fd, &p, _map) < 0) {
+			UNMAP(_map);
+			_map = NULL;
+			::close(_fd);
+			_fd = -1;
+		} else {
+			entries = p.sq_entries;
+		}
+	}
+#else
+	(void) use_ring;
+#endif
+
+	_reqs = (struct io_uring_req*) calloc(entries, sizeof(*_reqs));
+	_pend = (struct io_uring_req**) calloc(entries, sizeof(*_pend));
+	_done = (struct io_uring_req**) calloc(entries, sizeof(*_done));
+	if (! _reqs || ! _pend || ! _done) {
+		close();
+		return ErrOutOfMemory;
+	}
+
+	for (unsigned int x = 0; x + 1 < entries; x++) {
+		_reqs[x].next = &_reqs[x + 1];
+	}
+	_free		= _reqs;
+	_n_entry	= entries;
+
+	if (LIBVOS_DEBUG) {
+		printf("[%s] open: entries %u, ring %d\n", __cname, entries
+			, _fd);
+	}
+
+	return NULL;
+}
+
+/**
+ * Method close will release the io_uring. All requests that are in flight
+ * are cancelled by kernel, and their files should not be used until they
+ * are closed.
+ */
+void IOUring::close()
+{
+	if (_map) {
+		UNMAP(_map);
+		_map = NULL;
+	}
+	if (_fd >= 0) {
+		::close(_fd);
+		_fd = -1;
+	}
+
+	free(_reqs);
+	free(_pend);
+	free(_done);
+
+	_reqs		= NULL;
+	_free		= NULL;
+	_pend		= NULL;
+	_done		= NULL;
+	_n_entry	= 0;
+	_n_queue	= 0;
+	_n_flight	= 0;
+	_n_done		= 0;
+}
+
+/**
+ * Method fd will return the io_uring file descriptor, that is readable
+ * when there is result of request that can be returned by wait(), so it
+ * can be watched by select() or poll() in event loop with other
+ * descriptors.
+ *
+ * In fallback mode it will return -1, and the result of request is ready
+ * right after submit().
+ */
+int IOUring::fd()
+{
+	return _fd;
+}
+
+/**
+ * Method is_ring will return 1 if requests are executed by io_uring in the
+ * kernel, or 0 if they are executed in fallback mode.
+ */
+int IOUring::is_ring()
+{
+	return _fd >= 0;
+}
+
+/**
+ * Method register_files(files,n) will register the buffer of `n` files to
+ * the kernel, so reading and writing their buffer does not need to map
+ * the buffer on each request. The previously registered buffers are
+ * unregistered.
+ *
+ * The buffer of registered file must not be resized until the io_uring is
+ * closed or another files are registered, otherwise it is read and
+ * written as unregistered buffer.
+ *
+ * On success it will return NULL, otherwise it will return error.
+ */
+Error IOUring::register_files(File** files, int n)
+{
+	if (! _map) {
+		return NULL;
+	}
+
+#ifdef LIBVOS_IO_URING
+	if (_map->reg) {
+		REGISTER(_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+		free(_map->reg);
+		_map->reg = NULL;
+		_map->n_reg = 0;
+	}
+	if (n <= 0) {
+		return NULL;
+	}
+
+	_map->reg = (struct iovec*) calloc(size_t(n), sizeof(struct iovec));
+	if (! _map->reg) {
+		return ErrOutOfMemory;
+	}
+
+	for (int x = 0; x < n; x++) {
+		_map->reg[x].iov_base	= files[x]->_v;
+		_map->reg[x].iov_len	= files[x]->_l + 1;
+	}
+
+	if (REGISTER(_fd, IORING_REGISTER_BUFFERS, _map->reg
+			, (unsigned int) n) < 0) {
+		Error err = Error::SYS();
+
+		free(_map->reg);
+		_map->reg = NULL;
+
+		return err;
+	}
+
+	_map->n_reg = n;
+#else
+	(void) files;
+	(void) n;
+#endif
+
+	return NULL;
+}
+
+/**
+ * Method read(file,data) will queue request to fill the buffer of `file`
+ * from its current offset. The `data` is returned with the result of
+ * request by wait().
+ *
+ * On success it will return NULL, otherwise it will return error:
+ *
+ * - ErrIOUringNotOpen if file is not open.
+ * - ErrFileWriteOnly if file is opened as write only.
+ * - ErrIOUringFull if there are already `_n_entry` requests in flight.
+ */
+Error IOUring::read(File* file, void* data)
+{
+	if (file->_status == FILE_OPEN_NO) {
+		return ErrIOUringNotOpen;
+	}
+	if (file->_status == O_WRONLY) {
+		return ErrFileWriteOnly;
+	}
+	return queue(IO_URING_READ, file, data);
+}
+
+/**
+ * Method write(file,data) will queue request to write the content of
+ * `file` buffer into its current offset. The `data` is returned with the
+ * result of request by wait().
+ *
+ * On success it will return NULL, otherwise it will return error:
+ *
+ * - ErrIOUringNotOpen if file is not open.
+ * - ErrFileReadOnly if file is opened as read only.
+ * - ErrIOUringFull if there are already `_n_entry` requests in flight.
+ */
+Error IOUring::write(File* file, void* data)
+{
+	if (file->_status == FILE_OPEN_NO) {
+		return ErrIOUringNotOpen;
+	}
+	if (file->_status == O_RDONLY) {
+		return ErrFileReadOnly;
+	}
+	return queue(IO_URING_WRITE, file, data);
+}
+
+//
+// Method queue(op,file,data) will add a new request into submission queue,
+// or into pending list in fallback mode.
+//
+Error IOUring::queue(int op, File* file, void* data)
+{
+	struct io_uring_req* req = _free;
+
+	if (! req) {
+		return ErrIOUringFull;
+	}
+	_free = req->next;
+
+	req->file	= file;
+	req->data	= data;
+	req->op		= op;
+	req->next	= NULL;
+
+	if (op == IO_URING_READ) {
+		file->_i	= 0;
+		file->_p	= 0;
+		file->_v[0]	= '\0';
+		req->len	= file->_l;
+	} else {
+		req->len	= file->_i;
+	}
+
+	_n_flight++;
+
+#ifdef LIBVOS_IO_URING
+	if (_map) {
+		unsigned int		tail	= *_map->sq_tail;
+		unsigned int		idx	= tail & _map->sq_mask;
+		struct io_uring_sqe*	sqe	= NULL;
+
+		sqe = &((struct io_uring_sqe*) _map->sqes)[idx];
+		memset(sqe, 0, sizeof(*sqe));
+
+		sqe->opcode	= op == IO_URING_READ ? IORING_OP_READ
+						: IORING_OP_WRITE;
+		sqe->fd		= file->_d;
+		sqe->addr	= (uint64_t) (uintptr_t) file->_v;
+		sqe->len	= (uint32_t) req->len;
+		sqe->off	= (uint64_t) -1;
+		sqe->user_data	= (uint64_t) (uintptr_t) req;
+
+		for (int x = 0; x < _map->n_reg; x++) {
+			if (_map->reg[x].iov_base == file->_v
+			&&  _map->reg[x].iov_len > req->len) {
+				sqe->opcode = op == IO_URING_READ
+						? IORING_OP_READ_FIXED
+						: IORING_OP_WRITE_FIXED;
+				sqe->buf_index = (uint16_t) x;
+				break;
+			}
+		}
+
+		_map->sq_array[idx] = idx;
+		__atomic_store_n(_map->sq_tail, tail + 1, __ATOMIC_RELEASE);
+		_n_queue++;
+
+		return NULL;
+	}
+#endif
+
+	_pend[_n_queue++] = req;
+
+	return NULL;
+}
+
+/**
+ * Method submit will submit all queued requests to kernel without waiting
+ * for their result. In fallback mode, all queued requests are executed.
+ *
+ * On success it will return NULL, otherwise it will return error.
+ */
+Error IOUring::submit()
+{
+	if (_n_queue == 0) {
+		return NULL;
+	}
+
+#ifdef LIBVOS_IO_URING
+	if (_map) {
+		// Kernel stop submitting at the first request that fail
+		// to be prepared, e.g. invalid file descriptor, and
+		// return its result immediately, so keep submitting the
+		// rest.
+		while (_n_queue > 0) {
+			int s = ENTER(_fd, _n_queue, 0, 0);
+			if (s < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				if (errno == EAGAIN || errno == EBUSY) {
+					return NULL;
+				}
+				return Error::SYS();
+			}
+			if (s == 0) {
+				break;
+			}
+			_n_queue -= (unsigned int) s;
+		}
+		return NULL;
+	}
+#endif
+
+	for (unsigned int x = 0; x < _n_queue; x++) {
+		struct io_uring_req*	req	= _pend[x];
+		File*			f	= req->file;
+		ssize_t			s	= 0;
+
+		if (req->op == IO_URING_READ) {
+			s = ::read(f->_d, f->_v, req->len);
+		} else {
+			s = ::write(f->_d, f->_v, req->len);
+		}
+		if (s < 0) {
+			s = -errno;
+		}
+
+		// The result is kept temporarily in `len` until it is
+		// returned by wait().
+		req->len	= size_t(s);
+		_done[_n_done++] = req;
+	}
+	_n_queue = 0;
+
+	return NULL;
+}
+
+//
+// Method complete(req,res,out) will update the buffer of file in request
+// `req` with its result `res`, release the request, and save the result
+// into `out`.
+//
+void IOUring::complete(struct io_uring_req* req, int res
+			, struct io_uring_res* out)
+{
+	File* f = req->file;
+
+	if (req->op == IO_URING_READ) {
+		f->_i = res > 0 ? size_t(res) : 0;
+	} else if (res > 0) {
+		size_t n = size_t(res);
+
+		if (n < f->_i) {
+			memmove(f->_v, &f->_v[n], f->_i - n);
+			f->_i -= n;
+		} else {
+			f->_i = 0;
+		}
+	}
+	f->_v[f->_i] = '\0';
+
+	out->file	= f;
+	out->data	= req->data;
+	out->op		= req->op;
+	out->res	= res;
+
+	req->next	= _free;
+	_free		= req;
+	_n_flight--;
+}
+
+//
+// Method reap(res,n) will save at most `n` results of completed requests
+// into `res`, and return number of saved results.
+//
+int IOUring::reap(struct io_uring_res* res, int n)
+{
+	int got = 0;
+
+#ifdef LIBVOS_IO_URING
+	if (_map) {
+		unsigned int head = *_map->cq_head;
+		unsigned int tail = __atomic_load_n(_map->cq_tail
+						, __ATOMIC_ACQUIRE);
+		struct io_uring_cqe* cqes = (struct io_uring_cqe*) _map->cqes;
+
+		for (; head != tail && got < n; head++, got++) {
+			struct io_uring_cqe* cqe = &cqes[head & _map->cq_mask];
+
+			complete((struct io_uring_req*) (uintptr_t)
+				cqe->user_data, cqe->res, &res[got]);
+		}
+
+		__atomic_store_n(_map->cq_head, head, __ATOMIC_RELEASE);
+
+		return got;
+	}
+#endif
+
+	for (; unsigned(got) < _n_done && got < n; got++) {
+		complete(_done[got], int(ssize_t(_done[got]->len)), &res[got]);
+	}
+
+	_n_done -= unsigned(got);
+	if (_n_done > 0) {
+		memmove(_done, &_done[got], _n_done * sizeof(*_done));
+	}
+
+	return got;
+}
+
+/**
+ * Method wait(res,n,min) will submit all queued requests, and wait until
+ * at least `min` requests, or all requests in flight if less than `min`,
+ * are completed. At most `n` results are saved into `res`.
+ *
+ * It will return number of results saved into `res`, or -1 if fail.
+ */
+int IOUring::wait(struct io_uring_res* res, int n, int min)
+{
+	int got = 0;
+
+	if (min > n) {
+		min = n;
+	}
+	if (min > int(_n_flight)) {
+		min = int(_n_flight);
+	}
+
+#ifdef LIBVOS_IO_URING
+	if (_map) {
+		if (submit() != NULL) {
+			return -1;
+		}
+
+		got = reap(res, n);
+
+		while (got < min) {
+			// Only wait for requests that has been submitted,
+			// otherwise kernel will wait forever.
+			unsigned int want = unsigned(min - got);
+
+			if (want > _n_flight - _n_queue) {
+				want = _n_flight - _n_queue;
+			}
+			if (want == 0) {
+				break;
+			}
+
+			int s = ENTER(_fd, 0, want, IORING_ENTER_GETEVENTS);
+			if (s < 0 && errno != EINTR) {
+				return -1;
+			}
+
+			got += reap(&res[got], n - got);
+		}
+
+		return got;
+	}
+#endif
+
+	if (submit() != NULL) {
+		return -1;
+	}
+
+	return reap(res, n);
+}
+
+} // namespace::vos
+// vi: ts=8 sw=8 tw=80:
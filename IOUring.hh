@@ -0,0 +1,113 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#ifndef _LIBVOS_IOURING_HH
+#define _LIBVOS_IOURING_HH 1
+
+#include "File.hh"
+
+namespace vos {
+
+extern Error ErrIOUringFull;
+extern Error ErrIOUringNotOpen;
+
+enum _io_uring_op {
+	IO_URING_READ	= 0
+,	IO_URING_WRITE
+};
+
+//
+// io_uring_res contain the result of one request, returned by
+// IOUring::wait().
+//
+// Field `file` contain the file that is read or written.
+// Field `data` contain user data that is passed when request is queued.
+// Field `op` contain type of request, IO_URING_READ or IO_URING_WRITE.
+// Field `res` contain number of bytes read or written, or negative errno
+// if request fail.
+//
+struct io_uring_res {
+	File*	file;
+	void*	data;
+	int	op;
+	int	res;
+};
+
+struct io_uring_req;
+struct io_uring_map;
+
+//
+// Class IOUring will read and write many files or sockets using one system
+// call, by queueing the requests into io_uring of the kernel and reaping
+// their results later.
+//
+// Read request fill the buffer of file the same way as File::read(), from
+// the current file offset. Write request write all content of file buffer
+// to the current file offset, and remove the written content from buffer,
+// the same way as File::flush(). The file should not be used until the
+// result of its request is returned by wait().
+//
+// If io_uring is not available, because it is not supported or disabled
+// in the kernel, IOUring fallback to execute each request with read(2) or
+// write(2) when they are submitted, so caller does not need to handle both
+// cases.
+//
+// Field ENTRIES contain default maximum number of requests in flight.
+//
+// Field `_fd` contain io_uring file descriptor, or -1 in fallback mode.
+// Field `_n_entry` contain maximum number of requests in flight.
+// Field `_n_queue` contain number of requests that has been queued but not
+// submitted yet.
+// Field `_n_flight` contain number of requests that has been queued and
+// their result has not been returned by wait().
+//
+class IOUring {
+public:
+	static const char* __cname;
+	static unsigned int ENTRIES;
+
+	IOUring();
+	~IOUring();
+
+	Error open(unsigned int entries = 0, int use_ring = 1);
+	void close();
+
+	int fd();
+	int is_ring();
+
+	Error register_files(File** files, int n);
+
+	Error read(File* file, void* data = NULL);
+	Error write(File* file, void* data = NULL);
+
+	Error submit();
+	int wait(struct io_uring_res* res, int n, int min = 1);
+
+	int		_fd;
+	unsigned int	_n_entry;
+	unsigned int	_n_queue;
+	unsigned int	_n_flight;
+
+private:
+	struct io_uring_map*	_map;
+	struct io_uring_req*	_reqs;
+	struct io_uring_req*	_free;
+	struct io_uring_req**	_pend;
+	struct io_uring_req**	_done;
+	unsigned int		_n_done;
+
+	Error queue(int op, File* file, void* data);
+	void complete(struct io_uring_req* req, int res
+			, struct io_uring_res* out);
+	int reap(struct io_uring_res* res, int n);
+
+	IOUring(const IOUring&);
+	void operator=(const IOUring&);
+};
+
+} // namespace::vos
+#endif
+// vi: ts=8 sw=8 tw=80:
@@ -4,6 +4,7 @@
 // found in the LICENSE file.
 //
 
+#include <time.h>
 #include "libvos.hh"
 
 #if (NO_DEFAULT_LIBS)
@@ -55,6 +56,18 @@ int LIBVOS_DEBUG = getenv("LIBVOS_DEBUG") == NULL
 			? 0
 			: atoi(getenv("LIBVOS_DEBUG"));
 
+/**
+ * Function NOW() will return current monotonic time in seconds.
+ */
+double NOW()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
+
 } // namespace::vos
 
 // vi: ts=8 sw=8 tw=80:
@@ -34,6 +34,36 @@ namespace vos {
 
 extern int LIBVOS_DEBUG;
 
+double NOW();
+
+//
+// FNV1A_32 will return 32 bit FNV-1a hash of `len` bytes in `v`.
+//
+inline uint32_t FNV1A_32(const char* v, size_t len)
+{
+	uint32_t h = 2166136261U;
+
+	for (size_t x = 0; x < len; x++) {
+		h ^= (uint8_t) v[x];
+		h *= 16777619U;
+	}
+	return h;
+}
+
+//
+// FNV1A_64 will return 64 bit FNV-1a hash of `len` bytes in `v`.
+//
+inline uint64_t FNV1A_64(const char* v, size_t len)
+{
+	uint64_t h = 14695981039346656037ULL;
+
+	for (size_t x = 0; x < len; x++) {
+		h ^= (uint8_t) v[x];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
 } // namespace::vos
 
 #endif
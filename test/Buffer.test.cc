@@ -1416,6 +1416,42 @@ void test_appendd()
 			5,
 			16,
 		},
+		{
+			"With leading zero fraction (1.05, 3)",
+			"",
+			1.05,
+			3,
+			"1.050",
+			5,
+			16,
+		},
+		{
+			"With negative fraction (-0.5, 3)",
+			"",
+			-0.5,
+			3,
+			"-0.500",
+			6,
+			16,
+		},
+		{
+			"With zero precision (1.5, 0)",
+			"",
+			1.5,
+			0,
+			"1.0",
+			3,
+			16,
+		},
+		{
+			"With zero precision (-12.75, 0)",
+			"",
+			-12.75,
+			0,
+			"-12.0",
+			5,
+			16,
+		},
 	};
 
 	size_t tests_len = ARRAY_SIZE(tests);
@@ -1437,6 +1473,96 @@ void test_appendd()
 	}
 }
 
+void test_appendd_shortest()
+{
+	struct {
+		const char*  desc;
+		const double in_d;
+		const char*  exp_v;
+		const size_t exp_len;
+	} const tests[] = {
+		{
+			"With (0.1)",
+			0.1,
+			"0.1",
+			3,
+		},
+		{
+			"With (-123.456)",
+			-123.456,
+			"-123.456",
+			8,
+		},
+		{
+			"With (100)",
+			100,
+			"100.0",
+			5,
+		},
+		{
+			"With (0.000001)",
+			0.000001,
+			"0.000001",
+			8,
+		},
+		{
+			"With (1e300)",
+			1e300,
+			"1e+300",
+			6,
+		},
+		{
+			"With (5e-324)",
+			5e-324,
+			"5e-324",
+			6,
+		},
+	};
+
+	size_t tests_len = ARRAY_SIZE(tests);
+
+	for (size_t x = 0; x < tests_len; x++) {
+		T.start("appendd_shortest()", tests[x].desc);
+
+		Buffer b;
+
+		b.appendd_shortest(tests[x].in_d);
+
+		T.expect_string(tests[x].exp_v, b.v(), vos::IS_EQUAL);
+		T.expect_unsigned(tests[x].exp_len, b.len(), vos::IS_EQUAL);
+
+		T.ok();
+	}
+}
+
+void test_appendd_roundtrip()
+{
+	T.start("appendd_shortest()", "With round-trip");
+
+	Buffer b;
+	uint64_t u = 88172645463325252ULL;
+	double d;
+
+	for (int x = 0; x < 100000; x++) {
+		// xorshift64
+		u ^= u << 13;
+		u ^= u >> 7;
+		u ^= u << 17;
+
+		memcpy(&d, &u, sizeof(d));
+		if (d != d || d - d != 0) {
+			continue;
+		}
+
+		b.reset();
+		b.appendd_shortest(d);
+
+		T.expect_signed(1, strtod(b.v(), NULL) == d, vos::IS_EQUAL);
+	}
+
+	T.ok();
+}
+
 void test_append()
 {
 	struct {
@@ -2557,6 +2683,309 @@ void test_PARSE_INT()
 	}
 }
 
+void test_PARSE_I64()
+{
+	struct {
+		const char*   desc;
+		const char*   init;
+		const size_t  len;
+		const int64_t exp_v;
+		const size_t  exp_n;
+		const Error   exp_err;
+	} const tests[] = {
+		{
+			"With empty string",
+			"",
+			0,
+			0,
+			0,
+			0,
+		},
+		{
+			"With LONG_MAX",
+			"9223372036854775807",
+			19,
+			INT64_MAX,
+			19,
+			0,
+		},
+		{
+			"With LONG_MIN",
+			"-9223372036854775808",
+			20,
+			INT64_MIN,
+			20,
+			0,
+		},
+		{
+			"With out of range LONG_MAX",
+			"9223372036854775808",
+			19,
+			0,
+			0,
+			vos::ErrNumRange,
+		},
+		{
+			"With leading zeros",
+			"  +00000000000000000000000012345678912",
+			38,
+			12345678912,
+			38,
+			0,
+		},
+		{
+			"With span (12345678|9)",
+			"123456789",
+			8,
+			12345678,
+			8,
+			0,
+		},
+		{
+			"With number and string (1234567890123asdf)",
+			"1234567890123asdf",
+			17,
+			1234567890123,
+			13,
+			0,
+		},
+	};
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("PARSE_I64()", tests[x].desc);
+
+		int64_t v = 0;
+		size_t n = 0;
+
+		Error err = Buffer::PARSE_I64(tests[x].init, tests[x].len, &v
+			, &n);
+
+		T.expect_signed(1, tests[x].exp_err == err, vos::IS_EQUAL);
+		T.expect_signed(tests[x].exp_v, v, vos::IS_EQUAL);
+		T.expect_unsigned(tests[x].exp_n, n, vos::IS_EQUAL);
+
+		T.ok();
+	}
+}
+
+void test_PARSE_U64()
+{
+	struct {
+		const char*    desc;
+		const char*    init;
+		const uint64_t exp_v;
+		const Error    exp_err;
+	} const tests[] = {
+		{
+			"With ULONG_MAX",
+			"18446744073709551615",
+			UINT64_MAX,
+			0,
+		},
+		{
+			"With out of range ULONG_MAX",
+			"18446744073709551616",
+			0,
+			vos::ErrNumRange,
+		},
+		{
+			"With out of range 20 digits",
+			"28446744073709551615",
+			0,
+			vos::ErrNumRange,
+		},
+		{
+			"With 20 digits",
+			"10000000000000000000",
+			10000000000000000000ULL,
+			0,
+		},
+		{
+			"With negative",
+			"-1",
+			0,
+			0,
+		},
+	};
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("PARSE_U64()", tests[x].desc);
+
+		uint64_t v = 0;
+
+		Error err = Buffer::PARSE_U64(tests[x].init
+			, strlen(tests[x].init), &v);
+
+		T.expect_signed(1, tests[x].exp_err == err, vos::IS_EQUAL);
+		T.expect_unsigned(tests[x].exp_v, v, vos::IS_EQUAL);
+
+		T.ok();
+	}
+}
+
+void test_PARSE_DOUBLE()
+{
+	const char* tests[] = {
+		"0"
+	,	"-0.0"
+	,	"1.05"
+	,	".5"
+	,	"5."
+	,	"-123.456e-7"
+	,	"1e22"
+	,	"1e23"
+	,	"0.000000000000000000000000000001"
+	,	"3.14159265358979323846264338327950288"
+	,	"9007199254740993"
+	,	"2.2250738585072014e-308"
+	,	"1.7976931348623157e308"
+	};
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("PARSE_DOUBLE()", tests[x]);
+
+		double v = -1;
+		size_t n = 0;
+		size_t len = strlen(tests[x]);
+
+		Error err = Buffer::PARSE_DOUBLE(tests[x], len, &v, &n);
+
+		T.expect_signed(1, err == NULL, vos::IS_EQUAL);
+		T.expect_signed(1, strtod(tests[x], NULL) == v, vos::IS_EQUAL);
+		T.expect_unsigned(len, n, vos::IS_EQUAL);
+
+		T.ok();
+	}
+
+	T.start("PARSE_DOUBLE()", "With span");
+
+	double v = 0;
+	size_t n = 0;
+
+	Buffer::PARSE_DOUBLE("12.5e3|7", 6, &v, &n);
+
+	T.expect_double(12.5e3, v, vos::IS_EQUAL);
+	T.expect_unsigned(6, n, vos::IS_EQUAL);
+
+	T.ok();
+
+	T.start("PARSE_DOUBLE()", "With out of range");
+
+	Error err = Buffer::PARSE_DOUBLE("1e309", 5, &v, &n);
+
+	T.expect_signed(1, err == vos::ErrNumRange, vos::IS_EQUAL);
+
+	T.ok();
+
+	T.start("PARSE_DOUBLE()", "With too long number");
+
+	Buffer b;
+
+	b.append_raw("0.", 2);
+	for (int x = 0; x < 600; x++) {
+		b.appendc('1');
+	}
+
+	err = Buffer::PARSE_DOUBLE(b.v(), b.len(), &v, &n);
+
+	T.expect_signed(1, err == vos::ErrNumRange, vos::IS_EQUAL);
+
+	T.ok();
+}
+
+void test_PARSE_LINT()
+{
+	struct {
+		const char* desc;
+		const char* in;
+		size_t      in_len;
+		long int    exp;
+		size_t      exp_n;
+	} const tests[] = {{
+		"With decimal"
+	,	"-1234|5"
+	,	7
+	,	-1234
+	,	5
+	},{
+		"With hexadecimal"
+	,	"0x1fZ"
+	,	5
+	,	31
+	,	4
+	},{
+		"With hexadecimal in span"
+	,	"0xff"
+	,	3
+	,	15
+	,	3
+	},{
+		"With hexadecimal without digit"
+	,	"0xg"
+	,	3
+	,	0
+	,	1
+	},{
+		"With octal"
+	,	"-0178"
+	,	5
+	,	-15
+	,	4
+	},{
+		"With leading zeros longer than 72 characters"
+	,	"0000000000000000000000000000000000000000"
+		"0000000000000000000000000000000000000017"
+	,	80
+	,	15
+	,	80
+	}};
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("PARSE_LINT()", tests[x].desc);
+
+		long int v = -1;
+		size_t n = 0;
+
+		Error err = Buffer::PARSE_LINT(tests[x].in, tests[x].in_len
+			, &v, &n);
+
+		T.expect_signed(1, err == NULL, vos::IS_EQUAL);
+		T.expect_signed(tests[x].exp, v, vos::IS_EQUAL);
+		T.expect_unsigned(tests[x].exp_n, n, vos::IS_EQUAL);
+
+		T.ok();
+	}
+
+	T.start("PARSE_LINT()", "With out of range");
+
+	long int v = 0;
+	Error err = Buffer::PARSE_LINT("0x10000000000000000", 19, &v);
+
+	T.expect_signed(1, err == vos::ErrNumRange, vos::IS_EQUAL);
+
+	err = Buffer::PARSE_LINT("-0x8000000000000000", 19, &v);
+
+	T.expect_signed(1, err == NULL, vos::IS_EQUAL);
+	T.expect_signed(LONG_MIN, v, vos::IS_EQUAL);
+
+	T.ok();
+}
+
+void test_to_double()
+{
+	T.start("to_double()");
+
+	Buffer b("-1.5|", 4);
+	double got = 0;
+
+	Error err = b.to_double(&got);
+
+	T.expect_signed(1, err == NULL, vos::IS_EQUAL);
+	T.expect_double(-1.5, got, vos::IS_EQUAL);
+
+	T.ok();
+}
+
 void test_append_fmt()
 {
 	const char* exps[] = {
@@ -2610,6 +3039,20 @@ void test_append_fmt()
 	b.append_fmt("%.3f", d);
 
 	expectString(exps[exp_idx++], b.chars(), vos::IS_EQUAL);
+
+	b.reset();
+	b.append_fmt("[%d.%02d.%02d %02d:%02d] %s %lu %zu %c %u%%"
+		, 2017, 6, 3, 0, 59, "test", 1234567890123UL
+		, (size_t) 42, 'c', 7U);
+
+	expectString("[2017.06.03 00:59] test 1234567890123 42 c 7%"
+		, b.chars(), vos::IS_EQUAL);
+
+	b.reset();
+	b.append_fmt("%05d|%5d|%-5d|%6s|%ld|%.2f", -42, -42, 7, "ab", -1L, d);
+
+	expectString("-0042|  -42|7    |    ab|-1|112.98"
+		, b.chars(), vos::IS_EQUAL);
 }
 
 int main()
@@ -2651,6 +3094,8 @@ int main()
 	test_appendi();
 	test_appendui();
 	test_appendd();
+	test_appendd_shortest();
+	test_appendd_roundtrip();
 	test_append();
 	test_append_raw();
 	test_append_bin();
@@ -2670,6 +3115,11 @@ int main()
 	test_to_lint();
 
 	test_PARSE_INT();
+	test_PARSE_I64();
+	test_PARSE_U64();
+	test_PARSE_LINT();
+	test_PARSE_DOUBLE();
+	test_to_double();
 
 	return 0;
 }
@@ -0,0 +1,270 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include <fcntl.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "test.hh"
+#include "../DSVColumnar.hh"
+
+using vos::Buffer;
+using vos::DSVColumnar;
+using vos::DSVRecordMD;
+using vos::File;
+using vos::List;
+
+Test T("DSVColumnar");
+
+#define FIN	"dsv_columnar.in"
+#define FOUT	"dsv_columnar.out"
+#define META	":name,:id:::',':NUMBER,:price:::',':NUMBER,:note,:qty::::NUMBER"
+#define N_ROWS	1050
+#define N_BLOCK	100
+
+static const char* NAMES[] = { "alpha", "beta", "gamma" };
+
+//
+// WRITE_INPUT will create DSV file with N_ROWS rows. Column `qty` contain
+// invalid number in the third block.
+//
+static void WRITE_INPUT()
+{
+	File f;
+
+	Error err = f.open_wt(FIN);
+	assert(err == NULL);
+
+	for (int x = 0; x < N_ROWS; x++) {
+		if (x == 250) {
+			f.writef("%s,%d,%d.25,note %d,x\n", NAMES[x % 3], x
+				, x, x);
+		} else {
+			f.writef("%s,%d,%d.25,note %d,%d\n", NAMES[x % 3], x
+				, x, x, x % 7);
+		}
+	}
+
+	f.close();
+}
+
+void test_convert()
+{
+	const struct vos::dsv_col_chunk* c = NULL;
+	DSVColumnar col;
+	List* list_md = DSVRecordMD::INIT(META);
+
+	T.start("CONVERT", "With number and string columns");
+
+	DSVColumnar::BLOCK_ROWS = N_BLOCK;
+
+	T.expect_error(NULL, DSVColumnar::CONVERT(FIN, list_md, FOUT));
+	T.expect_error(NULL, col.open(FOUT));
+
+	T.expect_signed(5, col._n_cols);
+	T.expect_unsigned(N_ROWS, col._n_rows);
+	T.expect_unsigned(11, col._n_blocks);
+	T.expect_signed(2, col.column("price"));
+	T.expect_signed(-1, col.column("unknown"));
+	T.expect_signed(vos::RMD_T_NUMBER, col.column_type(1));
+
+	c = col.chunk(0, 0);
+	T.expect_signed(vos::DSV_COL_DICT, c->enc);
+	T.expect_signed(0, c->has_stat);
+
+	c = col.chunk(1, 1);
+	T.expect_signed(vos::DSV_COL_INT, c->enc);
+	T.expect_signed(1, c->has_stat);
+	T.expect_signed(100, int(c->min));
+	T.expect_signed(199, int(c->max));
+
+	T.expect_signed(vos::DSV_COL_DOUBLE, col.chunk(0, 2)->enc);
+	T.expect_signed(vos::DSV_COL_PLAIN, col.chunk(0, 3)->enc);
+	T.expect_signed(vos::DSV_COL_INT, col.chunk(0, 4)->enc);
+	T.expect_signed(vos::DSV_COL_DICT, col.chunk(2, 4)->enc);
+
+	T.expect_signed(1, col.chunk(11, 0) == NULL);
+	T.ok();
+
+	T.start("CONVERT", "With projection");
+
+	T.expect_signed(2, DSVRecordMD::PROJECT(list_md, "id,price"));
+	T.expect_error(NULL, DSVColumnar::CONVERT(FIN, list_md, FOUT));
+
+	for (int x = 0; x < list_md->size(); x++) {
+		DSVRecordMD* md = (DSVRecordMD*) list_md->at(x);
+		int skip = (x != 1 && x != 2);
+
+		T.expect_signed(skip, (md->_flag & vos::RMD_FL_SKIP) != 0);
+	}
+
+	col.close();
+	T.expect_error(NULL, col.open(FOUT));
+	T.expect_signed(5, col._n_cols);
+	T.expect_unsigned(N_ROWS, col._n_rows);
+	T.ok();
+
+	delete list_md;
+}
+
+void test_read()
+{
+	int x = 0;
+	int row = 0;
+	size_t n = 0;
+	size_t len = 0;
+	const char* v = NULL;
+	double ids[N_BLOCK];
+	double prices[N_BLOCK];
+	double qtys[N_BLOCK];
+	DSVColumnar col;
+	Buffer got;
+	Buffer exp;
+
+	T.expect_error(NULL, col.open(FOUT));
+
+	T.start("next_block", "Without filter");
+
+	while ((n = col.next_block()) > 0) {
+		T.expect_error(NULL, col.get_number(1, ids));
+		T.expect_error(NULL, col.get_number(2, prices));
+		T.expect_error(NULL, col.get_number(4, qtys));
+
+		for (x = 0; x < int(n); x++, row++) {
+			got.reset();
+			exp.reset();
+
+			col.get_string(0, size_t(x), &v, &len);
+			got.append_raw(v, len);
+			col.get_string(3, size_t(x), &v, &len);
+			got.appendc(',');
+			got.append_raw(v, len);
+			got.append_fmt(",%d,%.2f,", int(ids[x]), prices[x]);
+			if (isnan(qtys[x])) {
+				got.appendc('x');
+			} else {
+				got.appendi(int(qtys[x]));
+			}
+
+			exp.append_fmt("%s,note %d,%d,%d.25,", NAMES[row % 3]
+				, row, row, row);
+			if (row == 250) {
+				exp.appendc('x');
+			} else {
+				exp.appendi(row % 7);
+			}
+
+			if (got.like(&exp) != 0) {
+				T.expect_string(exp.chars(), got.chars());
+				break;
+			}
+		}
+	}
+
+	T.expect_signed(N_ROWS, row);
+	T.ok();
+
+	T.start("get_string", "With number column");
+	col.rewind();
+	col.next_block();
+	T.expect_error(vos::ErrDSVColumnarType, col.get_string(1, 0, &v, &len));
+	T.expect_error(vos::ErrDSVColumnarType, col.get_string(4, 0, &v, &len));
+	T.ok();
+
+	T.start("get_string", "With invalid number stored as string");
+	col.next_block();
+	col.next_block();
+	T.expect_error(NULL, col.get_string(4, 50, &v, &len));
+	T.expect_mem("x", v, len);
+	T.ok();
+
+	T.start("next_block", "With filter");
+
+	col.rewind();
+	row = 0;
+	while ((n = col.next_block(1, 250, 349)) > 0) {
+		T.expect_error(NULL, col.get_number(1, ids));
+		for (x = 0; x < int(n); x++) {
+			if (ids[x] >= 250 && ids[x] <= 349) {
+				++row;
+			}
+		}
+	}
+
+	T.expect_signed(100, row);
+	T.expect_unsigned(9, col._n_skipped);
+	T.ok();
+}
+
+void test_open()
+{
+	File f;
+	DSVColumnar col;
+
+	T.start("open", "With invalid file");
+
+	f.open_wt(FIN);
+	f.write_raw("VOSCOL01 not a columnar file, but long enough");
+	f.close();
+
+	T.expect_error(vos::ErrDSVColumnarFormat, col.open(FIN));
+	T.ok();
+}
+
+//
+// test_offsets will corrupt the third string offset of column `note` in the
+// first block, and check that reading any row of that block fail.
+//
+void test_offsets()
+{
+	int fd = 0;
+	uint32_t bad = 0xFFFFFFF0;
+	uint64_t off = 0;
+	size_t len = 0;
+	const char* v = NULL;
+	const struct vos::dsv_col_chunk* c = NULL;
+	DSVColumnar col;
+
+	T.start("get_string", "With unordered offset");
+
+	T.expect_error(NULL, col.open(FOUT));
+	c = col.chunk(0, 3);
+	T.expect_signed(vos::DSV_COL_PLAIN, c->enc);
+	off = c->off + 2 * sizeof(bad);
+	col.close();
+
+	fd = open(FOUT, O_WRONLY);
+	assert(fd >= 0);
+	T.expect_signed(ssize_t(sizeof(bad)), pwrite(fd, &bad, sizeof(bad)
+		, off_t(off)));
+	::close(fd);
+
+	T.expect_error(NULL, col.open(FOUT));
+	T.expect_unsigned(N_BLOCK, col.next_block());
+	T.expect_error(vos::ErrDSVColumnarFormat, col.get_string(3, 0, &v
+		, &len));
+	T.expect_error(vos::ErrDSVColumnarFormat, col.get_string(3, 5, &v
+		, &len));
+	T.expect_unsigned(N_BLOCK, col.next_block());
+	T.expect_error(NULL, col.get_string(3, 0, &v, &len));
+	T.ok();
+}
+
+int main()
+{
+	WRITE_INPUT();
+
+	test_convert();
+	test_read();
+	test_open();
+	test_offsets();
+
+	unlink(FIN);
+	unlink(FOUT);
+
+	return 0;
+}
+// vi: ts=8 sw=8 tw=80:
@@ -0,0 +1,158 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include "test.hh"
+#include "../DSVGroup.hh"
+
+using vos::Buffer;
+using vos::DSVGroup;
+using vos::DSVRecordMD;
+using vos::File;
+using vos::List;
+
+Test T("DSVGroup");
+
+#define FIN	"dsv_group.in"
+#define FOUT	"dsv_group.out"
+#define META	":name,:day,:n::::NUMBER"
+
+#define TEST_DATA	\
+"a,1,1\n"		\
+"b,1,2\n"		\
+"a,2,3\n"		\
+"c,1,x\n"		\
+"b,1,4\n"		\
+"a,1,-2.5\n"
+
+void test_group()
+{
+	struct {
+		const char* desc;
+		const char* keys;
+		const char* aggs;
+		int n_thread;
+		size_t batch_rows;
+		const char* exp;
+	} const tests[] = {{
+		"With one key"
+	,	"name"
+	,	"count,sum(n),min(n),max(n),avg(n)"
+	,	1
+	,	1024
+	,	"a,3,1.5,-2.5,3.0,0.5;b,2,6.0,2.0,4.0,3.0;c,1,0.0,,,;"
+	},{
+		"With two keys"
+	,	"day,name"
+	,	"count,sum(n)"
+	,	1
+	,	1024
+	,	"1,a,2,-1.5;1,b,2,6.0;2,a,1,3.0;1,c,1,0.0;"
+	},{
+		"Without key"
+	,	NULL
+	,	"count,max(n)"
+	,	1
+	,	1024
+	,	"6,4.0;"
+	},{
+		"With many threads"
+	,	"name"
+	,	"count,sum(n),min(n),max(n),avg(n)"
+	,	3
+	,	1
+	,	"a,3,1.5,-2.5,3.0,0.5;c,1,0.0,,,;b,2,6.0,2.0,4.0,3.0;"
+	}};
+
+	File f;
+	DSVGroup group;
+	Buffer got;
+	List* list_md = DSVRecordMD::INIT(META);
+
+	Error err = f.open_wt(FIN);
+	assert(err == NULL);
+	f.write_raw(TEST_DATA);
+	f.close();
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("group", tests[x].desc);
+
+		group._n_thread = tests[x].n_thread;
+		DSVGroup::BATCH_ROWS = tests[x].batch_rows;
+
+		T.expect_error(NULL, group.set_keys(list_md, tests[x].keys));
+		T.expect_error(NULL, group.set_aggs(list_md, tests[x].aggs));
+		T.expect_error(NULL, group.group(FIN, list_md, FOUT));
+
+		readLines(FOUT, &got);
+
+		T.expect_string(tests[x].exp, got.chars());
+		T.expect_unsigned(6, group._n_rows);
+		T.ok();
+	}
+
+	delete list_md;
+
+	unlink(FIN);
+	unlink(FOUT);
+}
+
+void test_set()
+{
+	struct {
+		const char* desc;
+		const char* aggs;
+		Error exp;
+	} const tests[] = {{
+		"With unknown function"
+	,	"median(n)"
+	,	vos::ErrDSVGroupAgg
+	},{
+		"Without field"
+	,	"sum"
+	,	vos::ErrDSVGroupAgg
+	},{
+		"With unknown field"
+	,	"sum(x)"
+	,	vos::ErrDSVGroupAgg
+	},{
+		"With non number field"
+	,	"sum(name)"
+	,	vos::ErrDSVGroupAgg
+	},{
+		"With empty"
+	,	""
+	,	vos::ErrDSVGroupAgg
+	},{
+		"With count of field"
+	,	"count(name), avg(n)"
+	,	NULL
+	}};
+
+	DSVGroup group;
+	List* list_md = DSVRecordMD::INIT(META);
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("set_aggs", tests[x].desc);
+		T.expect_error(tests[x].exp, group.set_aggs(list_md
+			, tests[x].aggs));
+		T.ok();
+	}
+
+	T.start("set_keys", "With unknown key");
+	T.expect_error(vos::ErrDSVGroupKey, group.set_keys(list_md, "name,x"));
+	T.ok();
+
+	delete list_md;
+}
+
+int main()
+{
+	test_group();
+	test_set();
+
+	return 0;
+}
+// vi: ts=8 sw=8 tw=80:
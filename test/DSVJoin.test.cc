@@ -0,0 +1,325 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include "test.hh"
+#include "../DSVJoin.hh"
+
+using vos::Buffer;
+using vos::DSVJoin;
+using vos::DSVRecordMD;
+using vos::File;
+using vos::List;
+
+Test T("DSVJoin");
+
+#define FLEFT	"dsv_join.left"
+#define FRIGHT	"dsv_join.right"
+#define FOUT	"dsv_join.out"
+
+//
+// WRITE_FILE will create file `name` with content `v`.
+//
+static void WRITE_FILE(const char* name, const char* v)
+{
+	File f;
+
+	Error err = f.open_wt(name);
+	assert(err == NULL);
+	f.write_raw(v);
+	f.close();
+}
+
+void test_join()
+{
+	struct {
+		const char* desc;
+		const char* left;
+		const char* right;
+		const char* key_left;
+		const char* key_right;
+		const char* exp;
+	} const tests[] = {{
+		"With one to one"
+	,	"1,alice\n2,bob\n3,carol\n"
+	,	"2,20\n3,30\n4,40\n"
+	,	"id"
+	,	"uid"
+	,	"2,bob,2,20;3,carol,3,30;"
+	},{
+		"With one to many"
+	,	"1,alice\n2,bob\n"
+	,	"1,10\n2,20\n1,11\n1,12\n"
+	,	"id"
+	,	"uid"
+	,	"1,alice,1,10;1,alice,1,11;1,alice,1,12;2,bob,2,20;"
+	},{
+		"With many to one"
+	,	"1,alice\n1,bob\n2,carol"
+	,	"1,10\n2,20"
+	,	"id"
+	,	"uid"
+	,	"1,alice,1,10;1,bob,1,10;2,carol,2,20;"
+	},{
+		"With two keys"
+	,	"1,a\n1,b\n2,a\n"
+	,	"1,a\n2,b\n2,a\n"
+	,	"id,name"
+	,	"uid,val"
+	,	"1,a,1,a;2,a,2,a;"
+	},{
+		"With keys in different order"
+	,	"1,a\n1,b\n2,a\n"
+	,	"a,1\nb,2\na,2\n"
+	,	"id,name"
+	,	"val,uid"
+	,	"1,a,a,1;2,a,a,2;"
+	},{
+		"Without match"
+	,	"1,alice\n"
+	,	"2,20\n"
+	,	"id"
+	,	"uid"
+	,	""
+	}};
+
+	DSVJoin join;
+	Buffer got;
+	List* md_left = DSVRecordMD::INIT(":id,:name::::");
+	List* md_right = DSVRecordMD::INIT(":uid,:val::::");
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("join", tests[x].desc);
+
+		WRITE_FILE(FLEFT, tests[x].left);
+		WRITE_FILE(FRIGHT, tests[x].right);
+
+		T.expect_error(NULL, join.join(FLEFT, md_left
+			, tests[x].key_left, FRIGHT, md_right
+			, tests[x].key_right, FOUT));
+
+		readLines(FOUT, &got);
+
+		T.expect_string(tests[x].exp, got.chars());
+		T.expect_unsigned(0, join._n_parts);
+		T.ok();
+	}
+
+	T.start("join", "With unknown key");
+	T.expect_error(vos::ErrDSVJoinKey, join.join(FLEFT, md_left, "x"
+		, FRIGHT, md_right, "uid", FOUT));
+	T.ok();
+
+	T.start("join", "With different number of keys");
+	T.expect_error(vos::ErrDSVJoinKey, join.join(FLEFT, md_left, "id"
+		, FRIGHT, md_right, "uid,val", FOUT));
+	T.ok();
+
+	T.start("join", "With projection");
+
+	T.expect_signed(1, DSVRecordMD::PROJECT(md_left, "name"));
+	T.expect_error(NULL, join.join(FLEFT, md_left, "id", FRIGHT
+		, md_right, "uid", FOUT));
+
+	for (int x = 0; x < md_left->size(); x++) {
+		DSVRecordMD* md = (DSVRecordMD*) md_left->at(x);
+
+		T.expect_signed(x == 0, (md->_flag & vos::RMD_FL_SKIP) != 0);
+	}
+	for (int x = 0; x < md_right->size(); x++) {
+		DSVRecordMD* md = (DSVRecordMD*) md_right->at(x);
+
+		T.expect_signed(0, (md->_flag & vos::RMD_FL_SKIP) != 0);
+	}
+	T.ok();
+
+	delete md_left;
+	delete md_right;
+}
+
+void test_join_spill()
+{
+	const int n_left = 3000;
+	const int n_right = 2000;
+	int n = 0;
+	File f;
+	DSVJoin join;
+	Buffer got;
+	Buffer exp;
+	List* md_left = DSVRecordMD::INIT(":id,:name::::");
+	List* md_right = DSVRecordMD::INIT(":uid,:val::::");
+
+	f.open_wt(FLEFT);
+	for (int x = 0; x < n_left; x++) {
+		f.writef("%d,name%d\n", x, x);
+	}
+	f.close();
+
+	// Each even left id match two right rows.
+	f.open_wt(FRIGHT);
+	for (int x = 0; x < n_right; x++) {
+		f.writef("%d,%d\n", (x % 1000) * 2, x);
+	}
+	f.close();
+
+	T.start("join", "With partitions");
+
+	join._mem_limit = 8 * 1024;
+
+	T.expect_error(NULL, join.join(FLEFT, md_left, "id", FRIGHT, md_right
+		, "uid", FOUT));
+	T.expect_signed(1, join._n_parts > 1);
+	T.expect_unsigned(n_left, join._n_left);
+	T.expect_unsigned(n_right, join._n_right);
+	T.expect_unsigned(n_right, join._n_out);
+
+	n = readLines(FOUT, &got);
+	T.expect_signed(n_right, n);
+
+	for (int x = 0; x < n_right; x++) {
+		exp.reset();
+		exp.append_fmt("%d,name%d,%d,%d;", (x % 1000) * 2
+			, (x % 1000) * 2, (x % 1000) * 2, x);
+		if (! strstr(got.chars(), exp.chars())) {
+			T.expect_string(exp.chars(), "");
+			break;
+		}
+	}
+
+	T.expect_signed(0, File::IS_EXIST(FOUT ".part.r0", O_RDONLY));
+	T.expect_signed(0, File::IS_EXIST(FOUT ".part.l0", O_RDONLY));
+	T.ok();
+
+	delete md_left;
+	delete md_right;
+}
+
+void test_distinct()
+{
+	struct {
+		const char* desc;
+		const char* keys;
+		const char* exp;
+	} const tests[] = {{
+		"With all fields"
+	,	NULL
+	,	"1,a;2,b;1,b;"
+	},{
+		"With first field"
+	,	"id"
+	,	"1,a;2,b;"
+	},{
+		"With second field"
+	,	"name"
+	,	"1,a;2,b;"
+	}};
+
+	DSVJoin join;
+	Buffer got;
+	List* list_md = DSVRecordMD::INIT(":id,:name::::");
+
+	WRITE_FILE(FLEFT, "1,a\n2,b\n1,a\n1,b\n2,b\n");
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("distinct", tests[x].desc);
+
+		T.expect_error(NULL, join.distinct(FLEFT, list_md
+			, tests[x].keys, FOUT));
+
+		readLines(FOUT, &got);
+
+		T.expect_string(tests[x].exp, got.chars());
+		T.expect_unsigned(5, join._n_left);
+		T.ok();
+	}
+
+	T.start("distinct", "With unknown key");
+	T.expect_error(vos::ErrDSVJoinKey, join.distinct(FLEFT, list_md, "x"
+		, FOUT));
+	T.ok();
+
+	T.start("distinct", "With projection");
+
+	T.expect_signed(1, DSVRecordMD::PROJECT(list_md, "id"));
+	T.expect_error(NULL, join.distinct(FLEFT, list_md, "name", FOUT));
+
+	for (int x = 0; x < list_md->size(); x++) {
+		DSVRecordMD* md = (DSVRecordMD*) list_md->at(x);
+
+		T.expect_signed(x == 1, (md->_flag & vos::RMD_FL_SKIP) != 0);
+	}
+	T.ok();
+
+	delete list_md;
+}
+
+void test_distinct_spill()
+{
+	const int n_rows = 10000;
+	const int n_keys = 1500;
+	int n = 0;
+	File f;
+	DSVJoin join;
+	Buffer got;
+	Buffer all;
+	Buffer exp;
+	List* list_md = DSVRecordMD::INIT(":id,:seq::::");
+
+	f.open_wt(FLEFT);
+	for (int x = 0; x < n_rows; x++) {
+		f.writef("k%d,%d\n", (x * 7) % n_keys, x);
+	}
+	f.close();
+
+	T.start("distinct", "With partitions");
+
+	join._mem_limit = 8 * 1024;
+
+	T.expect_error(NULL, join.distinct(FLEFT, list_md, "id", FOUT));
+	T.expect_signed(1, join._n_parts > 1);
+	T.expect_unsigned(n_rows, join._n_left);
+	T.expect_unsigned(n_keys, join._n_out);
+
+	n = readLines(FOUT, &got);
+	T.expect_signed(n_keys, n);
+
+	all.appendc(';');
+	all.append(&got);
+
+	// Each key must be written once, with its first sequence.
+	for (int x = 0; x < n_keys; x++) {
+		exp.reset();
+		for (int y = 0; y < n_rows; y++) {
+			if ((y * 7) % n_keys == x) {
+				exp.append_fmt(";k%d,%d;", x, y);
+				break;
+			}
+		}
+		if (! strstr(all.chars(), exp.chars())) {
+			T.expect_string(exp.chars(), "");
+			break;
+		}
+	}
+
+	T.expect_signed(0, File::IS_EXIST(FOUT ".part.0", O_RDONLY));
+	T.ok();
+
+	delete list_md;
+}
+
+int main()
+{
+	test_join();
+	test_join_spill();
+	test_distinct();
+	test_distinct_spill();
+
+	unlink(FLEFT);
+	unlink(FRIGHT);
+	unlink(FOUT);
+
+	return 0;
+}
+// vi: ts=8 sw=8 tw=80:
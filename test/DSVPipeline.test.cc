@@ -0,0 +1,199 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include "test.hh"
+#include "../DSVPipeline.hh"
+
+using vos::Buffer;
+using vos::DSVPipeline;
+using vos::DSVRecord;
+using vos::DSVRecordMD;
+using vos::File;
+using vos::List;
+
+Test T("DSVPipeline");
+
+#define FIN	"dsv_pipeline.in"
+#define FOUT	"dsv_pipeline.out"
+
+//
+// DROP_ODD will drop row with odd number in second column, and append "!" to
+// the first column.
+//
+static int DROP_ODD(DSVRecord* row, void*)
+{
+	DSVRecord* col = row->_next_col;
+
+	if ((col->v()[col->len() - 1] - '0') % 2) {
+		return 0;
+	}
+	row->appendc('!');
+
+	return 1;
+}
+
+//
+// FAIL_AT will stop pipeline when second column equal to `arg`.
+//
+static int FAIL_AT(DSVRecord* row, void* arg)
+{
+	if (row->_next_col->like_raw((const char*) arg) == 0) {
+		return -1;
+	}
+	return 1;
+}
+
+void test_run()
+{
+	struct {
+		const char* desc;
+		const char* md_out;
+		vos::dsv_pipeline_fn fn;
+		int n_thread;
+		size_t batch_rows;
+		int n_batch;
+		const char* exp;
+		size_t exp_out;
+	} const tests[] = {{
+		"Without transform"
+	,	NULL
+	,	NULL
+	,	1
+	,	1024
+	,	2
+	,	"a,0;b,1;c,2;d,3;e,4;"
+	,	5
+	},{
+		"With transform"
+	,	NULL
+	,	DROP_ODD
+	,	1
+	,	1024
+	,	2
+	,	"a!,0;c!,2;e!,4;"
+	,	3
+	},{
+		"With output meta-data"
+	,	"'\"':x:'\"'::'|',:y::::"
+	,	DROP_ODD
+	,	1
+	,	1024
+	,	2
+	,	"\"a!\"|0;\"c!\"|2;\"e!\"|4;"
+	,	3
+	},{
+		"With many threads and small batches"
+	,	NULL
+	,	DROP_ODD
+	,	3
+	,	1
+	,	2
+	,	"a!,0;c!,2;e!,4;"
+	,	3
+	}};
+
+	File f;
+	DSVPipeline pipe;
+	Buffer got;
+	List* md_in = DSVRecordMD::INIT(":name,:n::::");
+	List* md_out = NULL;
+
+	Error err = f.open_wt(FIN);
+	assert(err == NULL);
+	f.write_raw("a,0\nb,1\nc,2\nd,3\ne,4");
+	f.close();
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("run", tests[x].desc);
+
+		md_out = NULL;
+		if (tests[x].md_out) {
+			md_out = DSVRecordMD::INIT(tests[x].md_out);
+		}
+
+		pipe._n_thread = tests[x].n_thread;
+		pipe._batch_rows = tests[x].batch_rows;
+		pipe._n_batch = tests[x].n_batch;
+
+		T.expect_error(NULL, pipe.run(FIN, md_in, tests[x].fn, NULL
+			, FOUT, md_out));
+
+		readLines(FOUT, &got);
+
+		T.expect_string(tests[x].exp, got.chars());
+		T.expect_unsigned(5, pipe._n_rows);
+		T.expect_unsigned(tests[x].exp_out, pipe._n_out);
+		T.ok();
+
+		if (md_out) {
+			delete md_out;
+		}
+	}
+
+	delete md_in;
+}
+
+void test_run_many()
+{
+	const int n_rows = 50000;
+	int n = 0;
+	File f;
+	File r;
+	DSVPipeline pipe;
+	Buffer line;
+	Buffer exp;
+	List* md_in = DSVRecordMD::INIT(":name,:n::::");
+
+	f.open_wt(FIN);
+	for (int x = 0; x < n_rows; x++) {
+		f.writef("name%d,%d\n", x, x);
+	}
+	f.close();
+
+	T.start("run", "With many rows");
+
+	pipe._n_thread = 4;
+	pipe._batch_rows = 100;
+	pipe._n_batch = 3;
+
+	T.expect_error(NULL, pipe.run(FIN, md_in, DROP_ODD, NULL, FOUT));
+	T.expect_unsigned(n_rows, pipe._n_rows);
+	T.expect_unsigned(n_rows / 2, pipe._n_out);
+
+	r.open_ro(FOUT);
+	while (r.get_line(&line) == NULL) {
+		exp.reset();
+		exp.append_fmt("name%d!,%d", n * 2, n * 2);
+		if (line.like(&exp) != 0) {
+			T.expect_string(exp.chars(), line.chars());
+			break;
+		}
+		++n;
+	}
+
+	T.expect_signed(n_rows / 2, n);
+	T.ok();
+
+	T.start("run", "With failed transform");
+
+	T.expect_error(vos::ErrDSVPipelineTransform, pipe.run(FIN, md_in
+		, FAIL_AT, (void*) "30000", FOUT));
+	T.ok();
+
+	delete md_in;
+}
+
+int main()
+{
+	test_run();
+	test_run_many();
+
+	unlink(FIN);
+	unlink(FOUT);
+
+	return 0;
+}
+// vi: ts=8 sw=8 tw=80:
@@ -0,0 +1,453 @@
+//
+// Copyright 2009-2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include "test.hh"
+#include "../DSVReader.hh"
+
+using vos::Buffer;
+using vos::DSVReader;
+using vos::DSVRecord;
+using vos::DSVRecordMD;
+using vos::DSVRecordPool;
+using vos::File;
+using vos::List;
+
+Test T("DSVReader");
+
+#define TEST_FILE	"dsv.test"
+
+#define TEST_DATA	\
+"alpha,10,2017-01-01\n"	\
+"beta,20,2017-02-01\n"	\
+"gamma,30,2017-03-01\n"	\
+"delta,-5,2017-04-01\n"	\
+"beta2,x,2017-05-01\n"
+
+//
+// READ_ALL will read all rows in TEST_FILE using meta-data `meta` and return
+// accepted rows in `out`, each column separated by '|' and each row separated
+// by ';'.
+//
+// If `project` is not NULL, only fields in `project` will be read.
+//
+static void READ_ALL(const char* meta, Buffer* out, const char* project = NULL)
+{
+	int s = 0;
+	int n_col = 0;
+	DSVReader reader;
+	DSVRecord* row = NULL;
+	DSVRecord* col = NULL;
+	List* list_md = DSVRecordMD::INIT(meta);
+
+	assert(list_md != NULL);
+
+	n_col = list_md->size();
+	if (project) {
+		n_col = DSVRecordMD::PROJECT(list_md, project);
+		assert(n_col > 0);
+	}
+
+	DSVRecord::INIT_ROW(&row, n_col);
+
+	Error err = reader.open_ro(TEST_FILE);
+	assert(err == NULL);
+
+	out->reset();
+
+	do {
+		row->columns_reset();
+		s = reader.read(row, list_md);
+		if (s != 1) {
+			continue;
+		}
+		for (col = row; col; col = col->_next_col) {
+			out->append(col);
+			out->appendc(col->_next_col ? '|' : ';');
+		}
+	} while (s != 0);
+
+	delete row;
+	delete list_md;
+}
+
+void test_filter()
+{
+	struct {
+		const char* desc;
+		const char* meta;
+		const char* exp;
+	} const tests[] = {{
+		"Without filter"
+	,	":name,:n,:date::::"
+	,	"alpha|10|2017-01-01;beta|20|2017-02-01;gamma|30|2017-03-01;"
+		"delta|-5|2017-04-01;beta2|x|2017-05-01;"
+	},{
+		"With string equal"
+	,	":name:::',':STRING:=beta,:n,:date::::"
+	,	"beta|20|2017-02-01;"
+	},{
+		"With string not equal"
+	,	":name:::',':STRING:!=beta,:n,:date::::"
+	,	"alpha|10|2017-01-01;gamma|30|2017-03-01;delta|-5|2017-04-01;"
+		"beta2|x|2017-05-01;"
+	},{
+		"With string contains"
+	,	":name:::',':STRING:~et,:n,:date::::"
+	,	"beta|20|2017-02-01;beta2|x|2017-05-01;"
+	},{
+		"With number greater or equal"
+	,	":name,:n:::',':NUMBER:>=20,:date::::"
+	,	"beta|20|2017-02-01;gamma|30|2017-03-01;"
+	},{
+		"With number less than"
+	,	":name,:n:::',':NUMBER:<10,:date::::"
+	,	"delta|-5|2017-04-01;"
+	},{
+		"With reject number greater than"
+	,	":name,:n:::',':NUMBER:!>10,:date::::"
+	,	"alpha|10|2017-01-01;delta|-5|2017-04-01;beta2|x|2017-05-01;"
+	},{
+		"With filter on last column"
+	,	":name,:n,:date::::DATE:>'2017-02-15'"
+	,	"gamma|30|2017-03-01;delta|-5|2017-04-01;beta2|x|2017-05-01;"
+	},{
+		"With two filters"
+	,	":name:::',':STRING:~a,:n:::',':NUMBER:>0,:date::::"
+	,	"alpha|10|2017-01-01;beta|20|2017-02-01;gamma|30|2017-03-01;"
+	}};
+
+	Buffer got;
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("read", tests[x].desc);
+
+		READ_ALL(tests[x].meta, &got);
+
+		T.expect_string(tests[x].exp, got.chars());
+		T.ok();
+	}
+}
+
+void test_project()
+{
+	struct {
+		const char* desc;
+		const char* meta;
+		const char* project;
+		const char* exp;
+	} const tests[] = {{
+		"With one column"
+	,	":name,:n,:date::::"
+	,	"n"
+	,	"10;20;30;-5;x;"
+	},{
+		"With last column"
+	,	":name,:n,:date::::"
+	,	"date"
+	,	"2017-01-01;2017-02-01;2017-03-01;2017-04-01;2017-05-01;"
+	},{
+		"With unordered columns"
+	,	":name,:n,:date::::"
+	,	"date, name"
+	,	"alpha|2017-01-01;beta|2017-02-01;gamma|2017-03-01;"
+		"delta|2017-04-01;beta2|2017-05-01;"
+	},{
+		"With filter on skipped column"
+	,	":name,:n:::',':NUMBER:>=20,:date::::"
+	,	"name"
+	,	"beta;gamma;"
+	}};
+
+	Buffer got;
+	List* list_md = NULL;
+	const int idx[] = { 2, 0 };
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("PROJECT", tests[x].desc);
+
+		READ_ALL(tests[x].meta, &got, tests[x].project);
+
+		T.expect_string(tests[x].exp, got.chars());
+		T.ok();
+	}
+
+	list_md = DSVRecordMD::INIT(":name,:n,:date::::");
+
+	T.start("PROJECT", "With unknown name");
+	T.expect_signed(-1, DSVRecordMD::PROJECT(list_md, "name,x"));
+	T.ok();
+
+	T.start("PROJECT_IDX", "With valid index");
+	T.expect_signed(2, DSVRecordMD::PROJECT_IDX(list_md, idx, 2));
+	T.ok();
+
+	T.start("PROJECT_IDX", "With index out of range");
+	T.expect_signed(-1, DSVRecordMD::PROJECT_IDX(list_md, idx, 3));
+	T.ok();
+
+	delete list_md;
+}
+
+void test_index()
+{
+	const char* fdata = "dsv_index.test";
+	const char* fidx = "dsv_index.test.idx";
+	const char* meta = ":name,:n::::";
+	const size_t n_rows = 1000;
+	const size_t rows[] = { 0, 6, 7, 8, 500, 999 };
+
+	File f;
+	Buffer exp;
+	DSVReader reader;
+	DSVRecord* row = NULL;
+	List* list_md = DSVRecordMD::INIT(meta);
+
+	Error err = f.open_wt(fdata);
+	assert(err == NULL);
+	for (size_t x = 0; x < n_rows; x++) {
+		f.writef("row%zu,%zu\n", x, x * 3);
+	}
+	f.close();
+
+	DSVRecord::INIT_ROW(&row, list_md->size());
+
+	err = reader.open_ro(fdata);
+	assert(err == NULL);
+
+	T.start("seek_row", "Without index");
+	T.expect_error(NULL, reader.seek_row(1, list_md), vos::IS_NOT_EQUAL);
+	T.ok();
+
+	T.start("index_create", "With every 7 rows");
+	T.expect_error(NULL, reader.index_create(list_md, 7));
+	T.expect_unsigned(n_rows, reader.rows());
+	T.expect_signed(0, reader.offset());
+	T.expect_signed(1, vos::File::IS_EXIST(fidx, O_RDONLY));
+	T.ok();
+
+	for (size_t x = 0; x < ARRAY_SIZE(rows); x++) {
+		exp.reset();
+		exp.append_fmt("row%zu", rows[x]);
+
+		T.start("seek_row", exp.chars());
+		T.expect_error(NULL, reader.seek_row(rows[x], list_md));
+
+		row->columns_reset();
+		T.expect_signed(1, reader.read(row, list_md));
+		T.expect_string(exp.chars(), row->chars());
+		T.ok();
+	}
+
+	T.start("seek_row", "With row out of range");
+	T.expect_error(vos::ErrFileEnd, reader.seek_row(n_rows, list_md));
+	T.ok();
+
+	reader.close();
+
+	f.open_wo(fdata);
+	f.writef("row%zu,%zu\n", n_rows, n_rows * 3);
+	f.close();
+
+	DSVReader reader2;
+
+	reader2.open_ro(fdata);
+
+	T.start("index_load", "With outdated index");
+	T.expect_error(vos::ErrDSVIndexInvalid, reader2.index_load());
+	T.ok();
+
+	delete row;
+	delete list_md;
+
+	unlink(fdata);
+	unlink(fidx);
+}
+
+//
+// test_last_row will read file that its last row is not ended with new line.
+// The number of read is limited, so reader that does not stop at the end of
+// file fail the test instead of looping forever.
+//
+void test_last_row()
+{
+	const char* fdata = "dsv_eof.test";
+	int s = 0;
+	int n_read = 0;
+	File f;
+	Buffer got;
+	DSVReader reader;
+	DSVRecord* row = NULL;
+	DSVRecord* col = NULL;
+	List* list_md = DSVRecordMD::INIT(":name,:n::::");
+
+	Error err = f.open_wt(fdata);
+	assert(err == NULL);
+	f.write_raw("alpha,10\nbeta,20");
+	f.close();
+
+	DSVRecord::INIT_ROW(&row, list_md->size());
+
+	T.start("read", "With last row without new line");
+
+	T.expect_error(NULL, reader.open_ro(fdata));
+
+	do {
+		row->columns_reset();
+		s = reader.read(row, list_md);
+		if (s != 1) {
+			continue;
+		}
+		for (col = row; col; col = col->_next_col) {
+			got.append(col);
+			got.appendc(col->_next_col ? '|' : ';');
+		}
+	} while (s != 0 && ++n_read < 10);
+
+	T.expect_signed(0, s);
+	T.expect_string("alpha|10;beta|20;", got.chars());
+	T.ok();
+
+	delete row;
+	delete list_md;
+
+	unlink(fdata);
+}
+
+void test_read_row()
+{
+	const size_t batch = 2;
+	size_t n = 0;
+	DSVReader reader;
+	DSVRecordPool pool(2);
+	DSVRecord* rows = NULL;
+	DSVRecord* row = NULL;
+	Buffer got;
+	List* list_md = DSVRecordMD::INIT(":name,:n::::NUMBER:>0");
+
+	T.start("read_row", "With pool");
+
+	T.expect_error(NULL, reader.open_ro(TEST_FILE));
+
+	while ((row = reader.read_row(&pool, list_md)) != NULL) {
+		got.append(row);
+		got.appendc(';');
+
+		DSVRecord::ADD_ROW(&rows, row);
+		if (++n == batch) {
+			pool.put(rows);
+			rows = NULL;
+			n = 0;
+		}
+	}
+	pool.put(rows);
+
+	T.expect_string("alpha;beta;gamma;", got.chars());
+	T.expect_unsigned(batch, pool._n_alloc);
+	T.ok();
+
+	delete list_md;
+}
+
+//
+// APPEND will append `v` to file `name`.
+//
+static void APPEND(const char* name, const char* v)
+{
+	int fd = open(name, O_WRONLY | O_APPEND | O_CREAT, 0600);
+
+	assert(fd >= 0);
+	assert(write(fd, v, strlen(v)) == ssize_t(strlen(v)));
+	close(fd);
+}
+
+void test_follow()
+{
+	const char* fdata = "dsv_follow.test";
+	const char* frotate = "dsv_follow.test.1";
+	DSVReader reader;
+	DSVRecord* row = NULL;
+	Buffer got;
+	List* list_md = DSVRecordMD::INIT(":name,:n::::NUMBER:>0");
+
+	DSVRecord::INIT_ROW(&row, list_md->size());
+
+	unlink(fdata);
+	APPEND(fdata, "a,1\nx,-1\nb,2\nc,");
+
+	T.expect_error(NULL, reader.open_ro(fdata));
+
+	T.start("follow", "With partial row");
+
+	T.expect_signed(1, reader.follow(row, list_md, 0));
+	T.expect_string("a", row->chars());
+	T.expect_signed(1, reader.follow(row, list_md, 0));
+	T.expect_string("b", row->chars());
+	T.expect_signed(0, reader.follow(row, list_md, 10));
+	T.ok();
+
+	T.start("follow", "With appended row");
+
+	APPEND(fdata, "3\nd,4\n");
+
+	T.expect_signed(1, reader.follow(row, list_md, 100));
+	T.expect_string("c", row->chars());
+	T.expect_string("3", row->_next_col->chars());
+	T.expect_signed(1, reader.follow(row, list_md, 0));
+	T.expect_string("d", row->chars());
+	T.expect_signed(0, reader.follow(row, list_md, 0));
+	T.ok();
+
+	T.start("follow", "With rotated file");
+
+	APPEND(fdata, "old,");
+	rename(fdata, frotate);
+	APPEND(fdata, "e,5\n");
+
+	T.expect_signed(1, reader.follow(row, list_md, 100));
+	T.expect_string("e", row->chars());
+	T.expect_signed(0, reader.follow(row, list_md, 0));
+	T.ok();
+
+	T.start("follow", "With truncated file");
+
+	truncate(fdata, 0);
+
+	T.expect_signed(0, reader.follow(row, list_md, 0));
+
+	APPEND(fdata, "f,6\n");
+
+	T.expect_signed(1, reader.follow(row, list_md, 100));
+	T.expect_string("f", row->chars());
+	T.ok();
+
+	delete row;
+	delete list_md;
+
+	unlink(fdata);
+	unlink(frotate);
+}
+
+int main()
+{
+	File f;
+
+	Error err = f.open_wt(TEST_FILE);
+	assert(err == NULL);
+	f.write_raw(TEST_DATA);
+	f.close();
+
+	test_filter();
+	test_project();
+	test_index();
+	test_last_row();
+	test_read_row();
+	test_follow();
+
+	unlink(TEST_FILE);
+
+	return 0;
+}
+// vi: ts=8 sw=8 tw=80:
@@ -53,8 +53,132 @@ void test_INIT()
 	}
 }
 
+void test_INIT_filter()
+{
+	List* list_md;
+	DSVRecordMD* md = NULL;
+
+	list_md = DSVRecordMD::INIT(
+		":name:::',':STRING:!~'a b',"
+		":stat:::',':NUMBER:>=-1.5,"
+		":ttl::::DATE:<2017-01-01");
+
+	assert(list_md != NULL);
+	assert(list_md->size() == 3);
+
+	md = (DSVRecordMD*) list_md->at(0);
+	assert(md->_idx == 0);
+	assert(md->_fltr_idx == vos::RMD_FLTR_LIKE);
+	assert(md->_fltr_rule == vos::RMD_FLTR_REJECT);
+	expectString("a b", md->_fltr_v->chars(), 0);
+	assert(md->filter("xa by", 5) == 0);
+	assert(md->filter("xab", 3) == 1);
+
+	md = (DSVRecordMD*) list_md->at(1);
+	assert(md->_idx == 1);
+	assert(md->_sep == ',');
+	assert(md->_fltr_idx == vos::RMD_FLTR_GE);
+	assert(md->_fltr_rule == vos::RMD_FLTR_ACCEPT);
+	assert(md->_fltr_n == -1.5);
+	assert(md->filter("-1.5", 4) == 1);
+	assert(md->filter("-2", 2) == 0);
+	assert(md->filter("abc", 3) == 0);
+
+	md = (DSVRecordMD*) list_md->at(2);
+	assert(md->_sep == 0);
+	assert(md->_fltr_idx == vos::RMD_FLTR_LT);
+	assert(md->filter("2016-12-31", 10) == 1);
+	assert(md->filter("2017-01-01", 10) == 0);
+
+	delete list_md;
+
+	assert(DSVRecordMD::INIT(":name::::NUMBER:>abc") == NULL);
+	assert(DSVRecordMD::INIT(":name::::BLOB:=a") == NULL);
+	assert(DSVRecordMD::INIT(":name::::STRING:?a") == NULL);
+}
+
+void test_date_parse()
+{
+	struct {
+		const char* v;
+		int exp_s;
+		int64_t exp_t;
+	} const tests[] = {
+		{ "10/Oct/2017:13:55:36", 0, 1507643736 },
+		{ "10/oct/2017:14:00:00", 0, 1507644000 },
+		{ "11/Oct/2017:00:00:00", 0, 1507680000 },
+		{ "10/Oct/2017:14:00:00", 0, 1507644000 },
+		{ "29/Feb/2017:00:00:00", -1, 0 },
+		{ "29/Feb/2000:00:00:00", 0, 951782400 },
+		{ "10/Oct/2017:24:00:00", -1, 0 },
+		{ "10/Oct/2017:13:55", -1, 0 },
+		{ "10/Oct/2017:13:55:36Z", -1, 0 },
+		{ "10/Okt/2017:13:55:36", -1, 0 },
+	};
+
+	List* list_md = NULL;
+	DSVRecordMD* md = NULL;
+	struct vos::rmd_date_cache dc;
+	int64_t t = 0;
+
+	list_md = DSVRecordMD::INIT(
+		":log::::DATE'%d/%b/%Y:%H:%M:%S',"
+		":day::::DATE,"
+		":ts::::DATE'%y%m%d %H%M':>='991231 2359'");
+
+	assert(list_md != NULL);
+	assert(list_md->size() == 3);
+
+	md = (DSVRecordMD*) list_md->at(0);
+	expectString("%d/%b/%Y:%H:%M:%S", md->_date_format->chars(), 0);
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		t = 0;
+		assert(md->date_parse(tests[x].v, strlen(tests[x].v), &t)
+			== tests[x].exp_s);
+		assert(t == tests[x].exp_t);
+	}
+
+	// With day part cached by caller.
+	memset(&dc, 0, sizeof(dc));
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		t = 0;
+		assert(md->date_parse(tests[x].v, strlen(tests[x].v), &t, &dc)
+			== tests[x].exp_s);
+		assert(t == tests[x].exp_t);
+	}
+	assert(dc.md == md);
+	assert(dc.len == 12);
+
+	md = (DSVRecordMD*) list_md->at(1);
+	assert(md->_date_format == NULL);
+	assert(md->date_parse("2017-01-01", 10, &t) == 0);
+	assert(t == 1483228800);
+	assert(md->date_parse("1969-12-31", 10, &t) == 0);
+	assert(t == -86400);
+
+	md = (DSVRecordMD*) list_md->at(2);
+	assert(md->_fltr_n == 946684740);
+	assert(md->filter("991231 2359", 11) == 1);
+	assert(md->filter("000101 0000", 11) == 1);
+	assert(md->filter("991231 2358", 11) == 0);
+	assert(md->filter("x", 1) == 0);
+
+	// Cache filled by other meta-data is not used.
+	assert(md->filter("991231 2358", 11, &dc) == 0);
+	assert(dc.md == md);
+
+	delete list_md;
+
+	assert(DSVRecordMD::INIT(":t::::DATE'%Q'") == NULL);
+	assert(DSVRecordMD::INIT(":t::::DATE'%Y':>x") == NULL);
+}
+
 int main()
 {
 	test_INIT();
+	test_INIT_filter();
+	test_date_parse();
 	return 0;
 }
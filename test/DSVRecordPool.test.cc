@@ -0,0 +1,93 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include "test.hh"
+#include "../DSVRecordPool.hh"
+
+using vos::DSVRecord;
+using vos::DSVRecordPool;
+
+Test T("DSVRecordPool");
+
+void test_get()
+{
+	DSVRecordPool pool(2);
+	DSVRecord* row = NULL;
+	DSVRecord* row2 = NULL;
+	const char* v = NULL;
+
+	T.start("get", "With empty pool");
+
+	row = pool.get();
+
+	T.expect_signed(1, row != NULL);
+	T.expect_signed(1, row->get_column(1) != NULL);
+	T.expect_signed(1, row->get_column(2) == NULL);
+	T.expect_unsigned(1, pool._n_alloc);
+	T.ok();
+
+	T.start("get", "With released row");
+
+	row->copy_raw("a long value that will be kept");
+	row->_next_col->copy_raw("b");
+	v = row->v();
+
+	pool.put(row);
+	row2 = pool.get();
+
+	T.expect_signed(1, row == row2);
+	T.expect_signed(1, v == row2->v());
+	T.expect_unsigned(0, row2->len());
+	T.expect_unsigned(0, row2->_next_col->len());
+	T.expect_unsigned(1, pool._n_alloc);
+	T.ok();
+
+	pool.put(row2);
+}
+
+void test_put_rows()
+{
+	const size_t n = 100;
+	DSVRecordPool pool(3);
+	DSVRecord* rows = NULL;
+	DSVRecord* row = NULL;
+
+	T.start("put", "With list of rows");
+
+	T.expect_error(NULL, pool.reserve(n));
+
+	for (size_t x = 0; x < n; x++) {
+		row = pool.get();
+		row->copy_raw("x");
+		DSVRecord::ADD_ROW(&rows, row);
+	}
+
+	pool.put(rows);
+	rows = NULL;
+
+	for (size_t x = 0; x < n; x++) {
+		row = pool.get();
+		if (row->len() != 0 || row->_next_row != NULL) {
+			T.expect_unsigned(0, row->len());
+			break;
+		}
+		DSVRecord::ADD_ROW(&rows, row);
+	}
+
+	T.expect_unsigned(n, pool._n_alloc);
+	T.ok();
+
+	pool.put(rows);
+}
+
+int main()
+{
+	test_get();
+	test_put_rows();
+
+	return 0;
+}
+// vi: ts=8 sw=8 tw=80:
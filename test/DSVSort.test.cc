@@ -0,0 +1,226 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include "test.hh"
+#include "../DSVSort.hh"
+
+using vos::Buffer;
+using vos::DSVReader;
+using vos::DSVRecord;
+using vos::DSVRecordMD;
+using vos::DSVSort;
+using vos::File;
+using vos::List;
+
+Test T("DSVSort");
+
+#define FIN	"dsv_sort.in"
+#define FOUT	"dsv_sort.out"
+#define META	":name,:n:::',':NUMBER,:seq::::NUMBER"
+
+static const int N_ROWS = 5000;
+
+//
+// READ_ROWS will read all rows in `fin` and return their columns in `name`,
+// `n`, and `seq`.
+//
+static int READ_ROWS(const char* fin, List* list_md, Buffer* name, double* n
+	, double* seq)
+{
+	int s = 0;
+	int x = 0;
+	DSVReader reader;
+	DSVRecord* row = NULL;
+
+	DSVRecord::INIT_ROW(&row, list_md->size());
+
+	Error err = reader.open_ro(fin);
+	assert(err == NULL);
+
+	do {
+		row->columns_reset();
+		s = reader.read(row, list_md);
+		if (s != 1) {
+			continue;
+		}
+		name[x].copy(row);
+		row->_next_col->to_double(&n[x]);
+		row->_next_col->_next_col->to_double(&seq[x]);
+		x++;
+	} while (s != 0);
+
+	delete row;
+
+	return x;
+}
+
+void test_sort()
+{
+	struct {
+		const char* desc;
+		const char* keys;
+		size_t mem_limit;
+		int merge_way;
+	} const tests[] = {{
+		"With single run"
+	,	"n"
+	,	64 * 1024 * 1024
+	,	64
+	},{
+		"With many runs"
+	,	"n,name"
+	,	32 * 1024
+	,	64
+	},{
+		"With multi pass merge"
+	,	"-n"
+	,	32 * 1024
+	,	4
+	},{
+		"With string key"
+	,	"name,-seq"
+	,	64 * 1024
+	,	3
+	}};
+
+	File f;
+	DSVSort sorter;
+	List* list_md = DSVRecordMD::INIT(META);
+	Buffer* name = new Buffer[N_ROWS];
+	double* n = (double*) calloc(N_ROWS, sizeof(double));
+	double* seq = (double*) calloc(N_ROWS, sizeof(double));
+	int got = 0;
+	int s = 0;
+
+	Error err = f.open_wt(FIN);
+	assert(err == NULL);
+
+	srand(1);
+	for (int x = 0; x < N_ROWS; x++) {
+		f.writef("k%d,%d,%d\n", rand() % 50, rand() % 100 - 50, x);
+	}
+	f.close();
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("sort", tests[x].desc);
+
+		sorter._mem_limit = tests[x].mem_limit;
+		DSVSort::MERGE_WAY = tests[x].merge_way;
+
+		T.expect_error(NULL, sorter.set_keys(list_md, tests[x].keys));
+		T.expect_error(NULL, sorter.sort(FIN, FOUT, list_md));
+		T.expect_unsigned(N_ROWS, sorter._n_rows);
+
+		got = READ_ROWS(FOUT, list_md, name, n, seq);
+		T.expect_signed(N_ROWS, got);
+
+		for (int y = 1; y < got; y++) {
+			switch (x) {
+			case 0:
+				s = (n[y - 1] < n[y])
+				|| (n[y - 1] == n[y] && seq[y - 1] < seq[y]);
+				break;
+			case 1:
+				s = (n[y - 1] < n[y])
+				|| (n[y - 1] == n[y]
+				&& name[y - 1].cmp(&name[y]) < 0)
+				|| (n[y - 1] == n[y]
+				&& name[y - 1].cmp(&name[y]) == 0
+				&& seq[y - 1] < seq[y]);
+				break;
+			case 2:
+				s = (n[y - 1] > n[y])
+				|| (n[y - 1] == n[y] && seq[y - 1] < seq[y]);
+				break;
+			case 3:
+				s = (name[y - 1].cmp(&name[y]) < 0)
+				|| (name[y - 1].cmp(&name[y]) == 0
+				&& seq[y - 1] > seq[y]);
+				break;
+			}
+			if (! s) {
+				T.expect_signed(1, s);
+				break;
+			}
+		}
+
+		T.expect_signed(0, File::IS_EXIST(FOUT ".run.0", O_RDONLY));
+		T.ok();
+	}
+
+	T.start("set_keys", "With unknown key");
+	T.expect_error(vos::ErrDSVSortKey, sorter.set_keys(list_md, "x"));
+	T.ok();
+
+	unlink(FIN);
+	unlink(FOUT);
+
+	delete[] name;
+	free(n);
+	free(seq);
+	delete list_md;
+}
+
+void test_sort_date()
+{
+	const char* rows[] = {
+		"02/01/2017,0\n"
+	,	"31/12/2016,1\n"
+	,	"invalid,2\n"
+	,	"01/02/2016,3\n"
+	,	"15/01/2017,4\n"
+	};
+	const char* exp =
+		"invalid,2\n"
+		"01/02/2016,3\n"
+		"31/12/2016,1\n"
+		"02/01/2017,0\n"
+		"15/01/2017,4\n";
+
+	File f;
+	Buffer out;
+	DSVSort sorter;
+	List* list_md = DSVRecordMD::INIT(
+		":d:::',':DATE'%d/%m/%Y',:seq::::NUMBER");
+	assert(list_md != NULL);
+
+	Error err = f.open_wt(FIN);
+	assert(err == NULL);
+	for (size_t x = 0; x < ARRAY_SIZE(rows); x++) {
+		f.write_raw(rows[x]);
+	}
+	f.close();
+
+	T.start("sort", "With day first date key");
+
+	T.expect_error(NULL, sorter.set_keys(list_md, "d"));
+	T.expect_error(NULL, sorter.sort(FIN, FOUT, list_md));
+	T.expect_unsigned(ARRAY_SIZE(rows), sorter._n_rows);
+
+	err = f.open_ro(FOUT);
+	assert(err == NULL);
+	err = f.read();
+	assert(err == NULL);
+	out.copy(&f);
+	f.close();
+
+	T.expect_string(exp, out.chars());
+	T.ok();
+
+	unlink(FIN);
+	unlink(FOUT);
+
+	delete list_md;
+}
+
+int main()
+{
+	test_sort();
+	test_sort_date();
+
+	return 0;
+}
+// vi: ts=8 sw=8 tw=80:
@@ -0,0 +1,179 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include "test.hh"
+#include "../DSVReader.hh"
+#include "../DSVWriter.hh"
+
+using vos::Buffer;
+using vos::DSVReader;
+using vos::DSVRecord;
+using vos::DSVRecordMD;
+using vos::DSVWriter;
+using vos::File;
+using vos::List;
+
+Test T("DSVWriter");
+
+#define TEST_FILE	"dsv_writer.test"
+
+//
+// NEW_ROW will create new row with two columns, `a` and `b`.
+//
+static DSVRecord* NEW_ROW(const char* a, const char* b)
+{
+	DSVRecord* row = NULL;
+
+	DSVRecord::INIT_ROW(&row, 2);
+	row->copy_raw(a);
+	row->_next_col->copy_raw(b);
+
+	return row;
+}
+
+//
+// READ_FILE will return the content of file `name` in `out`.
+//
+static void READ_FILE(const char* name, Buffer* out)
+{
+	File f;
+
+	Error err = f.open_ro(name);
+	assert(err == NULL);
+
+	out->reset();
+	while (f.read() == NULL) {
+		out->append_raw(f.v(), f.len());
+	}
+}
+
+void test_write()
+{
+	struct {
+		const char* desc;
+		const char* meta;
+		const char* exp;
+		size_t exp_len;
+	} const tests[] = {{
+		"With separator"
+	,	":a,:b::::"
+	,	"x,1\nyy,22\n"
+	,	10
+	},{
+		"With quote"
+	,	"'\"':a:'\"',:b::::"
+	,	"\"x\",1\n\"yy\",22\n"
+	,	14
+	},{
+		"With end position"
+	,	":a:::3,:b::::"
+	,	"x\0\0,1\nyy\0,22\n"
+	,	13
+	},{
+		"With end position equal to value"
+	,	":a:::2,:b::::"
+	,	"x\0,1\nyy,22\n"
+	,	11
+	}};
+
+	DSVWriter w;
+	Buffer got;
+	DSVRecord* rows = NULL;
+	List* list_md = NULL;
+
+	DSVRecord::ADD_ROW(&rows, NEW_ROW("x", "1"));
+	DSVRecord::ADD_ROW(&rows, NEW_ROW("yy", "22"));
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("writes", tests[x].desc);
+
+		list_md = DSVRecordMD::INIT(tests[x].meta);
+		assert(list_md != NULL);
+
+		T.expect_error(NULL, w.open_wt(TEST_FILE));
+		T.expect_signed(0, w.writes(rows, list_md));
+		w.close();
+
+		READ_FILE(TEST_FILE, &got);
+
+		T.expect_unsigned(tests[x].exp_len, got.len());
+		T.expect_mem(tests[x].exp, got.v(), tests[x].exp_len);
+		T.ok();
+
+		delete list_md;
+	}
+
+	delete rows;
+}
+
+void test_write_many()
+{
+	const int n_rows = 20000;
+	int s = 0;
+	int n = 0;
+	DSVWriter w;
+	DSVReader reader;
+	DSVRecord* row = NULL;
+	Buffer exp;
+	List* list_md = DSVRecordMD::INIT(":name,:n::::");
+
+	T.start("write", "With many rows");
+
+	T.expect_error(NULL, w.open_wt(TEST_FILE));
+
+	for (int x = 0; x < n_rows; x++) {
+		exp.reset();
+		exp.append_fmt("name%d", x);
+
+		row = NEW_ROW(exp.chars(), "123456789");
+		s = w.write(row, list_md);
+		delete row;
+
+		if (s != 0) {
+			T.expect_signed(0, s);
+			break;
+		}
+	}
+
+	w.close();
+
+	DSVRecord::INIT_ROW(&row, list_md->size());
+
+	T.expect_error(NULL, reader.open_ro(TEST_FILE));
+
+	do {
+		row->columns_reset();
+		s = reader.read(row, list_md);
+		if (s != 1) {
+			continue;
+		}
+
+		exp.reset();
+		exp.append_fmt("name%d", n);
+		if (row->like(&exp) != 0) {
+			T.expect_string(exp.chars(), row->chars());
+			break;
+		}
+		++n;
+	} while (s != 0);
+
+	T.expect_signed(n_rows, n);
+	T.ok();
+
+	delete row;
+	delete list_md;
+}
+
+int main()
+{
+	test_write();
+	test_write_many();
+
+	unlink(TEST_FILE);
+
+	return 0;
+}
+// vi: ts=8 sw=8 tw=80:
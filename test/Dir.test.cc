@@ -4,12 +4,20 @@
 // in the LICENSE file.
 //
 
+#include <utime.h>
 #include "test.hh"
 #include "../Dir.hh"
 
+using vos::Buffer;
 using vos::Dir;
+using vos::DirName;
 using vos::DirNode;
 
+Test T("Dir");
+
+#define SCAN_D	"dir_scan"
+#define SCAN_N	4
+
 struct ExpDirNode {
 	const char* name;
 	int is_dir;
@@ -55,8 +63,526 @@ void test_open()
 	}
 }
 
+//
+// SCAN_TREE will create or remove directory tree for testing scan, with
+// SCAN_N directories in each levels and SCAN_N files in the last level.
+//
+static void SCAN_TREE(int create)
+{
+	Buffer p;
+
+	if (create) {
+		mkdir(SCAN_D, 0700);
+	}
+	for (int x = 0; x < SCAN_N; x++) {
+		for (int y = 0; y < SCAN_N; y++) {
+			p.reset();
+			p.append_fmt(SCAN_D "/%c%d/s%d", x % 2 ? 'D' : 'd', x
+				, y);
+			if (create) {
+				Dir::CREATES(p.v());
+			}
+			for (int z = 0; z < SCAN_N; z++) {
+				p.reset();
+				p.append_fmt(SCAN_D "/%c%d/s%d/f%d"
+					, x % 2 ? 'D' : 'd', x, y, z);
+				if (create) {
+					close(creat(p.v(), 0600));
+				} else {
+					unlink(p.v());
+				}
+			}
+			if (! create) {
+				p.reset();
+				p.append_fmt(SCAN_D "/%c%d/s%d"
+					, x % 2 ? 'D' : 'd', x, y);
+				rmdir(p.v());
+			}
+		}
+		if (! create) {
+			p.reset();
+			p.append_fmt(SCAN_D "/%c%d", x % 2 ? 'D' : 'd', x);
+			rmdir(p.v());
+		}
+	}
+	if (! create) {
+		rmdir(SCAN_D);
+	}
+}
+
+//
+// TREE_STR will convert name of all nodes in `node` into string.
+//
+static void TREE_STR(Buffer* out, DirNode* node)
+{
+	for (; node; node = node->_next) {
+		out->append_raw(node->_name.v(), node->_name.len());
+		if (node->_child) {
+			out->appendc('(');
+			TREE_STR(out, node->_child);
+			out->appendc(')');
+		}
+		out->appendc(';');
+	}
+}
+
+void test_open_parallel()
+{
+	struct {
+		const char* desc;
+		int n_thread;
+		int max_fd;
+		int depth;
+	} const tests[] = {{
+		"With one thread"
+	,	1
+	,	256
+	,	-1
+	},{
+		"With many threads"
+	,	4
+	,	256
+	,	-1
+	},{
+		"With many threads and full queue"
+	,	4
+	,	1
+	,	-1
+	},{
+		"With depth"
+	,	4
+	,	256
+	,	2
+	}};
+
+	Buffer exp;
+	Buffer got;
+	Buffer first;
+	Buffer s_dir;
+
+	SCAN_TREE(1);
+
+	exp.append_raw("D1(");
+	for (int y = 0; y < SCAN_N; y++) {
+		exp.append_fmt("s%d(f0;f1;f2;f3;);", y);
+	}
+	exp.append_raw(");");
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		T.start("open", tests[x].desc);
+
+		Dir dir;
+
+		Dir::MAX_FD = tests[x].max_fd;
+		dir._n_thread = tests[x].n_thread;
+
+		T.expect_signed(0, dir.open(SCAN_D, tests[x].depth));
+
+		got.reset();
+		TREE_STR(&got, dir._ls->_child);
+
+		// The tree must be the same as the one scanned by one thread.
+		if (x == 0) {
+			first.copy(&got);
+		} else if (tests[x].depth < 0) {
+			T.expect_string(first.chars(), got.chars());
+		}
+
+		// Names are sorted ignoring the case.
+		T.expect_string("d0", dir._ls->_child->_name.chars());
+		T.expect_string("D1"
+			, dir._ls->_child->_next->_name.chars());
+
+		s_dir.reset();
+		TREE_STR(&s_dir, dir._ls->_child->_next->_child);
+
+		if (tests[x].depth == 2) {
+			T.expect_string("s0;s1;s2;s3;", s_dir.chars());
+		} else {
+			got.reset();
+			got.append_raw("D1(");
+			got.append(&s_dir);
+			got.append_raw(");");
+			T.expect_string(exp.chars(), got.chars());
+		}
+
+		T.ok();
+	}
+
+	Dir::MAX_FD = 256;
+	SCAN_TREE(0);
+}
+
+void test_open_lazy()
+{
+	Dir dir;
+	Buffer path;
+	DirNode* node = NULL;
+
+	SCAN_TREE(1);
+
+	T.start("open", "With lazy");
+
+	dir._lazy = 1;
+
+	T.expect_signed(0, dir.open(SCAN_D));
+	T.expect_signed(1, dir._ls->_child == NULL);
+	T.expect_unsigned(0, dir._n_node);
+	T.ok();
+
+	T.start("get_node", "With lazy");
+
+	path.append(&dir._name);
+	path.append_raw("/D1/s2");
+
+	node = dir.get_node(&path, dir._name.v(), dir._name.len());
+
+	T.expect_signed(1, node != NULL);
+	T.expect_string("s2", node->_name.chars());
+	T.expect_string("f0", node->_child->_name.chars());
+	T.expect_signed(1, dir._ls->_child->_child == NULL);
+	T.expect_unsigned(SCAN_N * 3, dir._n_node);
+	T.ok();
+
+	T.start("evict", "With lazy");
+
+	path.reset();
+	path.append(&dir._name);
+	path.append_raw("/d0/s1");
+
+	dir.get_node(&path, dir._name.v(), dir._name.len());
+	T.expect_unsigned(SCAN_N * 5, dir._n_node);
+
+	// Directory D1 is the oldest visited.
+	dir._max_node = SCAN_N * 3;
+	dir.evict();
+
+	T.expect_unsigned(SCAN_N * 3, dir._n_node);
+	T.expect_signed(1, dir._ls->_child->_next->_child == NULL);
+
+	node = dir._ls->_child->_child->_next;
+
+	T.expect_string("s1", node->_name.chars());
+	T.expect_string("f0", node->_child->_name.chars());
+	T.ok();
+
+	SCAN_TREE(0);
+}
+
+//
+// CHILD_STR will return names of child of `path`, relative to root of `dir`.
+//
+static const char* CHILD_STR(Dir* dir, Buffer* out, const char* path)
+{
+	Buffer p;
+	DirNode* node = NULL;
+
+	p.append(&dir->_name);
+	p.append_raw(path);
+
+	out->reset();
+
+	node = dir->get_node(&p, dir->_name.v(), dir->_name.len());
+	if (node) {
+		TREE_STR(out, node->_child);
+	}
+	return out->chars();
+}
+
+void test_watch()
+{
+	struct {
+		const char* desc;
+		int lazy;
+		const char* exp;
+	} const tests[] = {{
+		"Without lazy"
+	,	0
+	,	"f2;f3;f8;f9;new(f;);"
+	},{
+		// New directory is not loaded until it is visited.
+		"With lazy"
+	,	1
+	,	"f2;f3;f8;f9;new;"
+	}};
+
+	Buffer got;
+
+	SCAN_TREE(1);
+
+	for (size_t x = 0; x < ARRAY_SIZE(tests); x++) {
+		Dir dir;
+
+		T.start("watch", tests[x].desc);
+
+		dir._lazy = tests[x].lazy;
+
+		T.expect_signed(0, dir.open(SCAN_D));
+
+		// Load directory before watching it.
+		CHILD_STR(&dir, &got, "/D1/s2");
+
+		T.expect_signed(0, dir.watch());
+		T.expect_signed(1, dir.is_watching());
+		T.ok();
+
+		T.start("sync", tests[x].desc);
+
+		close(creat(SCAN_D "/D1/s2/f9", 0600));
+		unlink(SCAN_D "/D1/s2/f0");
+		rename(SCAN_D "/D1/s2/f1", SCAN_D "/D1/s2/f8");
+		mkdir(SCAN_D "/D1/s2/new", 0700);
+		close(creat(SCAN_D "/D1/s2/new/f", 0600));
+
+		T.expect_signed(1, dir.sync() > 0);
+		T.expect_string(tests[x].exp, CHILD_STR(&dir, &got, "/D1/s2"));
+
+		rename(SCAN_D "/D1/s2/new", SCAN_D "/D1/s2/old");
+		close(creat(SCAN_D "/D1/s2/old/g", 0600));
+
+		T.expect_signed(1, dir.sync() > 0);
+		T.expect_string("f;g;", CHILD_STR(&dir, &got, "/D1/s2/old"));
+
+		unlink(SCAN_D "/D1/s2/old/f");
+		unlink(SCAN_D "/D1/s2/old/g");
+		rmdir(SCAN_D "/D1/s2/old");
+		rename(SCAN_D "/D1/s2/f8", SCAN_D "/D1/s2/f1");
+		unlink(SCAN_D "/D1/s2/f9");
+		close(creat(SCAN_D "/D1/s2/f0", 0600));
+
+		T.expect_signed(1, dir.sync() > 0);
+		T.expect_string("f0;f1;f2;f3;"
+			, CHILD_STR(&dir, &got, "/D1/s2"));
+		T.expect_signed(0, dir.sync());
+		T.ok();
+	}
+
+	SCAN_TREE(0);
+}
+
+void test_get_child()
+{
+	const int n_file = 100;
+	Dir dir;
+	Buffer p;
+	DirNode* node = NULL;
+	int n_found = 0;
+
+	mkdir(SCAN_D, 0700);
+	for (int x = 0; x < n_file; x++) {
+		p.reset();
+		p.append_fmt(SCAN_D "/f%d", x);
+		close(creat(p.v(), 0600));
+	}
+
+	T.start("get_child", "With index");
+
+	T.expect_signed(0, dir.open(SCAN_D));
+	T.expect_signed(1, dir._ls->_idx == NULL);
+
+	for (int x = 0; x < n_file; x++) {
+		p.reset();
+		p.append_fmt("f%d", x);
+		node = dir._ls->get_child(p.v());
+		if (node && node->_name.cmp_raw(p.v(), p.len()) == 0) {
+			n_found++;
+		}
+	}
+
+	T.expect_signed(1, dir._ls->_idx != NULL);
+	T.expect_signed(n_file, n_found);
+	T.expect_signed(1, dir._ls->get_child("f100") == NULL);
+	T.ok();
+
+	T.start("get_child", "After INSERT_CHILD and REMOVE_CHILD_BY_NAME");
+
+	close(creat(SCAN_D "/f100", 0600));
+	T.expect_signed(0, DirNode::INSERT_CHILD(dir._ls, SCAN_D "/f100"
+		, "f100"));
+	T.expect_signed(0, DirNode::REMOVE_CHILD_BY_NAME(dir._ls, "f50"));
+
+	T.expect_signed(1, dir._ls->get_child("f100") != NULL);
+	T.expect_signed(1, dir._ls->get_child("f50") == NULL);
+	T.expect_signed(1, dir.find(dir._ls, "f99") != NULL);
+
+	p.reset();
+	p.append(&dir._name);
+	p.append_raw("/f42");
+	node = dir.get_node(&p, dir._name.v(), dir._name.len());
+	T.expect_signed(1, node != NULL);
+	T.expect_string("f42", node->_name.chars());
+	T.ok();
+
+	for (int x = 0; x <= n_file; x++) {
+		p.reset();
+		p.append_fmt(SCAN_D "/f%d", x);
+		unlink(p.v());
+	}
+	rmdir(SCAN_D);
+}
+
+//
+// test_refresh_index will check that the index of child nodes, that is
+// built by get_child(), is still valid after directory is read again by
+// refresh_by_path().
+//
+void test_refresh_index()
+{
+	const int n_file = 40;
+	Dir dir;
+	Buffer p;
+	struct utimbuf t = { 1000, 1000 };
+	int n_child = 0;
+
+	mkdir(SCAN_D, 0700);
+	for (int x = 0; x < n_file; x++) {
+		p.reset();
+		p.append_fmt(SCAN_D "/f%d", x);
+		close(creat(p.v(), 0600));
+	}
+	// Make the directory old, so adding file is seen as modification.
+	utime(SCAN_D, &t);
+
+	T.start("refresh_by_path", "With index of child");
+
+	T.expect_signed(0, dir.open(SCAN_D));
+	T.expect_signed(1, dir._ls->get_child("none") == NULL);
+	T.expect_signed(1, dir._ls->_idx != NULL);
+
+	close(creat(SCAN_D "/new", 0600));
+	T.expect_signed(1, dir.refresh_by_path(&dir._name) > 0);
+
+	for (DirNode* c = dir._ls->_child; c; c = c->_next) {
+		n_child++;
+	}
+	T.expect_signed(n_file + 1, n_child);
+	T.expect_signed(1, dir._ls->get_child("f5") != NULL);
+	T.expect_signed(1, dir._ls->get_child("f39") != NULL);
+	T.expect_signed(1, dir._ls->get_child("new") != NULL);
+	T.expect_signed(1, dir._ls->get_child("none") == NULL);
+	T.ok();
+
+	dir.close();
+	for (int x = 0; x < n_file; x++) {
+		p.reset();
+		p.append_fmt(SCAN_D "/f%d", x);
+		unlink(p.v());
+	}
+	unlink(SCAN_D "/new");
+	rmdir(SCAN_D);
+}
+
+//
+// GROW_FILE will append `n` bytes to file `path` and set its modification
+// time back to `mtime`, as if file is modified in the same second.
+//
+static void GROW_FILE(const char* path, size_t n, time_t mtime)
+{
+	int fd = open(path, O_WRONLY | O_APPEND);
+	struct utimbuf t = { mtime, mtime };
+
+	assert(fd >= 0);
+	for (size_t x = 0; x < n; x++) {
+		assert(write(fd, "x", 1) == 1);
+	}
+	close(fd);
+	utime(path, &t);
+}
+
+void test_update_attr()
+{
+	int s = 0;
+	Dir dir;
+	DirNode* node = NULL;
+	DirNode* child = NULL;
+
+	mkdir(SCAN_D, 0700);
+	close(creat(SCAN_D "/f0", 0600));
+
+	T.expect_signed(0, dir.open(SCAN_D));
+	node = dir._ls->get_child("f0");
+	assert(node != NULL);
+
+	T.start("update_attr", "Without change");
+	T.expect_signed(0, node->update_attr(node, SCAN_D "/f0"));
+	T.expect_signed(0, dir._ls->update_child_attr(&child, SCAN_D "/f0"
+		, "f0"));
+	T.expect_signed(1, child == node);
+	T.ok();
+
+	T.start("update_attr", "With size changed in the same second");
+
+	GROW_FILE(SCAN_D "/f0", 3, node->_mtime);
+
+	s = node->update_attr(node, SCAN_D "/f0");
+	T.expect_signed(vos::_MTIME_CHANGED, s & vos::_MTIME_CHANGED);
+	T.expect_signed(3, node->_size);
+	T.ok();
+
+	T.start("update_child_attr", "With size changed in the same second");
+
+	GROW_FILE(SCAN_D "/f0", 2, node->_mtime);
+
+	T.expect_signed(1, dir._ls->update_child_attr(&child, SCAN_D "/f0"
+		, "f0"));
+	T.expect_signed(5, node->_size);
+	T.expect_signed(-1, dir._ls->update_child_attr(&child, SCAN_D "/f1"
+		, "f1"));
+	T.ok();
+
+	dir.close();
+	unlink(SCAN_D "/f0");
+	rmdir(SCAN_D);
+}
+
+void test_dir_name()
+{
+	DirName a;
+	DirName b;
+	DirName c;
+	Buffer bfr;
+
+	T.start("DirName", "With same value");
+
+	T.expect_signed(1, a.is_empty());
+	T.expect_string("", a.v());
+
+	bfr.copy_raw("abc");
+	T.expect_error(NULL, a.copy(&bfr));
+	T.expect_error(NULL, b.copy_raw("abcd", 3));
+	T.expect_error(NULL, c.copy_raw("ABD"));
+
+	T.expect_string("abc", b.v());
+	T.expect_unsigned(3, b.len());
+	T.expect_signed(1, a.v() == b.v());
+	T.expect_signed(0, a.cmp(&b));
+	T.expect_signed(1, a.cmp(&c));
+	T.expect_signed(-1, a.like(&c));
+	T.expect_signed(1, c.like(&a));
+	T.expect_signed(0, a.cmp_raw("abc"));
+	T.expect_signed(1, a.cmp_raw("ab"));
+	T.ok();
+
+	T.start("DirName", "After reset");
+
+	a.reset();
+	T.expect_signed(1, a.is_empty());
+	T.expect_string("abc", b.v());
+
+	T.expect_error(NULL, a.copy_raw("abc"));
+	T.expect_signed(1, a.v() == b.v());
+	T.ok();
+}
+
 int main()
 {
 	test_open();
+	test_open_parallel();
+	test_open_lazy();
+	test_watch();
+	test_get_child();
+	test_refresh_index();
+	test_update_attr();
+	test_dir_name();
 	return 0;
 }
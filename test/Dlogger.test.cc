@@ -33,9 +33,41 @@ void test_prefix()
 	dlog.close();
 }
 
+void test_rotate()
+{
+	const char* files[] = { "log.rotate", "log.rotate.1", "log.rotate.2"
+		, "log.rotate.3" };
+
+	for (size_t x = 0; x < ARRAY_SIZE(files); x++) {
+		unlink(files[x]);
+	}
+
+	dlog.open(files[0], 64, "", 0, 2);
+
+	for (int x = 0; x < 16; x++) {
+		dlog.it("line %d is a log line\n", x);
+	}
+
+	dlog.close();
+
+	assert(vos::File::IS_EXIST(files[0], O_RDONLY) == 1);
+	assert(vos::File::IS_EXIST(files[1], O_RDONLY) == 1);
+	assert(vos::File::IS_EXIST(files[2], O_RDONLY) == 1);
+	assert(vos::File::IS_EXIST(files[3], O_RDONLY) == 0);
+
+	off_t size = 0;
+
+	for (size_t x = 0; x < 3; x++) {
+		vos::File::GET_SIZE(files[x], &size);
+		assert(size > 0 && size <= 64);
+		unlink(files[x]);
+	}
+}
+
 int main()
 {
 	test_prefix();
+	test_rotate();
 
 	return 0;
 }
@@ -81,6 +81,39 @@ void test_operator_assign()
 	T.ok();
 }
 
+void test_assign_with_data()
+{
+	const char* big = "data that is longer than inline size";
+	const char* small = "small";
+
+	T.start("operator=", "Over error that own data");
+
+	Error err = vos::ErrUnknown.with(big, strlen(big));
+
+	err = vos::ErrUnknown.with(small, strlen(small));
+
+	T.expect_signed(1, err == vos::ErrUnknown, vos::IS_EQUAL);
+	T.expect_string(small, err.data_as_string(), vos::IS_EQUAL);
+
+	err = vos::ErrOutOfMemory;
+
+	T.expect_ptr(NULL, err.data(), vos::IS_EQUAL);
+
+	{
+		Error src = vos::ErrUnknown.with(big, strlen(big));
+
+		err = src;
+	}
+
+	T.expect_string(big, err.data_as_string(), vos::IS_EQUAL);
+
+	err = err;
+
+	T.expect_string(big, err.data_as_string(), vos::IS_EQUAL);
+
+	T.ok();
+}
+
 void test_with()
 {
 	int data = 10;
@@ -149,12 +182,42 @@ void test_data_as()
 	T.ok();
 }
 
+void test_sys()
+{
+	T.start("SYS()");
+
+	errno = ENOENT;
+	Error err = Error::SYS();
+
+	errno = ENOENT;
+	Error err2 = Error::SYS();
+
+	errno = EACCES;
+	Error err3 = Error::SYS();
+
+	T.expect_signed(ENOENT, err.errnum(), vos::IS_EQUAL);
+	T.expect_signed(1, err == err2, vos::IS_EQUAL);
+	T.expect_ptr(err.chars(), err2.chars(), vos::IS_EQUAL);
+	T.expect_string(strerror(ENOENT), err.chars(), vos::IS_EQUAL);
+	T.expect_signed(1, err != err3, vos::IS_EQUAL);
+
+	errno = 0;
+	Error err4 = Error::SYS();
+
+	T.expect_signed(1, err4 == vos::ErrUnknown, vos::IS_EQUAL);
+	T.expect_signed(0, err4.data_as_signed(), vos::IS_EQUAL);
+
+	T.ok();
+}
+
 int main()
 {
 	test_equality();
 	test_operator_assign();
+	test_assign_with_data();
 	test_with();
 	test_data_as();
+	test_sys();
 
 	return 0;
 }
@@ -7,13 +7,22 @@
 #include "test.hh"
 #include "../FTPD.hh"
 
+using vos::Buffer;
+using vos::Dir;
+using vos::DirNode;
+using vos::File;
 using vos::FTPD;
 
+Test T("FTPD");
+
 #define	TEST_USER_0	"user00"
 #define	TEST_USER_1	"user01"
 #define	TEST_USER_2	"user02"
 #define	TEST_USER_3	"user0"
 
+#define	TEST_DIR	"ftpd_list.d"
+#define	TEST_FILE	TEST_DIR "/f0"
+
 int s;
 FTPD ftpd;
 
@@ -57,8 +66,148 @@ void test_user_add()
 	assert(s == 0);
 }
 
+void test_list_cache()
+{
+	FTPD srv;
+	Buffer out;
+	Buffer p0;
+	Buffer p1;
+	Buffer p2;
+	DirNode dir;
+	struct vos::ftpd_list_cache* lc = NULL;
+
+	srv._list_cache_size = 2;
+
+	p0.copy_raw("/d0");
+	p1.copy_raw("/d1");
+	p2.copy_raw("/d2");
+	out.copy_raw("f0\r\n");
+	dir._mtime = 1;
+	dir._ctime = 1;
+
+	T.start("list_cache", "Without output");
+	T.expect_signed(1, srv.list_cache_get(&p0, &dir, 0, 0) == NULL);
+	T.ok();
+
+	T.start("list_cache", "With output");
+
+	srv.list_cache_put(&p0, &dir, 0, 0, &out);
+
+	lc = srv.list_cache_get(&p0, &dir, 0, 0);
+	T.expect_signed(1, lc != NULL);
+	T.expect_string("f0\r\n", lc ? lc->out.chars() : "");
+	T.expect_signed(1, srv.list_cache_get(&p0, &dir, 1, 0) == NULL);
+	T.expect_signed(1, srv.list_cache_get(&p0, &dir, 0, 1) == NULL);
+	T.ok();
+
+	T.start("list_cache", "After directory modified");
+
+	srv.list_cache_put(&p0, &dir, 0, 0, &out);
+	dir._mtime = 2;
+	T.expect_signed(1, srv.list_cache_get(&p0, &dir, 0, 0) == NULL);
+	T.ok();
+
+	T.start("list_cache", "With full cache");
+
+	srv.list_cache_put(&p0, &dir, 0, 0, &out);
+	srv.list_cache_put(&p1, &dir, 0, 0, &out);
+	T.expect_signed(1, srv.list_cache_get(&p0, &dir, 0, 0) != NULL);
+
+	// The least recently used, p1, is replaced.
+	srv.list_cache_put(&p2, &dir, 0, 0, &out);
+	T.expect_signed(1, srv.list_cache_get(&p0, &dir, 0, 0) != NULL);
+	T.expect_signed(1, srv.list_cache_get(&p1, &dir, 0, 0) == NULL);
+	T.expect_signed(1, srv.list_cache_get(&p2, &dir, 0, 0) != NULL);
+	T.ok();
+
+	T.start("list_cache", "After clear");
+
+	srv.list_cache_clear();
+	T.expect_signed(1, srv.list_cache_get(&p0, &dir, 0, 0) == NULL);
+	T.expect_signed(1, srv.list_cache_get(&p2, &dir, 0, 0) == NULL);
+	T.ok();
+
+	T.start("list_cache", "With output larger than LIST_CACHE_MAX");
+
+	out.reset();
+	for (size_t x = 0; x <= FTPD::LIST_CACHE_MAX; x += 8) {
+		out.append_raw("01234567");
+	}
+	srv.list_cache_put(&p0, &dir, 0, 0, &out);
+	T.expect_signed(1, srv.list_cache_get(&p0, &dir, 0, 0) == NULL);
+	T.ok();
+}
+
+//
+// WRITE_FILE will replace the content of TEST_FILE with `v`.
+//
+static void WRITE_FILE(const char* v)
+{
+	File f;
+
+	Error err = f.open_wt(TEST_FILE);
+	assert(err == NULL);
+	f.write_raw(v);
+	f.close();
+}
+
+void test_list_refresh()
+{
+	FTPD srv;
+	Buffer out;
+	Buffer path;
+	DirNode* node = NULL;
+
+	Dir::CREATE(TEST_DIR);
+	WRITE_FILE("abc");
+
+	s = srv._dir.open(TEST_DIR);
+	assert(s == 0);
+	path.copy(&srv._dir._name);
+	out.copy_raw("f0\r\n");
+
+	T.start("list_refresh", "Without change");
+
+	srv.list_cache_put(&path, srv._dir._ls, 0, 0, &out);
+	T.expect_signed(0, srv.list_refresh(&path));
+	T.expect_signed(1
+		, srv.list_cache_get(&path, srv._dir._ls, 0, 0) != NULL);
+	T.ok();
+
+	// Modifying a file does not change its directory, so by default the
+	// cached output is kept.
+	T.start("list_refresh", "After file size changed without stat child");
+
+	WRITE_FILE("abcd");
+
+	T.expect_signed(0, srv.list_refresh(&path));
+	T.expect_signed(1
+		, srv.list_cache_get(&path, srv._dir._ls, 0, 0) != NULL);
+	T.ok();
+
+	T.start("list_refresh", "After file size changed");
+
+	srv._dir._stat_child = 1;
+	WRITE_FILE("abcdefg");
+
+	T.expect_signed(0, srv.list_refresh(&path));
+	T.expect_signed(1
+		, srv.list_cache_get(&path, srv._dir._ls, 0, 0) == NULL);
+
+	node = srv._dir._ls->get_child("f0");
+	T.expect_signed(1, node != NULL);
+	T.expect_signed(7, node ? node->_size : 0);
+	T.ok();
+
+	srv._dir.close();
+	unlink(TEST_FILE);
+	rmdir(TEST_DIR);
+}
+
 int main()
 {
 	test_user_add();
+	test_list_cache();
+	test_list_refresh();
 	return 0;
 }
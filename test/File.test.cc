@@ -7,6 +7,7 @@
 #include "test.hh"
 #include "../File.hh"
 
+using vos::Buffer;
 using vos::File;
 
 Test T("File");
@@ -214,8 +215,18 @@ void test_BASENAME()
 
 void test_COPY()
 {
+	File big;
+	Buffer exp;
+	Buffer got;
+
 	unlink("LICENSE.copy");
 
+	big.open_wt("COPY.big");
+	for (int x = 0; x < 20000; x++) {
+		big.writef("%09d\n", x);
+	}
+	big.close();
+
 	struct {
 		const char* desc;
 		const char* src;
@@ -252,6 +263,18 @@ void test_COPY()
 	,	"LICENSE.copy"
 	,	NULL
 	,	1949
+	},{
+		"With large file"
+	,	"COPY.big"
+	,	"COPY.big.copy"
+	,	NULL
+	,	200000
+	},{
+		"With non regular file"
+	,	"/dev/null"
+	,	"LICENSE.copy"
+	,	NULL
+	,	0
 	}};
 
 	int tests_len = ARRAY_SIZE(tests);
@@ -275,7 +298,25 @@ void test_COPY()
 		T.ok();
 	}
 
+	T.start("COPY()", "With large file, compare content");
+
+	big.open_ro("COPY.big");
+	big.read(200000);
+	exp.copy(&big);
+	big.close();
+
+	big.open_ro("COPY.big.copy");
+	big.read(200000);
+	got.copy(&big);
+	big.close();
+
+	T.expect_unsigned(exp.len(), got.len());
+	T.expect_signed(0, memcmp(exp.v(), got.v(), exp.len()));
+	T.ok();
+
 	unlink("LICENSE.copy");
+	unlink("COPY.big");
+	unlink("COPY.big.copy");
 }
 
 void test_TOUCH()
@@ -0,0 +1,175 @@
+//
+// Copyright 2017 M. Shulhan (ms@kilabit.info). All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+
+#include <sys/select.h>
+#include "test.hh"
+#include "../IOUring.hh"
+
+using vos::Buffer;
+using vos::File;
+using vos::IOUring;
+
+Test T("IOUring");
+
+#define N_FILE	3
+
+static const char* FILES[N_FILE] = {
+	"io_uring.0"
+,	"io_uring.1"
+,	"io_uring.2"
+};
+
+//
+// CONTENT will set `out` to the content of file number `n`.
+//
+static void CONTENT(Buffer* out, int n)
+{
+	out->reset();
+	for (int x = 0; x <= n * 100; x++) {
+		out->append_fmt("file %d line %d\n", n, x);
+	}
+}
+
+void test_read_write(const char* desc, int use_ring)
+{
+	IOUring ring;
+	IOUring small;
+	File f[N_FILE];
+	File* fs[N_FILE];
+	Buffer exp[N_FILE];
+	struct vos::io_uring_res res[N_FILE];
+	int n = 0;
+	int x = 0;
+
+	T.start("open", desc);
+	T.expect_error(NULL, ring.open(4, use_ring));
+	T.expect_signed(use_ring, ring.is_ring());
+	T.ok();
+
+	T.start("write", desc);
+
+	for (x = 0; x < N_FILE; x++) {
+		CONTENT(&exp[x], x);
+		f[x].open_wt(FILES[x]);
+		f[x].copy(&exp[x]);
+		T.expect_error(NULL, ring.write(&f[x], (void*) &FILES[x]));
+	}
+
+	n = ring.wait(res, N_FILE, N_FILE);
+	T.expect_signed(N_FILE, n);
+
+	for (x = 0; x < n; x++) {
+		int i = int((const char**) res[x].data - FILES);
+
+		T.expect_signed(vos::IO_URING_WRITE, res[x].op);
+		T.expect_signed(int(exp[i].len()), res[x].res);
+		T.expect_unsigned(0, res[x].file->len());
+	}
+	T.expect_unsigned(0, ring._n_flight);
+	T.ok();
+
+	for (x = 0; x < N_FILE; x++) {
+		f[x].close();
+	}
+
+	T.start("read", desc);
+
+	for (x = 0; x < N_FILE; x++) {
+		f[x].open_ro(FILES[x]);
+		f[x].resize(8192);
+		fs[x] = &f[x];
+	}
+	T.expect_error(NULL, ring.register_files(fs, N_FILE));
+
+	for (x = 0; x < N_FILE; x++) {
+		T.expect_error(NULL, ring.read(&f[x], (void*) &FILES[x]));
+	}
+	T.expect_error(NULL, ring.submit());
+
+	if (ring.is_ring()) {
+		fd_set fds;
+		struct timeval tv = { 5, 0 };
+
+		FD_ZERO(&fds);
+		FD_SET(ring.fd(), &fds);
+		T.expect_signed(1, select(ring.fd() + 1, &fds, NULL, NULL
+			, &tv));
+	}
+
+	n = 0;
+	while (n < N_FILE) {
+		int s = ring.wait(&res[n], N_FILE - n, 1);
+		if (s <= 0) {
+			break;
+		}
+		n += s;
+	}
+	T.expect_signed(N_FILE, n);
+
+	for (x = 0; x < n; x++) {
+		int i = int((const char**) res[x].data - FILES);
+
+		T.expect_signed(vos::IO_URING_READ, res[x].op);
+		T.expect_signed(int(exp[i].len()), res[x].res);
+		T.expect_string(exp[i].chars(), res[x].file->chars());
+	}
+	T.ok();
+
+	T.start("read", "At end of file");
+
+	T.expect_error(NULL, ring.read(&f[0]));
+	T.expect_signed(1, ring.wait(res, 1));
+	T.expect_signed(0, res[0].res);
+	T.expect_unsigned(0, f[0].len());
+	T.ok();
+
+	T.start("read", "With file not opened");
+
+	File closed;
+
+	T.expect_error(vos::ErrIOUringNotOpen, ring.read(&closed));
+	T.expect_error(vos::ErrIOUringNotOpen, ring.write(&closed));
+	T.expect_unsigned(0, ring._n_flight);
+	T.ok();
+
+	T.start("read", "With too many requests");
+
+	T.expect_error(NULL, small.open(2, use_ring));
+	T.expect_error(NULL, small.read(&f[0]));
+	T.expect_error(NULL, small.read(&f[1]));
+	T.expect_error(vos::ErrIOUringFull, small.read(&f[2]));
+	T.expect_signed(2, small.wait(res, N_FILE, 2));
+	T.expect_error(NULL, small.read(&f[2]));
+	T.expect_signed(1, small.wait(res, N_FILE));
+	T.ok();
+
+	T.start("write", "With read only file");
+	T.expect_error(vos::ErrFileReadOnly, ring.write(&f[0]));
+	T.ok();
+
+	ring.close();
+
+	for (x = 0; x < N_FILE; x++) {
+		f[x].close();
+		unlink(FILES[x]);
+	}
+}
+
+int main()
+{
+	IOUring probe;
+
+	probe.open();
+
+	// Kernel may not support io_uring, or it is disabled.
+	if (probe.is_ring()) {
+		test_read_write("With io_uring", 1);
+	}
+	test_read_write("With fallback", 0);
+
+	return 0;
+}
+// vi: ts=8 sw=8 tw=80:
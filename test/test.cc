@@ -20,4 +20,31 @@ int expectString(const char* exp, const char* got, int to)
 	exit(1);
 }
 
+//
+// readLines will read all lines in file `name` into `out`, each line
+// terminated by ';' instead of new line, and return number of lines.
+//
+int readLines(const char* name, vos::Buffer* out)
+{
+	int n = 0;
+	vos::File f;
+	vos::Buffer line;
+
+	out->reset();
+
+	Error err = f.open_ro(name);
+	assert(err == NULL);
+
+	while (f.get_line(&line) == NULL) {
+		if (line.len() > 0 && line.v()[line.len() - 1] == '\n') {
+			line.truncate(line.len() - 1);
+		}
+		out->append(&line);
+		out->appendc(';');
+		++n;
+	}
+
+	return n;
+}
+
 // vi: ts=8 sw=8 tw=80:
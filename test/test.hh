@@ -26,5 +26,6 @@ using vos::Error;
 #define STR_TEST_2	"test 2"
 
 extern int expectString(const char* exp, const char* got, int to);
+extern int readLines(const char* name, vos::Buffer* out);
 
 // vi: ts=8 sw=8 tw=80: